@@ -0,0 +1,80 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of the region allocator.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "utility.h"
+
+static const size_t Alignment = 16;
+static const size_t AstChunkSize = 256 * 1024;
+
+Arena::Arena(size_t size)
+    : chunkSize(size), current(-1), used(0), before(0), limit(0), exceeded(NULL) {}
+
+Arena::~Arena() {
+    for (int i = 0; i < chunks.size(); i++)
+        free(chunks[i].base);
+}
+
+void *Arena::Allocate(size_t size) {
+    size = (size + Alignment - 1) & ~(Alignment - 1);
+    if (current < 0 || used + size > chunks[current].size) {
+        // Move on to the next chunk, reusing one kept from before the
+        // last Release() if it is big enough.
+        if (limit && BytesSince(limitMark) + size > limit) exceeded();
+        if (current >= 0) before += chunks[current].size;
+        current++;
+        if (current == chunks.size() || chunks[current].size < size) {
+            Chunk chunk;
+            chunk.size = size > chunkSize ? size : chunkSize;
+            chunk.base = (char *)malloc(chunk.size);
+            if (!chunk.base) Failure("Out of memory!");
+            chunks.insert(chunks.begin() + current, chunk);
+        }
+        used = 0;
+    }
+    void *p = chunks[current].base + used;
+    used += size;
+    return p;
+}
+
+char *Arena::Strdup(const char *str) {
+    size_t len = strlen(str) + 1;
+    return (char *)memcpy(Allocate(len), str, len);
+}
+
+void Arena::SetLimit(size_t bytes, void (*handler)()) {
+    limit = bytes;
+    limitMark = GetMark();
+    exceeded = handler;
+}
+
+Arena::Mark Arena::GetMark() const {
+    Mark mark;
+    mark.chunk = current;
+    mark.used = used;
+    return mark;
+}
+
+void Arena::Release(Mark mark) {
+    current = mark.chunk;
+    used = mark.used;
+    before = 0;
+    for (int i = 0; i < current; i++)
+        before += chunks[i].size;
+}
+
+size_t Arena::BytesSince(Mark mark) const {
+    size_t now = before + used, then = mark.used;
+    for (int i = 0; i < mark.chunk; i++)
+        then += chunks[i].size;
+    return now - then;
+}
+
+Arena &AstArena() {
+    static Arena arena(AstChunkSize);
+    return arena;
+}
@@ -0,0 +1,94 @@
+/**
+ * File: arena.h
+ * -------------
+ * A simple region allocator. Memory is handed out by bumping a pointer
+ * through large chunks and is never freed piece by piece; instead a
+ * caller takes a Mark and later releases everything allocated since,
+ * all at once. Released chunks are kept and reused, so a process that
+ * repeatedly checks shaders settles at a fixed footprint instead of
+ * growing, and stops taking page faults once it is warm.
+ *
+ * All AST nodes, their locations and identifier names, and the Lists
+ * that hold them are allocated from the arena returned by AstArena().
+ * Objects in an arena are not destroyed when it is released, so
+ * anything that owns heap memory of its own must not live there (List
+ * uses ArenaAllocator for its storage for this reason).
+ *
+ * An arena is not thread-safe.
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+#include <vector>
+
+class Arena {
+  public:
+    struct Mark {
+        int chunk;
+        size_t used;
+    };
+
+    Arena(size_t chunkSize);
+    ~Arena();
+
+    void *Allocate(size_t size);
+    char *Strdup(const char *str);
+
+    Mark GetMark() const;
+    void Release(Mark mark);
+
+    // Returns the number of bytes taken up since mark, counting the
+    // unused tails of any chunks filled in between
+    size_t BytesSince(Mark mark) const;
+
+    // While limit is not 0, Allocate() calls exceeded (which must not
+    // return) instead of taking more than limit bytes since the mark
+    // current when the limit was set. The limit is only checked when
+    // moving on to another chunk, so allocating stays a pointer bump.
+    void SetLimit(size_t limit, void (*exceeded)());
+
+  private:
+    struct Chunk {
+        char *base;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t chunkSize;
+    int current;        // index of the chunk being filled
+    size_t used;        // bytes used in the current chunk
+    size_t before;      // total size of all earlier chunks
+    size_t limit;
+    Mark limitMark;
+    void (*exceeded)();
+};
+
+/* Function: AstArena()
+ * --------------------
+ * The arena the AST lives in. It is created on first use, so it is safe
+ * to allocate nodes during static initialization (as ast_type.cc does).
+ */
+Arena &AstArena();
+
+/* Class: ArenaAllocator
+ * ---------------------
+ * Standard allocator that takes its memory from AstArena(); deallocation
+ * is a no-op.
+ */
+template<class T> class ArenaAllocator {
+  public:
+    typedef T value_type;
+
+    ArenaAllocator() {}
+    template<class U> ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t n)
+        { return (T *)AstArena().Allocate(n * sizeof(T)); }
+    void deallocate(T *, size_t) {}
+
+    template<class U> bool operator==(const ArenaAllocator<U> &) const { return true; }
+    template<class U> bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+#endif
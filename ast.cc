@@ -6,13 +6,17 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
-#include <string.h> // strdup
+#include "ast_writer.h"
 #include <stdio.h>  // printf
+#include <new>      // placement new
+#include <vector>
 
-SymbolTable * Node::symtable = new SymbolTable();
+using namespace std;
+
+thread_local SymbolTable * Node::symtable = new SymbolTable();
 
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    location = new (AstArena().Allocate(sizeof(yyltype))) yyltype(loc);
     parent = NULL;
 }
 
@@ -28,23 +32,56 @@ Node::Node() {
  * and prints the "print name" of the node. It then will invoke the
  * virtual function PrintChildren which is expected to print the
  * internals of the node (itself & children) as appropriate.
+ *
+ * Rather than recursing, Print keeps the nodes still to be printed on a
+ * stack of its own, so that deeply nested trees cannot overflow the C++
+ * stack: the Print calls a PrintChildren makes for the children only
+ * queue them, and once it returns they are printed in that order.
  */
+struct PrintJob {
+    Node *node;
+    int indentLevel;
+    const char *label;
+};
+
+static bool printing;
+static vector<PrintJob> queued;   // by the PrintChildren running now
+
 void Node::Print(int indentLevel, const char *label) { 
+    PrintJob job = { this, indentLevel, label };
+    if (printing) {
+        queued.push_back(job);
+        return;
+    }
     const int numSpaces = 3;
-    printf("\n");
-    if (GetLocation()) 
-        printf("%*d", numSpaces, GetLocation()->first_line);
-    else 
-        printf("%*s", numSpaces, "");
-    printf("%*s%s%s: ", indentLevel*numSpaces, "", 
-           label? label : "", GetPrintNameForNode());
-   PrintChildren(indentLevel);
+    vector<PrintJob> stack(1, job);
+    printing = true;
+    while (!stack.empty()) {
+        job = stack.back();
+        stack.pop_back();
+        Node *node = job.node;
+        printf("\n");
+        if (node->GetLocation()) 
+            printf("%*d", numSpaces, node->GetLocation()->first_line);
+        else 
+            printf("%*s", numSpaces, "");
+        printf("%*s%s%s: ", job.indentLevel*numSpaces, "", 
+               job.label? job.label : "", node->GetPrintNameForNode());
+        queued.clear();
+        node->PrintChildren(job.indentLevel);
+        stack.insert(stack.end(), queued.rbegin(), queued.rend());
+    }
+    printing = false;
 } 
 	 
 Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+    name = AstArena().Strdup(n);
 } 
 
 void Identifier::PrintChildren(int indentLevel) {
     printf("%s", name);
 }
+
+void Identifier::Serialize(AstWriter *out) {
+    out->WriteString(name);
+}
@@ -38,7 +38,10 @@
 #define _H_ast
 
 #include <stdlib.h>   // for NULL
+#include <string.h>   // for memset
 #include "location.h"
+#include "arena.h"
+#include "bounds.h"
 #include <iostream>
 
 using namespace std;
@@ -46,6 +49,8 @@ using namespace std;
 class SymbolTable;
 class MyStack;
 class FnDecl;
+class AstWriter;
+class GlslWriter;
 
 class Node  {
   protected:
@@ -57,6 +62,13 @@ class Node  {
     Node();
     virtual ~Node() {}
 
+    // Nodes live in the AST arena and are never freed individually.
+    // Several constructors leave optional children unset and count on
+    // fresh memory being zeroed, which reused arena memory is not.
+    void *operator new(size_t size)
+        { Bounds::CountNode(); return memset(AstArena().Allocate(size), 0, size); }
+    void operator delete(void *) {}
+
     yyltype *GetLocation()   { return location; }
     void SetParent(Node *p)  { parent = p; }
     Node *GetParent()        { return parent; }
@@ -69,7 +81,15 @@ class Node  {
     virtual void PrintChildren(int indentLevel)  {}
 
     virtual void Check() {}
-    static SymbolTable * symtable;
+    static thread_local SymbolTable * symtable;
+
+    // Hands the node's fields and children to a writer, see
+    // ast_writer.h. Like PrintChildren(), only the node's own part.
+    virtual void Serialize(AstWriter *out) {}
+    // Writes the node out as GLSL, see glsl.h. Also only the node's own
+    // part: its children go to the writer to be written in their turn.
+    virtual void Emit(GlslWriter *out) {}
+    friend class AstReader;
 };
 
 
@@ -83,6 +103,7 @@ class Identifier : public Node
     const char *GetPrintNameForNode()   { return "Identifier"; }
     char *GetName() const { return name; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
     friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name; }
 };
 
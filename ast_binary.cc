@@ -0,0 +1,532 @@
+/* File: ast_binary.cc
+ * -------------------
+ * Writing and reading binary ASTs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>      // placement new
+#include <map>
+#include <string>
+#include <vector>
+#include "ast_binary.h"
+#include "ast_writer.h"
+#include "ast.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+#include "glc.h"
+
+static const char AstMagic[8] = "glcast";
+
+// Nesting deeper than this is taken for a damaged file
+static const int MaxDepth = 10000;
+
+/* Every kind of node that can be written, by print name. A node's kind
+ * is stored as its position here, so only ever append to this list.
+ */
+enum NodeKind {
+    K_Program, K_StmtBlock, K_DeclStmt, K_ForStmt, K_WhileStmt, K_IfStmt,
+    K_BreakStmt, K_ContinueStmt, K_ReturnStmt, K_Case, K_Default, K_SwitchStmt,
+    K_EmptyExpr, K_IntConstant, K_FloatConstant, K_BoolConstant, K_VarExpr,
+    K_Operator, K_ArithmeticExpr, K_RelationalExpr, K_EqualityExpr, K_AssignExpr,
+    K_PostfixExpr, K_ConditionalExpr, K_ArrayAccess, K_FieldAccess,
+    K_Call, K_Identifier, K_VarDecl, K_FnDecl,
+    NumNodeKinds
+};
+
+static const char *kindNames[NumNodeKinds] = {
+    "Program", "StmtBlock", "DeclStmt", "ForStmt", "WhileStmt", "IfStmt",
+    "BreakStmt", "ContinueStmt", "ReturnStmt", "Case", "Default", "SwitchStmt",
+    "Empty", "IntConstant", "FloatConstant", "BoolConstant", "VarExpr",
+    "Operator", "ArithmeticExpr", "RelationalExpr", "EqualityExpr", "AssignExpr",
+    "PostfixExpr", "ConditionalExpr", "ArrayAccess", "FieldAccess",
+    "Call", "Identifier", "VarDecl", "FnDecl",
+};
+
+// Type codes: none, an array (followed by its element type and count),
+// or the built-in type numbered code - FirstBuiltinType
+enum { T_NoType, T_ArrayType, FirstBuiltinType };
+
+static void AppendUInt(string *out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((char)value);
+}
+
+class BinaryAstWriter : public AstWriter {
+  public:
+    BinaryAstWriter() : failed(false) {}
+
+    void WriteNode(Node *node);
+    void BeginList(int length) { WriteUInt(length); }
+    void EndList() {}
+    void WriteInt(int64_t value);
+    void WriteBool(bool value) { WriteUInt(value); }
+    void WriteDouble(double value);
+    void WriteString(const char *str);
+    void WriteSpan(const yyltype *span);
+    void WriteType(Type *type);
+    void WriteQualifier(TypeQualifier *typeq);
+
+    // The file contents for the tree written so far; false if it holds a
+    // node that has no binary form (only error placeholders do not)
+    bool Finish(string *contents);
+
+  private:
+    string body;
+    string strings;
+    map<string, int> interned;
+    bool failed;
+
+    void WriteUInt(uint64_t value);
+};
+
+void BinaryAstWriter::WriteNode(Node *node) {
+    if (node == NULL) {
+        WriteUInt(0);
+        return;
+    }
+    int kind = 0;
+    while (kind < NumNodeKinds && strcmp(kindNames[kind], node->GetPrintNameForNode()) != 0)
+        kind++;
+    if (kind == NumNodeKinds) {
+        failed = true;
+        WriteUInt(0);
+        return;
+    }
+    WriteUInt(kind + 1);
+    WriteSpan(node->GetLocation());
+    node->Serialize(this);
+}
+
+void BinaryAstWriter::WriteUInt(uint64_t value) {
+    AppendUInt(&body, value);
+}
+
+void BinaryAstWriter::WriteInt(int64_t value) {
+    WriteUInt(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void BinaryAstWriter::WriteDouble(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++)
+        body.push_back((char)(bits >> (8 * i)));
+}
+
+void BinaryAstWriter::WriteString(const char *str) {
+    map<string, int>::iterator found = interned.find(str);
+    if (found == interned.end()) {
+        int index = interned.size();
+        found = interned.insert(make_pair(string(str), index)).first;
+        AppendUInt(&strings, strlen(str));
+        strings += str;
+    }
+    WriteUInt(found->second);
+}
+
+void BinaryAstWriter::WriteSpan(const yyltype *span) {
+    if (span == NULL) {
+        WriteUInt(0);
+        return;
+    }
+    WriteUInt(span->first_line + 1);
+    WriteUInt(span->first_column);
+    WriteInt(span->last_line - span->first_line);
+    WriteUInt(span->last_column);
+}
+
+void BinaryAstWriter::WriteType(Type *type) {
+    if (type == NULL) {
+        WriteUInt(T_NoType);
+    } else if (ArrayType *array = dynamic_cast<ArrayType *>(type)) {
+        WriteUInt(T_ArrayType);
+        WriteSpan(array->GetLocation());
+        WriteType(array->GetElemType());
+        WriteInt(array->GetElemCount());
+    } else if (Type::IndexOf(type) >= 0) {
+        WriteUInt(FirstBuiltinType + Type::IndexOf(type));
+    } else {
+        failed = true;
+        WriteUInt(T_NoType);
+    }
+}
+
+void BinaryAstWriter::WriteQualifier(TypeQualifier *typeq) {
+    WriteUInt(TypeQualifier::IndexOf(typeq) + 1);
+}
+
+bool BinaryAstWriter::Finish(string *contents) {
+    contents->assign(AstMagic, sizeof(AstMagic));
+    char version[8];
+    strncpy(version, GLC_VERSION, sizeof(version));
+    contents->append(version, sizeof(version));
+    AppendUInt(contents, interned.size());
+    *contents += strings;
+    *contents += body;
+    return !failed;
+}
+
+bool WriteAst(Program *program, const char *path) {
+    BinaryAstWriter writer;
+    writer.WriteNode(program);
+    string contents;
+    if (!writer.Finish(&contents)) {
+        fprintf(stderr, "glc: the tree has nodes with no binary form\n");
+        return false;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    size_t done = 0;
+    while (fd >= 0 && done < contents.size()) {
+        ssize_t n = write(fd, contents.data() + done, contents.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    if (fd < 0 || done < contents.size() || close(fd) != 0) {
+        perror("glc: cannot write binary AST");
+        if (fd >= 0) unlink(path);
+        return false;
+    }
+    return true;
+}
+
+
+/* Class: AstReader
+ * ----------------
+ * Rebuilds a tree from the bytes of a binary AST. Any inconsistency sets
+ * failed, after which every read returns a zero or NULL and the caller
+ * gives up on the whole tree.
+ */
+class AstReader {
+  public:
+    AstReader(const char *data, size_t len)
+        : p((const unsigned char *)data), end((const unsigned char *)data + len),
+          failed(false), depth(0) {}
+
+    Program *ReadProgram();
+
+  private:
+    const unsigned char *p, *end;
+    vector<string> strings;
+    bool failed;
+    int depth;
+
+    Node *Fail() { failed = true; return NULL; }
+
+    uint64_t ReadUInt();
+    int64_t ReadInt();
+    double ReadDouble();
+    const char *ReadString();
+    bool ReadSpan(yyltype *span);
+    Type *ReadType();
+    TypeQualifier *ReadQualifier();
+    Node *ReadNode();
+    Node *Build(int kind, const yyltype &span);
+
+    // A child of type T, which must be there unless optional
+    template <class T> T *Read(bool optional = false) {
+        Node *node = ReadNode();
+        T *child = dynamic_cast<T *>(node);
+        if (node != child || (!child && !optional)) Fail();
+        return failed ? NULL : child;
+    }
+
+    template <class T> List<T *> *ReadList() {
+        uint64_t count = ReadUInt();
+        if (count > end - p) Fail();    // every element takes a byte at least
+        List<T *> *list = new List<T *>;
+        for (uint64_t i = 0; !failed && i < count; i++)
+            list->Append(Read<T>());
+        return failed ? NULL : list;
+    }
+
+    // Constructors that join their children's spans need them to have one
+    static bool Located(Node *node) { return node == NULL || node->GetLocation() != NULL; }
+};
+
+uint64_t AstReader::ReadUInt() {
+    uint64_t value = 0;
+    for (int shift = 0; !failed; shift += 7) {
+        if (p == end || shift > 63) {
+            Fail();
+            break;
+        }
+        unsigned char byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    return 0;
+}
+
+int64_t AstReader::ReadInt() {
+    uint64_t value = ReadUInt();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+double AstReader::ReadDouble() {
+    uint64_t bits = 0;
+    if (end - p < 8) Fail();
+    for (int i = 0; !failed && i < 8; i++)
+        bits |= (uint64_t)*p++ << (8 * i);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+const char *AstReader::ReadString() {
+    uint64_t index = ReadUInt();
+    if (index >= strings.size()) Fail();
+    return failed ? NULL : strings[index].c_str();
+}
+
+// Returns whether there is a span, filling it in if so
+bool AstReader::ReadSpan(yyltype *span) {
+    memset(span, 0, sizeof(*span));
+    uint64_t line = ReadUInt();
+    if (line == 0) return false;
+    span->first_line = line - 1;
+    span->first_column = ReadUInt();
+    span->last_line = span->first_line + ReadInt();
+    span->last_column = ReadUInt();
+    return true;
+}
+
+Type *AstReader::ReadType() {
+    uint64_t code = ReadUInt();
+    if (code == T_NoType) return NULL;
+    if (code == T_ArrayType) {
+        yyltype span;
+        ReadSpan(&span);
+        Type *elemType = ReadType();
+        int elemCount = ReadInt();
+        if (!elemType) Fail();
+        return failed ? NULL : new ArrayType(span, elemType, elemCount);
+    }
+    Type *type = Type::WithIndex(code - FirstBuiltinType);
+    if (!type) Fail();
+    return type;
+}
+
+TypeQualifier *AstReader::ReadQualifier() {
+    uint64_t code = ReadUInt();
+    TypeQualifier *typeq = code ? TypeQualifier::WithIndex(code - 1) : NULL;
+    if (code && !typeq) Fail();
+    return typeq;
+}
+
+Node *AstReader::ReadNode() {
+    uint64_t kind = ReadUInt();
+    if (failed || kind == 0) return NULL;
+    if (kind > NumNodeKinds || depth >= MaxDepth) return Fail();
+    yyltype span;
+    bool located = ReadSpan(&span);
+    depth++;
+    Node *node = failed ? NULL : Build(kind - 1, span);
+    depth--;
+    if (failed || !node) return Fail();
+    node->location = located ? new (AstArena().Allocate(sizeof(yyltype))) yyltype(span) : NULL;
+    return node;
+}
+
+/* Reads the fields of a node of the given kind and constructs it. The
+ * span is only passed on to constructors that take one; ReadNode() sets
+ * the node's location from it afterwards either way.
+ */
+Node *AstReader::Build(int kind, const yyltype &span) {
+    switch (kind) {
+      case K_Program: {
+        List<Decl *> *decls = ReadList<Decl>();
+        return failed ? NULL : new Program(decls);
+      }
+      case K_StmtBlock: {
+        List<VarDecl *> *decls = ReadList<VarDecl>();
+        List<Stmt *> *stmts = ReadList<Stmt>();
+        return failed ? NULL : new StmtBlock(decls, stmts);
+      }
+      case K_DeclStmt: {
+        Decl *decl = Read<Decl>();
+        return failed ? NULL : new DeclStmt(decl);
+      }
+      case K_ForStmt: {
+        Expr *init = Read<Expr>(), *test = Read<Expr>(), *step = Read<Expr>(true);
+        Stmt *body = Read<Stmt>();
+        return failed ? NULL : new ForStmt(init, test, step, body);
+      }
+      case K_WhileStmt: {
+        Expr *test = Read<Expr>();
+        Stmt *body = Read<Stmt>();
+        return failed ? NULL : new WhileStmt(test, body);
+      }
+      case K_IfStmt: {
+        Expr *test = Read<Expr>();
+        Stmt *thenBody = Read<Stmt>(), *elseBody = Read<Stmt>(true);
+        return failed ? NULL : new IfStmt(test, thenBody, elseBody);
+      }
+      case K_BreakStmt:
+        return new BreakStmt(span);
+      case K_ContinueStmt:
+        return new ContinueStmt(span);
+      case K_ReturnStmt: {
+        Expr *expr = Read<Expr>(true);
+        return failed ? NULL : new ReturnStmt(span, expr);
+      }
+      case K_Case: {
+        Expr *label = Read<Expr>();
+        Stmt *stmt = Read<Stmt>();
+        return failed ? NULL : new Case(label, stmt);
+      }
+      case K_Default: {
+        Expr *label = Read<Expr>(true);
+        Stmt *stmt = Read<Stmt>();
+        return failed || label ? NULL : new Default(stmt);
+      }
+      case K_SwitchStmt: {
+        Expr *expr = Read<Expr>();
+        List<Stmt *> *cases = ReadList<Stmt>();
+        Default *def = Read<Default>(true);
+        if (!failed && cases->NumElements() == 0) return NULL;
+        return failed ? NULL : new SwitchStmt(expr, cases, def);
+      }
+      case K_EmptyExpr:
+        return new EmptyExpr();
+      case K_IntConstant:
+        return new IntConstant(span, ReadInt());
+      case K_FloatConstant:
+        return new FloatConstant(span, ReadDouble());
+      case K_BoolConstant:
+        return new BoolConstant(span, ReadUInt() != 0);
+      case K_VarExpr: {
+        Identifier *id = Read<Identifier>();
+        return failed ? NULL : new VarExpr(span, id);
+      }
+      case K_Operator: {
+        const char *token = ReadString();
+        if (failed || strlen(token) >= 4) return NULL;   // see Operator::tokenString
+        return new Operator(span, token);
+      }
+      case K_ArithmeticExpr: case K_RelationalExpr: case K_EqualityExpr:
+      case K_AssignExpr: case K_PostfixExpr: {
+        Operator *op = Read<Operator>();
+        Expr *left = Read<Expr>(true), *right = Read<Expr>(true);
+        if (failed || !Located(op) || !Located(left) || !Located(right)) return NULL;
+        bool unary = !left && right, binary = left && right;
+        switch (kind) {
+          case K_ArithmeticExpr:
+            if (unary) return new ArithmeticExpr(op, right);
+            return binary ? new ArithmeticExpr(left, op, right) : NULL;
+          case K_RelationalExpr:
+            return binary ? new RelationalExpr(left, op, right) : NULL;
+          case K_EqualityExpr:
+            return binary ? new EqualityExpr(left, op, right) : NULL;
+          case K_AssignExpr:
+            return binary ? new AssignExpr(left, op, right) : NULL;
+          default:
+            return left && !right ? new PostfixExpr(left, op) : NULL;
+        }
+      }
+      case K_ConditionalExpr: {
+        Expr *cond = Read<Expr>(), *trueExpr = Read<Expr>(), *falseExpr = Read<Expr>();
+        if (failed || !Located(cond) || !Located(falseExpr)) return NULL;
+        return new ConditionalExpr(cond, trueExpr, falseExpr);
+      }
+      case K_ArrayAccess: {
+        Expr *base = Read<Expr>(), *subscript = Read<Expr>();
+        return failed ? NULL : new ArrayAccess(span, base, subscript);
+      }
+      case K_FieldAccess: {
+        Expr *base = Read<Expr>(true);
+        Identifier *field = Read<Identifier>();
+        if (failed || !Located(base) || !Located(field)) return NULL;
+        return new FieldAccess(base, field);
+      }
+      case K_Call: {
+        Expr *base = Read<Expr>(true);
+        Identifier *field = Read<Identifier>();
+        List<Expr *> *actuals = ReadList<Expr>();
+        return failed ? NULL : new Call(span, base, field, actuals);
+      }
+      case K_Identifier: {
+        const char *name = ReadString();
+        return failed ? NULL : new Identifier(span, name);
+      }
+      case K_VarDecl: {
+        Identifier *id = Read<Identifier>();
+        TypeQualifier *typeq = ReadQualifier();
+        Type *type = ReadType();
+        Expr *assignTo = Read<Expr>(true);
+        if (failed || !Located(id)) return NULL;
+        if (type && typeq) return new VarDecl(id, type, typeq, assignTo);
+        if (type) return new VarDecl(id, type, assignTo);
+        return typeq ? new VarDecl(id, typeq, assignTo) : NULL;
+      }
+      case K_FnDecl: {
+        Identifier *id = Read<Identifier>();
+        TypeQualifier *returnTypeq = ReadQualifier();
+        Type *returnType = ReadType();
+        List<VarDecl *> *formals = ReadList<VarDecl>();
+        Stmt *body = Read<Stmt>(true);
+        yyltype extent;
+        bool hasExtent = ReadSpan(&extent);
+        if (failed || !Located(id) || !returnType) return NULL;
+        FnDecl *fn = returnTypeq ? new FnDecl(id, returnType, returnTypeq, formals)
+                                 : new FnDecl(id, returnType, formals);
+        if (body) fn->SetFunctionBody(body);
+        if (hasExtent) fn->SetExtent(extent);
+        return fn;
+      }
+    }
+    return NULL;
+}
+
+Program *AstReader::ReadProgram() {
+    char version[8];
+    strncpy(version, GLC_VERSION, sizeof(version));
+    if (end - p < 16 || memcmp(p, AstMagic, 8) != 0 || memcmp(p + 8, version, 8) != 0)
+        return NULL;
+    p += 16;
+    uint64_t count = ReadUInt();
+    if (count > end - p) Fail();
+    for (uint64_t i = 0; !failed && i < count; i++) {
+        uint64_t len = ReadUInt();
+        if (len > end - p) {
+            Fail();
+            break;
+        }
+        strings.push_back(string((const char *)p, len));
+        p += len;
+    }
+    Program *program = Read<Program>();
+    return failed || p != end ? NULL : program;
+}
+
+Program *ReadAst(const char *data, size_t len) {
+    AstReader reader(data, len);
+    return reader.ReadProgram();
+}
+
+Program *LoadAst(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("glc: cannot open binary AST");
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    void *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    Program *program = data == MAP_FAILED ? NULL : ReadAst((const char *)data, st.st_size);
+    if (data != MAP_FAILED) munmap(data, st.st_size);
+    if (!program)
+        fprintf(stderr, "glc: %s is not a binary AST for glc %s\n", path, GLC_VERSION);
+    return program;
+}
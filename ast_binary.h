@@ -0,0 +1,56 @@
+/* File: ast_binary.h
+ * ------------------
+ * A compact binary form of the parse tree, written by glc --emit-ast
+ * <file> and read back by glc --ast <file>, so that tools further down
+ * the line and cached parses can skip scanning and parsing.
+ *
+ * A file starts with an 8-byte magic number and the glc version (8
+ * bytes, NUL padded), followed by a table of every distinct string the
+ * tree uses (identifiers and operators) and then the tree itself, root
+ * first. All numbers are unsigned LEB128 varints, signed ones zigzag
+ * encoded; doubles are their 8 IEEE bytes, little-endian. A node is its
+ * kind (0 for an absent child, otherwise one more than its position in
+ * the list of kinds in ast_binary.cc), its span (0 for none, otherwise
+ * first line + 1, first column, last line - first line, last column),
+ * and then whatever its Serialize() writes (see ast_writer.h). A list
+ * is its length followed by its elements. Types are written inline, see
+ * BinaryAstWriter::WriteType().
+ *
+ * The whole file is built in memory and written with a single write.
+ * Reading rebuilds the tree through the node constructors in the AST
+ * arena, checking every child against what the constructor requires,
+ * so a damaged file is rejected rather than crashing the reader.
+ * Expression types are not part of the format; checking a loaded tree
+ * fills them in, just as for a parsed one.
+ */
+
+#ifndef _H_ast_binary
+#define _H_ast_binary
+
+#include <stddef.h>
+
+class Program;
+
+/* Function: WriteAst()
+ * --------------------
+ * Writes program to the binary AST file at path. Returns false, after
+ * saying why on stderr, if it could not be written.
+ */
+bool WriteAst(Program *program, const char *path);
+
+/* Function: LoadAst()
+ * -------------------
+ * Maps the binary AST file at path and rebuilds the tree it holds.
+ * Returns NULL, after saying why on stderr, if it cannot be read or is
+ * not a tree this version of glc wrote.
+ */
+Program *LoadAst(const char *path);
+
+/* Function: ReadAst()
+ * -------------------
+ * Rebuilds the tree held in the len bytes at data, NULL if they are not
+ * a binary AST this version of glc wrote.
+ */
+Program *ReadAst(const char *data, size_t len);
+
+#endif
@@ -6,6 +6,10 @@
 #include "ast_type.h"
 #include "ast_stmt.h"
 #include "symtable.h"
+#include "memo.h"
+#include "ast_writer.h"
+#include "glsl.h"
+#include "deadline.h"
 
 Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     Assert(n != NULL);
@@ -14,13 +18,13 @@ Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
 
 void VarDecl::Check(){
     char * name = Decl::GetIdentifier()->GetName();
-    Symbol *symres = Node::symtable->findInCurrScope(name);
-    Symbol * newsym = new Symbol(name,this,E_VarDecl);
+    const Symbol *symres = Node::symtable->findInCurrScope(name);
+    Symbol newsym(name,this,E_VarDecl);
     if (symres != NULL){
         Decl *prevDecl = symres->decl;
         ReportError::DeclConflict(this,prevDecl);
     }
-    Node::symtable->insert(*newsym);
+    Node::symtable->insert(newsym);
 
     if (assignTo != NULL){
         assignTo->Check(); //check right hand expr
@@ -60,6 +64,36 @@ void VarDecl::PrintChildren(int indentLevel) {
    if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
 }
 
+void VarDecl::Serialize(AstWriter *out) {
+    out->WriteNode(id);
+    out->WriteQualifier(typeq);
+    out->WriteType(type);
+    out->WriteNode(assignTo);
+}
+
+// The ';' after a declaration is the statement's or the program's
+void VarDecl::Emit(GlslWriter *out) {
+    if (typeq) {
+        out->Text(typeq->GetName());
+        out->Space();
+    }
+    out->TypeName(type);
+    out->Space();
+    out->Name(id);
+    ArrayType *array = dynamic_cast<ArrayType *>(type);
+    if (array) {
+        out->Text("[");
+        out->Int(array->GetElemCount());
+        out->Text("]");
+    }
+    if (assignTo) {
+        out->Space();
+        out->Text("=");
+        out->Space();
+        out->Expression(assignTo, Expr::AssignLevel);
+    }
+}
+
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     Assert(n != NULL && r!= NULL && d != NULL);
     (returnType=r)->SetParent(this);
@@ -87,15 +121,60 @@ void FnDecl::PrintChildren(int indentLevel) {
     if (body) body->Print(indentLevel+1, "(body) ");
 }
 
+void FnDecl::Serialize(AstWriter *out) {
+    out->WriteNode(id);
+    out->WriteQualifier(returnTypeq);
+    out->WriteType(returnType);
+    out->WriteList(formals);
+    out->WriteNode(body);
+    out->WriteSpan(GetExtent());
+}
+
+void FnDecl::Emit(GlslWriter *out) {
+    if (returnTypeq) {
+        out->Text(returnTypeq->GetName());
+        out->Space();
+    }
+    out->TypeName(returnType);
+    out->Space();
+    out->Name(id);
+    out->Text("(");
+    for (int i = 0; i < formals->NumElements(); i++) {
+        if (i > 0) {
+            out->Text(",");
+            out->Space();
+        }
+        out->Part(formals->Nth(i));
+    }
+    out->Text(")");
+    if (body) {
+        out->Space();
+        out->Statement(body);
+    } else {
+        out->Text(";");
+    }
+}
+
 void FnDecl::Check(){
+    Declare();
+    CheckBody();
+}
+
+void FnDecl::Declare(){
     char *name = Decl::GetIdentifier()->GetName();
-    Symbol * symres = Node::symtable->findInCurrScope(name);
-    Symbol * newsym = new Symbol(name,this,E_FunctionDecl);
+    const Symbol * symres = Node::symtable->findInCurrScope(name);
+    Symbol newsym(name,this,E_FunctionDecl);
     if (symres != NULL){
         Decl *prevDecl = symres->decl;
         ReportError::DeclConflict(this,prevDecl);
     }
-    Node::symtable->insert(*newsym);
+    Node::symtable->insert(newsym);
+}
+
+void FnDecl::CheckBody(){
+    Deadline::Poll();
+    if (FunctionMemo::Begin(this))
+        return;
 
     if(/*returnType != NULL || */!returnType->IsEquivalentTo(Type::voidType)){
         Node::symtable->needReturn = true;
@@ -124,4 +203,5 @@ void FnDecl::Check(){
     Node::symtable->hasReturn = false;
     Node::symtable->needReturnType = NULL;
     Node::symtable->pop();
+    FunctionMemo::End();
 }
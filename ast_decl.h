@@ -52,7 +52,12 @@ class VarDecl : public Decl
     VarDecl(Identifier *name, Type *type, TypeQualifier *typeq, Expr *assignTo = NULL);
     const char *GetPrintNameForNode() { return "VarDecl"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     Type *GetType() const { return type; }
+    TypeQualifier *GetTypeQualifier() const { return typeq; }
+    Expr *GetInitializer() const { return assignTo; }
+    void SetInitializer(Expr *e) { assignTo = e; if (e) e->SetParent(this); }
 
     void Check();
 };
@@ -71,19 +76,34 @@ class FnDecl : public Decl
     Type *returnType;
     TypeQualifier *returnTypeq;
     Stmt *body;
+    yyltype extent;
 
   public:
     FnDecl() : Decl(), formals(NULL), returnType(NULL), returnTypeq(NULL), body(NULL) {}
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     FnDecl(Identifier *name, Type *returnType, TypeQualifier *returnTypeq, List<VarDecl*> *formals);
     void SetFunctionBody(Stmt *b);
+    // Forgets the body, for when its memory is about to be released
+    void DropFunctionBody() { body = NULL; }
+    // The source span of the whole definition, NULL if not recorded
+    void SetExtent(yyltype loc) { extent = loc; }
+    const yyltype *GetExtent() { return extent.first_line ? &extent : NULL; }
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
 
     Type *GetType() const { return returnType; }
+    TypeQualifier *GetTypeQualifier() const { return returnTypeq; }
     List<VarDecl*> *GetFormals() {return formals;}
+    bool HasBody() const { return body != NULL; }
+    Stmt *GetBody() { return body; }
 
     void Check();
+    // The two halves of Check(): adding the function to the current
+    // scope, and checking its formals and body in a scope of their own
+    void Declare();
+    void CheckBody();
 };
 
 class FormalsError : public FnDecl
@@ -4,15 +4,52 @@
  */
 
 #include <string.h>
+#include <limits.h>
 #include "ast_expr.h"
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
+#include "ast_writer.h"
+#include "glsl.h"
+#include "deadline.h"
+
+int Expr::maxDepth = 100000;
 
 Type * Expr::GetType(){
     return type;
 }
 
+void Expr::Check(){
+    struct Frame {
+        Expr *expr;
+        int step;
+    };
+    // Check() never runs inside itself, so one stack per thread serves
+    // every call (cleared first in case a Failure() abandoned the last)
+    static thread_local vector<Frame> stack;
+    stack.clear();
+    Frame root = { this, 0 };
+    stack.push_back(root);
+    while (!stack.empty()){
+        Deadline::Poll();
+        Frame &top = stack.back();
+        Expr *operand = top.expr->Operand(top.step++);
+        if (operand == NULL){
+            top.expr->CheckSelf();
+            stack.pop_back();
+        }else if (stack.size() < maxDepth){
+            Frame next = { operand, 0 };
+            stack.push_back(next);
+        }else{
+            ReportError::Formatted(operand->GetLocation(),
+                                   "Expression nested more than %d deep", maxDepth);
+            for (int i = 0; i < stack.size(); i++)
+                stack[i].expr->type = Type::errorType;
+            stack.clear();
+        }
+    }
+}
+
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
     value = val;
 }
@@ -20,6 +57,14 @@ void IntConstant::PrintChildren(int indentLevel) {
     printf("%d", value);
 }
 
+void IntConstant::Serialize(AstWriter *out) {
+    out->WriteInt(value);
+}
+
+void IntConstant::Emit(GlslWriter *out) {
+    out->Int(value);
+}
+
 FloatConstant::FloatConstant(yyltype loc, double val) : Expr(loc) {
     value = val;
 }
@@ -27,6 +72,14 @@ void FloatConstant::PrintChildren(int indentLevel) {
     printf("%g", value);
 }
 
+void FloatConstant::Serialize(AstWriter *out) {
+    out->WriteDouble(value);
+}
+
+void FloatConstant::Emit(GlslWriter *out) {
+    out->Float(value);
+}
+
 BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
     value = val;
 }
@@ -34,24 +87,48 @@ void BoolConstant::PrintChildren(int indentLevel) {
     printf("%s", value ? "true" : "false");
 }
 
+void BoolConstant::Serialize(AstWriter *out) {
+    out->WriteBool(value);
+}
+
+void BoolConstant::Emit(GlslWriter *out) {
+    out->Text(value ? "true" : "false");
+}
+
 VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
     Assert(ident != NULL);
     this->id = ident;
 }
 
+VarExpr::VarExpr(yyltype loc, VarDecl *var) : Expr(loc) {
+    Assert(var != NULL);
+    this->id = new Identifier(loc, var->GetIdentifier()->GetName());
+    this->decl = var;
+    this->type = var->GetType();
+}
+
 void VarExpr::PrintChildren(int indentLevel) {
     id->Print(indentLevel+1);
 }
 
-void VarExpr::Check(){
+void VarExpr::Serialize(AstWriter *out) {
+    out->WriteNode(id);
+}
+
+void VarExpr::Emit(GlslWriter *out) {
+    out->Name(id);
+}
+
+void VarExpr::CheckSelf(){
     char *name = this->GetIdentifier()->GetName();
-    Symbol * symres = Node::symtable->find(name);
+    const Symbol * symres = Node::symtable->find(name);
     if (symres == NULL){
         ReportError::IdentifierNotDeclared(this->GetIdentifier(),/*reasonT*/::LookingForVariable);
         this->type = Type::errorType;
     }else{
         VarDecl * vardecl = dynamic_cast<VarDecl*>(symres->decl);
         if (vardecl){
+            this->decl = vardecl;
             this->type = vardecl->GetType();
         }else{
             //the case where the declared variable is not vardecl
@@ -70,6 +147,10 @@ void Operator::PrintChildren(int indentLevel) {
     printf("%s",tokenString);
 }
 
+void Operator::Serialize(AstWriter *out) {
+    out->WriteString(tokenString);
+}
+
 bool Operator::IsOp(const char *op) const {
     return strcmp(tokenString, op) == 0;
 }
@@ -103,6 +184,45 @@ void CompoundExpr::PrintChildren(int indentLevel) {
    if (right) right->Print(indentLevel+1);
 }
 
+void CompoundExpr::Serialize(AstWriter *out) {
+    out->WriteNode(op);
+    out->WriteNode(left);
+    out->WriteNode(right);
+}
+
+int CompoundExpr::Precedence() {
+    static const struct { const char *op; int level; } levels[] = {
+        { "||", OrLevel }, { "&&", AndLevel }, { "==", EqualityLevel },
+        { "!=", EqualityLevel }, { "<", RelationalLevel }, { ">", RelationalLevel },
+        { "<=", RelationalLevel }, { ">=", RelationalLevel }, { "+", AdditiveLevel },
+        { "-", AdditiveLevel }, { "*", MultiplicativeLevel }, { "/", MultiplicativeLevel },
+    };
+    if (left == NULL) return UnaryLevel;
+    if (right == NULL) return PostfixLevel;
+    for (int i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+        if (op->IsOp(levels[i].op)) return levels[i].level;
+    return AssignLevel;   // the assignment operators
+}
+
+// Binary operators group to the left, except for assignment
+void CompoundExpr::Emit(GlslWriter *out) {
+    int level = Precedence();
+    if (left == NULL) {
+        out->Text(op->GetToken());
+        out->Expression(right, UnaryLevel);
+    } else if (right == NULL) {
+        out->Expression(left, PostfixLevel);
+        out->Text(op->GetToken());
+    } else {
+        bool assigns = level == AssignLevel;
+        out->Expression(left, assigns ? UnaryLevel : level);
+        out->Space();
+        out->Text(op->GetToken());
+        out->Space();
+        out->Expression(right, assigns ? AssignLevel : level + 1);
+    }
+}
+
 ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
   : Expr(Join(c->GetLocation(), f->GetLocation())) {
     Assert(c != NULL && t != NULL && f != NULL);
@@ -117,11 +237,32 @@ void ConditionalExpr::PrintChildren(int indentLevel) {
     falseExpr->Print(indentLevel+1, "(false) ");
 }
 
-void ArithmeticExpr::Check(){
+void ConditionalExpr::Serialize(AstWriter *out) {
+    out->WriteNode(cond);
+    out->WriteNode(trueExpr);
+    out->WriteNode(falseExpr);
+}
+
+void ConditionalExpr::Emit(GlslWriter *out) {
+    out->Expression(cond, OrLevel);
+    out->Space();
+    out->Text("?");
+    out->Space();
+    out->Expression(trueExpr, OrLevel);
+    out->Space();
+    out->Text(":");
+    out->Space();
+    out->Expression(falseExpr, OrLevel);
+}
+
+Expr *ArithmeticExpr::Operand(int step){
+    return step == 0 ? this->right : step == 1 ? this->left : NULL;
+}
+
+void ArithmeticExpr::CheckSelf(){
     Type * ltype = NULL;
     Type * rtype = NULL;
 
-    this->right->Check();
     rtype =  this->right->GetType();
 
     char AndArr[] = "&&";
@@ -131,7 +272,6 @@ void ArithmeticExpr::Check(){
 
     if (this->left){
         //if left expr * is not NULL
-        this->left->Check();
         ltype = this->left->GetType();
 
         if (!ltype->IsConvertibleTo(rtype) && !rtype->IsConvertibleTo(ltype)){
@@ -166,10 +306,11 @@ void ArithmeticExpr::Check(){
     }
 }
 
-void RelationalExpr::Check(){
-    this->left->Check();
-    this->right->Check();
+Expr *RelationalExpr::Operand(int step){
+    return step == 0 ? this->left : step == 1 ? this->right : NULL;
+}
 
+void RelationalExpr::CheckSelf(){
     Type * ltype = this->left->GetType();
     Type * rtype = this->right->GetType();
 
@@ -186,10 +327,11 @@ void RelationalExpr::Check(){
     }
 }
 
-void EqualityExpr::Check(){
-    this->left->Check();
-    this->right->Check();
+Expr *EqualityExpr::Operand(int step){
+    return step == 0 ? this->left : step == 1 ? this->right : NULL;
+}
 
+void EqualityExpr::CheckSelf(){
     Type * ltype = this->left->GetType();
     Type * rtype = this->right->GetType();
 
@@ -203,15 +345,184 @@ void EqualityExpr::Check(){
     }
 }
 
+/* Folding: an operator whose operands are constants gives way to the
+ * constant it computes, and one that leaves an operand as it is to that
+ * operand, as long as the type of the expression stays the same. Int
+ * arithmetic wraps around as it does on the GPU, float arithmetic is
+ * done in single precision, and anything that would divide by zero or
+ * give an infinity is left for the shader to compute.
+ */
+static yyltype Where(Node *node) {
+    yyltype none;
+    memset(&none, 0, sizeof(none));
+    return node->GetLocation() ? *node->GetLocation() : none;
+}
+
+// A new constant, checked so that it has its type
+static Expr *Checked(Expr *constant) {
+    constant->Check();
+    return constant;
+}
+
+/* What the expression gives way to can take its place only if the type
+ * agrees, the checker's type: it makes == an int, say, when its
+ * operands are. Subscripts are not checked, so in them there is no type
+ * to agree with.
+ */
+static Expr *Instead(Expr *expr, Expr *replacement) {
+    Type *type = expr->GetType();
+    return type == NULL || replacement->GetType() == type ? replacement : expr;
+}
+
+static bool IsInt(Expr *expr, int *value) {
+    IntConstant *constant = dynamic_cast<IntConstant *>(expr);
+    if (constant) *value = constant->GetValue();
+    return constant != NULL;
+}
+
+static bool IsFloat(Expr *expr, float *value) {
+    FloatConstant *constant = dynamic_cast<FloatConstant *>(expr);
+    if (constant) *value = constant->GetValue();
+    return constant != NULL;
+}
+
+static bool IsBool(Expr *expr, bool *value) {
+    BoolConstant *constant = dynamic_cast<BoolConstant *>(expr);
+    if (constant) *value = constant->GetValue();
+    return constant != NULL;
+}
+
+// Whether expr is an int or float constant equal to value
+static bool IsNumber(Expr *expr, float value) {
+    int i;
+    float f;
+    return (IsInt(expr, &i) && i == value) || (IsFloat(expr, &f) && f == value);
+}
+
+// Sets *result to x op y if op is a comparison
+static bool Compares(Operator *op, double x, double y, bool *result) {
+    if (op->IsOp("<")) *result = x < y;
+    else if (op->IsOp(">")) *result = x > y;
+    else if (op->IsOp("<=")) *result = x <= y;
+    else if (op->IsOp(">=")) *result = x >= y;
+    else if (op->IsOp("==")) *result = x == y;
+    else if (op->IsOp("!=")) *result = x != y;
+    else return false;
+    return true;
+}
+
+Expr *CompoundExpr::FoldOperator(){
+    yyltype loc = Where(this);
+    int i, j;
+    float x, y;
+    bool p, q, compared;
+
+    if (this->left == NULL){
+        if (this->op->IsOp("+"))
+            return Instead(this, this->right);
+        if (!this->op->IsOp("-"))
+            return this;
+        if (IsInt(this->right, &i))
+            return Instead(this, Checked(new IntConstant(loc, (int)(0u - (unsigned)i))));
+        if (IsFloat(this->right, &x))
+            return Instead(this, Checked(new FloatConstant(loc, -x)));
+        ArithmeticExpr *negated = dynamic_cast<ArithmeticExpr *>(this->right);
+        if (negated && negated->left == NULL && negated->op->IsOp("-"))
+            return Instead(this, negated->right);
+        return this;
+    }
+
+    if (IsInt(this->left, &i) && IsInt(this->right, &j)){
+        unsigned a = i, b = j;
+        if (this->op->IsOp("+"))
+            return Instead(this, Checked(new IntConstant(loc, (int)(a + b))));
+        if (this->op->IsOp("-"))
+            return Instead(this, Checked(new IntConstant(loc, (int)(a - b))));
+        if (this->op->IsOp("*"))
+            return Instead(this, Checked(new IntConstant(loc, (int)(a * b))));
+        if (this->op->IsOp("/"))
+            return j == 0 || (i == INT_MIN && j == -1) ? this
+                   : Instead(this, Checked(new IntConstant(loc, i / j)));
+        if (Compares(this->op, i, j, &compared))
+            return Instead(this, Checked(new BoolConstant(loc, compared)));
+        return this;
+    }
+    if (IsFloat(this->left, &x) && IsFloat(this->right, &y)){
+        float result;
+        if (this->op->IsOp("+")) result = x + y;
+        else if (this->op->IsOp("-")) result = x - y;
+        else if (this->op->IsOp("*")) result = x * y;
+        else if (this->op->IsOp("/")) result = y != 0 ? x / y : INFINITY;
+        else if (Compares(this->op, x, y, &compared))
+            return Instead(this, Checked(new BoolConstant(loc, compared)));
+        else return this;
+        return isfinite(result) ? Instead(this, Checked(new FloatConstant(loc, result))) : this;
+    }
+    if (IsBool(this->left, &p) && IsBool(this->right, &q)){
+        if (this->op->IsOp("&&"))
+            return Instead(this, Checked(new BoolConstant(loc, p && q)));
+        if (this->op->IsOp("||"))
+            return Instead(this, Checked(new BoolConstant(loc, p || q)));
+        if (this->op->IsOp("=="))
+            return Instead(this, Checked(new BoolConstant(loc, p == q)));
+        if (this->op->IsOp("!="))
+            return Instead(this, Checked(new BoolConstant(loc, p != q)));
+        return this;
+    }
+
+    // x*1, 1*x, x+0, 0+x, x-0 and x/1 are x
+    if (this->op->IsOp("*")){
+        if (IsNumber(this->right, 1)) return Instead(this, this->left);
+        if (IsNumber(this->left, 1)) return Instead(this, this->right);
+    }else if (this->op->IsOp("+")){
+        if (IsNumber(this->right, 0)) return Instead(this, this->left);
+        if (IsNumber(this->left, 0)) return Instead(this, this->right);
+    }else if (this->op->IsOp("-")){
+        if (IsNumber(this->right, 0)) return Instead(this, this->left);
+    }else if (this->op->IsOp("/")){
+        if (IsNumber(this->right, 1)) return Instead(this, this->left);
+        // x/c is x*(1/c), which GLSL allows a division to be done as
+        float reciprocal = IsFloat(this->right, &y) && y != 0 ? 1 / y : INFINITY;
+        if (isfinite(reciprocal) && reciprocal != 0){
+            Operator *times = new Operator(Where(this->op), "*");
+            ArithmeticExpr *product = new ArithmeticExpr(this->left, times,
+                    Checked(new FloatConstant(Where(this->right), reciprocal)));
+            product->type = this->type;
+            return product;
+        }
+    }else if (this->op->IsOp("&&")){
+        // x&&true is x; false&&x is false, and x is not evaluated
+        if (IsBool(this->right, &q) && q) return Instead(this, this->left);
+        if (IsBool(this->left, &p)) return p ? Instead(this, this->right) : Instead(this, this->left);
+    }else if (this->op->IsOp("||")){
+        if (IsBool(this->right, &q) && !q) return Instead(this, this->left);
+        if (IsBool(this->left, &p)) return p ? Instead(this, this->left) : Instead(this, this->right);
+    }
+    return this;
+}
+
+Expr *ArithmeticExpr::Fold(){
+    return FoldOperator();
+}
+
+Expr *RelationalExpr::Fold(){
+    return FoldOperator();
+}
+
+Expr *EqualityExpr::Fold(){
+    return FoldOperator();
+}
+
 /*void LogicalExpr::Check(){
     //add logical expr check in arithmetic check
 }
 */
 
-void AssignExpr::Check(){
-    this->left->Check();
-    this->right->Check();
+Expr *AssignExpr::Operand(int step){
+    return step == 0 ? this->left : step == 1 ? this->right : NULL;
+}
 
+void AssignExpr::CheckSelf(){
     Type * ltype = this->left->GetType();
     Type * rtype = this->right->GetType();
 
@@ -228,8 +539,11 @@ void AssignExpr::Check(){
     }
 }
 
-void PostfixExpr::Check(){
-    this->left->Check();
+Expr *PostfixExpr::Operand(int step){
+    return step == 0 ? this->left : NULL;
+}
+
+void PostfixExpr::CheckSelf(){
     Type * ltype = this->left->GetType();
     if (ltype->IsError()){
         this->type = Type::errorType;
@@ -241,7 +555,7 @@ void PostfixExpr::Check(){
     }
 }
 
-void ConditionalExpr::Check(){
+void ConditionalExpr::CheckSelf(){
     //Tutor says conditional expr won't be tested??
     this->type = Type::errorType;
 }
@@ -256,8 +570,23 @@ void ArrayAccess::PrintChildren(int indentLevel) {
     subscript->Print(indentLevel+1, "(subscript) ");
 }
 
-void ArrayAccess::Check(){
-    this->base->Check();
+void ArrayAccess::Serialize(AstWriter *out) {
+    out->WriteNode(base);
+    out->WriteNode(subscript);
+}
+
+void ArrayAccess::Emit(GlslWriter *out) {
+    out->Expression(base, PostfixLevel);
+    out->Text("[");
+    out->Expression(subscript, AssignLevel);
+    out->Text("]");
+}
+
+Expr *ArrayAccess::Operand(int step){
+    return step == 0 ? this->base : NULL;
+}
+
+void ArrayAccess::CheckSelf(){
     Type * baseType = this->base->GetType();
 
     if(baseType->IsError()){
@@ -303,8 +632,24 @@ void FieldAccess::PrintChildren(int indentLevel) {
     field->Print(indentLevel+1);
 }
 
-void FieldAccess::Check(){
-    this->base->Check();
+void FieldAccess::Serialize(AstWriter *out) {
+    out->WriteNode(base);
+    out->WriteNode(field);
+}
+
+void FieldAccess::Emit(GlslWriter *out) {
+    if (base) {
+        out->Expression(base, PostfixLevel);
+        out->Text(".");
+    }
+    out->Text(field->GetName());
+}
+
+Expr *FieldAccess::Operand(int step){
+    return step == 0 ? this->base : NULL;
+}
+
+void FieldAccess::CheckSelf(){
     Type * baseType = this->base->GetType();
 
     if(baseType->IsError()){
@@ -369,23 +714,79 @@ Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
     (actuals=a)->SetParentAll(this);
 }
 
+Call::Call(yyltype loc, FnDecl *fn, List<Expr*> *a) : Expr(loc) {
+    Assert(fn != NULL && a != NULL);
+    base = NULL;
+    (field = new Identifier(loc, fn->GetIdentifier()->GetName()))->SetParent(this);
+    (actuals=a)->SetParentAll(this);
+    callee = fn;
+    type = fn->GetType();
+}
+
 void Call::PrintChildren(int indentLevel) {
    if (base) base->Print(indentLevel+1);
    if (field) field->Print(indentLevel+1);
    if (actuals) actuals->PrintAll(indentLevel+1, "(actuals) ");
 }
 
-void Call::Check(){
+void Call::Serialize(AstWriter *out) {
+    out->WriteNode(base);
+    out->WriteNode(field);
+    out->WriteList(actuals);
+}
+
+void Call::Emit(GlslWriter *out) {
+    out->Name(field);
+    out->Text("(");
+    for (int i = 0; i < actuals->NumElements(); i++) {
+        if (i > 0) {
+            out->Text(",");
+            out->Space();
+        }
+        out->Expression(actuals->Nth(i), AssignLevel);
+    }
+    out->Text(")");
+}
+
+/* Resolves the call before any of the actuals are checked, then hands
+ * them out one at a time, giving up at the first whose type does not
+ * match its formal.
+ */
+Expr *Call::Operand(int step){
+    if (step == 0){
+        this->callee = Resolve();
+        if (this->callee == NULL){
+            this->type = Type::errorType;
+            return NULL;
+        }
+    }else{
+        VarDecl * expDecl = this->callee->GetFormals()->Nth(step - 1);
+        Type * actualType = this->actuals->Nth(step - 1)->GetType();
+        if(!actualType->IsEquivalentTo(expDecl->GetType())){
+            ReportError::FormalsTypeMismatch(this->field, step - 1, expDecl->GetType(), actualType);
+            this->type = Type::errorType;
+            this->callee = NULL;
+            return NULL;
+        }
+    }
+    return step < this->actuals->NumElements() ? this->actuals->Nth(step) : NULL;
+}
+
+void Call::CheckSelf(){
+    if (this->callee)
+        this->type = this->callee->GetType();
+}
+
+// Returns the function called, NULL after reporting why if there is none
+FnDecl *Call::Resolve(){
     if(this->field == NULL){
-        this->type = Type::errorType;
-        return;
+        return NULL;
     }
-    Symbol * funcSym = Node::symtable->find(this->field->GetName());
+    const Symbol * funcSym = Node::symtable->find(this->field->GetName());
     //if we cannot find that identifier in symbol table
     if(funcSym == NULL){
         ReportError::IdentifierNotDeclared(this->field, /*reasonT::*/LookingForFunction);
-        this->type = Type::errorType;
-        return;
+        return NULL;
     }
 
     FnDecl * fnDecl = dynamic_cast<FnDecl *> (funcSym->decl);
@@ -393,8 +794,7 @@ void Call::Check(){
     //if found in symbol table, but is not declared as a function
     if(funcSym->kind == E_VarDecl || fnDecl == NULL){
         ReportError::NotAFunction(this->field);
-        this->type = Type::errorType;
-        return;
+        return NULL;
     }
 
     //get the formals declared
@@ -403,24 +803,10 @@ void Call::Check(){
     int actualNum = this->actuals->NumElements();
     if(actualNum < expectNum){
         ReportError::LessFormals(this->field, expectNum, actualNum);
-        this->type = Type::errorType;
-        return;
+        return NULL;
     }else if(actualNum > expectNum){
         ReportError::ExtraFormals(this->field, expectNum, actualNum);
-        this->type = Type::errorType;
-        return;
-    }
-    //for each formal check the expected varDecl type is equivalent to expr type
-    for(int i = 0; i < expectNum; i++){
-        VarDecl * expDecl = expectedFormals->Nth(i);
-        Expr * actualExpr = this->actuals->Nth(i);
-        actualExpr->Check();//we are sure this works!
-        Type * actualType = actualExpr->GetType();
-        if(!actualType->IsEquivalentTo(expDecl->GetType())){
-            ReportError::FormalsTypeMismatch(this->field, i, expDecl->GetType(), actualType);
-            this->type = Type::errorType;
-            return;
-        }
+        return NULL;
     }
-    this->type = fnDecl->GetType();
+    return fnDecl;
 }
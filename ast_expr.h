@@ -13,22 +13,56 @@
 #ifndef _H_ast_expr
 #define _H_ast_expr
 
+#include <math.h>   // for signbit
 #include "ast.h"
 #include "ast_stmt.h"
 #include "list.h"
 #include "ast_type.h"
 
+class FnDecl;
+class VarDecl;
+
 void yyerror(const char *msg);
 
 class Expr : public Stmt
 {
   protected:
     Type *type;
+
+    /* Check() walks an expression with an explicit stack rather than
+     * recursing, so that a long chain such as a+a+...+a cannot overflow
+     * the C++ stack. It asks an expression for its operands one step at
+     * a time, checking each one before asking for the next, and once
+     * Operand() returns NULL calls CheckSelf() to work out the type of
+     * the expression from theirs. Operand() may look at the types of
+     * the operands already checked to decide whether to go on.
+     */
+    virtual Expr *Operand(int step) { return NULL; }
+    virtual void CheckSelf() = 0;
+
   public:
+    // Expressions nested deeper than this are reported, not checked
+    static int maxDepth;
+
     Expr(yyltype loc) : Stmt(loc) {}
     Expr() : Stmt() {}
     Type * GetType();
-    virtual void Check() = 0;
+    void Check();
+    // For a pass that copies an expression already checked (see copy.h)
+    void SetType(Type *t) { type = t; }
+
+    // Called by FoldConstants() once the operands have been folded (see
+    // fold.h). Returns the expression to put in place of this one, which
+    // is this one unless it could be simplified.
+    virtual Expr *Fold() { return this; }
+
+    // How tightly the expression binds, for writing it out (see glsl.h):
+    // an operand that binds less tightly than its place in the operator
+    // above it needs is put in parentheses
+    enum { AssignLevel = 1, ConditionalLevel, OrLevel, AndLevel, EqualityLevel,
+           RelationalLevel, AdditiveLevel, MultiplicativeLevel, UnaryLevel,
+           PostfixLevel, PrimaryLevel };
+    virtual int Precedence() { return PrimaryLevel; }
 
     friend std::ostream& operator<< (std::ostream& stream, Expr * expr) {
         return stream << expr->GetPrintNameForNode();
@@ -49,7 +83,7 @@ class EmptyExpr : public Expr
 {
   public:
     const char *GetPrintNameForNode() { return "Empty"; }
-    void Check() {this->type = Type::voidType;}
+    void CheckSelf() {this->type = Type::voidType;}
 };
 
 class IntConstant : public Expr
@@ -61,7 +95,11 @@ class IntConstant : public Expr
     IntConstant(yyltype loc, int val);
     const char *GetPrintNameForNode() { return "IntConstant"; }
     void PrintChildren(int indentLevel);
-    void Check() {this->type = Type::intType;}
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    int GetValue() const { return value; }
+    int Precedence() { return value < 0 ? UnaryLevel : PrimaryLevel; }
+    void CheckSelf() {this->type = Type::intType;}
 };
 
 class FloatConstant: public Expr
@@ -73,7 +111,11 @@ class FloatConstant: public Expr
     FloatConstant(yyltype loc, double val);
     const char *GetPrintNameForNode() { return "FloatConstant"; }
     void PrintChildren(int indentLevel);
-    void Check() {this->type = Type::floatType;}
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    double GetValue() const { return value; }
+    int Precedence() { return signbit(value) ? UnaryLevel : PrimaryLevel; }
+    void CheckSelf() {this->type = Type::floatType;}
 };
 
 class BoolConstant : public Expr
@@ -85,20 +127,29 @@ class BoolConstant : public Expr
     BoolConstant(yyltype loc, bool val);
     const char *GetPrintNameForNode() { return "BoolConstant"; }
     void PrintChildren(int indentLevel);
-    void Check() {this->type = Type::boolType;}
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    bool GetValue() const { return value; }
+    void CheckSelf() {this->type = Type::boolType;}
 };
 
 class VarExpr : public Expr
 {
   protected:
     Identifier *id;
+    VarDecl *decl;      // set by CheckSelf() if the name is a variable
 
   public:
     VarExpr(yyltype loc, Identifier *id);
+    // A use of var that is resolved already, for a pass that adds one
+    VarExpr(yyltype loc, VarDecl *var);
     const char *GetPrintNameForNode() { return "VarExpr"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     Identifier *GetIdentifier() {return id;}
-    void Check();
+    VarDecl *GetDecl() { return decl; }
+    void CheckSelf();
 };
 
 class Operator : public Node
@@ -110,8 +161,10 @@ class Operator : public Node
     Operator(yyltype loc, const char *tok);
     const char *GetPrintNameForNode() { return "Operator"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
     friend ostream& operator<<(ostream& out, Operator *o) { return out << o->tokenString; }
     bool IsOp(const char *op) const;
+    const char *GetToken() const { return tokenString; }
  };
 
 class CompoundExpr : public Expr
@@ -125,6 +178,17 @@ class CompoundExpr : public Expr
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    Operator *GetOperator() { return op; }
+    Expr *GetLeft() { return left; }
+    Expr *GetRight() { return right; }
+    Expr **ExprSlot(int i) { return i == 0 ? &left : i == 1 ? &right : NULL; }
+    int Precedence();
+
+  protected:
+    // The Fold() of the operators below that compute a value
+    Expr *FoldOperator();
 };
 
 class ArithmeticExpr : public CompoundExpr
@@ -133,7 +197,9 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
-    void Check();
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr *Fold();
 };
 
 class RelationalExpr : public CompoundExpr
@@ -141,7 +207,9 @@ class RelationalExpr : public CompoundExpr
   public:
     RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "RelationalExpr"; }
-    void Check();
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr *Fold();
 };
 
 class EqualityExpr : public CompoundExpr
@@ -149,7 +217,9 @@ class EqualityExpr : public CompoundExpr
   public:
     EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
-    void Check();
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr *Fold();
 };
 
 class LogicalExpr : public CompoundExpr
@@ -166,7 +236,9 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
-    void Check();
+    Expr *Operand(int step);
+    void CheckSelf();
+    int Precedence() { return AssignLevel; }
 };
 
 class PostfixExpr : public CompoundExpr
@@ -174,7 +246,9 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
-    void Check();
+    Expr *Operand(int step);
+    void CheckSelf();
+    int Precedence() { return PostfixLevel; }
 };
 
 class ConditionalExpr : public Expr
@@ -184,8 +258,15 @@ class ConditionalExpr : public Expr
   public:
     ConditionalExpr(Expr *c, Expr *t, Expr *f);
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     const char *GetPrintNameForNode() { return "ConditionalExpr"; }
-    void Check();
+    void CheckSelf();
+    int Precedence() { return ConditionalLevel; }
+    Expr *GetCondition() { return cond; }
+    Expr *GetTrueExpr() { return trueExpr; }
+    Expr *GetFalseExpr() { return falseExpr; }
+    Expr **ExprSlot(int i) { return i == 0 ? &cond : i == 1 ? &trueExpr : i == 2 ? &falseExpr : NULL; }
 };
 
 class LValue : public Expr
@@ -203,7 +284,13 @@ class ArrayAccess : public LValue
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
     const char *GetPrintNameForNode() { return "ArrayAccess"; }
     void PrintChildren(int indentLevel);
-    void Check();
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr *GetBase() { return base; }
+    Expr *GetSubscript() { return subscript; }
+    Expr **ExprSlot(int i) { return i == 0 ? &base : i == 1 ? &subscript : NULL; }
 };
 
 /* Note that field access is used both for qualified names
@@ -221,7 +308,13 @@ class FieldAccess : public LValue
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
     const char *GetPrintNameForNode() { return "FieldAccess"; }
     void PrintChildren(int indentLevel);
-    void Check();
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr *GetBase() { return base; }
+    Identifier *GetField() { return field; }
+    Expr **ExprSlot(int i) { return i == 0 ? &base : NULL; }
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -234,13 +327,26 @@ class Call : public Expr
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
     List<Expr*> *actuals;
+    FnDecl *callee;	// set by Operand(0) once the call has been resolved
+
+    FnDecl *Resolve();
 
   public:
-    Call() : Expr(), base(NULL), field(NULL), actuals(NULL) {}
+    Call() : Expr(), base(NULL), field(NULL), actuals(NULL), callee(NULL) {}
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
+    // A call that is resolved already, for a pass that adds one
+    Call(yyltype loc, FnDecl *fn, List<Expr*> *args);
     const char *GetPrintNameForNode() { return "Call"; }
+    Identifier *GetIdentifier() { return field; }
+    FnDecl *GetCallee() { return callee; }
+    List<Expr*> *GetActuals() { return actuals; }
     void PrintChildren(int indentLevel);
-    void Check();
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
+    Expr *Operand(int step);
+    void CheckSelf();
+    Expr **ExprSlot(int i)
+        { return actuals && i < actuals->NumElements() ? &actuals->NthRef(i) : NULL; }
 };
 
 class ActualsError : public Call
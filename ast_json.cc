@@ -0,0 +1,243 @@
+/* File: ast_json.cc
+ * -----------------
+ * Implementation of the JSON dump of the tree.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ast_json.h"
+#include "ast_writer.h"
+#include "ast.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+
+using namespace std;
+
+// The buffer is written out whenever it grows past this
+static const size_t FlushBytes = 1 << 20;
+
+class JsonAstWriter : public AstWriter {
+  public:
+    JsonAstWriter() : first(true) { out.reserve(FlushBytes + 4096); }
+
+    void Dump(Node *root);
+
+    void WriteNode(Node *node);
+    void BeginList(int length);
+    void EndList();
+    void WriteInt(int64_t value);
+    void WriteBool(bool value);
+    void WriteDouble(double value);
+    void WriteString(const char *str);
+    void WriteSpan(const yyltype *span);
+    void WriteType(Type *type);
+    void WriteQualifier(TypeQualifier *typeq);
+
+  private:
+    // What is still to be printed: a node, an absent child, or the
+    // punctuation that opens or closes a list or a node's children
+    struct Item {
+        enum Kind { NodeItem, NullItem, ListOpen, ListClose, NodeClose } kind;
+        Node *node;
+        Item(Kind k, Node *n = NULL) : kind(k), node(n) {}
+    };
+    vector<Item> stack;
+    vector<Item> children;       // handed over by the node being opened
+    string out;
+    bool first;                  // nothing printed yet in the current array
+    map<Type *, string> typeNames;
+
+    void Separate();
+    void Key(const char *key);
+    void Quote(const char *str);
+    void Span(const yyltype *span);
+    const string &TypeName(Type *type);
+    void Open(Node *node);
+    void Flush();
+};
+
+void JsonAstWriter::Dump(Node *root) {
+    stack.push_back(root ? Item(Item::NodeItem, root) : Item(Item::NullItem));
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        switch (item.kind) {
+          case Item::NodeItem:
+            Separate();
+            Open(item.node);
+            break;
+          case Item::NullItem:
+            Separate();
+            out += "null";
+            break;
+          case Item::ListOpen:
+            Separate();
+            out += '[';
+            first = true;
+            break;
+          case Item::ListClose:
+            out += ']';
+            first = false;
+            break;
+          case Item::NodeClose:
+            out += "]}";
+            first = false;
+            break;
+        }
+        if (out.size() >= FlushBytes) Flush();
+    }
+    out += '\n';
+    Flush();
+}
+
+/* Prints the node's kind, span, type and fields, and leaves its children
+ * on the stack to be printed after them.
+ */
+void JsonAstWriter::Open(Node *node) {
+    out += "{\"node\":";
+    Quote(node->GetPrintNameForNode());
+    if (node->GetLocation()) {
+        Key("span");
+        Span(node->GetLocation());
+    }
+    Expr *expr = dynamic_cast<Expr *>(node);
+    if (expr && expr->GetType()) {
+        Key("type");
+        Quote(TypeName(expr->GetType()).c_str());
+    }
+    children.clear();
+    node->Serialize(this);
+    out += ",\"children\":[";
+    first = true;
+    stack.push_back(Item(Item::NodeClose));
+    for (int i = children.size() - 1; i >= 0; i--)
+        stack.push_back(children[i]);
+}
+
+void JsonAstWriter::WriteNode(Node *node) {
+    children.push_back(node ? Item(Item::NodeItem, node) : Item(Item::NullItem));
+}
+
+void JsonAstWriter::BeginList(int length) {
+    children.push_back(Item(Item::ListOpen));
+}
+
+void JsonAstWriter::EndList() {
+    children.push_back(Item(Item::ListClose));
+}
+
+void JsonAstWriter::WriteInt(int64_t value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", (long long)value);
+    Key("value");
+    out += buf;
+}
+
+void JsonAstWriter::WriteBool(bool value) {
+    Key("value");
+    out += value ? "true" : "false";
+}
+
+void JsonAstWriter::WriteDouble(double value) {
+    Key("value");
+    if (!isfinite(value)) {   // JSON has no infinities
+        out += "null";
+        return;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    out += buf;
+    if (!strpbrk(buf, ".eE")) out += ".0";   // keep it a float for readers
+}
+
+void JsonAstWriter::WriteString(const char *str) {
+    Key("text");
+    Quote(str);
+}
+
+void JsonAstWriter::WriteSpan(const yyltype *span) {
+    if (!span) return;
+    Key("extent");
+    Span(span);
+}
+
+void JsonAstWriter::WriteType(Type *type) {
+    if (!type) return;
+    Key("declaredType");
+    Quote(TypeName(type).c_str());
+}
+
+void JsonAstWriter::WriteQualifier(TypeQualifier *typeq) {
+    if (!typeq) return;
+    Key("qualifier");
+    Quote(typeq->GetName());
+}
+
+void JsonAstWriter::Separate() {
+    if (!first) out += ',';
+    first = false;
+}
+
+void JsonAstWriter::Key(const char *key) {
+    out += ",\"";
+    out += key;
+    out += "\":";
+}
+
+void JsonAstWriter::Quote(const char *str) {
+    out += '"';
+    for (const char *p = str; *p; p++) {
+        unsigned char ch = *p;
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (ch < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out += buf;
+        } else {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+void JsonAstWriter::Span(const yyltype *span) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "[%d,%d,%d,%d]", span->first_line, span->first_column,
+             span->last_line, span->last_column);
+    out += buf;
+}
+
+// Types are mostly the shared built-in ones, so their names are cached
+const string &JsonAstWriter::TypeName(Type *type) {
+    map<Type *, string>::iterator found = typeNames.find(type);
+    if (found != typeNames.end()) return found->second;
+    ostringstream s;
+    s << type;
+    return typeNames[type] = s.str();
+}
+
+void JsonAstWriter::Flush() {
+    fflush(stdout);   // anything printed through stdio goes first
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = write(STDOUT_FILENO, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    out.clear();
+}
+
+void DumpAstJson(Node *root) {
+    JsonAstWriter writer;
+    writer.Dump(root);
+}
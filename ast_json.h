@@ -0,0 +1,37 @@
+/* File: ast_json.h
+ * ----------------
+ * The tree as JSON, printed by glc --dump-ast=json once the program has
+ * been checked, for tools to consume.
+ *
+ * The output is one JSON object per node:
+ *
+ *   {"node":"VarExpr","span":[2,13,2,16],"type":"vec4",
+ *    "children":[{"node":"Identifier","span":[2,13,2,16],"text":"tint","children":[]}]}
+ *
+ * "node" is the name dumpAST prints, "span" is first line, first column,
+ * last line and last column (left out if the node has no position), and
+ * "type" is the type checking resolved for an expression. The node's own
+ * fields follow: "text" for identifiers and operators, "value" for
+ * constants, "qualifier" and "declaredType" for declarations, "extent"
+ * for a function definition's span. "children" holds the node's
+ * children in the order its Serialize() hands them over, null for an
+ * absent one and a nested array for a list of them. The whole dump is
+ * one line.
+ *
+ * The tree is walked with an explicit stack, so deep trees cannot
+ * overflow the call stack, and the text is gathered in one large buffer
+ * that is written out with as few writes as possible.
+ */
+
+#ifndef _H_ast_json
+#define _H_ast_json
+
+class Node;
+
+/* Function: DumpAstJson()
+ * -----------------------
+ * Prints the tree under root to stdout as JSON, followed by a newline.
+ */
+void DumpAstJson(Node *root);
+
+#endif
@@ -8,6 +8,18 @@
 #include "ast_expr.h"
 #include "errors.h"
 #include "symtable.h"
+#include "ast_writer.h"
+#include "glsl.h"
+#include "memo.h"
+#include "callgraph.h"
+#include "deadline.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+int Program::jobs = 1;
 
 Program::Program(List<Decl*> *d) {
     Assert(d != NULL);
@@ -16,7 +28,24 @@ Program::Program(List<Decl*> *d) {
 
 void Program::PrintChildren(int indentLevel) {
     decls->PrintAll(indentLevel+1);
-    printf("\n");
+}
+
+void Program::Serialize(AstWriter *out) {
+    out->WriteList(decls);
+}
+
+// Function definitions are set off by blank lines
+void Program::Emit(GlslWriter *out) {
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *decl = decls->Nth(i);
+        FnDecl *fn = dynamic_cast<FnDecl *>(decl);
+        bool defined = fn && fn->HasBody();
+        if (i > 0) out->Line();
+        if (i > 0 && (defined || dynamic_cast<FnDecl *>(decls->Nth(i - 1))))
+            out->Line();
+        out->Part(decl);
+        if (!fn) out->Text(";");
+    }
 }
 
 void Program::Check() {
@@ -28,18 +57,130 @@ void Program::Check() {
      *      and polymorphism in the node classes.
      */
 
-    // sample test - not the actual working code
-    // replace it with your own implementation
-    if ( decls->NumElements() > 0 ) {
+    // With --reachable-only the functions that cannot be called from the
+    // entry points are only declared, not checked (see callgraph.h)
+    bool pruning = GetOption("reachable-only") != NULL;
+    vector<bool> reachable(decls->NumElements(), true);
+    if (pruning) {
+        const char *entries = GetOption("entry");
+        FindReachable(decls, entries ? entries : "main", &reachable);
+    }
+
+    // A memo entry records global lookups in the order they are made
+    if (jobs > 1 && !FunctionMemo::enabled) {
+        CheckInParallel(reachable);
+    } else if ( decls->NumElements() > 0 ) {
       for ( int i = 0; i < decls->NumElements(); ++i ) {
         Decl *d = decls->Nth(i);
         /* !!! YOUR CODE HERE !!!
          * Basically you have to make sure that each declaration is
          * semantically correct.
          */
-         d->Check();
+         if (reachable[i])
+             d->Check();
+         else
+             static_cast<FnDecl *>(d)->Declare();
       }
     }
+
+    if (pruning)
+        PrintUnreachable(reachable);
+}
+
+// Lists the functions --reachable-only skipped, so they can be stripped
+void Program::PrintUnreachable(const vector<bool> &reachable) {
+    for (int i = 0; i < decls->NumElements(); i++) {
+        if (reachable[i]) continue;
+        Decl *d = decls->Nth(i);
+        printf("Unreachable function '%s' on line %d\n",
+               d->GetIdentifier()->GetName(), d->GetLocation()->first_line);
+    }
+}
+
+/* The function bodies still to be checked by CheckInParallel(), and the
+ * errors each declaration raised, by index in the program.
+ */
+struct BodyQueue {
+    vector<FnDecl *> bodies;
+    vector<int> index;
+    atomic<int> next;
+    const ScopedTable *globals;
+    vector<vector<Diagnostic> > errors;
+    mutex lock;
+    exception_ptr failure;      // the first Failure() or deadline on any thread
+};
+
+static void CheckBodies(BodyQueue *queue) {
+    SymbolTable *own = Node::symtable;
+    SymbolTable table(queue->globals);
+    Node::symtable = &table;
+    vector<Diagnostic> *outer = ReportError::Capture(NULL);
+    try {
+        int i;
+        while ((i = queue->next++) < (int)queue->bodies.size()) {
+            FnDecl *fn = queue->bodies[i];
+            table.setVisibleTo(fn->GetLocation());
+            ReportError::Capture(&queue->errors[queue->index[i]]);
+            fn->CheckBody();
+        }
+    } catch (...) {
+        lock_guard<mutex> guard(queue->lock);
+        if (!queue->failure) queue->failure = current_exception();
+        queue->next = queue->bodies.size();
+    }
+    ReportError::Capture(outer);
+    Node::symtable = own;
+}
+
+static void CheckBodiesOnThread(BodyQueue *queue) {
+    CheckBodies(queue);
+    delete Node::symtable;   // the one this thread was started with
+}
+
+/* Checks on up to jobs threads at once. First the declarations are gone
+ * through in order on this thread, checking global variables and only
+ * declaring functions, which builds the whole global scope. Then the
+ * threads take the function bodies in turn and check each against that
+ * scope with a symbol table of their own, seeing only the names declared
+ * before the function, as when checking in order. The errors of every
+ * declaration are held back and reported in order at the end, so that
+ * the output is the same as well.
+ */
+void Program::CheckInParallel(const vector<bool> &reachable) {
+    BodyQueue queue;
+    int n = decls->NumElements();
+    queue.errors.resize(n);
+    for (int i = 0; i < n; i++) {
+        Decl *d = decls->Nth(i);
+        FnDecl *fn = dynamic_cast<FnDecl *>(d);
+        vector<Diagnostic> *outer = ReportError::Capture(&queue.errors[i]);
+        if (fn) {
+            fn->Declare();
+            if (reachable[i]) {
+                queue.bodies.push_back(fn);
+                queue.index.push_back(i);
+            }
+        } else {
+            d->Check();
+        }
+        ReportError::Capture(outer);
+    }
+
+    queue.next = 0;
+    queue.globals = Node::symtable->getGlobalScope();
+    int threads = min(jobs, (int)queue.bodies.size());
+    vector<thread> workers;
+    for (int i = 1; i < threads; i++)
+        workers.push_back(thread(CheckBodiesOnThread, &queue));
+    CheckBodies(&queue);
+    for (int i = 0; i < workers.size(); i++)
+        workers[i].join();
+    if (queue.failure)
+        rethrow_exception(queue.failure);
+
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < queue.errors[i].size(); j++)
+            ReportError::Report(queue.errors[i][j]);
 }
 
 StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
@@ -53,7 +194,30 @@ void StmtBlock::PrintChildren(int indentLevel) {
     stmts->PrintAll(indentLevel+1);
 }
 
+void StmtBlock::Serialize(AstWriter *out) {
+    out->WriteList(decls);
+    out->WriteList(stmts);
+}
+
+void StmtBlock::Emit(GlslWriter *out) {
+    out->Text("{");
+    out->Indent();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        out->Line();
+        out->Part(decls->Nth(i));
+        out->Text(";");
+    }
+    for (int i = 0; i < stmts->NumElements(); i++) {
+        out->Line();
+        out->Statement(stmts->Nth(i));
+    }
+    out->Dedent();
+    out->Line();
+    out->Text("}");
+}
+
 void StmtBlock::Check(){
+    Deadline::Poll();
     //Statement block does not need to push a new scope, the statement
     //before it (if, funcdecl, etc) should do the job
     if(decls){
@@ -83,6 +247,15 @@ void DeclStmt::PrintChildren(int indentLevel) {
     decl->Print(indentLevel+1);
 }
 
+void DeclStmt::Serialize(AstWriter *out) {
+    out->WriteNode(decl);
+}
+
+void DeclStmt::Emit(GlslWriter *out) {
+    out->Part(decl);
+    out->Text(";");
+}
+
 void DeclStmt::Check(){
     //not sure if we need to dynamic cast decl to vardecl & fndecl
     if(decl)
@@ -111,6 +284,30 @@ void ForStmt::PrintChildren(int indentLevel) {
     body->Print(indentLevel+1, "(body) ");
 }
 
+void ForStmt::Serialize(AstWriter *out) {
+    out->WriteNode(init);
+    out->WriteNode(test);
+    out->WriteNode(step);
+    out->WriteNode(body);
+}
+
+void ForStmt::Emit(GlslWriter *out) {
+    out->Text("for");
+    out->Space();
+    out->Text("(");
+    out->Expression(init, 0);
+    out->Text(";");
+    out->Space();
+    out->Expression(test, 0);
+    out->Text(";");
+    if (step) {
+        out->Space();
+        out->Expression(step, 0);
+    }
+    out->Text(")");
+    out->Body(body);
+}
+
 void ForStmt::Check(){
     //p3exe will let it pass as long as init, body are valid expr,
     //step has to be boolean
@@ -143,6 +340,20 @@ void WhileStmt::PrintChildren(int indentLevel) {
     body->Print(indentLevel+1, "(body) ");
 }
 
+void WhileStmt::Serialize(AstWriter *out) {
+    out->WriteNode(test);
+    out->WriteNode(body);
+}
+
+void WhileStmt::Emit(GlslWriter *out) {
+    out->Text("while");
+    out->Space();
+    out->Text("(");
+    out->Expression(test, 0);
+    out->Text(")");
+    out->Body(body);
+}
+
 void WhileStmt::Check(){
     if(test){
         test->Check();
@@ -173,6 +384,46 @@ void IfStmt::PrintChildren(int indentLevel) {
     if (elseBody) elseBody->Print(indentLevel+1, "(else) ");
 }
 
+void IfStmt::Serialize(AstWriter *out) {
+    out->WriteNode(test);
+    out->WriteNode(body);
+    out->WriteNode(elseBody);
+}
+
+/* With an else, the then part is always braced, so that an if without
+ * an else inside it cannot take the else for its own.
+ */
+void IfStmt::Emit(GlslWriter *out) {
+    out->Text("if");
+    out->Space();
+    out->Text("(");
+    out->Expression(test, 0);
+    out->Text(")");
+    if (!elseBody) {
+        out->Body(body);
+        return;
+    }
+    out->Space();
+    out->Braced(body);
+    out->Space();
+    out->Text("else");
+    out->Space();
+    if (dynamic_cast<IfStmt *>(elseBody))
+        out->Statement(elseBody);
+    else
+        out->Braced(elseBody);
+}
+
+void BreakStmt::Emit(GlslWriter *out) {
+    out->Text("break");
+    out->Text(";");
+}
+
+void ContinueStmt::Emit(GlslWriter *out) {
+    out->Text("continue");
+    out->Text(";");
+}
+
 void IfStmt::Check(){
     if(test){
         test->Check();
@@ -206,6 +457,19 @@ void ReturnStmt::PrintChildren(int indentLevel) {
       expr->Print(indentLevel+1);
 }
 
+void ReturnStmt::Serialize(AstWriter *out) {
+    out->WriteNode(expr);
+}
+
+void ReturnStmt::Emit(GlslWriter *out) {
+    out->Text("return");
+    if (expr) {
+        out->Space();
+        out->Expression(expr, 0);
+    }
+    out->Text(";");
+}
+
 void ReturnStmt::Check(){
     //set hasReturn to true if actually return something
     //p3exe will not report missing return as long as there is a return
@@ -260,6 +524,25 @@ void SwitchLabel::PrintChildren(int indentLevel) {
     if (stmt)  stmt->Print(indentLevel+1);
 }
 
+void SwitchLabel::Serialize(AstWriter *out) {
+    out->WriteNode(label);
+    out->WriteNode(stmt);
+}
+
+// The statements after the first under a label follow it in the switch
+void SwitchLabel::Emit(GlslWriter *out) {
+    if (label) {
+        out->Text("case");
+        out->Space();
+        out->Expression(label, 0);
+    } else {
+        out->Text("default");
+    }
+    out->Text(":");
+    out->Space();
+    out->Statement(stmt);
+}
+
 void SwitchLabel::Check(){
     //SwitchLabel constructor is never called in parser
 }
@@ -311,3 +594,35 @@ void SwitchStmt::PrintChildren(int indentLevel) {
     if (cases) cases->PrintAll(indentLevel+1);
     if (def) def->Print(indentLevel+1);
 }
+
+void SwitchStmt::Serialize(AstWriter *out) {
+    out->WriteNode(expr);
+    out->WriteList(cases);
+    out->WriteNode(def);
+}
+
+void SwitchStmt::Emit(GlslWriter *out) {
+    out->Text("switch");
+    out->Space();
+    out->Text("(");
+    out->Expression(expr, 0);
+    out->Text(")");
+    out->Space();
+    out->Text("{");
+    out->Indent();
+    for (int i = 0; i < cases->NumElements(); i++) {
+        Stmt *stmt = cases->Nth(i);
+        bool labeled = dynamic_cast<SwitchLabel *>(stmt) != NULL;
+        if (!labeled) out->Indent();   // under the label before it
+        out->Line();
+        out->Statement(stmt);
+        if (!labeled) out->Dedent();
+    }
+    if (def) {
+        out->Line();
+        out->Statement(def);
+    }
+    out->Dedent();
+    out->Line();
+    out->Text("}");
+}
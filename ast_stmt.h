@@ -28,11 +28,20 @@ class Program : public Node
   protected:
      List<Decl*> *decls;
 
+     void CheckInParallel(const vector<bool> &reachable);
+     void PrintUnreachable(const vector<bool> &reachable);
+
   public:
+     // Number of threads function bodies are checked on
+     static int jobs;
+
      Program(List<Decl*> *declList);
      const char *GetPrintNameForNode() { return "Program"; }
      void PrintChildren(int indentLevel);
+     void Serialize(AstWriter *out);
+     void Emit(GlslWriter *out);
      virtual void Check();
+     List<Decl*> *GetDecls() { return decls; }
 };
 
 class Stmt : public Node
@@ -41,6 +50,14 @@ class Stmt : public Node
      Stmt() : Node() {}
      Stmt(yyltype loc) : Node(loc) {}
      virtual void Check() = 0; //pure virtual
+
+     // The expressions and statements directly inside this one, by
+     // address so that a pass over the checked tree can replace them
+     // (see rewriter.h). Both return NULL past the last; the slot of an
+     // absent part holds NULL. An expression's operands are its
+     // expressions.
+     virtual Expr **ExprSlot(int i) { return NULL; }
+     virtual Stmt **StmtSlot(int i) { return NULL; }
 };
 
 class StmtBlock : public Stmt
@@ -53,7 +70,12 @@ class StmtBlock : public Stmt
     StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
     const char *GetPrintNameForNode() { return "StmtBlock"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    List<VarDecl*> *GetDecls() { return decls; }
+    List<Stmt*> *GetStmts() { return stmts; }
+    Stmt **StmtSlot(int i) { return i < stmts->NumElements() ? &stmts->NthRef(i) : NULL; }
 };
 
 class DeclStmt: public Stmt
@@ -65,7 +87,10 @@ class DeclStmt: public Stmt
     DeclStmt(Decl *d);
     const char *GetPrintNameForNode() { return "DeclStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    Decl *GetDecl() { return decl; }
 };
 
 class ConditionalStmt : public Stmt
@@ -77,7 +102,8 @@ class ConditionalStmt : public Stmt
   public:
     ConditionalStmt() : Stmt(), test(NULL), body(NULL) {}
     ConditionalStmt(Expr *testExpr, Stmt *body);
-
+    Expr **ExprSlot(int i) { return i == 0 ? &test : NULL; }
+    Stmt **StmtSlot(int i) { return i == 0 ? &body : NULL; }
 };
 
 class LoopStmt : public ConditionalStmt
@@ -96,7 +122,10 @@ class ForStmt : public LoopStmt
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
     const char *GetPrintNameForNode() { return "ForStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    Expr **ExprSlot(int i) { return i == 0 ? &init : i == 1 ? &test : i == 2 ? &step : NULL; }
 };
 
 class WhileStmt : public LoopStmt
@@ -105,6 +134,8 @@ class WhileStmt : public LoopStmt
     WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
     const char *GetPrintNameForNode() { return "WhileStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
 };
 
@@ -118,7 +149,10 @@ class IfStmt : public ConditionalStmt
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
     const char *GetPrintNameForNode() { return "IfStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    Stmt **StmtSlot(int i) { return i == 0 ? &body : i == 1 ? &elseBody : NULL; }
 };
 
 class IfStmtExprError : public IfStmt
@@ -133,6 +167,7 @@ class BreakStmt : public Stmt
   public:
     BreakStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "BreakStmt"; }
+    void Emit(GlslWriter *out);
     void Check();
 };
 
@@ -141,6 +176,7 @@ class ContinueStmt : public Stmt
   public:
     ContinueStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "ContinueStmt"; }
+    void Emit(GlslWriter *out);
     void Check();
 };
 
@@ -153,7 +189,10 @@ class ReturnStmt : public Stmt
     ReturnStmt(yyltype loc, Expr *expr = NULL);
     const char *GetPrintNameForNode() { return "ReturnStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    Expr **ExprSlot(int i) { return i == 0 ? &expr : NULL; }
 };
 
 class SwitchLabel : public Stmt
@@ -167,7 +206,11 @@ class SwitchLabel : public Stmt
     SwitchLabel(Expr *label, Stmt *stmt);
     SwitchLabel(Stmt *stmt);
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    Expr **ExprSlot(int i) { return i == 0 ? &label : NULL; }
+    Stmt **StmtSlot(int i) { return i == 0 ? &stmt : NULL; }
 };
 
 class Case : public SwitchLabel
@@ -192,14 +235,20 @@ class SwitchStmt : public Stmt
   protected:
     Expr *expr;
     List<Stmt*> *cases;
-    Default *def;
+    Stmt *def;      // a Default, or NULL
 
   public:
     SwitchStmt() : expr(NULL), cases(NULL), def(NULL) {}
     SwitchStmt(Expr *expr, List<Stmt*> *cases, Default *def);
     virtual const char *GetPrintNameForNode() { return "SwitchStmt"; }
     void PrintChildren(int indentLevel);
+    void Serialize(AstWriter *out);
+    void Emit(GlslWriter *out);
     void Check();
+    List<Stmt*> *GetCases() { return cases; }
+    Expr **ExprSlot(int i) { return i == 0 ? &expr : NULL; }
+    Stmt **StmtSlot(int i)
+        { int n = cases->NumElements(); return i < n ? &cases->NthRef(i) : i == n ? &def : NULL; }
 };
 
 class SwitchStmtError : public SwitchStmt
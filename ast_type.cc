@@ -42,6 +42,43 @@ TypeQualifier *TypeQualifier::outTypeQualifier = new TypeQualifier("out");
 TypeQualifier *TypeQualifier::constTypeQualifier = new TypeQualifier("const");
 TypeQualifier *TypeQualifier::uniformTypeQualifier = new TypeQualifier("uniform");
 
+/* Only ever append to these, since the numbering is stored in files. */
+static Type **const builtinTypes[] = {
+    &Type::intType, &Type::uintType, &Type::floatType, &Type::boolType, &Type::voidType,
+    &Type::vec2Type, &Type::vec3Type, &Type::vec4Type,
+    &Type::mat2Type, &Type::mat3Type, &Type::mat4Type,
+    &Type::ivec2Type, &Type::ivec3Type, &Type::ivec4Type,
+    &Type::bvec2Type, &Type::bvec3Type, &Type::bvec4Type,
+    &Type::uvec2Type, &Type::uvec3Type, &Type::uvec4Type,
+};
+static const int NumBuiltinTypes = sizeof(builtinTypes) / sizeof(builtinTypes[0]);
+
+static TypeQualifier **const builtinQualifiers[] = {
+    &TypeQualifier::inTypeQualifier, &TypeQualifier::outTypeQualifier,
+    &TypeQualifier::constTypeQualifier, &TypeQualifier::uniformTypeQualifier,
+};
+static const int NumBuiltinQualifiers = sizeof(builtinQualifiers) / sizeof(builtinQualifiers[0]);
+
+int Type::IndexOf(Type *type) {
+    for (int i = 0; type && i < NumBuiltinTypes; i++)
+        if (*builtinTypes[i] == type) return i;
+    return -1;
+}
+
+Type *Type::WithIndex(int index) {
+    return index >= 0 && index < NumBuiltinTypes ? *builtinTypes[index] : NULL;
+}
+
+int TypeQualifier::IndexOf(TypeQualifier *typeq) {
+    for (int i = 0; typeq && i < NumBuiltinQualifiers; i++)
+        if (*builtinQualifiers[i] == typeq) return i;
+    return -1;
+}
+
+TypeQualifier *TypeQualifier::WithIndex(int index) {
+    return index >= 0 && index < NumBuiltinQualifiers ? *builtinQualifiers[index] : NULL;
+}
+
 Type::Type(const char *n) {
     Assert(n);
     typeName = strdup(n);
@@ -29,8 +29,14 @@ class TypeQualifier : public Node
     TypeQualifier(yyltype loc) : Node(loc) {}
     TypeQualifier(const char *str);
 
+    // The qualifiers above by number, -1/NULL if there is none; files
+    // that store qualifiers this way depend on the numbering
+    static int IndexOf(TypeQualifier *typeq);
+    static TypeQualifier *WithIndex(int index);
+
     const char *GetPrintNameForNode() { return "TypeQualifier"; }
     void PrintChildren(int indentLevel);
+    const char *GetName() { return typeQualifierName; }
 };
 
 class Type : public Node 
@@ -49,6 +55,12 @@ class Type : public Node
 
     Type(yyltype loc) : Node(loc) {}
     Type(const char *str);
+
+    // The built-in types above (except errorType) by number, -1/NULL if
+    // there is none; files that store types this way depend on the
+    // numbering
+    static int IndexOf(Type *type);
+    static Type *WithIndex(int index);
     
     const char *GetPrintNameForNode() { return "Type"; }
     void PrintChildren(int indentLevel);
@@ -91,6 +103,7 @@ class ArrayType : public Type
     void PrintChildren(int indentLevel);
     void PrintToStream(ostream& out) { out << elemType << "[]"; }
     Type *GetElemType() {return elemType;}
+    int GetElemCount() {return elemCount;}
 };
 
  
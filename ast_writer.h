@@ -0,0 +1,45 @@
+/* File: ast_writer.h
+ * ------------------
+ * The interface through which a node hands its fields and children to
+ * something that writes the tree out, see Node::Serialize(). Each node
+ * writes only its own part, in a fixed order, and passes its children
+ * to WriteNode() (NULL for an absent one) or WriteList(); the writer
+ * decides whether and when to descend into them. Implemented by the
+ * binary AST writer (ast_binary.h) and the JSON dump (ast_json.h).
+ */
+
+#ifndef _H_ast_writer
+#define _H_ast_writer
+
+#include <stdint.h>
+#include "list.h"
+#include "location.h"
+
+class Node;
+class Type;
+class TypeQualifier;
+
+class AstWriter {
+  public:
+    virtual ~AstWriter() {}
+
+    virtual void WriteNode(Node *node) = 0;
+    template <class Element> void WriteList(List<Element> *list) {
+        BeginList(list->NumElements());
+        for (int i = 0; i < list->NumElements(); i++)
+            WriteNode(list->Nth(i));
+        EndList();
+    }
+    virtual void BeginList(int length) = 0;
+    virtual void EndList() = 0;
+
+    virtual void WriteInt(int64_t value) = 0;
+    virtual void WriteBool(bool value) = 0;
+    virtual void WriteDouble(double value) = 0;
+    virtual void WriteString(const char *str) = 0;     // a name or token
+    virtual void WriteSpan(const yyltype *span) = 0;   // NULL for none
+    virtual void WriteType(Type *type) = 0;            // as declared
+    virtual void WriteQualifier(TypeQualifier *typeq) = 0;
+};
+
+#endif
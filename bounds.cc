@@ -0,0 +1,50 @@
+/* File: bounds.cc
+ * ---------------
+ * Implementation of the limits on a check.
+ */
+
+#include <limits.h>
+#include "bounds.h"
+#include "errors.h"
+#include "arena.h"
+
+long Bounds::maxBytes = LONG_MAX;
+long Bounds::maxTokens = LONG_MAX;
+long Bounds::maxNodes = LONG_MAX;
+int Bounds::maxNesting = INT_MAX;
+int Bounds::maxScopes = INT_MAX;
+long Bounds::bytes = 0;
+long Bounds::tokens = 0;
+long Bounds::nodes = 0;
+int Bounds::nesting = 0;
+static long maxArenaBytes;
+
+static long OrNone(long limit) { return limit > 0 ? limit : LONG_MAX; }
+
+static void ArenaExceeded() {
+    throw Bounds::Exceeded("bytes of tree", maxArenaBytes);
+}
+
+void Bounds::Start(const glc_options *options) {
+    Stop();
+    bytes = tokens = nodes = 0;
+    nesting = 0;
+    if (!options) return;
+    maxBytes = OrNone(options->max_input_bytes);
+    maxTokens = OrNone(options->max_tokens);
+    maxNodes = OrNone(options->max_nodes);
+    maxNesting = options->max_nesting > 0 ? options->max_nesting : INT_MAX;
+    maxScopes = options->max_scope_depth > 0 ? options->max_scope_depth : INT_MAX;
+    maxArenaBytes = options->max_arena_bytes;
+    if (maxArenaBytes > 0) AstArena().SetLimit(maxArenaBytes, ArenaExceeded);
+}
+
+void Bounds::Stop() {
+    maxBytes = maxTokens = maxNodes = LONG_MAX;
+    maxNesting = maxScopes = INT_MAX;
+    AstArena().SetLimit(0, NULL);
+}
+
+void Bounds::Exceeded::Report() const {
+    ReportError::LimitExceeded(what, limit);
+}
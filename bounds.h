@@ -0,0 +1,80 @@
+/**
+ * File: bounds.h
+ * --------------
+ * Hard limits on what one check may take, for shaders from untrusted
+ * sources: the bytes of source scanned, the tokens parsed, the AST nodes
+ * built, how deeply brackets nest, how deeply scopes nest, and the bytes
+ * of arena the tree takes up. Each is counted where the resource is
+ * used, with one comparison against a limit that is the largest value
+ * of its type when not set:
+ *
+ *   bytes     DoBeforeEachAction() in the scanner, and GlcParser::Feed()
+ *             for a line still being buffered
+ *   tokens    yylex(), which also tracks the brackets open
+ *   nodes     Node::operator new
+ *   scopes    SymbolTable::push(), counting the global scope
+ *   arena     Arena::Allocate(), when it moves on to another chunk, so
+ *             the tree may run over by less than a chunk
+ *
+ * The first limit reached throws Bounds::Exceeded, which unwinds the
+ * check like an expired deadline, stopping the parser first if it was
+ * reached while scanning (see deadline.h), and is reported as a
+ * GLC_E_LIMIT_EXCEEDED error.
+ */
+
+#ifndef _H_bounds
+#define _H_bounds
+
+#include "glc.h"
+
+/* Struct: CheckAbandoned
+ * ----------------------
+ * Thrown to give up on a check part way through. Whoever started the
+ * check catches it, drops what the check was holding back, and calls
+ * Report() to raise the error saying why.
+ */
+struct CheckAbandoned {
+    virtual ~CheckAbandoned() {}
+    virtual void Report() const = 0;
+};
+
+class Bounds {
+  public:
+    struct Exceeded : CheckAbandoned {
+        const char *what;    // the unit counted, e.g. "tokens"
+        long limit;
+        Exceeded(const char *w, long l) : what(w), limit(l) {}
+        void Report() const;
+    };
+
+    // Arms the limits options sets for the check about to start (none if
+    // options is NULL) and zeroes the counts; Stop() disarms them.
+    static void Start(const glc_options *options);
+    static void Stop();
+
+    // Zeroes the counts of the scanner, keeping the limits, before the
+    // same input is scanned again
+    static void Recount() { bytes = tokens = 0; nesting = 0; }
+
+    static void CountBytes(long n)
+        { if ((bytes += n) > maxBytes) throw Exceeded("bytes", maxBytes); }
+    static void CheckBuffered(long n)
+        { if (n > maxBytes) throw Exceeded("bytes", maxBytes); }
+    static void CountToken()
+        { if (++tokens > maxTokens) throw Exceeded("tokens", maxTokens); }
+    static void OpenBracket()
+        { if (++nesting > maxNesting) throw Exceeded("levels of nesting", maxNesting); }
+    static void CloseBracket() { nesting--; }
+    static void CountNode()
+        { if (++nodes > maxNodes) throw Exceeded("nodes", maxNodes); }
+    static void CheckScopes(int depth)
+        { if (depth > maxScopes) throw Exceeded("nested scopes", maxScopes); }
+
+  private:
+    static long maxBytes, maxTokens, maxNodes;
+    static int maxNesting, maxScopes;
+    static long bytes, tokens, nodes;
+    static int nesting;
+};
+
+#endif
@@ -0,0 +1,250 @@
+/* File: cache.cc
+ * --------------
+ * Implementation of the on-disk result cache.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <algorithm>   // for sort
+#include "cache.h"
+#include "scanner.h"
+#include "parser.h"
+#include "utility.h"
+#include "glc.h"
+#include "prelude.h"
+#include "bounds.h"
+
+static const char EntrySuffix[] = ".glcc";
+
+/* Options that change which errors are reported for the same input, and
+ * so have to be part of the key. Add new ones here.
+ */
+static const char *ruleOptions[] = { "max-depth", "max-input-bytes", "max-tokens", "max-nodes",
+                                     "max-nesting", "max-scope-depth", "max-arena-bytes", NULL };
+
+static string RuleSet() {
+    string rules;
+    for (int i = 0; ruleOptions[i]; i++) {
+        const char *value = GetOption(ruleOptions[i]);
+        if (!value) continue;
+        rules += ruleOptions[i];
+        rules += '=';
+        rules += value;
+        rules += ';';
+    }
+    return rules;
+}
+
+// 64-bit FNV-1a
+static void Mix(uint64_t *hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        *hash ^= p[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+ResultCache::ResultCache(const char *d, long bytes)
+    : dir(d), maxBytes(bytes), usedBytes(-1), hits(0), misses(0), stores(0), evictions(0) {
+    mkdir(d, 0777); // fine if it already exists
+}
+
+/* Scans source and hashes its tokens into key, recording the position of
+ * each in tokens. Returns false if the scanner reported any errors, which
+ * are held back here and reported again when the input is checked. The
+ * scan is held to the check's limits, so that a hit is bounded too; the
+ * caller must Bounds::Recount() before scanning source again.
+ */
+bool ResultCache::Fingerprint(const string &source, uint64_t *key,
+                              vector<yyltype> *tokens) {
+    uint64_t hash = 14695981039346656037ULL;
+    string rules = RuleSet();
+    Mix(&hash, GLC_VERSION, sizeof(GLC_VERSION));
+    Mix(&hash, rules.c_str(), rules.size() + 1);
+    uint64_t prelude = PreludeFingerprint();
+    Mix(&hash, &prelude, sizeof(prelude));
+
+    vector<Diagnostic> raised;
+    InitScanner();
+    ScanChunk(source.data(), source.size(), false);
+    ReportError::Capture(&raised);
+    int token;
+    while ((token = yylex()) != 0 && token != YYerror) {
+        Mix(&hash, &token, sizeof(token));
+        Mix(&hash, &yylloc.first_line, sizeof(yylloc.first_line));
+        Mix(&hash, yytext, strlen(yytext) + 1);
+        tokens->push_back(yylloc);
+    }
+    ReportError::Capture(NULL);
+    RethrowAbandoned();
+    *key = hash;
+    return raised.empty();
+}
+
+string ResultCache::EntryPath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx", (unsigned long long)key);
+    return dir + name + EntrySuffix;
+}
+
+/* Entry format: a header line with the glc version and token count,
+ * then one line per error holding the indices of the tokens its
+ * position starts and ends at (-1 if it has none), its code and its
+ * message with newlines and backslashes escaped.
+ */
+bool ResultCache::Replay(const string &path, const vector<yyltype> &tokens) {
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp) return false;
+
+    char version[32];
+    int numTokens, numErrors;
+    bool ok = fscanf(fp, "glc %31s %d %d\n", version, &numTokens, &numErrors) == 3
+              && strcmp(version, GLC_VERSION) == 0 && numTokens == tokens.size();
+    vector<Diagnostic> diagnostics;
+    for (int i = 0; ok && i < numErrors; i++) {
+        Diagnostic d;
+        int start, end, code, ch;
+        ok = fscanf(fp, "%d %d %d ", &start, &end, &code) == 3
+             && start >= -1 && start < numTokens && end >= start && end < numTokens;
+        while (ok && (ch = getc(fp)) != '\n') {
+            if (ch == '\\') ch = getc(fp) == 'n' ? '\n' : '\\';
+            if (ch == EOF) ok = false;
+            else d.message += ch;
+        }
+        d.code = (glc_code)code;
+        d.located = start >= 0;
+        if (ok && d.located) {
+            d.loc = tokens[start];
+            d.loc.last_line = tokens[end].last_line;
+            d.loc.last_column = tokens[end].last_column;
+        }
+        diagnostics.push_back(d);
+    }
+    fclose(fp);
+    if (!ok) return false;
+
+    for (int i = 0; i < diagnostics.size(); i++)
+        ReportError::Report(diagnostics[i]);
+    utime(path.c_str(), NULL); // most recently used
+    return true;
+}
+
+void ResultCache::Store(const string &path, const vector<Diagnostic> &diagnostics,
+                        const vector<yyltype> &tokens) {
+    string entry;
+    char line[64];
+    snprintf(line, sizeof(line), "glc %s %d %d\n", GLC_VERSION,
+             (int)tokens.size(), (int)diagnostics.size());
+    entry += line;
+    for (int i = 0; i < diagnostics.size(); i++) {
+        const Diagnostic &d = diagnostics[i];
+        int start = -1, end = -1;
+        if (d.located && !FindTokens(tokens.data(), tokens.size(), d.loc, &start, &end))
+            return;
+        snprintf(line, sizeof(line), "%d %d %d ", start, end, (int)d.code);
+        entry += line;
+        for (int j = 0; j < d.message.size(); j++) {
+            char ch = d.message[j];
+            if (ch == '\n') entry += "\\n";
+            else if (ch == '\\') entry += "\\\\";
+            else entry += ch;
+        }
+        entry += '\n';
+    }
+
+    snprintf(line, sizeof(line), "/.tmp.%d", (int)getpid());
+    string temp = dir + line;
+    FILE *fp = fopen(temp.c_str(), "w");
+    if (!fp) return;
+    bool ok = fwrite(entry.data(), 1, entry.size(), fp) == entry.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    stores++;
+    if (usedBytes >= 0) usedBytes += entry.size();
+    if (usedBytes < 0 || usedBytes > maxBytes) Evict();
+}
+
+struct CacheEntry {
+    string path;
+    time_t used;
+    long bytes;
+    bool operator<(const CacheEntry &other) const { return used < other.used; }
+};
+
+void ResultCache::Evict() {
+    DIR *d = opendir(dir.c_str());
+    if (!d) return;
+    vector<CacheEntry> entries;
+    long total = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name), suffix = sizeof(EntrySuffix) - 1;
+        if (len <= suffix || strcmp(ent->d_name + len - suffix, EntrySuffix) != 0)
+            continue;
+        CacheEntry entry;
+        entry.path = dir + "/" + ent->d_name;
+        struct stat info;
+        if (stat(entry.path.c_str(), &info) != 0) continue;
+        entry.used = info.st_mtime;
+        entry.bytes = info.st_size;
+        total += entry.bytes;
+        entries.push_back(entry);
+    }
+    closedir(d);
+    usedBytes = total;
+    if (total <= maxBytes) return;
+
+    sort(entries.begin(), entries.end());
+    long target = maxBytes - maxBytes / 4;
+    for (int i = 0; i < entries.size() && total > target; i++) {
+        if (unlink(entries[i].path.c_str()) != 0) continue;
+        total -= entries[i].bytes;
+        evictions++;
+    }
+    usedBytes = total;
+}
+
+void ResultCache::Check(const string &source) {
+    vector<yyltype> tokens;
+    uint64_t key;
+    bool cacheable = Fingerprint(source, &key, &tokens);
+    string path = EntryPath(key);
+    if (cacheable && Replay(path, tokens)) {
+        hits++;
+        return;
+    }
+    misses++;
+    Bounds::Recount();   // the fingerprint counted the tokens once already
+
+    // Hold the errors back so they can be stored, then print them. A
+    // check cut short by its deadline or a limit prints what it found
+    // but is not stored, since it is not the whole result.
+    vector<Diagnostic> diagnostics;
+    ReportError::Collect(&diagnostics);
+    try {
+        GlcParser parser;
+        parser.Feed(source.data(), source.size());
+        parser.Finish();
+    } catch (const CheckAbandoned &) {
+        ReportError::Collect(NULL);
+        for (int i = 0; i < diagnostics.size(); i++)
+            ReportError::Print(diagnostics[i]);
+        throw;
+    }
+    ReportError::Collect(NULL);
+    for (int i = 0; i < diagnostics.size(); i++)
+        ReportError::Print(diagnostics[i]);
+    if (cacheable) Store(path, diagnostics, tokens);
+}
+
+void ResultCache::PrintStats() {
+    PrintDebug("stats", "cache: %d hits, %d misses, %d stored, %d evicted",
+               hits, misses, stores, evictions);
+}
@@ -0,0 +1,65 @@
+/**
+ * File: cache.h
+ * -------------
+ * On-disk cache of check results, used by glc --cache-dir so that
+ * shaders which have not changed since the last run are neither parsed
+ * nor checked again.
+ *
+ * An entry is keyed by a fingerprint of the input's token stream: the
+ * kind, text and line of every token, so whitespace and comments that do
+ * not move tokens to other lines do not change it. Lines stay in the key
+ * because some messages quote line numbers. The glc version and the
+ * options that affect checking are mixed in as well. The entry records
+ * each error's message and the tokens its position starts and ends at;
+ * on a hit the positions are taken from those tokens in the new input,
+ * so the output is exactly what checking it would have printed. Inputs
+ * the scanner reports errors for are never cached.
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * concurrent glc processes can share a cache directory. Using an entry
+ * touches it. The directory is only scanned on the first store and when
+ * the bytes stored since push the total it found past the size bound;
+ * then the least recently used entries are removed until it is back
+ * under three quarters of the bound, so that a full cache is not
+ * scanned again on the next store.
+ */
+
+#ifndef _H_cache
+#define _H_cache
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "location.h"
+#include "errors.h"
+
+using namespace std;
+
+#define DefaultCacheBytes (64L << 20)
+
+class ResultCache {
+  public:
+    ResultCache(const char *dir, long maxBytes);
+
+    // Checks source like glc does with stdin, printing its errors, but
+    // replays them from the cache when it can
+    void Check(const string &source);
+
+    // Prints hit and miss counts under the "stats" debug key
+    void PrintStats();
+
+  private:
+    string dir;
+    long maxBytes;
+    long usedBytes;     // at the last scan plus stored since, -1 before it
+    int hits, misses, stores, evictions;
+
+    bool Fingerprint(const string &source, uint64_t *key, vector<yyltype> *tokens);
+    string EntryPath(uint64_t key);
+    bool Replay(const string &path, const vector<yyltype> &tokens);
+    void Store(const string &path, const vector<Diagnostic> &diagnostics,
+               const vector<yyltype> &tokens);
+    void Evict();
+};
+
+#endif
@@ -0,0 +1,89 @@
+/* File: callgraph.cc
+ * ------------------
+ * Implementation of the call graph.
+ */
+
+#include <map>
+#include <string>
+#include "callgraph.h"
+#include "ast_writer.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+
+using namespace std;
+
+/* Goes through a tree with an explicit stack, like the JSON dump, taking
+ * each node's children from its Serialize() and noting the functions
+ * called.
+ */
+class CallCollector : public AstWriter {
+  public:
+    void Collect(Node *root, vector<const char *> *called);
+
+    void WriteNode(Node *node) { if (node) stack.push_back(node); }
+    void BeginList(int length) {}
+    void EndList() {}
+    void WriteInt(int64_t value) {}
+    void WriteBool(bool value) {}
+    void WriteDouble(double value) {}
+    void WriteString(const char *str) {}
+    void WriteSpan(const yyltype *span) {}
+    void WriteType(Type *type) {}
+    void WriteQualifier(TypeQualifier *typeq) {}
+
+  private:
+    vector<Node *> stack;
+};
+
+void CallCollector::Collect(Node *root, vector<const char *> *called) {
+    stack.push_back(root);
+    while (!stack.empty()) {
+        Node *node = stack.back();
+        stack.pop_back();
+        Call *call = dynamic_cast<Call *>(node);
+        if (call && call->GetIdentifier())
+            called->push_back(call->GetIdentifier()->GetName());
+        node->Serialize(this);
+    }
+}
+
+void FindReachable(List<Decl*> *decls, const char *entries, vector<bool> *reachable) {
+    int n = decls->NumElements();
+    reachable->assign(n, false);
+    multimap<string, int> functions;
+    vector<const char *> called;
+    CallCollector collector;
+    for (int i = 0; i < n; i++) {
+        Decl *decl = decls->Nth(i);
+        if (dynamic_cast<FnDecl *>(decl))
+            functions.insert(make_pair(string(decl->GetIdentifier()->GetName()), i));
+        else {
+            (*reachable)[i] = true;
+            collector.Collect(decl, &called);
+        }
+    }
+
+    vector<string> entryNames;
+    string names = entries;
+    for (size_t start = 0; start <= names.size(); ) {
+        size_t end = names.find(',', start);
+        if (end == string::npos) end = names.size();
+        if (end > start) entryNames.push_back(names.substr(start, end - start));
+        start = end + 1;
+    }
+    for (int i = 0; i < entryNames.size(); i++)
+        called.push_back(entryNames[i].c_str());
+
+    // Every function reached is searched for calls once
+    while (!called.empty()) {
+        string name = called.back();
+        called.pop_back();
+        pair<multimap<string, int>::iterator, multimap<string, int>::iterator> range
+            = functions.equal_range(name);
+        for (multimap<string, int>::iterator it = range.first; it != range.second; ++it) {
+            if ((*reachable)[it->second]) continue;
+            (*reachable)[it->second] = true;
+            collector.Collect(decls->Nth(it->second), &called);
+        }
+    }
+}
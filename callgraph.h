@@ -0,0 +1,30 @@
+/* File: callgraph.h
+ * -----------------
+ * The call graph of a program, for glc --reachable-only: which of its
+ * functions can be called, directly or not, from its entry points. The
+ * entry points are main unless --entry=name[,name...] names others, and
+ * calls in the initializers of global variables count as made from one.
+ *
+ * The graph is built before anything is checked, so calls are matched to
+ * functions by name alone: a name declared more than once reaches every
+ * declaration of it, and a call to a name that is not a function here
+ * (a prelude function, or a mistake checking will report) reaches none.
+ */
+
+#ifndef _H_callgraph
+#define _H_callgraph
+
+#include <vector>
+#include "list.h"
+
+class Decl;
+
+/* Function: FindReachable()
+ * -------------------------
+ * Sets (*reachable)[i] for each function among decls that can be reached
+ * from the entry points named in the comma-separated list entries, and
+ * for every declaration that is not a function.
+ */
+void FindReachable(List<Decl*> *decls, const char *entries, std::vector<bool> *reachable);
+
+#endif
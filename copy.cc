@@ -0,0 +1,227 @@
+/* File: copy.cc
+ * -------------
+ * Implementation of copying checked trees.
+ */
+
+#include <set>
+#include <vector>
+#include "copy.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+#include "symtable.h"
+
+using namespace std;
+
+// Some statements are made without a location
+static yyltype Where(Node *node) {
+    yyltype loc = {};
+    return node->GetLocation() ? *node->GetLocation() : loc;
+}
+
+void TreeCopier::Substitute(VarDecl *var, Expr *value) {
+    substitutes[var] = value;
+    byName[var->GetIdentifier()->GetName()] = value;
+}
+
+void TreeCopier::Clear() {
+    substitutes.clear();
+    byName.clear();
+}
+
+Stmt *TreeCopier::CopyStmt(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL) return NULL;
+    if (Expr *expr = dynamic_cast<Expr *>(stmt)) return CopyExpr(expr);
+
+    if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt))
+        return new DeclStmt(CopyDecl(dynamic_cast<VarDecl *>(declStmt->GetDecl())));
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        List<VarDecl*> *decls = new List<VarDecl*>;
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            decls->Append(CopyDecl(block->GetDecls()->Nth(i)));
+        List<Stmt*> *stmts = new List<Stmt*>;
+        for (int i = 0; i < block->GetStmts()->NumElements(); i++)
+            stmts->Append(CopyStmt(block->GetStmts()->Nth(i)));
+        return new StmtBlock(decls, stmts);
+    }
+
+    // The rest are made of their slots
+    vector<Expr *> exprs;
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        exprs.push_back(*exprSlot ? CopyExpr(*exprSlot) : NULL);
+    vector<Stmt *> stmts;
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        stmts.push_back(CopyStmt(*stmtSlot));
+    if (dynamic_cast<ForStmt *>(stmt))
+        return new ForStmt(exprs[0], exprs[1], exprs[2], stmts[0]);
+    if (dynamic_cast<WhileStmt *>(stmt))
+        return new WhileStmt(exprs[0], stmts[0]);
+    if (dynamic_cast<IfStmt *>(stmt))
+        return new IfStmt(exprs[0], stmts[0], stmts[1]);
+    if (dynamic_cast<BreakStmt *>(stmt))
+        return new BreakStmt(Where(stmt));
+    if (dynamic_cast<ContinueStmt *>(stmt))
+        return new ContinueStmt(Where(stmt));
+    if (dynamic_cast<ReturnStmt *>(stmt))
+        return new ReturnStmt(Where(stmt), exprs[0]);
+    if (dynamic_cast<Case *>(stmt))
+        return new Case(exprs[0], stmts[0]);
+    if (dynamic_cast<Default *>(stmt))
+        return new Default(stmts[0]);
+    SwitchStmt *switchStmt = dynamic_cast<SwitchStmt *>(stmt);
+    Assert(switchStmt != NULL);
+    List<Stmt*> *cases = new List<Stmt*>;
+    for (size_t i = 0; i + 1 < stmts.size(); i++)
+        cases->Append(stmts[i]);
+    return new SwitchStmt(exprs[0], cases, dynamic_cast<Default *>(stmts.back()));
+}
+
+// The initializer is copied before the name is the new variable's
+VarDecl *TreeCopier::CopyDecl(VarDecl *var) {
+    Expr *init = var->GetInitializer() ? CopyExpr(var->GetInitializer()) : NULL;
+    Identifier *name = new Identifier(Where(var), NameFor(var).c_str());
+    VarDecl *copy = var->GetTypeQualifier()
+                    ? new VarDecl(name, var->GetType(), var->GetTypeQualifier(), init)
+                    : new VarDecl(name, var->GetType(), init);
+    Substitute(var, new VarExpr(Where(var), copy));
+    return copy;
+}
+
+/* Operands are copied before the expression they are in, which takes
+ * the copies of its slots, NULL for an absent part, off the top of
+ * done.
+ */
+Expr *TreeCopier::CopyExpr(Expr *expr) {
+    struct Frame {
+        Expr *expr;
+        int next;       // the slot to copy next
+    };
+    vector<Frame> frames;
+    vector<Expr *> done;
+    Frame root = { expr, 0 };
+    frames.push_back(root);
+    while (!frames.empty()) {
+        Deadline::Poll();
+        Frame &top = frames.back();
+        Expr **operand = top.expr->ExprSlot(top.next++);
+        if (operand) {
+            Frame next = { *operand, 0 };
+            if (*operand) frames.push_back(next);
+            else done.push_back(NULL);
+            continue;
+        }
+        Expr *original = top.expr;
+        size_t count = top.next - 1;
+        frames.pop_back();
+        Expr *copy = CopyNode(original, count ? &done[done.size() - count] : NULL);
+        done.resize(done.size() - count);
+        done.push_back(copy);
+    }
+    return done.back();
+}
+
+Expr *TreeCopier::CopyValue(Expr *value) {
+    bool was = substituting;
+    substituting = false;
+    Expr *copy = CopyExpr(value);
+    substituting = was;
+    return copy;
+}
+
+Expr *TreeCopier::CopyNode(Expr *expr, Expr **operands) {
+    yyltype loc = Where(expr);
+    Expr *copy;
+    if (VarExpr *use = dynamic_cast<VarExpr *>(expr)) {
+        VarDecl *var = use->GetDecl();
+        if (substituting && var && substitutes.count(var))
+            return CopyValue(substitutes[var]);
+        const char *name = use->GetIdentifier()->GetName();
+        if (substituting && !var && byName.count(name))
+            return CopyValue(byName[name]);
+        copy = var ? new VarExpr(loc, var) : new VarExpr(loc, new Identifier(loc, name));
+    } else if (IntConstant *i = dynamic_cast<IntConstant *>(expr)) {
+        copy = new IntConstant(loc, i->GetValue());
+    } else if (FloatConstant *f = dynamic_cast<FloatConstant *>(expr)) {
+        copy = new FloatConstant(loc, f->GetValue());
+    } else if (BoolConstant *b = dynamic_cast<BoolConstant *>(expr)) {
+        copy = new BoolConstant(loc, b->GetValue());
+    } else if (CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr)) {
+        Operator *op = compound->GetOperator();
+        op = new Operator(Where(op), op->GetToken());
+        Expr *left = operands[0], *right = operands[1];
+        if (dynamic_cast<AssignExpr *>(expr))
+            copy = new AssignExpr(left, op, right);
+        else if (dynamic_cast<PostfixExpr *>(expr))
+            copy = new PostfixExpr(left, op);
+        else if (dynamic_cast<RelationalExpr *>(expr))
+            copy = new RelationalExpr(left, op, right);
+        else if (dynamic_cast<EqualityExpr *>(expr))
+            copy = new EqualityExpr(left, op, right);
+        else
+            copy = left ? new ArithmeticExpr(left, op, right) : new ArithmeticExpr(op, right);
+    } else if (dynamic_cast<ConditionalExpr *>(expr)) {
+        copy = new ConditionalExpr(operands[0], operands[1], operands[2]);
+    } else if (dynamic_cast<ArrayAccess *>(expr)) {
+        copy = new ArrayAccess(loc, operands[0], operands[1]);
+    } else if (FieldAccess *field = dynamic_cast<FieldAccess *>(expr)) {
+        Identifier *id = field->GetField();
+        copy = new FieldAccess(operands[0], new Identifier(Where(id), id->GetName()));
+    } else if (Call *call = dynamic_cast<Call *>(expr)) {
+        List<Expr*> *actuals = new List<Expr*>;
+        for (int i = 0; i < call->GetActuals()->NumElements(); i++)
+            actuals->Append(operands[i]);
+        if (call->GetCallee()) {
+            copy = new Call(loc, call->GetCallee(), actuals);
+        } else {
+            Identifier *id = call->GetIdentifier();
+            copy = new Call(loc, NULL, new Identifier(Where(id), id->GetName()), actuals);
+        }
+    } else {
+        Assert(dynamic_cast<EmptyExpr *>(expr) != NULL);
+        copy = new EmptyExpr();
+    }
+    copy->SetType(expr->GetType());
+    return copy;
+}
+
+// The names a function's body declares
+static void Declared(Stmt *stmt, set<string> *names) {
+    Deadline::Poll();
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return;
+    if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt)) {
+        names->insert(declStmt->GetDecl()->GetIdentifier()->GetName());
+        return;
+    }
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            names->insert(block->GetDecls()->Nth(i)->GetIdentifier()->GetName());
+    }
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Declared(*stmtSlot, names);
+}
+
+void DeclaredNames(Program *program, set<string> *names) {
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        names->insert(decls->Nth(i)->GetIdentifier()->GetName());
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!fn) continue;
+        List<VarDecl*> *formals = fn->GetFormals();
+        for (int j = 0; j < formals->NumElements(); j++)
+            names->insert(formals->Nth(j)->GetIdentifier()->GetName());
+        if (fn->HasBody()) Declared(fn->GetBody(), names);
+    }
+    const ScopedTable *prelude = SymbolTable::getPrelude();
+    if (prelude) {
+        const SymMap &symbols = prelude->getSymbols();
+        for (SymMap::const_iterator it = symbols.begin(); it != symbols.end(); ++it)
+            names->insert(it->first);
+    }
+}
@@ -0,0 +1,67 @@
+/* File: copy.h
+ * ------------
+ * Copies of the checked statements and expressions of a function, for
+ * the passes that duplicate code, such as loop unrolling (see
+ * unroll.h).
+ *
+ * A copy is as checked as what it copies: each expression has the type
+ * of the one it copies, and each variable and call the same
+ * declaration. Two things differ. A variable declared in what is copied
+ * is declared afresh, under the name NameFor() gives it, and uses of it
+ * that follow in the copy are uses of the new one; and uses of a
+ * variable the copier has been told to substitute become copies of
+ * what it is substituted by. Names the checker left unresolved, as in
+ * subscripts, are matched by name instead. Statements are copied by
+ * recursion, expressions with an explicit stack.
+ */
+
+#ifndef _H_copy
+#define _H_copy
+
+#include <map>
+#include <set>
+#include <string>
+
+class Program;
+class Stmt;
+class Expr;
+class VarDecl;
+
+class TreeCopier {
+  public:
+    TreeCopier() : substituting(true) {}
+    virtual ~TreeCopier() {}
+
+    // From now on, uses of var in what is copied become copies of value,
+    // which is not itself copied with substitutions
+    void Substitute(VarDecl *var, Expr *value);
+    // Forgets the substitutions, including the variables declared afresh
+    void Clear();
+
+    Stmt *CopyStmt(Stmt *stmt);
+    Expr *CopyExpr(Expr *expr);
+
+  protected:
+    // The name to declare the copy of var, which what is copied
+    // declares, under
+    virtual std::string NameFor(VarDecl *var) = 0;
+
+  private:
+    std::map<VarDecl *, Expr *> substitutes;
+    std::map<std::string, Expr *> byName;       // for unresolved names
+    bool substituting;
+
+    VarDecl *CopyDecl(VarDecl *var);
+    Expr *CopyNode(Expr *expr, Expr **operands);
+    Expr *CopyValue(Expr *value);
+};
+
+/* Function: DeclaredNames()
+ * --------------------------
+ * Adds to names every name program or the prelude declares, globally
+ * or in a function, for a pass to give what it declares names that
+ * none of them hide or are hidden by.
+ */
+void DeclaredNames(Program *program, std::set<std::string> *names);
+
+#endif
@@ -0,0 +1,699 @@
+/* File: cse.cc
+ * ------------
+ * Implementation of common subexpression elimination.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cse.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+/* What an expression computes, as far as telling values apart goes: the
+ * kind of node and its operator or field, the number of its type, a
+ * constant's bits, a variable's declaration or a call's callee, and the
+ * value numbers of its operands (of a variable, what it has been stored
+ * to). The actuals of a call are numbered as a list of their own, each
+ * value of it adding one to those before.
+ */
+struct Value {
+    const char *kind, *name;
+    int type;
+    uint64_t leaf;
+    int operands[3];
+
+    bool operator==(const Value &other) const {
+        return strcmp(kind, other.kind) == 0 && strcmp(name, other.name) == 0
+               && type == other.type && leaf == other.leaf
+               && memcmp(operands, other.operands, sizeof(operands)) == 0;
+    }
+};
+
+struct ValueHash {
+    size_t operator()(const Value &value) const {
+        // 64-bit FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char *c = value.kind; *c; c++)
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+        for (const char *c = value.name; *c; c++)
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+        uint64_t words[] = { (uint64_t)value.type, value.leaf, (uint64_t)value.operands[0],
+                             (uint64_t)value.operands[1], (uint64_t)value.operands[2] };
+        for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+            hash = (hash ^ words[i]) * 1099511628211ULL;
+        return hash;
+    }
+};
+
+// The assignment, increment or decrement that expr is, if it is one
+static CompoundExpr *AsStore(Expr *expr) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr))
+        return compound;
+    if (compound && !compound->GetLeft()
+        && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--")))
+        return compound;
+    return NULL;
+}
+
+// The variable a store to target writes to, a[i] and v.x being a and v
+static VarDecl *Stored(Expr *target) {
+    for (;;) {
+        ArrayAccess *element = dynamic_cast<ArrayAccess *>(target);
+        FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+        if (element) target = element->GetBase();
+        else if (field && field->GetBase()) target = field->GetBase();
+        else break;
+    }
+    VarExpr *var = dynamic_cast<VarExpr *>(target);
+    return var ? var->GetDecl() : NULL;
+}
+
+static VarDecl *Stored(CompoundExpr *store) {
+    return Stored(store->GetLeft() ? store->GetLeft() : store->GetRight());
+}
+
+// Appends every expression in stmt to exprs, and its local variables to vars
+static void Scan(Stmt *stmt, vector<Expr *> *exprs, vector<VarDecl *> *vars) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    size_t from = exprs->size();
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    VarDecl *var = declStmt ? dynamic_cast<VarDecl *>(declStmt->GetDecl()) : NULL;
+    if (dynamic_cast<Expr *>(stmt)) {
+        exprs->push_back(dynamic_cast<Expr *>(stmt));
+    } else if (var) {
+        vars->push_back(var);
+        if (var->GetInitializer()) exprs->push_back(var->GetInitializer());
+    } else {
+        Expr **exprSlot;
+        for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+            if (*exprSlot) exprs->push_back(*exprSlot);
+    }
+    // Each expression added brings its operands in after it
+    for (size_t i = from; i < exprs->size(); i++) {
+        Deadline::Poll();
+        Expr **operand;
+        for (int j = 0; (operand = (*exprs)[i]->ExprSlot(j)) != NULL; j++)
+            if (*operand) exprs->push_back(*operand);
+    }
+    if (dynamic_cast<Expr *>(stmt) || declStmt) return;
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Scan(*stmtSlot, exprs, vars);
+}
+
+static bool Mentions(Expr *expr, const set<VarDecl *> &vars) {
+    vector<Expr *> stack(1, expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        VarExpr *var = dynamic_cast<VarExpr *>(top);
+        if (var && vars.count(var->GetDecl())) return true;
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    return false;
+}
+
+// Whether the operands of the operator in compound can be swapped
+static bool Commutes(CompoundExpr *compound) {
+    Operator *op = compound->GetOperator();
+    Type *left = compound->GetLeft()->GetType(), *right = compound->GetRight()->GetType();
+    if (!left || !right) return false;
+    if (op->IsOp("*")) return !left->IsMatrix() && !right->IsMatrix();
+    return op->IsOp("+") || op->IsOp("==") || op->IsOp("!=");
+}
+
+class SubexpressionEliminator {
+  public:
+    SubexpressionEliminator(Program *program)
+        : decls(program->GetDecls()), nextNumber(0), nextVersion(0), epoch(0),
+          globalEpoch(0), globalStores(0), nextTemp(0), replaced(0), temps(0), reused(0) {}
+
+    void Run();
+
+  private:
+    // Where a value was first computed, and what holds it: the variable
+    // it was stored to while that is unchanged, else a temporary once
+    // one is needed
+    struct Available {
+        Expr **slot;            // NULL if it is the initializer
+        VarDecl *initOf;        // of this variable
+        int frame, index;       // the block and the statement in it
+        VarDecl *holder;
+        int holderVersion;
+        VarDecl *temp;
+    };
+    // A block being gone through: the temporaries to declare in it, each
+    // before the statement numbered with it, and the values it makes
+    // available
+    struct Frame {
+        StmtBlock *block;
+        vector<pair<int, VarDecl *> > temps;
+        vector<int> values;
+    };
+    struct Visit {
+        Expr **slot;
+        bool conditional;       // computed only if a branch is taken
+    };
+
+    List<Decl*> *decls;
+    set<FnDecl *> pure;
+    unordered_map<Value, int, ValueHash> numbering;
+    unordered_map<int, Available> available;
+    vector<Frame> frames;
+    vector<Expr *> stack;
+    vector<Visit> visits;
+
+    // Of the function being gone through
+    set<VarDecl *> locals;
+    map<string, int> declared;                  // how many locals have each name
+    set<string> names;                          // it mentions or declares
+    unordered_map<VarDecl *, int> versions;
+    unordered_map<Expr *, int> numbers;         // of the statement being gone through
+
+    int nextNumber, nextVersion;
+    int epoch, globalEpoch;                     // for stores to variables not known
+    int globalStores;                           // for what calls return
+    int nextTemp;
+    int replaced, temps, reused;
+
+    void FindPure();
+    void Function(FnDecl *fn);
+
+    void Walk(Stmt **slot, bool listed, int index);
+    void WalkBlock(StmtBlock *block);
+    void Statement(Expr *expr, int host);
+    void Initializer(VarDecl *var, int host);
+    void Site(Expr **slot, int host);
+    void Hold(Available *entry, VarDecl *var);
+
+    void Number(Expr *root);
+    int NumberOf(Expr *expr);
+    int Find(const Value &value);
+    Available *Replace(Expr **root, int host, VarDecl *initOf);
+    void Reuse(Available *entry, Expr **slot);
+    void MakeTemp(Available *entry);
+    void Declare(Frame *frame);
+
+    bool Candidate(Expr *expr);
+    bool HasEffects(Expr *expr, CompoundExpr *store);
+    void Invalidate(Stmt *stmt);
+    void Bump(VarDecl *var);
+    string NewName();
+};
+
+void SubexpressionEliminator::Run() {
+    FindPure();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (fn && fn->HasBody()) Function(fn);
+    }
+    PrintDebug("stats", "cse: replaced %d repeated expressions: %d with %d new temporaries, "
+               "%d with variables that held them", replaced, replaced - reused, temps, reused);
+}
+
+/* A function is pure if neither it nor anything it calls stores to a
+ * global or an out parameter. Functions outside the program are not
+ * known to be.
+ */
+void SubexpressionEliminator::FindPure() {
+    set<FnDecl *> defined;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (fn && fn->HasBody()) defined.insert(fn);
+    }
+    map<FnDecl *, vector<FnDecl *> > callees;
+    for (set<FnDecl *>::iterator it = defined.begin(); it != defined.end(); ++it) {
+        FnDecl *fn = *it;
+        vector<Expr *> exprs;
+        vector<VarDecl *> vars;
+        Scan(fn->GetBody(), &exprs, &vars);
+        List<VarDecl*> *formals = fn->GetFormals();
+        bool writes = false;
+        for (int i = 0; i < formals->NumElements(); i++) {
+            vars.push_back(formals->Nth(i));
+            if (formals->Nth(i)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                writes = true;
+        }
+        set<VarDecl *> own(vars.begin(), vars.end());
+        for (size_t i = 0; i < exprs.size() && !writes; i++) {
+            CompoundExpr *store = AsStore(exprs[i]);
+            Call *call = dynamic_cast<Call *>(exprs[i]);
+            if (store && !own.count(Stored(store)))
+                writes = true;
+            else if (call && !defined.count(call->GetCallee()))
+                writes = true;
+            else if (call)
+                callees[fn].push_back(call->GetCallee());
+        }
+        if (!writes) pure.insert(fn);
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        map<FnDecl *, vector<FnDecl *> >::iterator it;
+        for (it = callees.begin(); it != callees.end(); ++it) {
+            if (!pure.count(it->first)) continue;
+            for (size_t i = 0; i < it->second.size(); i++) {
+                if (pure.count(it->second[i])) continue;
+                pure.erase(it->first);
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+void SubexpressionEliminator::Function(FnDecl *fn) {
+    vector<Expr *> exprs;
+    vector<VarDecl *> vars;
+    Scan(fn->GetBody(), &exprs, &vars);
+    List<VarDecl*> *formals = fn->GetFormals();
+    for (int i = 0; i < formals->NumElements(); i++)
+        vars.push_back(formals->Nth(i));
+    locals.clear();
+    declared.clear();
+    names.clear();
+    for (size_t i = 0; i < vars.size(); i++) {
+        locals.insert(vars[i]);
+        declared[vars[i]->GetIdentifier()->GetName()]++;
+        names.insert(vars[i]->GetIdentifier()->GetName());
+    }
+    for (size_t i = 0; i < exprs.size(); i++) {
+        if (VarExpr *var = dynamic_cast<VarExpr *>(exprs[i]))
+            names.insert(var->GetIdentifier()->GetName());
+        else if (Call *call = dynamic_cast<Call *>(exprs[i]))
+            names.insert(call->GetIdentifier()->GetName());
+    }
+    versions.clear();
+    numbering.clear();
+    Stmt *body = fn->GetBody();
+    Walk(&body, false, 0);
+}
+
+/* Only the statements directly in a block can have temporaries declared
+ * before them, and so make values available; anywhere else a statement
+ * can only use those made available before it. index is the place of
+ * the statement in its block, if listed.
+ */
+void SubexpressionEliminator::Walk(Stmt **slot, bool listed, int index) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL) return;
+    int host = listed ? index : -1;
+    if (Expr *expr = dynamic_cast<Expr *>(stmt)) {
+        Statement(expr, host);
+        return;
+    }
+    if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt)) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var && var->GetInitializer()) Initializer(var, host);
+        else if (var) Bump(var);
+        return;
+    }
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        WalkBlock(block);
+        return;
+    }
+    if (dynamic_cast<LoopStmt *>(stmt)) {
+        // The test and the step are gone through as the head sees them
+        ForStmt *forStmt = dynamic_cast<ForStmt *>(stmt);
+        if (forStmt && *stmt->ExprSlot(0)) Statement(*stmt->ExprSlot(0), host);
+        Invalidate(stmt);
+        Site(stmt->ExprSlot(forStmt ? 1 : 0), -1);
+        if (forStmt && *stmt->ExprSlot(2)) Statement(*stmt->ExprSlot(2), -1);
+        Walk(stmt->StmtSlot(0), false, 0);
+        return;
+    }
+    // An if, a switch, a return, a case: its expression first
+    if (stmt->ExprSlot(0) && !dynamic_cast<SwitchLabel *>(stmt))
+        Site(stmt->ExprSlot(0), host);
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Walk(stmtSlot, false, 0);
+}
+
+// The values made available in block are forgotten at its end
+void SubexpressionEliminator::WalkBlock(StmtBlock *block) {
+    Frame frame;
+    frame.block = block;
+    frames.push_back(frame);
+    List<Stmt*> *stmts = block->GetStmts();
+    for (int i = 0; i < stmts->NumElements(); i++)
+        Walk(&stmts->NthRef(i), true, i);
+    Frame *done = &frames.back();
+    for (size_t i = 0; i < done->values.size(); i++)
+        available.erase(done->values[i]);
+    if (!done->temps.empty()) Declare(done);
+    frames.pop_back();
+}
+
+/* The value an assignment stores is available, but the variable it
+ * stores to, and the targets of stores anywhere else, are changed.
+ */
+void SubexpressionEliminator::Statement(Expr *expr, int host) {
+    CompoundExpr *store = AsStore(expr);
+    if (!store || HasEffects(expr, store)) {
+        Invalidate(expr);
+        return;
+    }
+    Expr **value = dynamic_cast<AssignExpr *>(store) ? store->ExprSlot(1) : NULL;
+    Available *entry = NULL;
+    if (value) {
+        Number(*value);
+        entry = Replace(value, host, NULL);
+    }
+    VarDecl *var = Stored(store);
+    Bump(var);
+    if (entry && store->GetOperator()->IsOp("=") && dynamic_cast<VarExpr *>(store->GetLeft()))
+        Hold(entry, var);
+}
+
+// An initializer that names its own variable names the one it belongs to
+void SubexpressionEliminator::Initializer(VarDecl *var, int host) {
+    Expr *init = var->GetInitializer();
+    if (HasEffects(init, NULL)) {
+        Invalidate(init);
+        Bump(var);
+        return;
+    }
+    set<VarDecl *> self;
+    self.insert(var);
+    if (Mentions(init, self)) host = -1;
+    Number(init);
+    Expr *root = init;
+    Available *entry = Replace(&root, host, var);
+    if (root != init) var->SetInitializer(root);
+    Bump(var);
+    if (entry) Hold(entry, var);
+}
+
+// An expression that is computed for its value only
+void SubexpressionEliminator::Site(Expr **slot, int host) {
+    if (*slot == NULL) return;
+    if (HasEffects(*slot, NULL)) {
+        Invalidate(*slot);
+        return;
+    }
+    Number(*slot);
+    Replace(slot, host, NULL);
+}
+
+// A variable whose name another local shares may not be the one meant
+void SubexpressionEliminator::Hold(Available *entry, VarDecl *var) {
+    Expr *value = entry->initOf ? entry->initOf->GetInitializer() : *entry->slot;
+    if (var && locals.count(var) && declared[var->GetIdentifier()->GetName()] == 1
+        && var->GetType() == value->GetType()) {
+        entry->holder = var;
+        entry->holderVersion = versions[var];
+    }
+}
+
+// Numbers root and everything in it, operands first
+void SubexpressionEliminator::Number(Expr *root) {
+    numbers.clear();
+    stack.push_back(root);
+    vector<Expr *> order;
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        order.push_back(top);
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    for (size_t i = order.size(); i-- > 0; )
+        numbers[order[i]] = NumberOf(order[i]);
+}
+
+int SubexpressionEliminator::NumberOf(Expr *expr) {
+    Value value = { expr->GetPrintNameForNode(), "", Type::IndexOf(expr->GetType()), 0,
+                    { 0, 0, 0 } };
+    if (VarExpr *var = dynamic_cast<VarExpr *>(expr)) {
+        VarDecl *decl = var->GetDecl();
+        if (decl == NULL) return nextNumber++;
+        unordered_map<VarDecl *, int>::iterator version = versions.find(decl);
+        value.leaf = (uintptr_t)decl;
+        value.operands[0] = version == versions.end() ? 0 : version->second;
+        value.operands[1] = locals.count(decl) ? epoch : globalEpoch;
+    } else if (IntConstant *i = dynamic_cast<IntConstant *>(expr)) {
+        value.leaf = (uint64_t)(int64_t)i->GetValue();
+    } else if (FloatConstant *f = dynamic_cast<FloatConstant *>(expr)) {
+        double bits = f->GetValue();
+        memcpy(&value.leaf, &bits, sizeof(bits));
+    } else if (BoolConstant *b = dynamic_cast<BoolConstant *>(expr)) {
+        value.leaf = b->GetValue();
+    } else if (FieldAccess *field = dynamic_cast<FieldAccess *>(expr)) {
+        if (!field->GetBase()) return nextNumber++;
+        value.name = field->GetField()->GetName();
+        value.operands[0] = numbers[field->GetBase()];
+    } else if (Call *call = dynamic_cast<Call *>(expr)) {
+        // What the callee returns may depend on any global
+        value.leaf = (uintptr_t)call->GetCallee();
+        int actuals = -1;
+        for (int i = 0; i < call->GetActuals()->NumElements(); i++) {
+            Value more = { "Actuals", "", -1, 0,
+                           { actuals, numbers[call->GetActuals()->Nth(i)], 0 } };
+            actuals = Find(more);
+        }
+        value.operands[0] = actuals;
+        value.operands[1] = globalEpoch;
+        value.operands[2] = globalStores;
+    } else if (dynamic_cast<ArrayAccess *>(expr) || dynamic_cast<CompoundExpr *>(expr)
+               || dynamic_cast<ConditionalExpr *>(expr)) {
+        if (CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr))
+            value.name = compound->GetOperator()->GetToken();
+        Expr **operand;
+        for (int i = 0; (operand = expr->ExprSlot(i)) != NULL; i++)
+            value.operands[i] = *operand ? numbers[*operand] : -1;
+        CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+        if (compound && compound->GetLeft() && Commutes(compound)
+            && value.operands[0] > value.operands[1])
+            swap(value.operands[0], value.operands[1]);
+    } else {
+        return nextNumber++;
+    }
+    return Find(value);
+}
+
+// The number of value, a new one if it has not been seen before
+int SubexpressionEliminator::Find(const Value &value) {
+    pair<unordered_map<Value, int, ValueHash>::iterator, bool> known =
+        numbering.insert(make_pair(value, nextNumber));
+    if (known.second) nextNumber++;
+    return known.first->second;
+}
+
+/* Goes through the expression in root from the top, replacing each
+ * value that is available already and, if host is not -1, making
+ * available each other one. Returns what root was made, if it was.
+ */
+SubexpressionEliminator::Available *SubexpressionEliminator::Replace(Expr **root, int host,
+                                                                     VarDecl *initOf) {
+    Available *made = NULL;
+    Visit first = { root, false };
+    visits.push_back(first);
+    while (!visits.empty()) {
+        Deadline::Poll();
+        Visit visit = visits.back();
+        visits.pop_back();
+        Expr *expr = *visit.slot;
+        if (Candidate(expr)) {
+            int number = numbers[expr];
+            unordered_map<int, Available>::iterator known = available.find(number);
+            if (known != available.end()) {
+                Reuse(&known->second, visit.slot);
+                continue;
+            }
+            if (host >= 0 && !visit.conditional) {
+                bool top = visit.slot == root;
+                Available entry = { top && initOf ? NULL : visit.slot, top ? initOf : NULL,
+                                    (int)frames.size() - 1, host, NULL, 0, NULL };
+                available[number] = entry;
+                frames.back().values.push_back(number);
+                if (top) made = &available[number];
+            }
+        }
+        // Pushed last to first, so that the first is the first found
+        CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+        bool shortCircuits = compound && (compound->GetOperator()->IsOp("&&")
+                                          || compound->GetOperator()->IsOp("||"));
+        bool selects = dynamic_cast<ConditionalExpr *>(expr) != NULL;
+        int n = 0;
+        while (expr->ExprSlot(n)) n++;
+        for (int i = n - 1; i >= 0; i--) {
+            Expr **operand = expr->ExprSlot(i);
+            Visit next = { operand, visit.conditional || (i > 0 && (shortCircuits || selects)) };
+            if (*operand) visits.push_back(next);
+        }
+    }
+    return made;
+}
+
+void SubexpressionEliminator::Reuse(Available *entry, Expr **slot) {
+    VarDecl *with;
+    if (entry->holder && versions[entry->holder] == entry->holderVersion) {
+        with = entry->holder;
+        reused++;
+    } else {
+        if (!entry->temp) MakeTemp(entry);
+        with = entry->temp;
+    }
+    replaced++;
+    Expr *use = new VarExpr(*(*slot)->GetLocation(), with);
+    use->SetParent((*slot)->GetParent());
+    *slot = use;
+}
+
+// Moves the value where it was first computed into a new temporary
+void SubexpressionEliminator::MakeTemp(Available *entry) {
+    Expr *value = entry->initOf ? entry->initOf->GetInitializer() : *entry->slot;
+    yyltype loc = *value->GetLocation();
+    string name = NewName();
+    VarDecl *temp = new VarDecl(new Identifier(loc, name.c_str()), value->GetType());
+    Expr *use = new VarExpr(loc, temp);
+    if (entry->initOf) {
+        entry->initOf->SetInitializer(use);
+    } else {
+        use->SetParent(value->GetParent());
+        *entry->slot = use;
+    }
+    temp->SetInitializer(value);
+    frames[entry->frame].temps.push_back(make_pair(entry->index, temp));
+    entry->temp = temp;
+    entry->holder = NULL;
+    temps++;
+}
+
+static bool Earlier(const pair<int, VarDecl *> &a, const pair<int, VarDecl *> &b) {
+    return a.first < b.first;
+}
+
+/* Puts the temporaries of a block in before their statements, those
+ * that others are computed from first.
+ */
+void SubexpressionEliminator::Declare(Frame *frame) {
+    vector<pair<int, VarDecl *> > &made = frame->temps;
+    stable_sort(made.begin(), made.end(), Earlier);
+    List<Stmt*> *stmts = frame->block->GetStmts();
+    vector<Stmt *> kept;
+    size_t next = 0;
+    for (int i = 0; i < stmts->NumElements(); i++) {
+        set<VarDecl *> waiting;
+        for (size_t j = next; j < made.size() && made[j].first == i; j++)
+            waiting.insert(made[j].second);
+        while (!waiting.empty()) {
+            for (size_t j = next; j < made.size() && made[j].first == i; j++) {
+                VarDecl *temp = made[j].second;
+                if (!waiting.count(temp)) continue;
+                waiting.erase(temp);
+                if (Mentions(temp->GetInitializer(), waiting)) {
+                    waiting.insert(temp);
+                    continue;
+                }
+                DeclStmt *declStmt = new DeclStmt(temp);
+                declStmt->SetParent(frame->block);
+                kept.push_back(declStmt);
+            }
+        }
+        while (next < made.size() && made[next].first == i) next++;
+        kept.push_back(stmts->Nth(i));
+    }
+    while (stmts->NumElements() > 0)
+        stmts->RemoveAt(stmts->NumElements() - 1);
+    for (size_t i = 0; i < kept.size(); i++)
+        stmts->Append(kept[i]);
+}
+
+// An operator, a ?: or a call that computes a value of a built-in type
+bool SubexpressionEliminator::Candidate(Expr *expr) {
+    if (Type::IndexOf(expr->GetType()) < 0 || expr->GetType() == Type::voidType)
+        return false;
+    if (dynamic_cast<ConditionalExpr *>(expr)) return true;
+    if (Call *call = dynamic_cast<Call *>(expr)) return pure.count(call->GetCallee()) > 0;
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    return compound && compound->GetLeft() && compound->GetRight() && !AsStore(expr);
+}
+
+// Whether expr stores anywhere but in store, or calls what may
+bool SubexpressionEliminator::HasEffects(Expr *expr, CompoundExpr *store) {
+    size_t base = stack.size();
+    stack.push_back(expr);
+    bool effects = false;
+    while (stack.size() > base && !effects) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        Call *call = dynamic_cast<Call *>(top);
+        effects = (top != store && AsStore(top)) || (call && !pure.count(call->GetCallee()));
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    stack.resize(base);
+    return effects;
+}
+
+// Changes the variables stmt may store to
+void SubexpressionEliminator::Invalidate(Stmt *stmt) {
+    vector<Expr *> exprs;
+    vector<VarDecl *> vars;
+    Scan(stmt, &exprs, &vars);
+    for (size_t i = 0; i < exprs.size(); i++) {
+        CompoundExpr *store = AsStore(exprs[i]);
+        Call *call = dynamic_cast<Call *>(exprs[i]);
+        if (store) Bump(Stored(store));
+        if (!call || pure.count(call->GetCallee())) continue;
+        globalEpoch++;
+        FnDecl *callee = call->GetCallee();
+        List<VarDecl*> *formals = callee ? callee->GetFormals() : NULL;
+        List<Expr*> *actuals = call->GetActuals();
+        for (int j = 0; formals && j < formals->NumElements() && j < actuals->NumElements(); j++)
+            if (formals->Nth(j)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                Bump(Stored(actuals->Nth(j)));
+    }
+    for (size_t i = 0; i < vars.size(); i++)
+        Bump(vars[i]);
+}
+
+// A variable that is not known could be any
+void SubexpressionEliminator::Bump(VarDecl *var) {
+    if (var == NULL) {
+        epoch++;
+        globalEpoch++;
+        return;
+    }
+    versions[var] = ++nextVersion;
+    if (!locals.count(var)) globalStores++;
+}
+
+string SubexpressionEliminator::NewName() {
+    char name[32];
+    do {
+        snprintf(name, sizeof(name), "cse%d", nextTemp++);
+    } while (names.count(name));
+    return name;
+}
+
+void EliminateCommonSubexpressions(Program *program) {
+    SubexpressionEliminator eliminator(program);
+    eliminator.Run();
+}
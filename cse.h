@@ -0,0 +1,51 @@
+/* File: cse.h
+ * -----------
+ * Common subexpression elimination, for glc --cse: computes once the
+ * expressions that a function of a program that checked without errors
+ * computes again with nothing they depend on changed in between, before
+ * it is written out (see glsl.h).
+ *
+ * Expressions are given value numbers by hashing what they are made of:
+ * the kind of node and its operator (or field, or callee), the number of
+ * its type (see Type::IndexOf()) and the numbers of its operands, with a
+ * + or * of scalars or vectors, an == or a != taken the same whichever
+ * way round its operands are. A variable is numbered by its declaration
+ * and how often it has been stored to so far, so that an assignment to
+ * it, an increment or passing it as an out argument makes what was
+ * computed from it before a different value. Calls to functions that
+ * store to globals or out parameters, or that are outside the program,
+ * count as storing to every global; other calls are values like any
+ * operator, that change when a global does.
+ *
+ * A value computed again where one computed before is still available
+ * is replaced by a variable holding it: the local variable it was
+ * assigned to or initialized with, if that has not changed since (and
+ * no other local of the function has its name), or else a new
+ * temporary declared just before the statement that first computed it.
+ * A value is available from that statement on, to the end of the block
+ * it is in; the statements listed under a switch's case labels, which
+ * can be jumped into, make none available. Nor does one computed only
+ * if the right of an && or a || or a branch of a ?: is taken, so that
+ * nothing is ever computed that was not before. A loop forgets, on the
+ * way in, the values of the variables stored to anywhere in it, and any
+ * statement that stores to a variable in the middle of an expression,
+ * or calls a function with side effects, is left as it is. A name the
+ * checker left unresolved, as in a subscript, is taken to be a
+ * different value each time.
+ *
+ * Once done, the pass says how many expressions it replaced under the
+ * "stats" debug key.
+ */
+
+#ifndef _H_cse
+#define _H_cse
+
+class Program;
+
+/* Function: EliminateCommonSubexpressions()
+ * -----------------------------------------
+ * Replaces the repeated expressions of program in place.
+ */
+void EliminateCommonSubexpressions(Program *program);
+
+#endif
@@ -0,0 +1,870 @@
+/* File: dce.cc
+ * ------------
+ * Implementation of dead code elimination.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "dce.h"
+#include "symtable.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+/* A set of the parameters and local variables of one function, each
+ * known by the number it is given.
+ */
+class VarSet {
+  public:
+    void Clear(int size) { words.assign((size + 63) / 64, 0); }
+    bool Has(int i) const { return words[i / 64] >> (i % 64) & 1; }
+    void Add(int i) { words[i / 64] |= (uint64_t)1 << (i % 64); }
+    void Remove(int i) { words[i / 64] &= ~((uint64_t)1 << (i % 64)); }
+    void Union(const VarSet &other)
+        { for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i]; }
+
+  private:
+    vector<uint64_t> words;
+};
+
+// The assignment, increment or decrement that expr is, if it is one
+static CompoundExpr *AsStore(Expr *expr) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr))
+        return compound;
+    if (compound && !compound->GetLeft()
+        && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--")))
+        return compound;
+    return NULL;
+}
+
+// The variable store writes to, a[i] and v.x being writes to a and v
+static VarExpr *Target(CompoundExpr *store) {
+    Expr *target = store->GetLeft() ? store->GetLeft() : store->GetRight();
+    for (;;) {
+        ArrayAccess *element = dynamic_cast<ArrayAccess *>(target);
+        FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+        if (element) target = element->GetBase();
+        else if (field && field->GetBase()) target = field->GetBase();
+        else break;
+    }
+    return dynamic_cast<VarExpr *>(target);
+}
+
+static bool IsInterface(VarDecl *var) {
+    TypeQualifier *typeq = var->GetTypeQualifier();
+    return typeq == TypeQualifier::inTypeQualifier || typeq == TypeQualifier::outTypeQualifier
+           || typeq == TypeQualifier::uniformTypeQualifier;
+}
+
+// The statements stmt holds in a list, if it holds any that way
+static List<Stmt*> *StmtsOf(Stmt *stmt) {
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) return block->GetStmts();
+    if (SwitchStmt *switchStmt = dynamic_cast<SwitchStmt *>(stmt)) return switchStmt->GetCases();
+    return NULL;
+}
+
+template<class Element>
+static void Refill(List<Element> *list, const vector<Element> &elems) {
+    while (list->NumElements() > 0)
+        list->RemoveAt(list->NumElements() - 1);
+    for (size_t i = 0; i < elems.size(); i++)
+        list->Append(elems[i]);
+}
+
+// Closes up the gaps that removing statements from list left
+static void Compact(List<Stmt*> *list) {
+    vector<Stmt *> kept;
+    for (int i = 0; i < list->NumElements(); i++)
+        if (list->Nth(i)) kept.push_back(list->Nth(i));
+    if ((int)kept.size() != list->NumElements()) Refill(list, kept);
+}
+
+static StmtBlock *EmptyBlock() {
+    return new StmtBlock(new List<VarDecl*>, new List<Stmt*>);
+}
+
+static bool IsEmpty(Stmt *stmt) {
+    StmtBlock *block = dynamic_cast<StmtBlock *>(stmt);
+    return stmt == NULL || dynamic_cast<EmptyExpr *>(stmt)
+           || (block && block->GetStmts()->NumElements() == 0
+               && block->GetDecls()->NumElements() == 0);
+}
+
+static bool HasDecls(StmtBlock *block) {
+    List<Stmt*> *stmts = block->GetStmts();
+    for (int i = 0; i < stmts->NumElements(); i++)
+        if (dynamic_cast<DeclStmt *>(stmts->Nth(i))) return true;
+    return block->GetDecls()->NumElements() > 0;
+}
+
+// Whether control can go on to the statement after stmt
+static bool FallsThrough(Stmt *stmt) {
+    if (dynamic_cast<BreakStmt *>(stmt) || dynamic_cast<ContinueStmt *>(stmt)
+        || dynamic_cast<ReturnStmt *>(stmt))
+        return false;
+    if (dynamic_cast<SwitchLabel *>(stmt))
+        return FallsThrough(*stmt->StmtSlot(0));
+    if (IfStmt *ifStmt = dynamic_cast<IfStmt *>(stmt)) {
+        Stmt *otherwise = *ifStmt->StmtSlot(1);
+        return !otherwise || FallsThrough(*ifStmt->StmtSlot(0)) || FallsThrough(otherwise);
+    }
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        List<Stmt*> *stmts = block->GetStmts();
+        int n = stmts->NumElements();
+        return n == 0 || FallsThrough(stmts->Nth(n - 1));
+    }
+    return true;
+}
+
+// Whether stmt holds a case label of a switch around it
+static bool HasLabel(Stmt *stmt) {
+    if (stmt == NULL || dynamic_cast<SwitchStmt *>(stmt)) return false;
+    if (dynamic_cast<SwitchLabel *>(stmt)) return true;
+    Stmt **slot;
+    for (int i = 0; (slot = stmt->StmtSlot(i)) != NULL; i++)
+        if (HasLabel(*slot)) return true;
+    return false;
+}
+
+static bool HasDefault(SwitchStmt *switchStmt) {
+    Stmt **slot;
+    for (int i = 0; (slot = switchStmt->StmtSlot(i)) != NULL; i++) {
+        for (Stmt *stmt = *slot; dynamic_cast<SwitchLabel *>(stmt); stmt = *stmt->StmtSlot(0))
+            if (dynamic_cast<Default *>(stmt)) return true;
+    }
+    return false;
+}
+
+// The statements in stmt, blocks not counting as statements themselves
+static int CountStmts(Stmt *stmt) {
+    if (stmt == NULL) return 0;
+    int count = dynamic_cast<StmtBlock *>(stmt) ? 0 : 1;
+    if (dynamic_cast<Expr *>(stmt)) return count;
+    Stmt **slot;
+    for (int i = 0; (slot = stmt->StmtSlot(i)) != NULL; i++)
+        count += CountStmts(*slot);
+    return count;
+}
+
+// Puts with in the place of the statement in slot
+static void Put(Stmt **slot, Stmt *with) {
+    with->SetParent((*slot)->GetParent());
+    *slot = with;
+}
+
+// Takes the statement in slot out of the list it is in, or leaves an
+// empty statement in its place if it is not in one
+static void Remove(Stmt **slot, bool listed) {
+    if (listed)
+        *slot = NULL;
+    else if (dynamic_cast<SwitchLabel *>((*slot)->GetParent()))
+        Put(slot, new EmptyExpr());
+    else
+        Put(slot, EmptyBlock());
+}
+
+class DeadCodeEliminator {
+  public:
+    DeadCodeEliminator(Program *program)
+        : decls(program->GetDecls()), fn(NULL),
+          unreachable(0), constant(0), noEffect(0), unused(0), removedInLoop(false) {}
+
+    void Run();
+
+  private:
+    // How often a variable is named, and how often other than as the
+    // variable a statement stores to
+    struct Usage {
+        int mentions, reads;
+    };
+    // What a function does besides return a value: whether it has out
+    // parameters or writes to what is not in the program, the globals it
+    // stores to, and the functions it calls
+    struct Effects {
+        bool writes;
+        vector<VarDecl *> stores;
+        vector<FnDecl *> callees;
+    };
+
+    List<Decl*> *decls;
+    SymbolTable table;
+    unordered_map<VarExpr *, VarDecl *> resolved;   // names the checker left unresolved
+    set<VarDecl *> globals;
+    map<FnDecl *, vector<VarDecl *> > locals;       // parameters first
+    map<FnDecl *, Effects> effects;
+    set<FnDecl *> pure;
+    unordered_map<VarDecl *, Usage> usage;
+    vector<Expr *> stack;
+
+    // Of the function being gone through
+    FnDecl *fn;
+    unordered_map<VarDecl *, int> numbers;          // in locals[fn]
+    VarSet exitLive;                                // its out parameters
+    vector<VarSet *> breaks, continues;             // live where each goes
+    vector<VarSet *> entries;                       // live at a switch's labels
+
+    int unreachable, constant, noEffect, unused;
+    bool removedInLoop;
+
+    void Resolve();
+    void ResolveStmt(Stmt *stmt);
+    void ResolveExpr(Expr *expr);
+    void DeclareLocal(VarDecl *var);
+    VarDecl *Variable(VarExpr *var);
+    void FindPure();
+
+    Stmt *Simplify(Stmt *stmt);
+    void SimplifyList(Stmt *stmt, List<Stmt*> *list);
+
+    void CountUses();
+    void CountStmt(Stmt *stmt);
+    void CountExpr(Expr *expr, bool statement);
+
+    void RemoveDeadStores();
+    void Live(Stmt **slot, bool listed, VarSet *live);
+    void LiveList(Stmt *stmt, VarSet *live);
+    void LiveStore(Stmt **slot, bool listed, VarSet *live);
+    void LiveDecl(VarDecl *var, VarSet *live);
+    void Uses(Expr *expr, VarSet *live, VarExpr *stored = NULL);
+    void Reads(Stmt *stmt, VarSet *live);
+    void Removed();
+
+    void RemoveUnused();
+    void RemoveUnusedIn(Stmt **slot, bool listed);
+
+    VarDecl *DeclOf(VarExpr *var);
+    bool Pure(Expr *expr);
+    bool Unread(VarDecl *var);
+};
+
+/* Removing a store can leave the variables its value was computed from
+ * unread, or a function that made it pure, and removing one from a loop
+ * leaves the loop reading less, so the stores are gone through again
+ * until that stops happening.
+ */
+void DeadCodeEliminator::Run() {
+    Resolve();
+    CountUses();
+    FindPure();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *function = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (function && function->HasBody()) Simplify(function->GetBody());
+    }
+    for (;;) {
+        int removed = noEffect;
+        removedInLoop = false;
+        RemoveDeadStores();
+        if (noEffect == removed) break;
+        set<VarDecl *> wasUnread;
+        unordered_map<VarDecl *, Usage>::iterator it;
+        for (it = usage.begin(); it != usage.end(); ++it)
+            if (Unread(it->first)) wasUnread.insert(it->first);
+        size_t wasPure = pure.size();
+        CountUses();
+        FindPure();
+        bool again = removedInLoop || pure.size() != wasPure;
+        for (it = usage.begin(); it != usage.end() && !again; ++it)
+            again = Unread(it->first) && !wasUnread.count(it->first);
+        if (!again) break;
+    }
+    RemoveUnused();
+    PrintDebug("stats", "dce: removed %d statements: %d unreachable, %d under constant "
+               "conditions, %d with no effect, %d unused variables",
+               unreachable + constant + noEffect + unused, unreachable, constant,
+               noEffect, unused);
+}
+
+// In source order, declaring names as the checker does
+void DeadCodeEliminator::Resolve() {
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *decl = decls->Nth(i);
+        VarDecl *var = dynamic_cast<VarDecl *>(decl);
+        FnDecl *function = dynamic_cast<FnDecl *>(decl);
+        if (var) {
+            globals.insert(var);
+            Symbol sym(var->GetIdentifier()->GetName(), var, E_VarDecl);
+            table.insert(sym);
+            fn = NULL;
+            if (var->GetInitializer()) ResolveExpr(var->GetInitializer());
+        } else if (function) {
+            Symbol sym(function->GetIdentifier()->GetName(), function, E_FunctionDecl);
+            table.insert(sym);
+            if (!function->HasBody()) continue;
+            fn = function;
+            numbers.clear();
+            effects[fn].writes = false;
+            table.push();
+            List<VarDecl*> *formals = fn->GetFormals();
+            for (int j = 0; j < formals->NumElements(); j++) {
+                DeclareLocal(formals->Nth(j));
+                if (formals->Nth(j)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                    effects[fn].writes = true;
+            }
+            ResolveStmt(fn->GetBody());
+            table.pop();
+        }
+    }
+    fn = NULL;
+}
+
+/* The bodies of ifs and loops have scopes of their own, and so does a
+ * switch, all its cases together. A block does not: the statement it
+ * belongs to has already opened one.
+ */
+void DeadCodeEliminator::ResolveStmt(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    Expr *expr = dynamic_cast<Expr *>(stmt);
+    if (expr) {
+        ResolveExpr(expr);
+        return;
+    }
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var) DeclareLocal(var);
+        if (var && var->GetInitializer()) ResolveExpr(var->GetInitializer());
+        return;
+    }
+    StmtBlock *block = dynamic_cast<StmtBlock *>(stmt);
+    if (block) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            DeclareLocal(block->GetDecls()->Nth(i));
+    }
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        if (*exprSlot) ResolveExpr(*exprSlot);
+    bool switches = dynamic_cast<SwitchStmt *>(stmt) != NULL;
+    bool scoped = dynamic_cast<ConditionalStmt *>(stmt) != NULL;
+    if (switches) table.push();
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++) {
+        if (scoped) table.push();
+        ResolveStmt(*stmtSlot);
+        if (scoped) table.pop();
+    }
+    if (switches) table.pop();
+}
+
+// Also notes what the function being gone through writes and calls
+void DeadCodeEliminator::ResolveExpr(Expr *expr) {
+    stack.push_back(expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        VarExpr *var = dynamic_cast<VarExpr *>(top);
+        if (var && !var->GetDecl()) {
+            VarDecl *decl = Variable(var);
+            if (decl) resolved[var] = decl;
+        }
+        CompoundExpr *store = AsStore(top);
+        Call *call = dynamic_cast<Call *>(top);
+        if (fn && store) {
+            VarExpr *target = Target(store);
+            VarDecl *decl = target ? Variable(target) : NULL;
+            if (decl && globals.count(decl)) effects[fn].stores.push_back(decl);
+            else if (!decl || !numbers.count(decl)) effects[fn].writes = true;
+        } else if (fn && call) {
+            if (call->GetCallee()) effects[fn].callees.push_back(call->GetCallee());
+            else effects[fn].writes = true;
+        }
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+}
+
+void DeadCodeEliminator::DeclareLocal(VarDecl *var) {
+    numbers[var] = locals[fn].size();
+    locals[fn].push_back(var);
+    Symbol sym(var->GetIdentifier()->GetName(), var, E_VarDecl);
+    table.insert(sym);
+}
+
+VarDecl *DeadCodeEliminator::Variable(VarExpr *var) {
+    if (var->GetDecl()) return var->GetDecl();
+    const Symbol *sym = table.find(var->GetIdentifier()->GetName());
+    return sym ? dynamic_cast<VarDecl *>(sym->decl) : NULL;
+}
+
+/* A function is pure if neither it nor anything it calls writes to an
+ * out variable or to a global that is read. Functions outside the
+ * program are not known to be.
+ */
+void DeadCodeEliminator::FindPure() {
+    map<FnDecl *, Effects>::iterator it;
+    pure.clear();
+    for (it = effects.begin(); it != effects.end(); ++it) {
+        vector<VarDecl *> &stores = it->second.stores;
+        bool writes = it->second.writes;
+        for (size_t i = 0; i < stores.size() && !writes; i++)
+            writes = !Unread(stores[i]);
+        if (!writes) pure.insert(it->first);
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (it = effects.begin(); it != effects.end(); ++it) {
+            if (!pure.count(it->first)) continue;
+            vector<FnDecl *> &callees = it->second.callees;
+            for (size_t i = 0; i < callees.size(); i++) {
+                if (pure.count(callees[i])) continue;
+                pure.erase(it->first);
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+/* Returns what to put in the place of stmt once the code in it that is
+ * never reached has been removed: stmt itself, the branch of an if that
+ * is always taken, or NULL for nothing at all.
+ */
+Stmt *DeadCodeEliminator::Simplify(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt) || dynamic_cast<DeclStmt *>(stmt))
+        return stmt;
+    List<Stmt*> *list = StmtsOf(stmt);
+    if (list) SimplifyList(stmt, list);
+    Stmt **slot;
+    for (int i = list ? list->NumElements() : 0; (slot = stmt->StmtSlot(i)) != NULL; i++) {
+        Stmt *simpler = Simplify(*slot);
+        if (simpler != *slot && simpler) Put(slot, simpler);
+        else if (simpler != *slot) Remove(slot, false);
+    }
+
+    if (!dynamic_cast<ConditionalStmt *>(stmt)) return stmt;
+    ForStmt *forStmt = dynamic_cast<ForStmt *>(stmt);
+    Expr *test = *stmt->ExprSlot(forStmt ? 1 : 0);
+    BoolConstant *value = dynamic_cast<BoolConstant *>(test);
+    if (dynamic_cast<IfStmt *>(stmt)) {
+        Stmt *then = *stmt->StmtSlot(0), *otherwise = *stmt->StmtSlot(1);
+        if (value) {
+            Stmt *taken = value->GetValue() ? then : otherwise;
+            if (dynamic_cast<DeclStmt *>(taken)) {
+                // Still in a scope of its own
+                StmtBlock *block = EmptyBlock();
+                block->GetStmts()->Append(taken);
+                taken->SetParent(block);
+                taken = block;
+            }
+            constant += CountStmts(stmt) - CountStmts(taken);
+            return taken;
+        }
+        if (IsEmpty(then) && IsEmpty(otherwise) && Pure(test)) {
+            noEffect += CountStmts(stmt);
+            return NULL;
+        }
+    } else if (value && !value->GetValue()) {
+        // A loop that is never entered, though a for still runs its init
+        Expr *init = forStmt ? *stmt->ExprSlot(0) : NULL;
+        if (init && !Pure(init)) {
+            constant += CountStmts(stmt) - 1;
+            return init;
+        }
+        constant += CountStmts(stmt);
+        return NULL;
+    }
+    return stmt;
+}
+
+/* Statements after one that does not fall through are dropped up to the
+ * next case label, except for declarations a later case could use. A
+ * block that an if simplifies to is spliced in if nothing is declared in
+ * it.
+ */
+void DeadCodeEliminator::SimplifyList(Stmt *stmt, List<Stmt*> *list) {
+    int lastLabel = -1;
+    for (int i = 0; i < list->NumElements(); i++)
+        if (dynamic_cast<SwitchLabel *>(list->Nth(i))) lastLabel = i;
+    vector<Stmt *> kept;
+    bool reached = true;
+    for (int i = 0; i < list->NumElements(); i++) {
+        Stmt *old = list->Nth(i);
+        if (dynamic_cast<SwitchLabel *>(old)) reached = true;
+        if (!reached && !(i < lastLabel && dynamic_cast<DeclStmt *>(old)) && !HasLabel(old)) {
+            unreachable += CountStmts(old);
+            continue;
+        }
+        Stmt *simpler = Simplify(old);
+        if (simpler == NULL) continue;
+        StmtBlock *block = dynamic_cast<StmtBlock *>(simpler);
+        if (simpler != old && block && !HasDecls(block)) {
+            List<Stmt*> *inner = block->GetStmts();
+            for (int j = 0; j < inner->NumElements(); j++) {
+                inner->Nth(j)->SetParent(stmt);
+                kept.push_back(inner->Nth(j));
+            }
+        } else {
+            simpler->SetParent(stmt);
+            kept.push_back(simpler);
+        }
+        if (!dynamic_cast<DeclStmt *>(simpler)) reached = FallsThrough(simpler);
+    }
+    Refill(list, kept);
+}
+
+void DeadCodeEliminator::CountUses() {
+    usage.clear();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        VarDecl *var = dynamic_cast<VarDecl *>(decls->Nth(i));
+        FnDecl *function = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (var && var->GetInitializer()) CountExpr(var->GetInitializer(), false);
+        if (function && function->HasBody()) CountStmt(function->GetBody());
+    }
+}
+
+void DeadCodeEliminator::CountStmt(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    Expr *expr = dynamic_cast<Expr *>(stmt);
+    if (expr) {
+        CountExpr(expr, true);
+        return;
+    }
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var && var->GetInitializer()) CountExpr(var->GetInitializer(), false);
+        return;
+    }
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        if (*exprSlot) CountExpr(*exprSlot, false);
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        CountStmt(*stmtSlot);
+}
+
+// The variable a statement stores to is not read by naming it there
+void DeadCodeEliminator::CountExpr(Expr *expr, bool statement) {
+    CompoundExpr *store = statement ? AsStore(expr) : NULL;
+    VarExpr *stored = store ? Target(store) : NULL;
+    stack.push_back(expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        VarExpr *var = dynamic_cast<VarExpr *>(top);
+        VarDecl *decl = var ? DeclOf(var) : NULL;
+        if (decl) {
+            Usage &use = usage[decl];
+            use.mentions++;
+            if (var != stored) use.reads++;
+        }
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+}
+
+// Backwards through each function, from its out parameters
+void DeadCodeEliminator::RemoveDeadStores() {
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *function = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!function || !function->HasBody()) continue;
+        fn = function;
+        vector<VarDecl *> &vars = locals[fn];
+        numbers.clear();
+        exitLive.Clear(vars.size());
+        for (size_t j = 0; j < vars.size(); j++) {
+            numbers[vars[j]] = j;
+            if (vars[j]->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                exitLive.Add(j);
+        }
+        VarSet live = exitLive;
+        Stmt *body = fn->GetBody();
+        Live(&body, false, &live);
+    }
+    fn = NULL;
+}
+
+/* On entry live holds the variables whose values may be read after the
+ * statement in slot, and on return those that may be read from before
+ * it on. A loop is taken to read at its head every variable read
+ * anywhere in it, besides those read after it, so that its body needs
+ * going through only once.
+ */
+void DeadCodeEliminator::Live(Stmt **slot, bool listed, VarSet *live) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL) return;
+    if (dynamic_cast<Expr *>(stmt)) {
+        LiveStore(slot, listed, live);
+        return;
+    }
+    if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt)) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var) LiveDecl(var, live);
+        return;
+    }
+    if (dynamic_cast<ReturnStmt *>(stmt)) {
+        *live = exitLive;
+        if (*stmt->ExprSlot(0)) Uses(*stmt->ExprSlot(0), live);
+        return;
+    }
+    if (dynamic_cast<BreakStmt *>(stmt)) {
+        if (!breaks.empty()) *live = *breaks.back();
+        return;
+    }
+    if (dynamic_cast<ContinueStmt *>(stmt)) {
+        if (!continues.empty()) *live = *continues.back();
+        return;
+    }
+    if (dynamic_cast<IfStmt *>(stmt)) {
+        // An empty branch leaves otherwise as live was after the if
+        VarSet otherwise = *live;
+        Live(stmt->StmtSlot(1), false, &otherwise);
+        Live(stmt->StmtSlot(0), false, live);
+        Expr *test = *stmt->ExprSlot(0);
+        if (IsEmpty(*stmt->StmtSlot(1))) *stmt->StmtSlot(1) = NULL;
+        if (IsEmpty(*stmt->StmtSlot(0)) && !*stmt->StmtSlot(1) && Pure(test)) {
+            *live = otherwise;
+            Remove(slot, listed);
+            Removed();
+            return;
+        }
+        live->Union(otherwise);
+        Uses(test, live);
+        return;
+    }
+    if (dynamic_cast<LoopStmt *>(stmt)) {
+        VarSet after = *live;
+        live->Union(exitLive);
+        Reads(stmt, live);
+        VarSet body = *live;
+        breaks.push_back(&after);
+        continues.push_back(live);
+        Live(stmt->StmtSlot(0), false, &body);
+        breaks.pop_back();
+        continues.pop_back();
+        return;
+    }
+    if (SwitchStmt *switchStmt = dynamic_cast<SwitchStmt *>(stmt)) {
+        VarSet after = *live, labels;
+        labels.Clear(numbers.size());
+        breaks.push_back(&after);
+        entries.push_back(&labels);
+        LiveList(stmt, live);
+        breaks.pop_back();
+        entries.pop_back();
+        *live = labels;
+        if (!HasDefault(switchStmt)) live->Union(after);
+        Uses(*stmt->ExprSlot(0), live);
+        return;
+    }
+    if (dynamic_cast<SwitchLabel *>(stmt)) {
+        Live(stmt->StmtSlot(0), false, live);
+        if (!entries.empty()) entries.back()->Union(*live);
+        return;
+    }
+    LiveList(stmt, live);
+}
+
+void DeadCodeEliminator::LiveList(Stmt *stmt, VarSet *live) {
+    List<Stmt*> *list = StmtsOf(stmt);
+    int n = 0;
+    while (stmt->StmtSlot(n)) n++;
+    for (int i = n - 1; i >= 0; i--)
+        Live(stmt->StmtSlot(i), list && i < list->NumElements(), live);
+    if (list) Compact(list);
+}
+
+/* A store is dead if what it stores is not live after it, or if nothing
+ * reads the variable at all. What it stores is kept as a statement of
+ * its own if computing it has side effects.
+ */
+void DeadCodeEliminator::LiveStore(Stmt **slot, bool listed, VarSet *live) {
+    Expr *expr = dynamic_cast<Expr *>(*slot);
+    CompoundExpr *store = AsStore(expr);
+    VarExpr *target = store ? Target(store) : NULL;
+    VarDecl *var = target ? DeclOf(target) : NULL;
+    if (var == NULL) {
+        Uses(expr, live);
+        return;
+    }
+    unordered_map<VarDecl *, int>::iterator number = numbers.find(var);
+    int n = number == numbers.end() ? -1 : number->second;
+    bool whole = dynamic_cast<AssignExpr *>(store) && store->GetOperator()->IsOp("=")
+                 && store->GetLeft() == target;
+    if (!Unread(var) && (n < 0 || live->Has(n))) {
+        if (whole && n >= 0) {
+            live->Remove(n);
+            Uses(store->GetRight(), live);
+        } else {
+            Uses(expr, live);
+        }
+        return;
+    }
+    if (Pure(store->GetLeft()) && Pure(store->GetRight())) {
+        Remove(slot, listed);
+        Removed();
+    } else if (whole) {
+        Put(slot, store->GetRight());
+        Removed();
+        Uses(store->GetRight(), live);
+    } else {
+        Uses(expr, live);
+    }
+}
+
+// A const variable keeps its initializer, which it cannot do without
+void DeadCodeEliminator::LiveDecl(VarDecl *var, VarSet *live) {
+    unordered_map<VarDecl *, int>::iterator number = numbers.find(var);
+    if (number == numbers.end()) return;
+    Expr *init = var->GetInitializer();
+    if (init && var->GetTypeQualifier() != TypeQualifier::constTypeQualifier
+        && (Unread(var) || !live->Has(number->second)) && Pure(init)) {
+        var->SetInitializer(NULL);
+        Removed();
+        init = NULL;
+    }
+    live->Remove(number->second);
+    if (init) Uses(init, live);
+}
+
+void DeadCodeEliminator::Uses(Expr *expr, VarSet *live, VarExpr *stored) {
+    stack.push_back(expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        VarExpr *var = dynamic_cast<VarExpr *>(top);
+        if (var && var != stored) {
+            unordered_map<VarDecl *, int>::iterator number = numbers.find(DeclOf(var));
+            if (number != numbers.end()) live->Add(number->second);
+        }
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+}
+
+// The variables stmt reads, not counting those it only stores to
+void DeadCodeEliminator::Reads(Stmt *stmt, VarSet *live) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    Expr *expr = dynamic_cast<Expr *>(stmt);
+    if (expr) {
+        CompoundExpr *store = AsStore(expr);
+        Uses(expr, live, store ? Target(store) : NULL);
+        return;
+    }
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var && var->GetInitializer()) Uses(var->GetInitializer(), live);
+        return;
+    }
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        if (*exprSlot) Uses(*exprSlot, live);
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Reads(*stmtSlot, live);
+}
+
+// A loop reads less once something in it is removed
+void DeadCodeEliminator::Removed() {
+    noEffect++;
+    if (!continues.empty()) removedInLoop = true;
+}
+
+/* Drops the declarations of variables that are no longer named
+ * anywhere, keeping their initializers if those have side effects.
+ */
+void DeadCodeEliminator::RemoveUnused() {
+    vector<Decl *> kept;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *decl = decls->Nth(i);
+        VarDecl *var = dynamic_cast<VarDecl *>(decl);
+        FnDecl *function = dynamic_cast<FnDecl *>(decl);
+        if (var && !IsInterface(var) && !usage.count(var)
+            && (!var->GetInitializer() || Pure(var->GetInitializer()))) {
+            unused++;
+            continue;
+        }
+        if (function && function->HasBody()) {
+            Stmt *body = function->GetBody();
+            RemoveUnusedIn(&body, false);
+        }
+        kept.push_back(decl);
+    }
+    if ((int)kept.size() != decls->NumElements()) Refill(decls, kept);
+}
+
+void DeadCodeEliminator::RemoveUnusedIn(Stmt **slot, bool listed) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return;
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (!var || usage.count(var)) return;
+        unused++;
+        Expr *init = var->GetInitializer();
+        if (init && !Pure(init)) Put(slot, init);
+        else Remove(slot, listed);
+        return;
+    }
+    List<Stmt*> *list = StmtsOf(stmt);
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        RemoveUnusedIn(stmtSlot, list && i < list->NumElements());
+    if (list) Compact(list);
+}
+
+VarDecl *DeadCodeEliminator::DeclOf(VarExpr *var) {
+    if (var->GetDecl()) return var->GetDecl();
+    unordered_map<VarExpr *, VarDecl *>::iterator decl = resolved.find(var);
+    return decl == resolved.end() ? NULL : decl->second;
+}
+
+// Whether expr can be left out without anything else changing
+bool DeadCodeEliminator::Pure(Expr *expr) {
+    if (expr == NULL) return true;
+    size_t base = stack.size();
+    stack.push_back(expr);
+    bool pureSoFar = true;
+    while (stack.size() > base) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        Call *call = dynamic_cast<Call *>(top);
+        if (AsStore(top) || (call && !pure.count(call->GetCallee()))) {
+            pureSoFar = false;
+            break;
+        }
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    stack.resize(base);
+    return pureSoFar;
+}
+
+// Out variables are read by whoever runs the shader or makes the call
+bool DeadCodeEliminator::Unread(VarDecl *var) {
+    if (var->GetTypeQualifier() == TypeQualifier::outTypeQualifier
+        || (globals.count(var) && IsInterface(var)))
+        return false;
+    unordered_map<VarDecl *, Usage>::iterator use = usage.find(var);
+    return use == usage.end() || use->second.reads == 0;
+}
+
+void EliminateDeadCode(Program *program) {
+    DeadCodeEliminator eliminator(program);
+    eliminator.Run();
+}
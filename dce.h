@@ -0,0 +1,49 @@
+/* File: dce.h
+ * -----------
+ * Dead code elimination, for glc --dce: removes from a program that
+ * checked without errors the code that cannot change what it outputs,
+ * before it is written out (see glsl.h).
+ *
+ * What a shader outputs is what it leaves in its out variables, global
+ * or parameters, and what its functions return; everything else it
+ * computes only matters if it reaches one of those. Removed are:
+ *
+ *  - statements after a return, break or continue, up to the next case
+ *    label, and the branch of an if, while or for whose condition is a
+ *    constant that never takes it (run --fold first to find more);
+ *  - assignments, increments and decrements whose value is overwritten
+ *    or goes out of scope before anything reads it, and those to
+ *    variables that nothing reads at all, along with the initializers
+ *    of local variables that are overwritten before they are read;
+ *  - ifs left with nothing to do, and declarations of variables left
+ *    with no uses.
+ *
+ * Which values are still read is worked out backwards through each
+ * function (liveness). A loop is taken to read at its head everything
+ * read anywhere in it, so a value that only a later iteration might
+ * read is kept. Parts of a removed statement with side effects, such
+ * as calls to functions that write global or out variables, are kept
+ * as statements of their own; calls to functions outside the program,
+ * such as the prelude's, always count as having side effects. Globals
+ * with an in, out or uniform qualifier are never removed, and neither
+ * are parameters.
+ *
+ * Names are looked up with a symbol table of the pass's own, scoped as
+ * the checker scopes them, so that the parts of the tree the checker
+ * leaves unresolved (such as subscripts) count as uses too. Once done,
+ * the pass says how many statements it removed under the "stats" debug
+ * key.
+ */
+
+#ifndef _H_dce
+#define _H_dce
+
+class Program;
+
+/* Function: EliminateDeadCode()
+ * -----------------------------
+ * Removes the dead code of program in place.
+ */
+void EliminateDeadCode(Program *program);
+
+#endif
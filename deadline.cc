@@ -0,0 +1,32 @@
+/* File: deadline.cc
+ * -----------------
+ * Implementation of the deadline of a check.
+ */
+
+#include <chrono>
+#include "deadline.h"
+#include "errors.h"
+
+using namespace std;
+
+atomic<bool> Deadline::armed(false);
+thread_local int Deadline::countdown = 0;
+static chrono::steady_clock::time_point expiry;
+
+void Deadline::Start(long ms) {
+    expiry = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    armed.store(ms > 0, memory_order_relaxed);
+    countdown = 0;
+}
+
+void Deadline::CheckClock() {
+    countdown = PollInterval;
+    if (chrono::steady_clock::now() >= expiry) {
+        Stop();   // so that unwinding does not throw again
+        throw Exceeded();
+    }
+}
+
+void Deadline::Exceeded::Report() const {
+    ReportError::DeadlineExceeded();
+}
@@ -0,0 +1,51 @@
+/**
+ * File: deadline.h
+ * ----------------
+ * Cooperative cancellation of a check that runs too long, so that in the
+ * daemon one pathological shader cannot hold up the requests behind it.
+ *
+ * Deadline::Start() arms a deadline some milliseconds away. The scanner
+ * polls it for every token, and the checker on entry to each function,
+ * block and expression node. A poll only reads the clock once every
+ * PollInterval calls on its thread, and while no deadline is armed it
+ * does nothing but test a flag.
+ *
+ * Once the deadline has passed, the next poll to read the clock throws
+ * Deadline::Exceeded. Like the exception a Failure() throws in the
+ * library, it unwinds to whoever armed the deadline, passing through the
+ * threads of --jobs (see Program::CheckInParallel()), where it is
+ * reported as a GLC_E_DEADLINE_EXCEEDED error. yylex() catches it to
+ * abort the parser cleanly instead, and throws it again once the parser
+ * has returned (see scanner.l).
+ */
+
+#ifndef _H_deadline
+#define _H_deadline
+
+#include <atomic>
+#include "bounds.h"   // for CheckAbandoned
+
+// Polls between two readings of the clock
+#define PollInterval 1024
+
+class Deadline {
+  public:
+    struct Exceeded : CheckAbandoned {
+        void Report() const;
+    };
+
+    // Arms a deadline ms milliseconds from now; ms <= 0 disarms it
+    static void Start(long ms);
+    static void Stop() { armed.store(false, std::memory_order_relaxed); }
+
+    static void Poll()
+        { if (armed.load(std::memory_order_relaxed) && --countdown <= 0) CheckClock(); }
+
+  private:
+    static std::atomic<bool> armed;   // read by the threads of --jobs
+    static thread_local int countdown;
+
+    static void CheckClock();
+};
+
+#endif
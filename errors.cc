@@ -18,6 +18,8 @@ using namespace std;
 #include "ast_decl.h"
 
 int ReportError::numErrors = 0;
+thread_local vector<Diagnostic> *ReportError::captured = NULL;
+vector<Diagnostic> *ReportError::collected = NULL;
 
 void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
     if (!line) return;
@@ -29,15 +31,36 @@ void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
 
  
  
-void ReportError::OutputError(yyltype *loc, string msg) {
+void ReportError::OutputError(yyltype *loc, string msg, glc_code code) {
+    Diagnostic d;
+    d.located = (loc != NULL);
+    if (loc) d.loc = *loc;
+    d.code = code;
+    d.message = msg;
+    Report(d);
+}
+
+void ReportError::Report(const Diagnostic &d) {
+    if (captured) {
+        captured->push_back(d);
+        return;
+    }
     numErrors++;
+    if (collected)
+        collected->push_back(d);
+    else
+        Print(d);
+}
+
+void ReportError::Print(const Diagnostic &d) {
+    yyltype loc = d.loc;
     fflush(stdout); // make sure any buffered text has been output
-    if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+    if (d.located) {
+        cerr << endl << "*** Error line " << loc.first_line << "." << endl;
+        UnderlineErrorInLine(GetLineNumbered(loc.first_line), &loc);
     } else
         cerr << endl << "*** Error." << endl;
-    cerr << "*** " << msg << endl << endl;
+    cerr << "*** " << d.message << endl << endl;
 }
 
 
@@ -48,44 +71,58 @@ void ReportError::Formatted(yyltype *loc, const char *format, ...) {
     va_start(args, format);
     vsprintf(errbuf,format, args);
     va_end(args);
-    OutputError(loc, errbuf);
+    OutputError(loc, errbuf, GLC_E_FORMATTED);
+}
+
+void ReportError::SyntaxError(yyltype *loc, const char *msg) {
+    OutputError(loc, msg, GLC_E_SYNTAX);
+}
+
+void ReportError::DeadlineExceeded() {
+    OutputError(NULL, "Deadline exceeded", GLC_E_DEADLINE_EXCEEDED);
+}
+
+void ReportError::LimitExceeded(const char *what, long limit) {
+    ostringstream s;
+    s << "Input exceeds the limit of " << limit << " " << what;
+    OutputError(NULL, s.str(), GLC_E_LIMIT_EXCEEDED);
 }
 
 void ReportError::UntermComment() {
-    OutputError(NULL, "Input ends with unterminated comment");
+    OutputError(NULL, "Input ends with unterminated comment", GLC_E_UNTERM_COMMENT);
 }
 
 
 void ReportError::LongIdentifier(yyltype *loc, const char *ident) {
     ostringstream s;
     s << "Identifier too long: \"" << ident << "\"";
-    OutputError(loc, s.str());
+    OutputError(loc, s.str(), GLC_E_LONG_IDENTIFIER);
 }
 
 void ReportError::UntermString(yyltype *loc, const char *str) {
     ostringstream s;
     s << "Unterminated string constant: " << str;
-    OutputError(loc, s.str());
+    OutputError(loc, s.str(), GLC_E_UNTERM_STRING);
 }
 
 void ReportError::UnrecogChar(yyltype *loc, char ch) {
     ostringstream s;
     s << "Unrecognized char: '" << ch << "'";
-    OutputError(loc, s.str());
+    OutputError(loc, s.str(), GLC_E_UNRECOG_CHAR);
 }
 
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     ostringstream s;
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
       << prevDecl->GetLocation()->first_line;
-    OutputError(decl->GetLocation(), s.str());
+    OutputError(decl->GetLocation(), s.str(), GLC_E_DECL_CONFLICT);
 }
 
 void ReportError::InvalidInitialization(Identifier *id, Type *lType, Type *rType) {
     ostringstream s;
     s << "Wrong initialization of identifier '" << id << "': idType '" 
       << lType << "' exprType '" << rType << "'" ;
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_INVALID_INITIALIZATION);
 }
 
 void ReportError::IdentifierNotDeclared(Identifier *ident, reasonT whyNeeded) {
@@ -93,21 +130,21 @@ void ReportError::IdentifierNotDeclared(Identifier *ident, reasonT whyNeeded) {
     static const char *names[] =  {"type", "variable", "function"};
     Assert(whyNeeded >= 0 && whyNeeded <= sizeof(names)/sizeof(names[0]));
     s << "No declaration found for "<< names[whyNeeded] << " '" << ident << "'";
-    OutputError(ident->GetLocation(), s.str());
+    OutputError(ident->GetLocation(), s.str(), GLC_E_IDENTIFIER_NOT_DECLARED);
 }
 
 void ReportError::ExtraFormals(Identifier *id, int expCount, int actualCount) {
     ostringstream s;
     s << "Extra arguments given to function '" << id << "': expected " 
       << expCount << ", given " << actualCount ;
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_EXTRA_FORMALS);
 }
 
 void ReportError::LessFormals(Identifier *id, int expCount, int actualCount) {
     ostringstream s;
     s << "Less arguments given to function '" << id << "': expected " 
       << expCount << ", given " << actualCount ;
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_LESS_FORMALS);
 }
 
 void ReportError::FormalsTypeMismatch(Identifier *id, int pos, Type *expType, Type *actualType)
@@ -115,37 +152,37 @@ void ReportError::FormalsTypeMismatch(Identifier *id, int pos, Type *expType, Ty
     ostringstream s;
     s << "Formal type mismatch in function '" << id << "' at pos " << pos 
       << ": expected '" << expType << "', given '" << actualType <<"'";
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_FORMALS_TYPE_MISMATCH);
 }
 
 void ReportError::NotAFunction(Identifier *id) {
     ostringstream s;
     s << "'" << id << "' is not a function.";
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_NOT_A_FUNCTION);
 }
 
 void ReportError::NotAnArray(Identifier *id) {
     ostringstream s;
     s << "'" << id << "' is not an array.";
-    OutputError(id->GetLocation(), s.str());
+    OutputError(id->GetLocation(), s.str(), GLC_E_NOT_AN_ARRAY);
 }
 
 void ReportError::IncompatibleOperands(Operator *op, Type *lhs, Type *rhs) {
     ostringstream s;
     s << "Incompatible operands: " << lhs << " " << op << " " << rhs;
-    OutputError(op->GetLocation(), s.str());
+    OutputError(op->GetLocation(), s.str(), GLC_E_INCOMPATIBLE_OPERANDS);
 }
      
 void ReportError::IncompatibleOperand(Operator *op, Type *rhs) {
     ostringstream s;
     s << "Incompatible operand: " << op << " " << rhs;
-    OutputError(op->GetLocation(), s.str());
+    OutputError(op->GetLocation(), s.str(), GLC_E_INCOMPATIBLE_OPERAND);
 }
 
 void ReportError::ReturnMismatch(ReturnStmt *rStmt, Type *given, Type *expected) {
     ostringstream s;
     s << "Incompatible return: " << given << " given, " << expected << " expected";
-    OutputError(rStmt->GetLocation(), s.str());
+    OutputError(rStmt->GetLocation(), s.str(), GLC_E_RETURN_MISMATCH);
 }
 
 void ReportError::ReturnMissing(FnDecl *fnDecl) {
@@ -153,43 +190,43 @@ void ReportError::ReturnMissing(FnDecl *fnDecl) {
     s << "Declaration of '" << fnDecl << "' on line " 
       << fnDecl->GetLocation()->first_line
       << " doesn't have a return";
-    OutputError(fnDecl->GetLocation(), s.str());
+    OutputError(fnDecl->GetLocation(), s.str(), GLC_E_RETURN_MISSING);
 }
 
 void ReportError::InaccessibleSwizzle(Identifier *field, Expr *base) {
     ostringstream s;
     s << base << " non-vector type can't have swizzle '" << field <<"'";
-    OutputError(field->GetLocation(), s.str());
+    OutputError(field->GetLocation(), s.str(), GLC_E_INACCESSIBLE_SWIZZLE);
 }
      
 void ReportError::InvalidSwizzle(Identifier *field, Expr *base) {
     ostringstream s;
     s << base << " swizzle '" << field <<"' is not proper subset of [xyzw]";
-    OutputError(field->GetLocation(), s.str());
+    OutputError(field->GetLocation(), s.str(), GLC_E_INVALID_SWIZZLE);
 }
      
 void ReportError::SwizzleOutOfBound(Identifier *field, Expr *base) {
     ostringstream s;
     s << base << " swizzle '" << field <<"' exceeds its vector component";
-    OutputError(field->GetLocation(), s.str());
+    OutputError(field->GetLocation(), s.str(), GLC_E_SWIZZLE_OUT_OF_BOUND);
 }
 
 void ReportError::OversizedVector(Identifier *field, Expr *base) {
     ostringstream s;
     s << base << " swizzle '" << field <<"' generates a vector longer than vec4";
-    OutputError(field->GetLocation(), s.str());
+    OutputError(field->GetLocation(), s.str(), GLC_E_OVERSIZED_VECTOR);
 }
 
 void ReportError::TestNotBoolean(Expr *expr) {
-    OutputError(expr->GetLocation(), "Test expression must have boolean type");
+    OutputError(expr->GetLocation(), "Test expression must have boolean type", GLC_E_TEST_NOT_BOOLEAN);
 }
 
 void ReportError::BreakOutsideLoop(BreakStmt *bStmt) {
-    OutputError(bStmt->GetLocation(), "break is only allowed inside a loop");
+    OutputError(bStmt->GetLocation(), "break is only allowed inside a loop", GLC_E_BREAK_OUTSIDE_LOOP);
 }
   
 void ReportError::ContinueOutsideLoop(ContinueStmt *cStmt) {
-    OutputError(cStmt->GetLocation(), "continue is only allowed inside a loop");
+    OutputError(cStmt->GetLocation(), "continue is only allowed inside a loop", GLC_E_CONTINUE_OUTSIDE_LOOP);
 }
 
 /**
@@ -204,5 +241,5 @@ void ReportError::ContinueOutsideLoop(ContinueStmt *cStmt) {
  */
 
 void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+    ReportError::SyntaxError(&yylloc, msg);
 }
@@ -14,8 +14,10 @@
 #define _errors_h_
 
 #include <string>
+#include <vector>
 #include "location.h"
 #include "ast_decl.h"
+#include "glc.h"     // for glc_code
 
 using namespace std;
 
@@ -50,6 +52,20 @@ class ReturnStmt;
 class Decl;
 class Operator;
 
+/**
+ * Struct: Diagnostic
+ * ------------------
+ * One error message, as held back by ReportError::Capture() or gathered
+ * by ReportError::Collect() instead of being printed. The location is
+ * only meaningful if located is true.
+ */
+struct Diagnostic {
+    bool located;
+    yyltype loc;
+    glc_code code;
+    string message;
+};
+
 typedef enum {
       LookingForType,
       LookingForVariable,
@@ -99,16 +115,44 @@ class ReportError {
   static void BreakOutsideLoop(BreakStmt *bStmt); 
   static void ContinueOutsideLoop(ContinueStmt *cStmt); 
 
+  // Used when a check is cut short by its deadline (see deadline.h)
+  static void DeadlineExceeded();
+  // Used when a check reaches one of its limits (see bounds.h)
+  static void LimitExceeded(const char *what, long limit);
+
   // Generic method to report a printf-style error message
   static void Formatted(yyltype *loc, const char *format, ...);
 
+  // Used by yyerror() for errors found by the parser
+  static void SyntaxError(yyltype *loc, const char *msg);
+
 
   // Returns number of error messages printed
   static int NumErrors() { return numErrors; }
+
+  static void ResetNumErrors() { numErrors = 0; }
+
+  // While list is non-NULL, errors raised on the calling thread are
+  // appended to it instead of being output or counted. Report() later
+  // outputs a captured error as if it had just been raised, so into the
+  // enclosing capture if there is one. Returns the list that was being
+  // captured into before, for the caller to restore.
+  static vector<Diagnostic> *Capture(vector<Diagnostic> *list)
+      { vector<Diagnostic> *outer = captured; captured = list; return outer; }
+  static void Report(const Diagnostic &d);
+
+  // Outputs d to cerr without counting it
+  static void Print(const Diagnostic &d);
+
+  // While list is non-NULL, errors are counted as usual but appended to
+  // it rather than printed to cerr. Used by the library, see glc.h.
+  static void Collect(vector<Diagnostic> *list) { collected = list; }
   
  private:
   static void UnderlineErrorInLine(const char *line, yyltype *pos);
-  static void OutputError(yyltype *loc, string msg);
+  static void OutputError(yyltype *loc, string msg, glc_code code);
   static int numErrors;
+  static thread_local vector<Diagnostic> *captured;
+  static vector<Diagnostic> *collected;
 };
 #endif
@@ -0,0 +1,292 @@
+/* File: flatten.cc
+ * ----------------
+ * Implementation of branch flattening.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "flatten.h"
+#include "copy.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+// A store a branch makes
+struct Store {
+    AssignExpr *assign;
+    Expr *target;
+    Expr *value;
+};
+
+// A variable, or a component of one, that a store can go to
+static bool Plain(Expr *target) {
+    FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+    if (field) return field->GetBase() && Plain(field->GetBase());
+    VarExpr *use = dynamic_cast<VarExpr *>(target);
+    return use && use->GetDecl();
+}
+
+static VarDecl *Root(Expr *target) {
+    while (FieldAccess *field = dynamic_cast<FieldAccess *>(target))
+        target = field->GetBase();
+    return dynamic_cast<VarExpr *>(target)->GetDecl();
+}
+
+static bool SameTarget(Expr *a, Expr *b) {
+    FieldAccess *fieldA = dynamic_cast<FieldAccess *>(a);
+    FieldAccess *fieldB = dynamic_cast<FieldAccess *>(b);
+    if (fieldA || fieldB) {
+        return fieldA && fieldB
+               && strcmp(fieldA->GetField()->GetName(), fieldB->GetField()->GetName()) == 0
+               && SameTarget(fieldA->GetBase(), fieldB->GetBase());
+    }
+    return Root(a) == Root(b);
+}
+
+// Another use of a target, to read it with
+static Expr *Reread(Expr *target) {
+    yyltype loc = *target->GetLocation();
+    FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+    if (!field) return new VarExpr(loc, Root(target));
+    Expr *copy = new FieldAccess(Reread(field->GetBase()),
+                                 new Identifier(loc, field->GetField()->GetName()));
+    copy->SetType(target->GetType());
+    return copy;
+}
+
+/* Whether value can be worked out where the branch it is in would not
+ * have been taken, adding its expressions to cost.
+ */
+static bool Quiet(Expr *value, int *cost) {
+    vector<Expr *> stack(1, value);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *expr = stack.back();
+        stack.pop_back();
+        (*cost)++;
+        CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+        if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr)
+            || dynamic_cast<Call *>(expr) || dynamic_cast<ArrayAccess *>(expr))
+            return false;
+        if (compound && !compound->GetLeft()
+            && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--")))
+            return false;
+        Expr **operand;
+        for (int i = 0; (operand = expr->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    return true;
+}
+
+/* The stores branch makes, if it makes nothing else, adding what it
+ * costs to cost.
+ */
+static bool Stores(Stmt *branch, vector<Store> *stores, int *cost) {
+    if (branch == NULL) return true;
+    vector<Stmt *> stmts;
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(branch)) {
+        if (block->GetDecls()->NumElements() > 0) return false;
+        for (int i = 0; i < block->GetStmts()->NumElements(); i++)
+            stmts.push_back(block->GetStmts()->Nth(i));
+    } else {
+        stmts.push_back(branch);
+    }
+    for (size_t i = 0; i < stmts.size(); i++) {
+        AssignExpr *assign = dynamic_cast<AssignExpr *>(stmts[i]);
+        if (!assign || !Plain(assign->GetLeft())) return false;
+        Operator *op = assign->GetOperator();
+        if (!op->IsOp("=") && !op->IsOp("+=") && !op->IsOp("-=") && !op->IsOp("*=")
+            && !op->IsOp("/="))
+            return false;
+        if (!Quiet(assign->GetRight(), cost)) return false;
+        (*cost)++;
+        Store store = { assign, assign->GetLeft(), assign->GetRight() };
+        stores->push_back(store);
+    }
+    return true;
+}
+
+// What a store leaves in its target, v + e for v += e
+static Expr *Stored(const Store &store) {
+    Operator *op = store.assign->GetOperator();
+    if (op->IsOp("=")) return store.value;
+    yyltype loc = *op->GetLocation();
+    char token[2] = { op->GetToken()[0], '\0' };
+    Expr *value = new ArithmeticExpr(Reread(store.target), new Operator(loc, token), store.value);
+    value->SetType(store.target->GetType());
+    return value;
+}
+
+/* Goes through the functions' statements innermost first, replacing
+ * the ifs that only store with stores of selects.
+ */
+class BranchFlattener {
+  public:
+    BranchFlattener(Program *program, int most)
+        : candidates(0), flattened(0), selects(0), program(program), most(most) {}
+
+    void Run();
+
+    int candidates, flattened, selects;
+
+  private:
+    Program *program;
+    int most;
+    set<string> names;
+    int nextTemp;
+    set<Stmt *> loose;          // blocks of selects to put in the block around them
+
+    void Walk(Stmt **slot);
+    void WalkBlock(StmtBlock *block);
+    Stmt *Flatten(IfStmt *branch, bool listed);
+    Expr *Select(Expr *test, const Store &store, Expr *other, bool taken);
+    string NewName();
+};
+
+void BranchFlattener::Run() {
+    DeclaredNames(program, &names);
+    nextTemp = 0;
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!fn || !fn->HasBody()) continue;
+        Stmt *body = fn->GetBody();
+        Walk(&body);
+    }
+}
+
+void BranchFlattener::Walk(Stmt **slot) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return;
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        WalkBlock(block);
+        return;
+    }
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Walk(stmtSlot);
+    IfStmt *branch = dynamic_cast<IfStmt *>(stmt);
+    Stmt *flat = branch ? Flatten(branch, dynamic_cast<StmtBlock *>(stmt->GetParent())) : NULL;
+    if (flat == NULL) return;
+    flat->SetParent(stmt->GetParent());
+    *slot = flat;
+}
+
+// The selects that replace an if are put in the block it was in
+void BranchFlattener::WalkBlock(StmtBlock *block) {
+    List<Stmt*> *stmts = block->GetStmts();
+    vector<Stmt *> kept;
+    bool changed = false;
+    for (int i = 0; i < stmts->NumElements(); i++) {
+        Walk(&stmts->NthRef(i));
+        StmtBlock *selects = dynamic_cast<StmtBlock *>(stmts->Nth(i));
+        if (!selects || !loose.count(selects)) {
+            kept.push_back(stmts->Nth(i));
+            continue;
+        }
+        changed = true;
+        for (int j = 0; j < selects->GetStmts()->NumElements(); j++) {
+            kept.push_back(selects->GetStmts()->Nth(j));
+            kept.back()->SetParent(block);
+        }
+    }
+    if (!changed) return;
+    while (stmts->NumElements() > 0)
+        stmts->RemoveAt(stmts->NumElements() - 1);
+    for (size_t i = 0; i < kept.size(); i++)
+        stmts->Append(kept[i]);
+}
+
+/* The statement to put in place of branch, NULL to leave it be. listed
+ * says whether branch is directly in a block, whose statements the
+ * selects can go among.
+ */
+Stmt *BranchFlattener::Flatten(IfStmt *branch, bool listed) {
+    vector<Store> taken, otherwise;
+    int cost = 0;
+    if (!Stores(*branch->StmtSlot(0), &taken, &cost)
+        || !Stores(*branch->StmtSlot(1), &otherwise, &cost)
+        || taken.size() + otherwise.size() == 0)
+        return NULL;
+    candidates++;
+    if (cost > most) return NULL;
+    flattened++;
+
+    Expr *test = *branch->ExprSlot(0);
+    yyltype loc = *test->GetLocation();
+    List<Stmt*> *stmts = new List<Stmt*>;
+    if (taken.size() == 1 && otherwise.size() == 1
+        && taken[0].assign->GetOperator()->IsOp("=")
+        && otherwise[0].assign->GetOperator()->IsOp("=")
+        && SameTarget(taken[0].target, otherwise[0].target)) {
+        selects++;
+        Expr *select = new ConditionalExpr(test, taken[0].value, otherwise[0].value);
+        select->SetType(taken[0].target->GetType());
+        Expr *assign = new AssignExpr(taken[0].target, new Operator(loc, "="), select);
+        assign->SetType(taken[0].target->GetType());
+        return assign;
+    }
+
+    // The test is worked out once, unless it is a variable left alone
+    VarExpr *use = dynamic_cast<VarExpr *>(test);
+    VarDecl *var = use ? use->GetDecl() : NULL;
+    for (size_t i = 0; var && i < taken.size(); i++)
+        if (Root(taken[i].target) == var) var = NULL;
+    for (size_t i = 0; var && i < otherwise.size(); i++)
+        if (Root(otherwise[i].target) == var) var = NULL;
+    VarDecl *temp = NULL;
+    if (!var && taken.size() + otherwise.size() > 1) {
+        temp = new VarDecl(new Identifier(loc, NewName().c_str()), Type::boolType, test);
+        stmts->Append(new DeclStmt(temp));
+        var = temp;
+    }
+    for (size_t i = 0; i < taken.size() + otherwise.size(); i++) {
+        bool then = i < taken.size();
+        const Store &store = then ? taken[i] : otherwise[i - taken.size()];
+        Expr *select = Select(var && (temp || i > 0) ? new VarExpr(loc, var) : test,
+                              store, Reread(store.target), then);
+        Expr *assign = new AssignExpr(store.target, new Operator(loc, "="), select);
+        assign->SetType(store.target->GetType());
+        stmts->Append(assign);
+    }
+    if (stmts->NumElements() == 1) return stmts->Nth(0);
+    StmtBlock *block = new StmtBlock(new List<VarDecl*>, stmts);
+    if (listed && !temp) loose.insert(block);
+    return block;
+}
+
+// test ? what store stores : other, or the other way round if not taken
+Expr *BranchFlattener::Select(Expr *test, const Store &store, Expr *other, bool taken) {
+    selects++;
+    Expr *value = Stored(store);
+    Expr *select = taken ? new ConditionalExpr(test, value, other)
+                         : new ConditionalExpr(test, other, value);
+    select->SetType(store.target->GetType());
+    return select;
+}
+
+string BranchFlattener::NewName() {
+    char name[32];
+    do {
+        snprintf(name, sizeof(name), "cond_%d", ++nextTemp);
+    } while (names.count(name));
+    names.insert(name);
+    return name;
+}
+
+int FlattenBranches(Program *program, int cost) {
+    BranchFlattener flattener(program, cost);
+    flattener.Run();
+    PrintDebug("stats", "flatten: flattened %d of %d ifs that only store into %d selects",
+               flattener.flattened, flattener.candidates, flattener.selects);
+    return flattener.flattened;
+}
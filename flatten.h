@@ -0,0 +1,46 @@
+/* File: flatten.h
+ * ---------------
+ * Branch flattening, for glc --flatten[=cost]: rewrites the ifs of a
+ * program that checked without errors that only store values into
+ * variables as stores of selects, so that the GPU need not branch,
+ * before the program is written out (see glsl.h).
+ *
+ * An if is flattened if each of its branches is nothing but stores,
+ * = or one of += -= *= /=, to variables or their components (v or v.x,
+ * not a[i]), of values without side effects: no stores, no calls, and
+ * no subscripts, which might be out of range where the branch would not
+ * have been taken. Each store of the then branch becomes
+ *
+ *   v = test ? value : v;
+ *
+ * and each of the else branch v = test ? v : value, with v += e storing
+ * v + e and so on. A single store to the same variable in each branch
+ * becomes one select, v = test ? a : b. If there is more than one
+ * select the test is worked out once into a new bool variable first,
+ * unless it is a variable the branches do not store to. Ifs inside
+ * others are flattened first, so that a nest of them can become nested
+ * selects.
+ *
+ * Since both values of a select are worked out, an if is flattened only
+ * if it costs at most cost (default DefaultFlattenCost), counting one
+ * for each expression in the values its branches store and one for
+ * each select. Once done, the pass says how many ifs it flattened, of
+ * those it could have, under the "stats" debug key.
+ */
+
+#ifndef _H_flatten
+#define _H_flatten
+
+class Program;
+
+// Ifs that cost at most this much are flattened by --flatten
+#define DefaultFlattenCost 16
+
+/* Function: FlattenBranches()
+ * ---------------------------
+ * Flattens in place the ifs of program that cost at most cost. Returns
+ * how many it flattened.
+ */
+int FlattenBranches(Program *program, int cost);
+
+#endif
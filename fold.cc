@@ -0,0 +1,64 @@
+/* File: fold.cc
+ * -------------
+ * Implementation of constant folding.
+ */
+
+#include <set>
+#include "fold.h"
+#include "rewriter.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+
+using namespace std;
+
+/* Folds each expression once its operands are, and puts the value of a
+ * const variable that is never written in place of its uses.
+ */
+class Folder : public Rewriter {
+  public:
+    Folder(const set<VarDecl *> *written) : written(written) {}
+
+  protected:
+    Expr *LeaveExpr(Expr *expr);
+
+  private:
+    const set<VarDecl *> *written;
+
+    Expr *Propagate(VarExpr *use);
+};
+
+Expr *Folder::LeaveExpr(Expr *expr) {
+    VarExpr *use = dynamic_cast<VarExpr *>(expr);
+    return use ? Propagate(use) : expr->Fold();
+}
+
+Expr *Folder::Propagate(VarExpr *use) {
+    VarDecl *var = use->GetDecl();
+    if (!var || var->GetTypeQualifier() != TypeQualifier::constTypeQualifier
+        || written->count(var))
+        return use;
+    // The initializer has been folded already, being earlier in the source
+    Expr *init = var->GetInitializer();
+    if (!init || init->GetType() != var->GetType()) return use;
+    yyltype loc = *use->GetLocation();
+    Expr *copy;
+    if (IntConstant *i = dynamic_cast<IntConstant *>(init))
+        copy = new IntConstant(loc, i->GetValue());
+    else if (FloatConstant *f = dynamic_cast<FloatConstant *>(init))
+        copy = new FloatConstant(loc, f->GetValue());
+    else if (BoolConstant *b = dynamic_cast<BoolConstant *>(init))
+        copy = new BoolConstant(loc, b->GetValue());
+    else
+        return use;
+    copy->Check();
+    return copy;
+}
+
+void FoldConstants(Program *program) {
+    WriteFinder finder;
+    finder.Rewrite(program);
+    Folder folder(&finder.written);
+    folder.Rewrite(program);
+}
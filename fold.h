@@ -0,0 +1,30 @@
+/* File: fold.h
+ * ------------
+ * Constant folding, for glc --fold: simplifies a program that checked
+ * without errors before it is written out (see glsl.h).
+ *
+ * Operators whose operands are constants are replaced by the constant
+ * they compute, and operators that leave an operand unchanged, such as
+ * x*1, x+0 and -(-x), by that operand; a division by a float constant
+ * becomes a multiplication by its reciprocal (see Expr::Fold()). A use
+ * of a const variable whose initializer folds to a constant is replaced
+ * by a copy of that constant, as long as nothing assigns to the
+ * variable or passes it as an out argument. The declaration itself is
+ * left in place.
+ *
+ * There are no vector or matrix constants to fold, since the language
+ * has no constructors to write them with.
+ */
+
+#ifndef _H_fold
+#define _H_fold
+
+class Program;
+
+/* Function: FoldConstants()
+ * -------------------------
+ * Folds the constants of program in place.
+ */
+void FoldConstants(Program *program);
+
+#endif
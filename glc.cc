@@ -0,0 +1,113 @@
+/* File: glc.cc
+ * ------------
+ * Implementation of the library interface declared in glc.h. Each call
+ * resets the compiler's global state, runs the source through the push
+ * parser (which checks the program once it has been parsed) and turns
+ * the errors collected along the way into glc_diagnostics, ending with a
+ * GLC_E_DEADLINE_EXCEEDED or GLC_E_LIMIT_EXCEEDED one if it was cut
+ * short. The tree is
+ * built in the AST arena and released before returning, so repeated
+ * calls reuse the same memory.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include "glc.h"
+#include "parser.h"
+#include "errors.h"
+#include "symtable.h"
+#include "utility.h"
+#include "arena.h"
+#include "memo.h"
+#include "deadline.h"
+#include "bounds.h"
+#include "options.h"
+
+/* Thrown by the failure handler installed for the duration of a check,
+ * so that Failure() and Assert() unwind to glc_check() instead of
+ * aborting the caller's process.
+ */
+struct CompilerFailure {
+    string message;
+};
+
+static void ThrowFailure(const char *message) {
+    CompilerFailure failure;
+    failure.message = message;
+    throw failure;
+}
+
+/* The checker's state lives in statics that are normally set up once per
+ * process; put them back as they are at startup.
+ */
+static void ResetCompilerState() {
+    ResetSymbolTable();
+    ReportError::ResetNumErrors();
+}
+
+int glc_check(const char *src, size_t len, const glc_options *options,
+              glc_result *result) {
+    vector<Diagnostic> diagnostics;
+    Arena::Mark mark = AstArena().GetMark();
+    // The passes, dumps and the like that the process's own command line
+    // may ask for would print and write files
+    ProgramOptionsOff off;
+
+    ResetCompilerState();
+    ReportError::Collect(&diagnostics);
+    SetFailureHandler(ThrowFailure);
+    Deadline::Start(options ? options->deadline_ms : 0);
+    Bounds::Start(options);
+    try {
+        GlcParser parser;
+        parser.Feed(src, len);
+        parser.Finish();
+    } catch (const CompilerFailure &failure) {
+        FunctionMemo::Abandon();
+        ReportError::Capture(NULL); // a streamed check may hold errors back
+        Diagnostic d;
+        d.located = false;
+        d.code = GLC_E_INTERNAL;
+        d.message = failure.message;
+        diagnostics.push_back(d);
+    } catch (const CheckAbandoned &reason) {
+        FunctionMemo::Abandon();
+        ReportError::Capture(NULL);
+        reason.Report();
+    }
+    Deadline::Stop();
+    Bounds::Stop();
+    SetFailureHandler(NULL);
+    ReportError::Collect(NULL);
+    // Nothing refers to this call's tree any more except the symbol
+    // table, which the next call replaces before looking at it.
+    AstArena().Release(mark);
+
+    int count = diagnostics.size();
+    if (options && options->max_diagnostics > 0 && count > options->max_diagnostics)
+        count = options->max_diagnostics;
+    result->num_diagnostics = count;
+    result->diagnostics = count ? (glc_diagnostic *)calloc(count, sizeof(glc_diagnostic)) : NULL;
+    for (int i = 0; i < count; i++) {
+        const Diagnostic &d = diagnostics[i];
+        glc_diagnostic *out = &result->diagnostics[i];
+        if (d.located) {
+            out->span.first_line = d.loc.first_line;
+            out->span.first_column = d.loc.first_column;
+            out->span.last_line = d.loc.first_line;
+            out->span.last_column = d.loc.last_column;
+        }
+        out->code = d.code;
+        out->message = strdup(d.message.c_str());
+    }
+    return diagnostics.size();
+}
+
+void glc_result_free(glc_result *result) {
+    for (int i = 0; i < result->num_diagnostics; i++)
+        free((char *)result->diagnostics[i].message);
+    free(result->diagnostics);
+    result->num_diagnostics = 0;
+    result->diagnostics = NULL;
+}
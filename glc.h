@@ -0,0 +1,122 @@
+/**
+ * File: glc.h
+ * -----------
+ * Public interface of libglc, the compiler front end packaged as a
+ * library so that tools can check shader source held in memory without
+ * running the glc executable. It is a plain C interface, usable from C
+ * and C++ alike.
+ *
+ * glc_check() scans, parses and semantically checks one shader and
+ * hands back every error it found as a glc_diagnostic. Nothing is
+ * printed and the process is never exited or aborted: even an internal
+ * failure of the compiler comes back as a GLC_E_INTERNAL diagnostic.
+ * Options given to glc that concern only the program, such as the passes
+ * and the dumps, are ignored for the duration of the check.
+ *
+ * The compiler keeps its state in globals, so glc_check() must not be
+ * called from more than one thread at a time.
+ */
+
+#ifndef _H_glc
+#define _H_glc
+
+#include <stddef.h>
+
+/* Version of the compiler. Anything that changes which diagnostics are
+ * produced for a given input must bump it, since results cached by
+ * glc --cache-dir are only reused by the same version.
+ */
+#define GLC_VERSION "1.1"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every error the compiler can report has its own code. The values are
+ * part of the interface and will not change.
+ */
+typedef enum glc_code {
+    GLC_E_INTERNAL                  = 1,  /* Failure() or Assert() fired */
+    GLC_E_SYNTAX                    = 2,
+    GLC_E_FORMATTED                 = 3,  /* ReportError::Formatted() */
+    GLC_E_UNTERM_COMMENT            = 4,
+    GLC_E_LONG_IDENTIFIER           = 5,
+    GLC_E_UNTERM_STRING             = 6,
+    GLC_E_UNRECOG_CHAR              = 7,
+    GLC_E_DECL_CONFLICT             = 8,
+    GLC_E_INVALID_INITIALIZATION    = 9,
+    GLC_E_IDENTIFIER_NOT_DECLARED   = 10,
+    GLC_E_NOT_AN_ARRAY              = 11,
+    GLC_E_INCOMPATIBLE_OPERAND      = 12,
+    GLC_E_INCOMPATIBLE_OPERANDS     = 13,
+    GLC_E_EXTRA_FORMALS             = 14,
+    GLC_E_LESS_FORMALS              = 15,
+    GLC_E_FORMALS_TYPE_MISMATCH     = 16,
+    GLC_E_NOT_A_FUNCTION            = 17,
+    GLC_E_INACCESSIBLE_SWIZZLE      = 18,
+    GLC_E_INVALID_SWIZZLE           = 19,
+    GLC_E_SWIZZLE_OUT_OF_BOUND      = 20,
+    GLC_E_OVERSIZED_VECTOR          = 21,
+    GLC_E_TEST_NOT_BOOLEAN          = 22,
+    GLC_E_RETURN_MISMATCH           = 23,
+    GLC_E_RETURN_MISSING            = 24,
+    GLC_E_BREAK_OUTSIDE_LOOP        = 25,
+    GLC_E_CONTINUE_OUTSIDE_LOOP     = 26,
+    GLC_E_DEADLINE_EXCEEDED         = 27,  /* see glc_options.deadline_ms */
+    GLC_E_LIMIT_EXCEEDED            = 28   /* one of the glc_options.max_ */
+} glc_code;
+
+/* Source position of a diagnostic, lines and columns counted from 1.
+ * All fields are 0 when the error has no position (e.g. an unterminated
+ * comment at end of input). last_line is not tracked by the scanner and
+ * is reported equal to first_line.
+ */
+typedef struct glc_span {
+    int first_line, first_column;
+    int last_line, last_column;
+} glc_span;
+
+typedef struct glc_diagnostic {
+    glc_span span;
+    glc_code code;
+    const char *message;     /* without the "*** " prefix glc prints */
+} glc_diagnostic;
+
+/* Pass NULL to glc_check() to get the defaults, which are all zero. */
+typedef struct glc_options {
+    int max_diagnostics;     /* return at most this many; 0 for all */
+    long deadline_ms;        /* give up after this long; 0 for no limit */
+
+    /* Limits for untrusted input, each 0 for none (see bounds.h). A check
+     * stops at the first one it reaches with GLC_E_LIMIT_EXCEEDED. */
+    long max_input_bytes;
+    long max_tokens;
+    long max_nodes;          /* AST nodes */
+    int max_nesting;         /* brackets open at once */
+    int max_scope_depth;
+    long max_arena_bytes;    /* memory taken by the tree */
+} glc_options;
+
+typedef struct glc_result {
+    int num_diagnostics;
+    glc_diagnostic *diagnostics;   /* in the order they were raised */
+} glc_result;
+
+/* Checks the len bytes of shader source at src (which need not be
+ * NUL-terminated) and fills in result, which must later be released with
+ * glc_result_free(). Returns the number of errors found, so 0 means the
+ * shader is valid. If options set deadline_ms and the check takes longer,
+ * it stops where it is and the last diagnostic is GLC_E_DEADLINE_EXCEEDED,
+ * after those found up to then; it stops the same way, with
+ * GLC_E_LIMIT_EXCEEDED, at the first of the max_ limits it reaches.
+ */
+int glc_check(const char *src, size_t len, const glc_options *options,
+              glc_result *result);
+
+void glc_result_free(glc_result *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+/* File: glc_client.cc
+ * -------------------
+ * Command-line client for the validation daemon (glc --serve).
+ *
+ *   glc-client <socket> [file ...]
+ *
+ * Sends each file (or stdin if none are named) to the daemon over one
+ * connection and prints each JSON response on a line of its own. Exits
+ * with 0 if every shader was valid, 1 if any had errors, and 2 if the
+ * daemon could not be reached.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "protocol.h"
+
+static bool Check(int fd, istream &in, bool *valid) {
+    ostringstream source;
+    source << in.rdbuf();
+    string response;
+    if (!WriteFrame(fd, source.str()) || !ReadFrame(fd, &response))
+        return false;
+    printf("%s\n", response.c_str());
+    *valid = *valid && response.compare(0, 11, "{\"errors\":0") == 0;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket> [file ...]\n", argv[0]);
+        return 2;
+    }
+    int fd = ConnectToDaemon(argv[1]);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    bool valid = true, ok = true;
+    if (argc == 2)
+        ok = Check(fd, cin, &valid);
+    for (int i = 2; ok && i < argc; i++) {
+        ifstream file(argv[i], ios::binary);
+        if (!file) {
+            perror(argv[i]);
+            return 2;
+        }
+        ok = Check(fd, file, &valid);
+    }
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "%s: connection to daemon lost\n", argv[0]);
+        return 2;
+    }
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/* File: glc_loadtest.cc
+ * ---------------------
+ * Load-test driver for the validation daemon (glc --serve).
+ *
+ *   glc-loadtest <socket> <shader> [connections [requests]]
+ *
+ * Opens the given number of connections (default 4), each on its own
+ * thread, and has each send the shader requests times (default 1000)
+ * back to back. Reports throughput and the latency distribution of
+ * individual requests as seen by the client.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "protocol.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<bool> failed(false);
+
+static void Drive(const char *path, const string *source, int requests,
+                  vector<double> *latencies) {
+    int fd = ConnectToDaemon(path);
+    if (fd < 0) {
+        failed = true;
+        return;
+    }
+    string response;
+    for (int i = 0; i < requests; i++) {
+        Clock::time_point start = Clock::now();
+        if (!WriteFrame(fd, *source) || !ReadFrame(fd, &response)) {
+            failed = true;
+            break;
+        }
+        latencies->push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    close(fd);
+}
+
+static double Percentile(const vector<double> &sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <socket> <shader> [connections [requests]]\n", argv[0]);
+        return 2;
+    }
+    ifstream file(argv[2], ios::binary);
+    if (!file) {
+        perror(argv[2]);
+        return 2;
+    }
+    ostringstream buffer;
+    buffer << file.rdbuf();
+    string source = buffer.str();
+    int connections = argc > 3 ? atoi(argv[3]) : 4;
+    int requests = argc > 4 ? atoi(argv[4]) : 1000;
+    if (connections < 1 || requests < 1) {
+        fprintf(stderr, "%s: connections and requests must be positive\n", argv[0]);
+        return 2;
+    }
+
+    vector<vector<double> > latencies(connections);
+    vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < connections; i++)
+        threads.push_back(std::thread(Drive, argv[1], &source, requests, &latencies[i]));
+    for (int i = 0; i < connections; i++)
+        threads[i].join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    vector<double> all;
+    for (int i = 0; i < connections; i++)
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    if (failed || all.empty()) {
+        fprintf(stderr, "%s: requests to %s failed\n", argv[0], argv[1]);
+        if (all.empty()) return 2;
+    }
+    sort(all.begin(), all.end());
+    printf("%zu requests over %d connections in %.2f s (%.0f requests/s)\n",
+           all.size(), connections, seconds, all.size() / seconds);
+    printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+           Percentile(all, 0.50), Percentile(all, 0.90), Percentile(all, 0.99), all.back());
+    return failed ? 1 : 0;
+}
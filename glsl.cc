@@ -0,0 +1,241 @@
+/* File: glsl.cc
+ * -------------
+ * Implementation of the GLSL writer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+#include "glsl.h"
+#include "ast.h"
+#include "ast_stmt.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "minify.h"
+
+using namespace std;
+
+// Spaces per level of indentation
+static const int IndentWidth = 4;
+
+void GlslWriter::Write(Node *root, string *o) {
+    out = o;
+    stack.push_back(Item(Item::NodeItem, root));
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        switch (item.kind) {
+          case Item::TextItem:
+            Append(item.text.c_str());
+            break;
+          case Item::NodeItem:
+            Open(item.node, item.level);
+            break;
+          case Item::StmtItem:
+            if (dynamic_cast<Expr *>(item.node)) {
+                stack.push_back(Item(Item::TextItem));
+                stack.back().text = ";";
+                stack.push_back(Item(Item::NodeItem, item.node));
+            } else {
+                Open(item.node, 0);
+            }
+            break;
+          case Item::SpaceItem:
+            if (!minify) *out += ' ';
+            break;
+          case Item::LineItem:
+            if (minify) break;
+            while (!out->empty() && (*out)[out->size() - 1] == ' ')
+                out->erase(out->size() - 1);
+            *out += '\n';
+            out->append(indent * IndentWidth, ' ');
+            break;
+          case Item::IndentItem:
+            indent++;
+            break;
+          case Item::DedentItem:
+            indent--;
+            break;
+        }
+    }
+    if (!minify) *out += '\n';
+}
+
+/* Emits the node's own tokens and leaves its children on the stack to be
+ * written after them, in parentheses if it is an expression that binds
+ * less tightly than level.
+ */
+void GlslWriter::Open(Node *node, int level) {
+    parts.clear();
+    node->Emit(this);
+    Expr *expr = dynamic_cast<Expr *>(node);
+    bool parenthesize = expr && expr->Precedence() < level;
+    if (parenthesize) {
+        stack.push_back(Item(Item::TextItem));
+        stack.back().text = ")";
+        Append("(");
+    }
+    for (int i = parts.size() - 1; i >= 0; i--)
+        stack.push_back(parts[i]);
+}
+
+static bool IsWordChar(char ch) {
+    return isalnum((unsigned char)ch) || ch == '_';
+}
+
+// Appends token, after a space if it would otherwise run into the last
+void GlslWriter::Append(const char *token) {
+    if (!*token) return;
+    if (!out->empty()) {
+        char last = (*out)[out->size() - 1];
+        if ((IsWordChar(last) && IsWordChar(token[0]))
+            || ((last == '+' || last == '-') && token[0] == last))
+            *out += ' ';
+    }
+    *out += token;
+}
+
+void GlslWriter::Text(const char *token) {
+    parts.push_back(Item(Item::TextItem));
+    parts.back().text = token;
+}
+
+void GlslWriter::Name(Identifier *id) {
+    map<Identifier *, string>::iterator renamed = names.find(id);
+    Text(renamed != names.end() ? renamed->second.c_str() : id->GetName());
+}
+
+void GlslWriter::Int(int value) {
+    char buf[32];
+    if (value == INT_MIN)   // its magnitude is not an int
+        snprintf(buf, sizeof(buf), "(%d - 1)", INT_MIN + 1);
+    else
+        snprintf(buf, sizeof(buf), "%d", value);
+    Text(buf);
+}
+
+/* Prints value with the fewest digits that read back as the same float,
+ * always with a '.', and without an exponent, which the scanner does not
+ * take. Minified, "2.0" is "2.".
+ */
+void GlslWriter::Float(double value) {
+    float single = (float)value;
+    bool exact = isfinite(single) || !isfinite(value);   // else keep the double
+    char buf[400];
+    for (int digits = 1; digits <= 17; digits++) {
+        snprintf(buf, sizeof(buf), "%.*g", digits, exact ? (double)single : value);
+        double back = strtod(buf, NULL);
+        if (exact ? (float)back == single : back == value) break;
+    }
+    if (strpbrk(buf, "eE")) {
+        for (int decimals = 1; decimals <= 60; decimals++) {
+            snprintf(buf, sizeof(buf), "%.*f", decimals, exact ? (double)single : value);
+            double back = strtod(buf, NULL);
+            if (exact ? (float)back == single : back == value) break;
+        }
+    } else if (!strchr(buf, '.')) {
+        strcat(buf, ".0");
+    }
+    if (minify) {
+        char *end = buf + strlen(buf);
+        while (end[-1] == '0' && strchr(buf, '.') < end - 1) *--end = '\0';
+    }
+    Text(buf);
+}
+
+void GlslWriter::TypeName(Type *type) {
+    ArrayType *array = dynamic_cast<ArrayType *>(type);
+    if (array) type = array->GetElemType();   // the count goes after the name
+    ostringstream s;
+    s << type;
+    Text(s.str().c_str());
+}
+
+void GlslWriter::Space() {
+    parts.push_back(Item(Item::SpaceItem));
+}
+
+void GlslWriter::Line() {
+    parts.push_back(Item(Item::LineItem));
+}
+
+void GlslWriter::Indent() {
+    parts.push_back(Item(Item::IndentItem));
+}
+
+void GlslWriter::Dedent() {
+    parts.push_back(Item(Item::DedentItem));
+}
+
+void GlslWriter::Expression(Expr *expr, int level) {
+    parts.push_back(Item(Item::NodeItem, expr, level));
+}
+
+void GlslWriter::Statement(Stmt *stmt) {
+    parts.push_back(Item(Item::StmtItem, stmt));
+}
+
+void GlslWriter::Body(Stmt *stmt) {
+    if (dynamic_cast<StmtBlock *>(stmt)) {
+        Space();
+        Statement(stmt);
+    } else {
+        Indent();
+        Line();
+        Statement(stmt);
+        Dedent();
+    }
+}
+
+void GlslWriter::Braced(Stmt *stmt) {
+    if (dynamic_cast<StmtBlock *>(stmt)) {
+        Statement(stmt);
+    } else {
+        Text("{");
+        Indent();
+        Line();
+        Statement(stmt);
+        Dedent();
+        Line();
+        Text("}");
+    }
+}
+
+void GlslWriter::Part(Node *node) {
+    parts.push_back(Item(Item::NodeItem, node));
+}
+
+bool WriteOutput(const char *path, const string &contents, const char *what) {
+    bool toStdout = strcmp(path, "-") == 0;
+    if (toStdout) fflush(stdout);   // anything printed through stdio goes first
+    int fd = toStdout ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    size_t done = 0;
+    while (fd >= 0 && done < contents.size()) {
+        ssize_t n = write(fd, contents.data() + done, contents.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    if (fd < 0 || done < contents.size() || (!toStdout && close(fd) != 0)) {
+        string message = string("glc: cannot write ") + what;
+        perror(message.c_str());
+        if (fd >= 0 && !toStdout) unlink(path);
+        return false;
+    }
+    return true;
+}
+
+bool EmitGlsl(Program *program, const char *path, bool minify) {
+    string contents;
+    GlslWriter writer(minify);
+    if (minify) Minify(program, &writer);
+    writer.Write(program, &contents);
+    return WriteOutput(path, contents, "GLSL");
+}
@@ -0,0 +1,100 @@
+/* File: glsl.h
+ * ------------
+ * The tree printed back out as GLSL source, by glc --emit-glsl <file>
+ * once the program has been checked (and, with --fold, simplified; see
+ * fold.h). The output checks just as the input did.
+ *
+ * Each node emits its own tokens through Node::Emit(), handing its
+ * children to the writer, which prints them after the node's own tokens
+ * that come before them. An expression is put in parentheses only where
+ * the place it appears in binds more tightly than it does (see
+ * Expr::Precedence()), so the parentheses of the source are not kept.
+ * Comments and the original layout are not kept either: the program is
+ * laid out afresh, one statement to a line, indented by four spaces.
+ *
+ * With --minify the writer leaves the layout out instead, keeping only
+ * the spaces that stop two tokens from running together, and writes
+ * floats without the zeros after their '.'; the identifiers it is told
+ * to rename are written under their new names (see minify.h).
+ *
+ * Like the JSON dump, the writer walks the tree with an explicit stack
+ * and gathers the text in one buffer.
+ */
+
+#ifndef _H_glsl
+#define _H_glsl
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Node;
+class Stmt;
+class Expr;
+class Identifier;
+class Type;
+class Program;
+
+class GlslWriter {
+  public:
+    GlslWriter(bool minify = false) : minify(minify), indent(0) {}
+
+    // Appends the text of the whole tree under root to out
+    void Write(Node *root, std::string *out);
+    // Writes id as name wherever it appears
+    void Rename(Identifier *id, const std::string &name) { names[id] = name; }
+
+    // The calls Emit() makes: tokens, layout, and children
+    void Text(const char *token);
+    void Name(Identifier *id);
+    void Int(int value);
+    void Float(double value);
+    void TypeName(Type *type);
+    void Space();                           // between tokens, for reading
+    void Line();                            // a new line at the indentation
+    void Indent();
+    void Dedent();
+    void Expression(Expr *expr, int level); // parenthesized if it binds looser
+    void Statement(Stmt *stmt);             // an expression gets its ';'
+    void Body(Stmt *stmt);                  // of an if, a loop: a block or indented
+    void Braced(Stmt *stmt);                // in a block even if it is not one
+    void Part(Node *node);                  // a declaration, a case
+
+  private:
+    struct Item {
+        enum Kind { TextItem, NodeItem, StmtItem, SpaceItem, LineItem,
+                    IndentItem, DedentItem } kind;
+        Node *node;
+        int level;                          // the precedence a NodeItem needs
+        std::string text;
+        Item(Kind k, Node *n = NULL, int l = 0) : kind(k), node(n), level(l) {}
+    };
+    std::vector<Item> stack;
+    std::vector<Item> parts;                // handed over by the node being emitted
+    std::string *out;
+    bool minify;
+    int indent;
+    std::map<Identifier *, std::string> names;
+
+    void Open(Node *node, int level);
+    void Append(const char *token);
+};
+
+/* Function: EmitGlsl()
+ * --------------------
+ * Writes program as GLSL to the file at path, or to stdout if path is
+ * "-", minified if minify is set (which drops and renames declarations
+ * of program). Returns false, after saying why on stderr, if it could
+ * not be written.
+ */
+bool EmitGlsl(Program *program, const char *path, bool minify = false);
+
+/* Function: WriteOutput()
+ * -----------------------
+ * Writes contents to the file at path, or to stdout if path is "-", as
+ * EmitGlsl() does; what names the contents if it has to say on stderr
+ * why they could not be written, which it returns false for.
+ */
+bool WriteOutput(const char *path, const std::string &contents, const char *what);
+
+#endif
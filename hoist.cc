@@ -0,0 +1,317 @@
+/* File: hoist.cc
+ * --------------
+ * Implementation of uniform hoisting.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "hoist.h"
+#include "rewriter.h"
+#include "glsl.h"
+#include "copy.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+// What is known of an expression that has been left, as bits
+enum {
+    Fixed = 1,          // reads only uniforms and constants
+    ReadsUniform = 2,
+    HasOperator = 4
+};
+
+// The literal a const variable is initialized with, NULL if it is not
+static Expr *Literal(VarDecl *var) {
+    if (!var || var->GetTypeQualifier() != TypeQualifier::constTypeQualifier) return NULL;
+    Expr *init = var->GetInitializer();
+    if (!init || init->GetType() != var->GetType()) return NULL;
+    if (dynamic_cast<IntConstant *>(init) || dynamic_cast<FloatConstant *>(init)
+        || dynamic_cast<BoolConstant *>(init))
+        return init;
+    return NULL;
+}
+
+static Expr *Copy(Expr *literal, yyltype loc) {
+    Expr *copy;
+    if (IntConstant *i = dynamic_cast<IntConstant *>(literal))
+        copy = new IntConstant(loc, i->GetValue());
+    else if (FloatConstant *f = dynamic_cast<FloatConstant *>(literal))
+        copy = new FloatConstant(loc, f->GetValue());
+    else
+        copy = new BoolConstant(loc, dynamic_cast<BoolConstant *>(literal)->GetValue());
+    copy->Check();
+    return copy;
+}
+
+static bool IsStore(Expr *expr) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr)) return true;
+    return compound && !compound->GetLeft()
+           && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--"));
+}
+
+// Whether operand i of expr is stored to, and so has to stay a variable
+static bool IsTarget(Expr *expr, int i) {
+    if (IsStore(expr)) return i == (dynamic_cast<CompoundExpr *>(expr)->GetLeft() ? 0 : 1);
+    Call *call = dynamic_cast<Call *>(expr);
+    if (!call || !call->GetCallee()) return false;
+    List<VarDecl*> *formals = call->GetCallee()->GetFormals();
+    return i < formals->NumElements()
+           && formals->Nth(i)->GetTypeQualifier() == TypeQualifier::outTypeQualifier;
+}
+
+static string TypeName(Type *type) {
+    ostringstream name;
+    name << type;
+    return name.str();
+}
+
+static void Quote(const string &str, string *out) {
+    *out += '"';
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char ch = str[i];
+        if (ch == '"' || ch == '\\') {
+            *out += '\\';
+            *out += ch;
+        } else if (ch < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            *out += buf;
+        } else {
+            *out += ch;
+        }
+    }
+    *out += '"';
+}
+
+static bool ByName(VarDecl *a, VarDecl *b) {
+    return strcmp(a->GetIdentifier()->GetName(), b->GetIdentifier()->GetName()) < 0;
+}
+
+/* Marks each expression as it is left, and replaces those that are
+ * fixed when the expression they are in is not, or when they are not
+ * in one.
+ */
+class UniformHoister : public Rewriter {
+  public:
+    UniformHoister(Program *program, const set<VarDecl *> *written)
+        : program(program), written(written), nextName(0), replaced(0) {}
+
+    void Run();
+    string Manifest();
+    int NumReplaced() { return replaced; }
+    int NumHoisted() { return hoisted.size(); }
+
+  protected:
+    Expr *LeaveExpr(Expr *expr);
+
+  private:
+    // A new uniform, and what the manifest says of it
+    struct Hoisted {
+        VarDecl *decl;
+        string expression;
+        vector<VarDecl *> inputs;
+        int uses;
+    };
+
+    Program *program;
+    const set<VarDecl *> *written;
+    vector<int> marks;                          // of the operands left so far
+    vector<Hoisted> hoisted;
+    map<string, int> byText;                    // type and expression to hoisted
+    set<string> names;                          // the program or prelude uses
+    int nextName;
+    int replaced;
+
+    int Mark(Expr *expr, const int *operands, int count);
+    bool Worth(Expr *expr, int mark);
+    Expr *Hoist(Expr *expr);
+    string NewName();
+};
+
+void UniformHoister::Run() {
+    List<Decl*> *decls = program->GetDecls();
+    int first = 0;
+    while (first < decls->NumElements() && !dynamic_cast<FnDecl *>(decls->Nth(first)))
+        first++;
+    DeclaredNames(program, &names);
+
+    // Global initializers are computed once already
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (fn && fn->HasBody()) RewriteDecl(fn);
+    }
+    for (int i = hoisted.size() - 1; i >= 0; i--) {
+        decls->InsertAt(hoisted[i].decl, first);
+        hoisted[i].decl->SetParent(program);
+    }
+}
+
+/* Most expressions read something that is not fixed, which their
+ * operands already say, so what kind of expression it is is only asked
+ * once they do not.
+ */
+int UniformHoister::Mark(Expr *expr, const int *operands, int count) {
+    int mark = 0;
+    for (int i = 0; i < count; i++) {
+        if (!(operands[i] & Fixed)) return 0;
+        mark |= operands[i];
+    }
+    Type *type = expr->GetType();
+    if (!type || type == Type::errorType) return 0;
+    if (VarExpr *use = dynamic_cast<VarExpr *>(expr)) {
+        VarDecl *var = use->GetDecl();
+        TypeQualifier *typeq = var ? var->GetTypeQualifier() : NULL;
+        if (typeq != TypeQualifier::uniformTypeQualifier && !Literal(var)) return 0;
+        if (written->count(var)) return 0;
+        return typeq == TypeQualifier::uniformTypeQualifier ? Fixed | ReadsUniform : Fixed;
+    }
+    if (dynamic_cast<IntConstant *>(expr) || dynamic_cast<FloatConstant *>(expr)
+        || dynamic_cast<BoolConstant *>(expr))
+        return Fixed;
+    FieldAccess *field = dynamic_cast<FieldAccess *>(expr);
+    if (dynamic_cast<CompoundExpr *>(expr))
+        return IsStore(expr) ? 0 : mark | Fixed | HasOperator;
+    if (dynamic_cast<ConditionalExpr *>(expr))
+        return mark | Fixed | HasOperator;
+    if (dynamic_cast<ArrayAccess *>(expr) || (field && field->GetBase()))
+        return mark | Fixed;
+    return 0;
+}
+
+bool UniformHoister::Worth(Expr *expr, int mark) {
+    Type *type = expr->GetType();
+    return mark == (Fixed | ReadsUniform | HasOperator)
+           && Type::IndexOf(type) >= 0 && type != Type::voidType;
+}
+
+/* Operands are left just before the expression they are in, so their
+ * marks are the last ones pushed.
+ */
+Expr *UniformHoister::LeaveExpr(Expr *expr) {
+    int count = 0;
+    Expr **operand;
+    for (int i = 0; (operand = expr->ExprSlot(i)) != NULL; i++)
+        if (*operand) count++;
+    size_t first = marks.size() - count;
+    int mark = Mark(expr, count ? &marks[first] : NULL, count);
+    if (!(mark & Fixed)) {
+        for (int i = 0, j = first; (operand = expr->ExprSlot(i)) != NULL; i++) {
+            if (!*operand) continue;
+            if (Worth(*operand, marks[j++]) && !IsTarget(expr, i)) {
+                *operand = Hoist(*operand);
+                (*operand)->SetParent(expr);
+            }
+        }
+    }
+    marks.resize(first);
+    // A statement, condition or initializer is not in an expression
+    if (dynamic_cast<Expr *>(expr->GetParent()) == NULL)
+        return (mark & Fixed) && Worth(expr, mark) ? Hoist(expr) : expr;
+    marks.push_back(mark);
+    return expr;
+}
+
+Expr *UniformHoister::Hoist(Expr *expr) {
+    // The manifest has the values of const variables in place of them
+    set<VarDecl *> seen;
+    vector<VarDecl *> inputs;
+    vector<Expr *> stack(1, expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++) {
+            if (!*operand) continue;
+            VarExpr *use = dynamic_cast<VarExpr *>(*operand);
+            Expr *literal = use ? Literal(use->GetDecl()) : NULL;
+            if (literal) {
+                *operand = Copy(literal, *use->GetLocation());
+                (*operand)->SetParent(top);
+            } else if (use) {
+                if (seen.insert(use->GetDecl()).second) inputs.push_back(use->GetDecl());
+            } else {
+                stack.push_back(*operand);
+            }
+        }
+    }
+    sort(inputs.begin(), inputs.end(), ByName);
+
+    string text;
+    GlslWriter writer;
+    writer.Write(expr, &text);
+    while (!text.empty() && text[text.size() - 1] == '\n') text.erase(text.size() - 1);
+    string key = TypeName(expr->GetType()) + " " + text;
+    map<string, int>::iterator it = byText.find(key);
+    if (it == byText.end()) {
+        Hoisted made;
+        string name = NewName();
+        made.decl = new VarDecl(new Identifier(*expr->GetLocation(), name.c_str()),
+                                expr->GetType(), TypeQualifier::uniformTypeQualifier);
+        made.expression = text;
+        made.inputs = inputs;
+        made.uses = 0;
+        hoisted.push_back(made);
+        it = byText.insert(make_pair(key, (int)hoisted.size() - 1)).first;
+    }
+    Hoisted &entry = hoisted[it->second];
+    entry.uses++;
+    replaced++;
+    return new VarExpr(*expr->GetLocation(), entry.decl);
+}
+
+string UniformHoister::NewName() {
+    char name[32];
+    do {
+        snprintf(name, sizeof(name), "hoisted%d", nextName++);
+    } while (names.count(name));
+    return name;
+}
+
+string UniformHoister::Manifest() {
+    string out = "{\n  \"uniforms\": [";
+    for (size_t i = 0; i < hoisted.size(); i++) {
+        Hoisted &entry = hoisted[i];
+        out += i ? ",\n    {\"name\": " : "\n    {\"name\": ";
+        Quote(entry.decl->GetIdentifier()->GetName(), &out);
+        out += ", \"type\": ";
+        Quote(TypeName(entry.decl->GetType()), &out);
+        out += ", \"expression\": ";
+        Quote(entry.expression, &out);
+        out += ",\n     \"inputs\": [";
+        for (size_t j = 0; j < entry.inputs.size(); j++) {
+            out += j ? ", {\"name\": " : "{\"name\": ";
+            Quote(entry.inputs[j]->GetIdentifier()->GetName(), &out);
+            out += ", \"type\": ";
+            Quote(TypeName(entry.inputs[j]->GetType()), &out);
+            out += "}";
+        }
+        char uses[32];
+        snprintf(uses, sizeof(uses), "], \"uses\": %d}", entry.uses);
+        out += uses;
+    }
+    out += hoisted.empty() ? "]\n}\n" : "\n  ]\n}\n";
+    return out;
+}
+
+bool HoistUniforms(Program *program, const char *path) {
+    WriteFinder finder;
+    finder.Rewrite(program);
+    UniformHoister hoister(program, &finder.written);
+    hoister.Run();
+    PrintDebug("stats", "hoist: hoisted %d expressions into %d new uniforms",
+               hoister.NumReplaced(), hoister.NumHoisted());
+    return WriteOutput(path, hoister.Manifest(), "the uniform manifest");
+}
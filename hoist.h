@@ -0,0 +1,54 @@
+/* File: hoist.h
+ * -------------
+ * Uniform hoisting, for glc --hoist-uniforms <file>: takes out of the
+ * functions of a program that checked without errors the expressions
+ * that come out the same for every vertex or pixel of a draw, so that
+ * the engine computes them once per draw instead, before the program is
+ * written out (see glsl.h).
+ *
+ * An expression is fixed for a draw if everything it reads is a
+ * uniform variable or a constant: a literal, or a const variable
+ * initialized with one (run --fold first to find more). Operators,
+ * ?:, swizzles and subscripts of fixed expressions are fixed; calls,
+ * assignments, increments and names the checker left unresolved, as in
+ * subscripts, never are, and neither is a uniform or const variable
+ * the program writes to. Each fixed expression of a built-in type that
+ * no bigger fixed expression contains, that reads a uniform and that
+ * has an operator in it, such as projection * view or 1.0 / gamma, is
+ * replaced by a new uniform of its type. The new uniforms are declared
+ * before the first function, named hoisted0, hoisted1 and so on
+ * (skipping names the program or the prelude already use), and one
+ * expression, written out the same, is given the same uniform wherever
+ * it is.
+ *
+ * What the engine has to set the new uniforms to is written to the file
+ * as JSON, or to stdout if it is "-":
+ *
+ *   {
+ *     "uniforms": [
+ *       {"name": "hoisted0", "type": "mat4", "expression": "projection * view",
+ *        "inputs": [{"name": "projection", "type": "mat4"}, ...], "uses": 2},
+ *       ...
+ *     ]
+ *   }
+ *
+ * with each expression written as GLSL over the uniforms it lists as
+ * inputs, the values of const variables put in place of their names.
+ * Once done, the pass says how many expressions it hoisted under the
+ * "stats" debug key.
+ */
+
+#ifndef _H_hoist
+#define _H_hoist
+
+class Program;
+
+/* Function: HoistUniforms()
+ * -------------------------
+ * Hoists the fixed expressions of program in place and writes the
+ * manifest for them to the file at path. Returns false, after saying
+ * why on stderr, if the manifest could not be written.
+ */
+bool HoistUniforms(Program *program, const char *path);
+
+#endif
@@ -0,0 +1,784 @@
+/* File: inline.cc
+ * ---------------
+ * Implementation of inlining.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "inline.h"
+#include "copy.h"
+#include "rewriter.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+static bool IsGlobal(VarDecl *var) {
+    return dynamic_cast<Program *>(var->GetParent()) != NULL;
+}
+
+// The assignment, increment or decrement that expr is, if it is one
+static CompoundExpr *AsStore(Expr *expr) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr))
+        return compound;
+    if (compound && !compound->GetLeft()
+        && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--")))
+        return compound;
+    return NULL;
+}
+
+/* Counts the statements in stmt, expressions and blocks aside, and adds
+ * the names of the variables they declare to names.
+ */
+static void Statements(Stmt *stmt, int *count, set<string> *names) {
+    Deadline::Poll();
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return;
+    StmtBlock *block = dynamic_cast<StmtBlock *>(stmt);
+    if (block) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            names->insert(block->GetDecls()->Nth(i)->GetIdentifier()->GetName());
+    } else {
+        (*count)++;
+    }
+    if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt))
+        names->insert(declStmt->GetDecl()->GetIdentifier()->GetName());
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Statements(*stmtSlot, count, names);
+}
+
+// Whether stmt returns however it goes
+static bool AlwaysReturns(Stmt *stmt) {
+    if (dynamic_cast<ReturnStmt *>(stmt)) return true;
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        List<Stmt*> *stmts = block->GetStmts();
+        int last = stmts->NumElements() - 1;
+        return last >= 0 && AlwaysReturns(stmts->Nth(last));
+    }
+    IfStmt *branch = dynamic_cast<IfStmt *>(stmt);
+    return branch && *branch->StmtSlot(1) && AlwaysReturns(*branch->StmtSlot(0))
+           && AlwaysReturns(*branch->StmtSlot(1));
+}
+
+// An if with no else whose body returns, followed by more statements
+static IfStmt *EarlyReturn(List<Stmt*> *stmts, int i) {
+    IfStmt *branch = dynamic_cast<IfStmt *>(stmts->Nth(i));
+    if (!branch || *branch->StmtSlot(1) || i == stmts->NumElements() - 1) return NULL;
+    return AlwaysReturns(*branch->StmtSlot(0)) ? branch : NULL;
+}
+
+/* Whether every return in stmt is at its end, if end says that stmt is
+ * at the end of the function: the last statement of a block or a branch
+ * of an if at the end. An if with no else whose body returns counts as
+ * having the statements after it as its else.
+ */
+static bool ReturnsAtEnd(Stmt *stmt, bool end) {
+    Deadline::Poll();
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return true;
+    if (dynamic_cast<ReturnStmt *>(stmt)) return end;
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        List<Stmt*> *stmts = block->GetStmts();
+        for (int i = 0; i < stmts->NumElements(); i++) {
+            bool last = i == stmts->NumElements() - 1 || EarlyReturn(stmts, i);
+            if (!ReturnsAtEnd(stmts->Nth(i), end && last)) return false;
+        }
+        return true;
+    }
+    bool branches = dynamic_cast<IfStmt *>(stmt) != NULL;
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        if (!ReturnsAtEnd(*stmtSlot, end && branches)) return false;
+    return true;
+}
+
+/* Makes the returns of a copy of a function's body, all at its end (see
+ * ReturnsAtEnd()), store what they return into result, or drop them if
+ * there is no result to store into. The statements after an if with no
+ * else whose body returns become its else.
+ */
+static void StoreReturns(Stmt **slot, VarDecl *result) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL) return;
+    if (ReturnStmt *ret = dynamic_cast<ReturnStmt *>(stmt)) {
+        Expr *value = *ret->ExprSlot(0);
+        Stmt *replacement = value;
+        if (value && result) {
+            yyltype loc = *result->GetIdentifier()->GetLocation();
+            Expr *assign = new AssignExpr(new VarExpr(loc, result), new Operator(loc, "="), value);
+            assign->SetType(result->GetType());
+            replacement = assign;
+        } else if (!value) {
+            replacement = new StmtBlock(new List<VarDecl*>, new List<Stmt*>);
+        }
+        replacement->SetParent(stmt->GetParent());
+        *slot = replacement;
+        return;
+    }
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        List<Stmt*> *stmts = block->GetStmts();
+        for (int i = 0; i < stmts->NumElements(); i++) {
+            IfStmt *branch = EarlyReturn(stmts, i);
+            if (!branch) continue;
+            List<Stmt*> *rest = new List<Stmt*>;
+            while (stmts->NumElements() > i + 1) {
+                rest->Append(stmts->Nth(i + 1));
+                stmts->RemoveAt(i + 1);
+            }
+            StmtBlock *otherwise = new StmtBlock(new List<VarDecl*>, rest);
+            otherwise->SetParent(branch);
+            *branch->StmtSlot(1) = otherwise;
+        }
+        int last = stmts->NumElements() - 1;
+        ReturnStmt *ret = last >= 0 ? dynamic_cast<ReturnStmt *>(stmts->Nth(last)) : NULL;
+        if (ret && !*ret->ExprSlot(0)) stmts->RemoveAt(last);
+        else if (last >= 0) StoreReturns(&stmts->NthRef(last), result);
+        return;
+    }
+    if (dynamic_cast<IfStmt *>(stmt)) {
+        StoreReturns(stmt->StmtSlot(0), result);
+        StoreReturns(stmt->StmtSlot(1), result);
+    }
+}
+
+// An argument that can stand for a parameter the function does not store to
+static bool Direct(Expr *actual) {
+    if (dynamic_cast<IntConstant *>(actual) || dynamic_cast<FloatConstant *>(actual)
+        || dynamic_cast<BoolConstant *>(actual))
+        return true;
+    VarExpr *use = dynamic_cast<VarExpr *>(actual);
+    return use && use->GetDecl() && !IsGlobal(use->GetDecl());
+}
+
+/* What inlining needs to know of a function's body: the variables it
+ * writes to, the calls it makes, the names it uses of globals, of
+ * functions and that the checker left unresolved, and how many
+ * expressions it has.
+ */
+class FunctionFacts : public WriteFinder {
+  public:
+    FunctionFacts() : exprs(0) {}
+
+    void Gather(FnDecl *fn) { RewriteDecl(fn); }
+
+    vector<Call *> calls;
+    set<string> used;
+    int exprs;
+
+  protected:
+    Expr *LeaveExpr(Expr *expr);
+};
+
+Expr *FunctionFacts::LeaveExpr(Expr *expr) {
+    exprs++;
+    if (VarExpr *use = dynamic_cast<VarExpr *>(expr)) {
+        if (!use->GetDecl() || IsGlobal(use->GetDecl()))
+            used.insert(use->GetIdentifier()->GetName());
+    } else if (Call *call = dynamic_cast<Call *>(expr)) {
+        calls.push_back(call);
+        used.insert(call->GetIdentifier()->GetName());
+    }
+    return WriteFinder::LeaveExpr(expr);
+}
+
+/* Goes through the functions callees first, inlining into each the
+ * calls it makes that can be, and keeps what became of every call to a
+ * function of the program for the report.
+ */
+class Inliner : public TreeCopier {
+  public:
+    Inliner(Program *program, int most) : inlined(0), program(program), most(most) {}
+
+    void Run();
+    void Report();
+
+    int inlined;
+
+  protected:
+    string NameFor(VarDecl *var);
+
+  private:
+    // What is known of a function defined in the program
+    struct Callee {
+        Callee() : pure(true), recursive(false), cost(0) {}
+        bool pure, recursive;
+        int cost;                       // once inlined into
+        set<string> used;               // names it does not declare
+        set<VarDecl *> written;
+    };
+    // What became of a call to a function of the program
+    struct Site {
+        Site() : decided(false), inlined(false), cost(0) {}
+        bool decided, inlined;
+        int cost;
+        string reason;                  // if not inlined
+    };
+    // An expression a site is in, and the operand it is in
+    struct Frame {
+        Expr *expr;
+        int next;
+    };
+
+    Program *program;
+    int most;
+    map<FnDecl *, Callee> callees;
+    vector<FnDecl *> order;
+    map<Call *, Site> sites;
+    set<string> names;
+    map<string, int> suffixes;          // the last one given each name
+
+    // Of the function being gone through
+    set<string> locals;
+
+    void Analyze();
+    void FindRecursion(map<FnDecl *, vector<FnDecl *> > &calls);
+    void Learn(FnDecl *fn);
+    string Fresh(const char *base);
+
+    void Walk(Stmt **slot);
+    void WalkBlock(StmtBlock *block);
+    bool Statement(Stmt *stmt, StmtBlock *block, vector<Stmt *> *before);
+    void Leave(Stmt *stmt);
+    bool NextSite(Stmt *stmt, vector<Frame> *path);
+    string Decide(Stmt *stmt, const vector<Frame> &path);
+    bool HasEffects(Expr *expr, Expr *skip, const set<Expr *> &quiet);
+    bool Pure(Call *call);
+    bool Passed(Call *call, int i, bool effects);
+    bool Inline(Stmt *stmt, StmtBlock *block, const vector<Frame> &path,
+                vector<Stmt *> *before);
+};
+
+void Inliner::Run() {
+    DeclaredNames(program, &names);
+    Analyze();
+    for (size_t i = 0; i < order.size(); i++) {
+        FnDecl *fn = order[i];
+        int count = 0;
+        locals.clear();
+        Statements(fn->GetBody(), &count, &locals);
+        List<VarDecl*> *formals = fn->GetFormals();
+        for (int j = 0; j < formals->NumElements(); j++)
+            locals.insert(formals->Nth(j)->GetIdentifier()->GetName());
+        Stmt *body = fn->GetBody();
+        Walk(&body);
+        if (body != fn->GetBody()) fn->SetFunctionBody(body);
+        Learn(fn);
+    }
+}
+
+/* Learns which functions are pure, in the sense of cse.cc: neither they
+ * nor anything they call stores to a global or an out parameter, and
+ * they call only functions of the program. Finds the calls to report
+ * on, and the order to go through the functions in.
+ */
+void Inliner::Analyze() {
+    List<Decl*> *decls = program->GetDecls();
+    map<FnDecl *, vector<FnDecl *> > calls;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!fn || !fn->HasBody()) continue;
+        FunctionFacts facts;
+        facts.Gather(fn);
+        Callee &callee = callees[fn];
+        List<VarDecl*> *formals = fn->GetFormals();
+        for (int j = 0; j < formals->NumElements(); j++)
+            if (formals->Nth(j)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                callee.pure = false;
+        for (set<VarDecl *>::iterator it = facts.written.begin(); it != facts.written.end(); ++it)
+            if (IsGlobal(*it)) callee.pure = false;
+        for (size_t j = 0; j < facts.calls.size(); j++) {
+            FnDecl *target = facts.calls[j]->GetCallee();
+            if (!target || !target->HasBody()) callee.pure = false;
+            if (target && target->HasBody()) calls[fn].push_back(target);
+            if (target && dynamic_cast<Program *>(target->GetParent()))
+                sites[facts.calls[j]] = Site();
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        map<FnDecl *, vector<FnDecl *> >::iterator it;
+        for (it = calls.begin(); it != calls.end(); ++it) {
+            if (!callees[it->first].pure) continue;
+            for (size_t j = 0; j < it->second.size(); j++) {
+                if (callees[it->second[j]].pure) continue;
+                callees[it->first].pure = false;
+                changed = true;
+                break;
+            }
+        }
+    }
+    FindRecursion(calls);
+}
+
+/* Tarjan's algorithm, with an explicit stack, for the functions that
+ * are in a cycle of calls. A function is finished after those it calls
+ * but that are not in its cycle, which gives the order to go through
+ * them in.
+ */
+void Inliner::FindRecursion(map<FnDecl *, vector<FnDecl *> > &calls) {
+    struct Visit {
+        FnDecl *fn;
+        size_t next;    // the call to follow next
+    };
+    map<FnDecl *, int> index, low;
+    vector<FnDecl *> stack;
+    set<FnDecl *> onStack;
+    int counter = 0;
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *root = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!root || !root->HasBody() || index.count(root)) continue;
+        vector<Visit> visits;
+        Visit first = { root, 0 };
+        visits.push_back(first);
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack.insert(root);
+        while (!visits.empty()) {
+            Deadline::Poll();
+            FnDecl *fn = visits.back().fn;
+            vector<FnDecl *> &out = calls[fn];
+            if (visits.back().next < out.size()) {
+                FnDecl *next = out[visits.back().next++];
+                if (next == fn) {
+                    callees[fn].recursive = true;
+                } else if (!index.count(next)) {
+                    Visit visit = { next, 0 };
+                    visits.push_back(visit);
+                    index[next] = low[next] = counter++;
+                    stack.push_back(next);
+                    onStack.insert(next);
+                } else if (onStack.count(next)) {
+                    low[fn] = min(low[fn], index[next]);
+                }
+                continue;
+            }
+            visits.pop_back();
+            if (!visits.empty())
+                low[visits.back().fn] = min(low[visits.back().fn], low[fn]);
+            order.push_back(fn);
+            if (low[fn] != index[fn]) continue;
+            FnDecl *member;
+            bool cycle = stack.back() != fn;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack.erase(member);
+                if (cycle) callees[member].recursive = true;
+            } while (member != fn);
+        }
+    }
+}
+
+// What fn costs and uses once the calls in it have been inlined
+void Inliner::Learn(FnDecl *fn) {
+    Callee &callee = callees[fn];
+    FunctionFacts facts;
+    facts.Gather(fn);
+    set<string> declared;
+    int count = 0;
+    Statements(fn->GetBody(), &count, &declared);
+    List<VarDecl*> *formals = fn->GetFormals();
+    for (int i = 0; i < formals->NumElements(); i++)
+        declared.insert(formals->Nth(i)->GetIdentifier()->GetName());
+    callee.cost = count + facts.exprs;
+    callee.written = facts.written;
+    callee.used.clear();
+    for (set<string>::iterator it = facts.used.begin(); it != facts.used.end(); ++it)
+        if (!declared.count(*it)) callee.used.insert(*it);
+}
+
+/* Only the statements directly in a block can have others put before
+ * them, so any other statement a call could be inlined out of is put in
+ * a block of its own, which is taken away again if no call is.
+ */
+void Inliner::Walk(Stmt **slot) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL) return;
+    if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        WalkBlock(block);
+        return;
+    }
+    vector<Frame> path;
+    if (dynamic_cast<LoopStmt *>(stmt) || dynamic_cast<DeclStmt *>(stmt)
+        || dynamic_cast<SwitchLabel *>(stmt) || !NextSite(stmt, &path)) {
+        Leave(stmt);
+        Stmt **stmtSlot;
+        for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+            Walk(stmtSlot);
+        return;
+    }
+    List<Stmt*> *stmts = new List<Stmt*>;
+    stmts->Append(stmt);
+    StmtBlock *block = new StmtBlock(new List<VarDecl*>, stmts);
+    block->SetParent(stmt->GetParent());
+    *slot = block;
+    WalkBlock(block);
+    // Nor is it needed if all that is left is one inlined call
+    Stmt *only = stmts->NumElements() == 1 ? stmts->Nth(0) : NULL;
+    if (only == stmt || dynamic_cast<StmtBlock *>(only)) {
+        only->SetParent(block->GetParent());
+        *slot = only;
+    }
+}
+
+/* The statements of the block are put back all at once, since putting
+ * each inlined call in place among them would take as long as moving
+ * those after it.
+ */
+void Inliner::WalkBlock(StmtBlock *block) {
+    List<Stmt*> *stmts = block->GetStmts();
+    vector<Stmt *> kept;
+    bool changed = false;
+    for (int i = 0; i < stmts->NumElements(); i++) {
+        Stmt *stmt = stmts->Nth(i);
+        size_t from = kept.size();
+        bool stays = Statement(stmt, block, &kept);
+        if (kept.size() > from || !stays) changed = true;
+        if (!stays) continue;
+        kept.push_back(stmt);
+        if (dynamic_cast<Expr *>(stmt) || dynamic_cast<DeclStmt *>(stmt)) continue;
+        Stmt **stmtSlot;
+        for (int j = 0; (stmtSlot = stmt->StmtSlot(j)) != NULL; j++)
+            Walk(stmtSlot);
+    }
+    if (!changed) return;
+    while (stmts->NumElements() > 0)
+        stmts->RemoveAt(stmts->NumElements() - 1);
+    for (size_t i = 0; i < kept.size(); i++)
+        stmts->Append(kept[i]);
+}
+
+/* Inlines what can be of the calls in stmt, a statement of block,
+ * innermost first, adding what goes before it to before. Returns
+ * whether stmt is still wanted, rather than having been only a call.
+ */
+bool Inliner::Statement(Stmt *stmt, StmtBlock *block, vector<Stmt *> *before) {
+    vector<Frame> path;
+    while (NextSite(stmt, &path)) {
+        Call *call = dynamic_cast<Call *>(path.back().expr);
+        Site &site = sites[call];
+        site.decided = true;
+        site.reason = Decide(stmt, path);
+        if (!site.reason.empty()) continue;
+        site.inlined = true;
+        site.cost = callees[call->GetCallee()].cost;
+        inlined++;
+        if (!Inline(stmt, block, path, before)) return false;
+    }
+    return true;
+}
+
+// Decides the calls in a statement that nothing can be put before
+void Inliner::Leave(Stmt *stmt) {
+    vector<Frame> path;
+    while (NextSite(stmt, &path)) {
+        Site &site = sites[dynamic_cast<Call *>(path.back().expr)];
+        site.decided = true;
+        site.reason = Decide(stmt, path);
+        if (site.reason.empty())
+            site.reason = "nothing can be put before the statement it is in";
+    }
+}
+
+/* Finds the first call, with its operands before it, in the expressions
+ * of stmt that is still to be decided. path is left holding the
+ * expressions it is in from the outermost, and the call itself last.
+ */
+bool Inliner::NextSite(Stmt *stmt, vector<Frame> *path) {
+    vector<Expr *> roots;
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    VarDecl *var = declStmt ? dynamic_cast<VarDecl *>(declStmt->GetDecl()) : NULL;
+    if (dynamic_cast<Expr *>(stmt)) {
+        roots.push_back(dynamic_cast<Expr *>(stmt));
+    } else if (var && var->GetInitializer()) {
+        roots.push_back(var->GetInitializer());
+    } else if (!declStmt) {
+        Expr **exprSlot;
+        for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+            if (*exprSlot) roots.push_back(*exprSlot);
+    }
+    for (size_t i = 0; i < roots.size(); i++) {
+        path->clear();
+        Frame root = { roots[i], 0 };
+        path->push_back(root);
+        while (!path->empty()) {
+            Deadline::Poll();
+            Frame &top = path->back();
+            Expr **operand = top.expr->ExprSlot(top.next++);
+            if (operand) {
+                Frame next = { *operand, 0 };
+                if (*operand) path->push_back(next);
+                continue;
+            }
+            Call *call = dynamic_cast<Call *>(top.expr);
+            if (call && sites.count(call) && !sites[call].decided) return true;
+            path->pop_back();
+        }
+    }
+    return false;
+}
+
+/* Why the call on top of path, in stmt, cannot be inlined, or nothing
+ * if it can. A call is moved before the statement it is in, with its
+ * arguments, so it may have side effects only if it is the whole value
+ * of the statement, and the rest of the statement, the expressions it
+ * is in aside since they are made after it, may have none.
+ */
+string Inliner::Decide(Stmt *stmt, const vector<Frame> &path) {
+    Call *call = dynamic_cast<Call *>(path.back().expr);
+    FnDecl *fn = call->GetCallee();
+    if (!fn->HasBody()) return "it has no body";
+    Callee &callee = callees[fn];
+    if (callee.recursive) return "it is recursive";
+    bool declarable = Type::IndexOf(fn->GetType()) >= 0;
+    List<VarDecl*> *formals = fn->GetFormals();
+    for (int i = 0; i < formals->NumElements(); i++)
+        if (Type::IndexOf(formals->Nth(i)->GetType()) < 0) declarable = false;
+    if (!declarable) return "it takes or returns a value of a type that is not built in";
+    if (!ReturnsAtEnd(fn->GetBody(), true)) return "it returns before its end";
+    if (callee.cost > most) {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "it costs %d, more than %d", callee.cost, most);
+        return reason;
+    }
+    if (dynamic_cast<LoopStmt *>(stmt)) return "it is in the head of a loop";
+    for (set<string>::iterator it = callee.used.begin(); it != callee.used.end(); ++it)
+        if (locals.count(*it)) return "it uses '" + *it + "', which a local here hides";
+
+    set<Expr *> around;
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        Expr *expr = path[i].expr;
+        int slot = path[i].next - 1;
+        CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+        if (dynamic_cast<ConditionalExpr *>(expr) && slot > 0)
+            return "it is only made if a condition holds";
+        if (compound && slot == 1 && !AsStore(expr)
+            && (compound->GetOperator()->IsOp("&&") || compound->GetOperator()->IsOp("||")))
+            return "it is only made if a condition holds";
+        around.insert(expr);
+    }
+    if (HasEffects(path[0].expr, call, around))
+        return "the rest of the statement has side effects";
+    AssignExpr *store = path.size() == 2 && path[0].expr == stmt
+                        ? dynamic_cast<AssignExpr *>(stmt) : NULL;
+    bool whole = path.size() == 1
+                 || (store && store->GetOperator()->IsOp("=") && path[0].next - 1 == 1);
+    bool effects = !Pure(call);
+    set<Expr *> none;
+    for (int i = 0; i < call->GetActuals()->NumElements(); i++)
+        if (HasEffects(call->GetActuals()->Nth(i), NULL, none)) effects = true;
+    if (effects && !whole) return "it has side effects and is not all the statement does";
+    Type *type = fn->GetType();
+    bool alone = path.size() == 1 && path[0].expr == stmt;
+    if (!alone && type != Type::voidType
+        && !type->IsNumeric() && !type->IsVector() && !type->IsMatrix()) {
+        // The checker takes such a value in a declaration, not an assignment
+        List<Stmt*> *stmts = dynamic_cast<StmtBlock *>(fn->GetBody())->GetStmts();
+        bool simple = stmts->NumElements() == 1 && dynamic_cast<ReturnStmt *>(stmts->Nth(0));
+        for (int i = 0; simple && i < formals->NumElements(); i++)
+            simple = Passed(call, i, effects);
+        if (!simple) return "what it returns cannot be assigned, only given as an initializer";
+    }
+    if (effects && store) {
+        // Where the store goes must not be something the call changes
+        vector<Expr *> stack(1, store->GetLeft());
+        while (!stack.empty()) {
+            Expr *expr = stack.back();
+            stack.pop_back();
+            VarExpr *use = dynamic_cast<VarExpr *>(expr);
+            if (use && (!use->GetDecl() || IsGlobal(use->GetDecl())))
+                return "it may change where the statement stores to";
+            Expr **operand;
+            for (int i = 0; (operand = expr->ExprSlot(i)) != NULL; i++)
+                if (*operand) stack.push_back(*operand);
+        }
+    }
+    return "";
+}
+
+/* Whether expr stores anything or calls a function that is not pure,
+ * what is in skip aside and the expressions in quiet not counting.
+ */
+bool Inliner::HasEffects(Expr *expr, Expr *skip, const set<Expr *> &quiet) {
+    vector<Expr *> stack(1, expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *next = stack.back();
+        stack.pop_back();
+        if (next == skip) continue;
+        Call *call = dynamic_cast<Call *>(next);
+        if (!quiet.count(next) && (AsStore(next) || (call && !Pure(call)))) return true;
+        Expr **operand;
+        for (int i = 0; (operand = next->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    return false;
+}
+
+bool Inliner::Pure(Call *call) {
+    FnDecl *fn = call->GetCallee();
+    return fn && fn->HasBody() && callees[fn].pure;
+}
+
+/* Whether the ith argument of call can be used in place of the
+ * parameter, rather than held in a variable of its own, given whether
+ * any of the arguments has side effects.
+ */
+bool Inliner::Passed(Call *call, int i, bool effects) {
+    VarDecl *formal = call->GetCallee()->GetFormals()->Nth(i);
+    return formal->GetTypeQualifier() != TypeQualifier::outTypeQualifier && !effects
+           && !callees[call->GetCallee()].written.count(formal)
+           && Direct(call->GetActuals()->Nth(i));
+}
+
+/* Adds the call on top of path, in stmt, a statement of block, to what
+ * goes before stmt, and replaces it with its value. Returns whether
+ * stmt is still wanted, rather than having been only the call.
+ */
+bool Inliner::Inline(Stmt *stmt, StmtBlock *block, const vector<Frame> &path,
+                     vector<Stmt *> *before) {
+    Call *call = dynamic_cast<Call *>(path.back().expr);
+    FnDecl *fn = call->GetCallee();
+    yyltype loc = *call->GetLocation();
+    bool alone = path.size() == 1 && path[0].expr == stmt;
+    VarDecl *result = NULL;
+    if (!alone && fn->GetType() != Type::voidType) {
+        Identifier *name = new Identifier(loc, Fresh(fn->GetIdentifier()->GetName()).c_str());
+        result = new VarDecl(name, fn->GetType());
+    }
+    Assert(alone || result != NULL);
+
+    // Arguments with side effects are made in order, into variables
+    List<Expr*> *actuals = call->GetActuals();
+    bool effects = false;
+    set<Expr *> none;
+    for (int i = 0; i < actuals->NumElements(); i++)
+        if (HasEffects(actuals->Nth(i), NULL, none)) effects = true;
+    List<Stmt*> *body = new List<Stmt*>;
+    vector<pair<Expr *, VarDecl *> > outs;
+    List<VarDecl*> *formals = fn->GetFormals();
+    Clear();
+    for (int i = 0; i < formals->NumElements(); i++) {
+        VarDecl *formal = formals->Nth(i);
+        Expr *actual = actuals->Nth(i);
+        bool out = formal->GetTypeQualifier() == TypeQualifier::outTypeQualifier;
+        if (Passed(call, i, effects)) {
+            Substitute(formal, actual);
+            continue;
+        }
+        Identifier *name = new Identifier(loc, NameFor(formal).c_str());
+        VarDecl *param = new VarDecl(name, formal->GetType(), out ? NULL : actual);
+        body->Append(new DeclStmt(param));
+        Substitute(formal, new VarExpr(loc, param));
+        if (out) outs.push_back(make_pair(actual, param));
+    }
+    Stmt *copy = CopyStmt(fn->GetBody());
+    Clear();
+    StoreReturns(&copy, result);
+    StmtBlock *copied = dynamic_cast<StmtBlock *>(copy);
+    if (copied && copied->GetDecls()->NumElements() == 0) {
+        for (int i = 0; i < copied->GetStmts()->NumElements(); i++)
+            body->Append(copied->GetStmts()->Nth(i));
+    } else {
+        body->Append(copy);
+    }
+    for (size_t i = 0; i < outs.size(); i++) {
+        Expr *target = outs[i].first;
+        Expr *assign = new AssignExpr(target, new Operator(loc, "="), new VarExpr(loc, outs[i].second));
+        assign->SetType(target->GetType());
+        body->Append(assign);
+    }
+
+    // A body that only works out the value initializes the variable for it
+    AssignExpr *only = body->NumElements() == 1 ? dynamic_cast<AssignExpr *>(body->Nth(0)) : NULL;
+    VarExpr *stored = only ? dynamic_cast<VarExpr *>(only->GetLeft()) : NULL;
+    bool initialized = result && stored && stored->GetDecl() == result;
+    if (initialized) result->SetInitializer(only->GetRight());
+    if (result) {
+        DeclStmt *declStmt = new DeclStmt(result);
+        declStmt->SetParent(block);
+        before->push_back(declStmt);
+    }
+    if (!initialized) {
+        StmtBlock *inlinedBlock = new StmtBlock(new List<VarDecl*>, body);
+        inlinedBlock->SetParent(block);
+        before->push_back(inlinedBlock);
+    }
+    if (alone) return false;
+    Expr *value = new VarExpr(loc, result);
+    if (path.size() > 1) {
+        const Frame &parent = path[path.size() - 2];
+        *parent.expr->ExprSlot(parent.next - 1) = value;
+        value->SetParent(parent.expr);
+    } else if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt)) {
+        dynamic_cast<VarDecl *>(declStmt->GetDecl())->SetInitializer(value);
+    } else {
+        *stmt->ExprSlot(0) = value;
+        value->SetParent(stmt);
+    }
+    return true;
+}
+
+string Inliner::NameFor(VarDecl *var) {
+    return Fresh(var->GetIdentifier()->GetName());
+}
+
+string Inliner::Fresh(const char *base) {
+    int &suffix = suffixes[base];
+    char name[64];
+    do {
+        snprintf(name, sizeof(name), "%s_%d", base, ++suffix);
+    } while (names.count(name));
+    names.insert(name);
+    return name;
+}
+
+// The calls in the order they are in the source
+static bool Earlier(const pair<yyltype, string> &a, const pair<yyltype, string> &b) {
+    if (a.first.first_line != b.first.first_line) return a.first.first_line < b.first.first_line;
+    return a.first.first_column < b.first.first_column;
+}
+
+void Inliner::Report() {
+    vector<pair<yyltype, string> > lines;
+    for (map<Call *, Site>::iterator it = sites.begin(); it != sites.end(); ++it) {
+        Call *call = it->first;
+        const Site &site = it->second;
+        yyltype loc = {};
+        if (call->GetLocation()) loc = *call->GetLocation();
+        char line[128];
+        snprintf(line, sizeof(line), "glc: call to '%s' on line %d ",
+                 call->GetIdentifier()->GetName(), loc.first_line);
+        string text = line;
+        if (site.inlined) {
+            snprintf(line, sizeof(line), "inlined (cost %d)", site.cost);
+            text += line;
+        } else {
+            text += "not inlined: " + site.reason;
+        }
+        lines.push_back(make_pair(loc, text));
+    }
+    stable_sort(lines.begin(), lines.end(), Earlier);
+    for (size_t i = 0; i < lines.size(); i++)
+        fprintf(stderr, "%s\n", lines[i].second.c_str());
+    PrintDebug("stats", "inline: inlined %d of %d calls", inlined, (int)sites.size());
+}
+
+int InlineCalls(Program *program, int cost) {
+    Inliner inliner(program, cost);
+    inliner.Run();
+    inliner.Report();
+    return inliner.inlined;
+}
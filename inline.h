@@ -0,0 +1,65 @@
+/* File: inline.h
+ * --------------
+ * Inlining, for glc --inline[=cost]: puts in place of the calls to the
+ * small functions of a program that checked without errors the code of
+ * the function itself, before the program is written out (see glsl.h).
+ *
+ * A function can be inlined if it is defined in the program, does not
+ * call itself, directly or not, costs at most cost (default
+ * DefaultInlineCost), counting one for each statement and expression
+ * in its body, and returns only at its end: as the last statement of
+ * its body, or of the branches of an if that ends it. An if with no
+ * else whose body returns counts as having the statements after it for
+ * its else. Functions are inlined into those that call them after the
+ * calls they make have been, so that what is counted is the cost once
+ * they have.
+ *
+ * A call is inlined by putting before the statement it is in a variable
+ * for the value it returns, and a block holding a variable for each
+ * parameter, initialized with the argument for it, a copy of the body
+ * in which each return assigns the variable for the value, and the
+ * stores of out parameters back into their arguments (see copy.h). An
+ * argument that is a literal, or a local variable of the caller that
+ * the function does not store to, is used in place of the parameter
+ * instead, and a body that comes to no more than working out the value
+ * initializes its variable instead of going in a block. The call is
+ * then replaced by the variable for its value, or the statement removed
+ * if it was only the call. Since the checker only lets a bool or an
+ * integer vector be stored by a declaration, a function returning one
+ * is inlined only that way. Every variable the copy declares gets a
+ * name of its own that nothing in the program or the prelude declares,
+ * so that it hides nothing; a function that uses a global a local of
+ * the caller hides is not inlined there.
+ *
+ * Only the calls in statements that something can be put before are
+ * inlined: expression statements, declarations, returns, and the
+ * conditions of ifs and switches, not loop conditions or steps. The
+ * rest of the statement, what the call is part of aside, must have no
+ * side effects, nor may the call and its arguments unless the call is
+ * the whole statement, the right of an assignment, an initializer, the
+ * value returned or the condition. And the call must not be made only
+ * if a condition holds, in the right of an && or a || or a branch of a
+ * ?:.
+ *
+ * The pass says on stderr, for each call to a function of the program,
+ * whether it was inlined and if not why. The report is part of what
+ * --inline is for, so unlike the counts of the other passes it is not
+ * kept under the "stats" debug key; how many calls were inlined is.
+ */
+
+#ifndef _H_inline
+#define _H_inline
+
+class Program;
+
+// Functions that cost at most this much are inlined by --inline
+#define DefaultInlineCost 40
+
+/* Function: InlineCalls()
+ * -----------------------
+ * Inlines the calls of program in place to the functions that cost at
+ * most cost. Returns how many it inlined.
+ */
+int InlineCalls(Program *program, int cost);
+
+#endif
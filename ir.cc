@@ -0,0 +1,471 @@
+/* File: ir.cc
+ * -----------
+ * Implementation of the intermediate representation: printing it and
+ * checking it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include "ir.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+
+using namespace std;
+
+IrValue::IrValue(IrOp op, Type *type)
+    : op(op), type(type), id(-1), block(NULL), intValue(0), floatValue(0), name(NULL),
+      var(NULL), callee(NULL), replacement(NULL), complete(true) {}
+
+static const char *opNames[] = {
+    "const", "undef", "param", "phi",
+    "load", "store",
+    "neg", "add", "sub", "mul", "div", "matmul",
+    "lt", "le", "gt", "ge", "eq", "ne",
+    "extract", "insert", "index", "setindex",
+    "call", "outarg",
+    "jump", "branch", "switch", "ret"
+};
+
+static void PrintType(ostream &out, Type *type) {
+    ArrayType *array = dynamic_cast<ArrayType *>(type);
+    if (array)
+        out << array->GetElemType() << "[" << array->GetElemCount() << "]";
+    else
+        out << type;
+}
+
+// Whether the instruction has a value that can be used. A call to a void
+// function has one for the outargs that take its out parameters.
+static bool HasValue(IrValue *value) {
+    return (value->type != Type::voidType || value->op == IrCall)
+           && value->op != IrStore && !value->IsTerminator();
+}
+
+static void PrintOperand(ostream &out, IrValue *value) {
+    if (value->op == IrUndef) {
+        out << "undef";
+    } else if (value->op != IrConst) {
+        out << "%" << value->id;
+    } else if (value->type == Type::boolType) {
+        out << (value->intValue ? "true" : "false");
+    } else if (value->type == Type::floatType) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.9g", value->floatValue);
+        out << buf;
+        if (!strpbrk(buf, ".eEni")) out << ".0";   // not inf or nan either
+    } else {
+        out << value->intValue;
+    }
+}
+
+static void PrintInstr(ostream &out, IrValue *instr) {
+    out << "    ";
+    if (HasValue(instr)) out << "%" << instr->id << " = ";
+    out << opNames[instr->op];
+    if (HasValue(instr)) {
+        out << " ";
+        PrintType(out, instr->type);
+    }
+    const IrValues &ops = instr->operands;
+    switch (instr->op) {
+      case IrPhi:
+        for (int i = 0; i < ops.size(); i++) {
+            out << (i ? ", [" : " [");
+            PrintOperand(out, ops[i]);
+            out << ", b" << instr->block->preds[i]->id << "]";
+        }
+        break;
+      case IrLoad:
+        out << " @" << instr->var->GetIdentifier()->GetName();
+        break;
+      case IrStore:
+        out << " @" << instr->var->GetIdentifier()->GetName() << ", ";
+        PrintOperand(out, ops[0]);
+        break;
+      case IrExtract:
+      case IrInsert:
+        out << " ";
+        PrintOperand(out, ops[0]);
+        out << ", " << instr->name;
+        if (ops.size() > 1) {
+            out << ", ";
+            PrintOperand(out, ops[1]);
+        }
+        break;
+      case IrCall:
+        out << " " << instr->name << "(";
+        for (int i = 0; i < ops.size(); i++) {
+            if (i) out << ", ";
+            PrintOperand(out, ops[i]);
+        }
+        out << ")";
+        break;
+      case IrOutArg:
+        out << " ";
+        PrintOperand(out, ops[0]);
+        out << ", " << instr->intValue;
+        break;
+      case IrJump:
+        out << " b" << instr->targets[0]->id;
+        break;
+      case IrBranch:
+        out << " ";
+        PrintOperand(out, ops[0]);
+        out << ", b" << instr->targets[0]->id << ", b" << instr->targets[1]->id;
+        break;
+      case IrSwitch:
+        out << " ";
+        PrintOperand(out, ops[0]);
+        for (int i = 1; i < ops.size(); i++) {
+            out << ", ";
+            PrintOperand(out, ops[i]);
+            out << ": b" << instr->targets[i - 1]->id;
+        }
+        out << ", default: b" << instr->targets.back()->id;
+        break;
+      case IrReturn:
+        for (int i = 0; i < ops.size(); i++) {
+            out << (i ? ", " : " ");
+            if (i > 0 || !instr->intValue) out << "out ";
+            PrintOperand(out, ops[i]);
+        }
+        break;
+      default:
+        for (int i = 0; i < ops.size(); i++) {
+            out << (i ? ", " : " ");
+            PrintOperand(out, ops[i]);
+        }
+        break;
+    }
+    out << "\n";
+}
+
+static void PrintFunction(ostream &out, IrFunction *fn) {
+    int next = 0;
+    for (int i = 0; i < fn->params.size(); i++)
+        fn->params[i]->id = next++;
+    for (int i = 0; i < fn->blocks.size(); i++) {
+        IrBlock *block = fn->blocks[i];
+        for (int j = 0; j < block->phis.size(); j++)
+            block->phis[j]->id = next++;
+        for (int j = 0; j < block->instrs.size(); j++)
+            if (HasValue(block->instrs[j])) block->instrs[j]->id = next++;
+    }
+
+    out << "function ";
+    PrintType(out, fn->returnType);
+    if (!fn->decl) {
+        out << " <globals>()";
+    } else {
+        out << " " << fn->decl->GetIdentifier()->GetName() << "(";
+        List<VarDecl*> *formals = fn->decl->GetFormals();
+        int param = 0;
+        for (int i = 0; i < formals->NumElements(); i++) {
+            VarDecl *formal = formals->Nth(i);
+            if (i) out << ", ";
+            if (formal->GetTypeQualifier() == TypeQualifier::outTypeQualifier) {
+                out << "out ";
+                PrintType(out, formal->GetType());
+                out << " " << formal->GetIdentifier()->GetName();
+            } else {
+                PrintType(out, formal->GetType());
+                out << " %" << fn->params[param++]->id;
+            }
+        }
+        out << ")";
+    }
+    out << " {\n";
+    for (int i = 0; i < fn->blocks.size(); i++) {
+        IrBlock *block = fn->blocks[i];
+        out << "  b" << block->id;
+        for (int j = 0; j < block->preds.size(); j++)
+            out << (j ? ", b" : " (from b") << block->preds[j]->id;
+        out << (block->preds.empty() ? ":\n" : "):\n");
+        for (int j = 0; j < block->phis.size(); j++)
+            PrintInstr(out, block->phis[j]);
+        for (int j = 0; j < block->instrs.size(); j++)
+            PrintInstr(out, block->instrs[j]);
+    }
+    out << "}\n";
+}
+
+void DumpIr(IrProgram *program, ostream &out) {
+    for (int i = 0; i < program->globals.size(); i++) {
+        VarDecl *var = program->globals[i];
+        out << "global ";
+        if (var->GetTypeQualifier()) out << var->GetTypeQualifier()->GetName() << " ";
+        PrintType(out, var->GetType());
+        out << " @" << var->GetIdentifier()->GetName() << "\n";
+    }
+    for (int i = 0; i < program->functions.size(); i++) {
+        if (i || !program->globals.empty()) out << "\n";
+        PrintFunction(out, program->functions[i]);
+    }
+}
+
+/* Checks one function. Dominance is answered in constant time from the
+ * order in which a walk of the dominator tree enters and leaves each
+ * block, so checking takes time linear in the size of the function
+ * once the dominators are known.
+ */
+class Verifier {
+  public:
+    Verifier(IrFunction *fn) : fn(fn), ok(true) {}
+
+    bool Run();
+
+  private:
+    IrFunction *fn;
+    bool ok;
+    vector<int> index;                 // of each block in fn->blocks, by id
+    vector<int> idom;                  // by index
+    vector<int> enter, leave;          // of the walk of the dominator tree
+    vector<int> position;              // of each instruction in its block
+
+    void Fail(IrBlock *block, const char *what, IrValue *value = NULL);
+    bool Known(IrBlock *block);
+    void FindDominators();
+    bool Dominates(IrBlock *a, IrBlock *b);
+    void CheckOperand(IrValue *user, IrValue *operand, IrBlock *at, int pos);
+};
+
+void Verifier::Fail(IrBlock *block, const char *what, IrValue *value) {
+    ok = false;
+    cerr << "glc: bad IR in "
+         << (fn->decl ? fn->decl->GetIdentifier()->GetName() : "<globals>");
+    if (block) cerr << ", b" << block->id;
+    cerr << ": " << what;
+    if (value) cerr << " (" << opNames[value->op] << ")";
+    cerr << endl;
+}
+
+bool Verifier::Known(IrBlock *block) {
+    return block && block->id >= 0 && block->id < index.size() && index[block->id] >= 0
+           && fn->blocks[index[block->id]] == block;
+}
+
+// Cooper, Harvey and Kennedy's algorithm, over the blocks in reverse
+// postorder
+void Verifier::FindDominators() {
+    int n = fn->blocks.size();
+    vector<int> order, rpo(n, -1);
+    vector<pair<int, int> > stack;
+    vector<bool> seen(n, false);
+    stack.push_back(make_pair(0, 0));
+    seen[0] = true;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        IrValue *term = fn->blocks[b]->Terminator();
+        int next = stack.back().second++;
+        if (term && next < term->targets.size()) {
+            IrBlock *succ = term->targets[next];
+            if (Known(succ) && !seen[index[succ->id]]) {
+                seen[index[succ->id]] = true;
+                stack.push_back(make_pair(index[succ->id], 0));
+            }
+        } else {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    reverse(order.begin(), order.end());
+    for (int i = 0; i < order.size(); i++)
+        rpo[order[i]] = i;
+    for (int b = 0; b < n; b++)
+        if (!seen[b]) Fail(fn->blocks[b], "block cannot be reached");
+
+    idom.assign(n, -1);
+    idom[0] = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = 1; i < order.size(); i++) {
+            IrBlock *block = fn->blocks[order[i]];
+            int dom = -1;
+            for (int j = 0; j < block->preds.size(); j++) {
+                int p = Known(block->preds[j]) ? index[block->preds[j]->id] : -1;
+                if (p < 0 || idom[p] < 0) continue;
+                if (dom < 0) {
+                    dom = p;
+                    continue;
+                }
+                int a = p;
+                while (a != dom) {
+                    while (rpo[a] > rpo[dom]) a = idom[a];
+                    while (rpo[dom] > rpo[a]) dom = idom[dom];
+                }
+            }
+            if (dom >= 0 && idom[order[i]] != dom) {
+                idom[order[i]] = dom;
+                changed = true;
+            }
+        }
+    }
+
+    vector<vector<int> > children(n);
+    for (int b = 1; b < n; b++)
+        if (idom[b] >= 0) children[idom[b]].push_back(b);
+    enter.assign(n, -1);
+    leave.assign(n, -1);
+    int clock = 0;
+    stack.push_back(make_pair(0, 0));
+    enter[0] = clock++;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        int next = stack.back().second++;
+        if (next < children[b].size()) {
+            enter[children[b][next]] = clock++;
+            stack.push_back(make_pair(children[b][next], 0));
+        } else {
+            leave[b] = clock++;
+            stack.pop_back();
+        }
+    }
+}
+
+bool Verifier::Dominates(IrBlock *a, IrBlock *b) {
+    int ia = index[a->id], ib = index[b->id];
+    return enter[ia] >= 0 && enter[ib] >= 0 && enter[ia] <= enter[ib] && leave[ib] <= leave[ia];
+}
+
+// at is the block the operand is used in, and pos the position of the
+// use there (a phi's operand is used at the end of a pred)
+void Verifier::CheckOperand(IrValue *user, IrValue *operand, IrBlock *at, int pos) {
+    if (operand == NULL) {
+        Fail(user->block, "missing operand", user);
+        return;
+    }
+    if (operand->replacement) Fail(user->block, "operand is a phi that was removed", user);
+    if (operand->op == IrParam) {
+        if (operand->intValue >= fn->params.size() || fn->params[operand->intValue] != operand)
+            Fail(user->block, "parameter of another function", user);
+        return;
+    }
+    if (operand->block == NULL) return;   // a constant or undef
+    if (!Known(operand->block)) {
+        Fail(user->block, "operand defined outside the function", user);
+    } else if (!HasValue(operand)) {
+        Fail(user->block, "operand has no value", user);
+    } else if (operand->block == at) {
+        if (operand->op != IrPhi && position[operand->id] >= pos)
+            Fail(user->block, "operand used before it is defined", user);
+    } else if (!Dominates(operand->block, at)) {
+        Fail(user->block, "operand does not dominate its use", user);
+    }
+}
+
+bool Verifier::Run() {
+    int n = fn->blocks.size();
+    if (n == 0) {
+        Fail(NULL, "no blocks");
+        return false;
+    }
+    // Instructions are numbered here for position, not for printing
+    int maxId = 0;
+    for (int b = 0; b < n; b++)
+        maxId = max(maxId, fn->blocks[b]->id + 1);
+    index.assign(maxId, -1);
+    for (int b = 0; b < n; b++) {
+        if (fn->blocks[b]->id < 0 || index[fn->blocks[b]->id] >= 0) {
+            Fail(fn->blocks[b], "block number used twice");
+            return false;
+        }
+        index[fn->blocks[b]->id] = b;
+    }
+    int count = 0;
+    for (int b = 0; b < n; b++) {
+        IrBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->phis.size(); i++) {
+            block->phis[i]->id = count++;
+            position.push_back(-1);
+        }
+        for (int i = 0; i < block->instrs.size(); i++) {
+            block->instrs[i]->id = count++;
+            position.push_back(i);
+        }
+    }
+
+    if (!fn->blocks[0]->preds.empty()) Fail(fn->blocks[0], "entry block has preds");
+    vector<vector<IrBlock *> > incoming(n);
+    for (int b = 0; b < n; b++) {
+        IrBlock *block = fn->blocks[b];
+        IrValue *term = block->Terminator();
+        if (!term) {
+            Fail(block, "block does not end in a terminator");
+            continue;
+        }
+        for (int i = 0; i < term->targets.size(); i++) {
+            if (Known(term->targets[i]))
+                incoming[index[term->targets[i]->id]].push_back(block);
+            else
+                Fail(block, "branch to a block outside the function", term);
+        }
+    }
+    for (int b = 0; b < n; b++) {
+        IrBlocks &preds = fn->blocks[b]->preds;
+        vector<IrBlock *> listed(preds.begin(), preds.end());
+        sort(listed.begin(), listed.end());
+        sort(incoming[b].begin(), incoming[b].end());
+        if (listed != incoming[b]) Fail(fn->blocks[b], "preds are not the blocks that branch here");
+    }
+    if (!ok) return false;   // dominators need the edges right
+
+    FindDominators();
+    for (int b = 0; b < n; b++) {
+        IrBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->phis.size(); i++) {
+            IrValue *phi = block->phis[i];
+            if (phi->op != IrPhi || phi->block != block) Fail(block, "not a phi of this block", phi);
+            if (phi->operands.size() != block->preds.size()) {
+                Fail(block, "phi operands do not match the preds", phi);
+                continue;
+            }
+            for (int j = 0; j < phi->operands.size(); j++) {
+                IrValue *operand = phi->operands[j];
+                IrBlock *pred = block->preds[j];
+                CheckOperand(phi, operand, pred, pred->instrs.size());
+                if (operand && operand->type != phi->type) Fail(block, "phi operand of another type", phi);
+            }
+        }
+        for (int i = 0; i < block->instrs.size(); i++) {
+            IrValue *instr = block->instrs[i];
+            if (instr->block != block) Fail(block, "instruction of another block", instr);
+            if (instr->op == IrPhi || instr->op == IrConst || instr->op == IrUndef
+                || instr->op == IrParam)
+                Fail(block, "instruction out of place", instr);
+            if (instr->IsTerminator() && i != block->instrs.size() - 1)
+                Fail(block, "terminator before the end of the block", instr);
+            if (HasValue(instr) && instr->type == NULL) Fail(block, "value has no type", instr);
+            for (int j = 0; j < instr->operands.size(); j++)
+                CheckOperand(instr, instr->operands[j], block, i);
+            if (!ok) continue;
+            switch (instr->op) {
+              case IrBranch:
+                if (instr->operands[0]->type != Type::boolType)
+                    Fail(block, "branch on a value that is not a bool", instr);
+                break;
+              case IrStore:
+                if (instr->operands[0]->type != instr->var->GetType())
+                    Fail(block, "stored value of another type", instr);
+                break;
+              case IrReturn:
+                if (instr->intValue && instr->operands[0]->type != fn->returnType)
+                    Fail(block, "returned value of another type", instr);
+                break;
+              default:
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+bool VerifyIr(IrProgram *program) {
+    bool ok = true;
+    for (int i = 0; i < program->functions.size(); i++) {
+        Verifier verifier(program->functions[i]);
+        if (!verifier.Run()) ok = false;
+    }
+    return ok;
+}
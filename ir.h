@@ -0,0 +1,136 @@
+/* File: ir.h
+ * ----------
+ * An intermediate representation of a checked program, for the passes
+ * that need to know where values come from rather than how the source
+ * spelled them. glc --dump-ir prints it (see lower.h for how it is
+ * built from the tree).
+ *
+ * Each function is a list of basic blocks in SSA form: every value is
+ * computed by exactly one instruction, and where control flow joins,
+ * a phi at the top of the block picks the value that came in along each
+ * predecessor. Values are typed with the types of the tree, vectors and
+ * matrices included: arithmetic works on them componentwise, except for
+ * matmul, and whole vectors, matrices and arrays are values too, taken
+ * apart by extract (a swizzle) and index, and put back together by
+ * insert and setindex. Parameters and local variables become values;
+ * global variables stay in memory, read by load and written by store.
+ * An out parameter is handed back by ret, and outarg takes it from the
+ * call on the caller's side.
+ *
+ * Constants, undefined values and parameters belong to no block, and
+ * are printed in place where they are used. Everything is allocated in
+ * the AST arena, and lives as long as the tree does.
+ */
+
+#ifndef _H_ir
+#define _H_ir
+
+#include <iostream>
+#include <vector>
+#include "arena.h"
+
+class Type;
+class VarDecl;
+class FnDecl;
+class IrBlock;
+
+enum IrOp {
+    IrConst, IrUndef, IrParam, IrPhi,
+    IrLoad, IrStore,
+    IrNeg, IrAdd, IrSub, IrMul, IrDiv, IrMatMul,
+    IrLess, IrLessEqual, IrGreater, IrGreaterEqual, IrEqual, IrNotEqual,
+    IrExtract, IrInsert, IrIndex, IrSetIndex,
+    IrCall, IrOutArg,
+    IrJump, IrBranch, IrSwitch, IrReturn
+};
+
+class IrValue;
+typedef std::vector<IrValue *, ArenaAllocator<IrValue *> > IrValues;
+typedef std::vector<IrBlock *, ArenaAllocator<IrBlock *> > IrBlocks;
+
+class IrValue {
+  public:
+    IrOp op;
+    Type *type;              // voidType for a store, a jump and the like
+    int id;                  // numbered for printing
+    IrBlock *block;          // NULL for a constant, undef or parameter
+    IrValues operands;       // a phi's in the order of its block's preds
+    IrBlocks targets;        // of a jump, branch or switch (default last)
+
+    int intValue;            // of an int, uint or bool constant; the
+                             // number of a parameter or of an outarg's
+                             // out parameter; whether ret has a value
+    double floatValue;
+    const char *name;        // a swizzle, or the name of a callee
+    VarDecl *var;            // loaded or stored
+    FnDecl *callee;          // NULL if not in the program
+
+    // Set while building a phi
+    IrValue *replacement;    // the value a trivial phi stands for
+    IrValues phiUsers;
+    bool complete;
+
+    IrValue(IrOp op, Type *type);
+
+    void *operator new(size_t size) { return AstArena().Allocate(size); }
+    void operator delete(void *) {}
+
+    bool IsTerminator() const { return op >= IrJump; }
+};
+
+class IrBlock {
+  public:
+    int id;
+    IrBlocks preds;
+    IrValues phis;
+    IrValues instrs;         // a terminator last
+    bool sealed;             // all preds known
+
+    IrBlock(int id) : id(id), sealed(false) {}
+
+    void *operator new(size_t size) { return AstArena().Allocate(size); }
+    void operator delete(void *) {}
+
+    IrValue *Terminator() const
+        { return instrs.empty() || !instrs.back()->IsTerminator() ? NULL : instrs.back(); }
+};
+
+class IrFunction {
+  public:
+    FnDecl *decl;            // NULL for the initializers of globals
+    Type *returnType;
+    IrValues params;         // of the parameters that are not out
+    IrBlocks blocks;         // the entry first
+
+    IrFunction(FnDecl *decl, Type *returnType) : decl(decl), returnType(returnType) {}
+
+    void *operator new(size_t size) { return AstArena().Allocate(size); }
+    void operator delete(void *) {}
+};
+
+class IrProgram {
+  public:
+    std::vector<VarDecl *, ArenaAllocator<VarDecl *> > globals;
+    std::vector<IrFunction *, ArenaAllocator<IrFunction *> > functions;
+
+    void *operator new(size_t size) { return AstArena().Allocate(size); }
+    void operator delete(void *) {}
+};
+
+/* Function: DumpIr()
+ * ------------------
+ * Prints program to out, numbering its values and blocks as it goes.
+ */
+void DumpIr(IrProgram *program, std::ostream &out);
+
+/* Function: VerifyIr()
+ * --------------------
+ * Checks that program is well formed: each block ends in a single
+ * terminator, the preds of each block are the blocks that branch to it,
+ * each phi has one operand per pred, and each value is defined in a
+ * block that dominates its uses. Says what is wrong on stderr and
+ * returns false if anything is.
+ */
+bool VerifyIr(IrProgram *program);
+
+#endif
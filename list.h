@@ -30,6 +30,7 @@
 
 #include <deque>
 #include "utility.h"  // for Assert()
+#include "arena.h"
 using namespace std;
 
 class Node;
@@ -37,12 +38,16 @@ class Node;
 template<class Element> class List {
 
  private:
-    deque<Element> elems;
+    deque<Element, ArenaAllocator<Element> > elems;
 
  public:
            // Create a new empty list
     List() {}
 
+           // Lists live in the AST arena along with the nodes they hold
+    void *operator new(size_t size) { return AstArena().Allocate(size); }
+    void operator delete(void *) {}
+
            // Returns count of elements currently in list
     int NumElements() const
 	{ return elems.size(); }
@@ -50,6 +55,12 @@ template<class Element> class List {
           // Returns element at index in list. Indexing is 0-based.
           // Raises an assert if index is out of range.
     Element Nth(int index) const
+	{ Assert(index >= 0 && index < NumElements());
+	  return elems[index]; }
+
+          // Returns the element at index itself, so that it can be
+          // replaced in place. Raises an assert if index is out of range.
+    Element &NthRef(int index)
 	{ Assert(index >= 0 && index < NumElements());
 	  return elems[index]; }
 
@@ -55,5 +55,38 @@ inline yyltype Join(yyltype *firstPtr, yyltype *lastPtr)
 }
 
 
+/* Function: FindTokens
+ * --------------------
+ * Given the locations of count consecutive tokens, finds the ones that
+ * loc starts and ends at. Returns false if loc does not line up with
+ * token boundaries.
+ * Used to record an error's position in a form that survives changes to
+ * the whitespace around it.
+ */
+inline bool FindTokens(const yyltype *tokens, int count, const yyltype &loc,
+                       int *start, int *end)
+{
+  int lo = 0, hi = count;   // first token not before loc
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (tokens[mid].first_line < loc.first_line ||
+        (tokens[mid].first_line == loc.first_line &&
+         tokens[mid].first_column < loc.first_column))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == count || tokens[lo].first_line != loc.first_line ||
+      tokens[lo].first_column != loc.first_column)
+    return false;
+  *start = lo;
+  *end = -1;
+  for (int i = lo; i < count && *end < 0 && tokens[i].first_line <= loc.last_line; i++)
+    if (tokens[i].first_line == loc.last_line && tokens[i].last_column == loc.last_column)
+      *end = i;
+  return *end >= 0;
+}
+
+
 #endif
 
@@ -0,0 +1,1121 @@
+/* File: lower.cc
+ * --------------
+ * Implementation of lowering a checked program to SSA form.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lower.h"
+#include "ir.h"
+#include "symtable.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+
+using namespace std;
+
+// The type of the components of a vector or matrix, or the type itself
+static Type *ComponentType(Type *type) {
+    if (type == Type::vec2Type || type == Type::vec3Type || type == Type::vec4Type
+        || type->IsMatrix())
+        return Type::floatType;
+    if (type == Type::ivec2Type || type == Type::ivec3Type || type == Type::ivec4Type)
+        return Type::intType;
+    if (type == Type::bvec2Type || type == Type::bvec3Type || type == Type::bvec4Type)
+        return Type::boolType;
+    if (type == Type::uvec2Type || type == Type::uvec3Type || type == Type::uvec4Type)
+        return Type::uintType;
+    return type;
+}
+
+// The components of a vector, the columns of a matrix, 1 for a scalar
+static int Components(Type *type) {
+    Type *twos[] = { Type::vec2Type, Type::ivec2Type, Type::bvec2Type, Type::uvec2Type, Type::mat2Type };
+    Type *threes[] = { Type::vec3Type, Type::ivec3Type, Type::bvec3Type, Type::uvec3Type, Type::mat3Type };
+    Type *fours[] = { Type::vec4Type, Type::ivec4Type, Type::bvec4Type, Type::uvec4Type, Type::mat4Type };
+    for (int i = 0; i < 5; i++) {
+        if (type == twos[i]) return 2;
+        if (type == threes[i]) return 3;
+        if (type == fours[i]) return 4;
+    }
+    return 1;
+}
+
+static Type *VectorOf(Type *component, int n) {
+    if (n < 2 || n > 4) return component;
+    if (component == Type::floatType)
+        return n == 2 ? Type::vec2Type : n == 3 ? Type::vec3Type : Type::vec4Type;
+    if (component == Type::intType)
+        return n == 2 ? Type::ivec2Type : n == 3 ? Type::ivec3Type : Type::ivec4Type;
+    if (component == Type::boolType)
+        return n == 2 ? Type::bvec2Type : n == 3 ? Type::bvec3Type : Type::bvec4Type;
+    if (component == Type::uintType)
+        return n == 2 ? Type::uvec2Type : n == 3 ? Type::uvec3Type : Type::uvec4Type;
+    return Type::errorType;
+}
+
+// An element of an array, a column of a matrix, a component of a vector
+static Type *ElementType(Type *type) {
+    ArrayType *array = dynamic_cast<ArrayType *>(type);
+    if (array) return array->GetElemType();
+    if (type->IsMatrix()) return VectorOf(Type::floatType, Components(type));
+    return ComponentType(type);
+}
+
+static bool IsScalar(Type *type) {
+    return Components(type) == 1 && !dynamic_cast<ArrayType *>(type);
+}
+
+static Type *ResultType(IrOp op, Type *left, Type *right) {
+    if (op >= IrLess && op <= IrNotEqual) return Type::boolType;
+    if (op == IrMatMul && !(left->IsMatrix() && right->IsMatrix()))
+        return left->IsMatrix() ? right : left;   // a vector either way
+    return IsScalar(left) ? right : left;
+}
+
+static bool IsOut(VarDecl *formal) {
+    return formal->GetTypeQualifier() == TypeQualifier::outTypeQualifier;
+}
+
+// Whether the ith argument is for an out parameter of a function with
+// formals (NULL if the function is not known)
+static bool IsOutArg(List<VarDecl*> *formals, int i) {
+    return formals && i < formals->NumElements() && IsOut(formals->Nth(i));
+}
+
+class Lowerer {
+  public:
+    Lowerer(Program *program);
+
+    IrProgram *Run();
+
+  private:
+    // An expression being lowered, and how far along it is
+    struct Frame {
+        Expr *expr;
+        int step;
+        IrBlock *a, *b;
+        IrValue *v;
+    };
+    // A block being looked through for the value of a variable
+    struct ReadFrame {
+        IrBlock *block;
+        IrValue *phi;          // NULL if the block has a single pred
+        int next;              // pred
+    };
+    struct Targets {
+        IrBlock *breakTo, *continueTo;   // continueTo NULL for a switch
+    };
+
+    List<Decl*> *decls;
+    IrProgram *ir;
+    IrFunction *fn;
+    IrBlock *current;
+    int nextBlock;
+    SymbolTable table;
+    unordered_map<Decl *, int> locals;          // numbered, for the current function
+    vector<Type *> localTypes;
+    vector<VarDecl *> outs;                     // out parameters
+    unordered_map<long long, IrValue *> defs;   // by block and local
+    unordered_map<IrBlock *, vector<pair<int, IrValue *> > > incomplete;   // phis
+    vector<Targets> targets;
+    vector<Frame> frames;
+    vector<IrValue *> values;                   // of the expressions lowered
+    vector<ReadFrame> reads;
+    vector<IrValue *> trivial;
+    vector<Expr *> path;                        // of the lvalue being written
+    vector<IrValue *> levels;
+    IrFunction *init;                           // of the globals
+    IrBlock *initBlock;
+
+    void LowerGlobal(VarDecl *var);
+    void LowerFunction(FnDecl *decl);
+    void Finish(IrFunction *function);
+
+    void LowerStmt(Stmt *stmt);
+    void LowerLocal(VarDecl *var);
+    void LowerIf(IfStmt *stmt);
+    void LowerWhile(WhileStmt *stmt);
+    void LowerFor(ForStmt *stmt);
+    void LowerSwitch(SwitchStmt *stmt);
+    void Return(IrValue *value);
+
+    IrValue *LowerExpr(Expr *expr);
+    void Step();
+    void StepCompound(CompoundExpr *expr, int step);
+    void StepUpdate(CompoundExpr *expr, int step);
+    void StepShortCircuit(CompoundExpr *expr, int step);
+    void StepConditional(ConditionalExpr *expr, int step);
+    void StepCall(Call *call, int step);
+    void Push(Expr *expr);
+    void Done(IrValue *value);
+    IrValue *Pop();
+
+    VarDecl *Variable(Identifier *id);
+    FnDecl *Function(Call *call);
+    VarDecl *PathOf(Expr *lvalue);
+    int Subscripts();
+    void PushSubscripts();
+    void Store(VarDecl *var, IrValue **indices, const string &update, IrValue *value,
+               IrValue **oldValue, IrValue **newValue);
+
+    IrBlock *NewBlock();
+    void Seal(IrBlock *block);
+    void Unreachable();
+    IrValue *Emit(IrOp op, Type *type);
+    IrValue *Constant(Type *type, int intValue, double floatValue);
+    IrValue *Undef(Type *type);
+    void Jump(IrBlock *to);
+    void Branch(IrValue *cond, IrBlock *ifTrue, IrBlock *ifFalse);
+    IrValue *Binary(const string &op, IrValue *left, IrValue *right);
+    IrValue *Access(IrValue *whole, Expr *step, IrValue *index);
+    IrValue *Put(IrValue *whole, Expr *step, IrValue *index, IrValue *part);
+
+    void DeclareLocal(VarDecl *var);
+    IrValue *ReadVar(VarDecl *var);
+    void WriteVar(VarDecl *var, IrValue *value);
+    IrValue *ReadLocal(int var, IrBlock *block);
+    IrValue *Lookup(int var, IrBlock *block);
+    void WriteLocal(int var, IrBlock *block, IrValue *value)
+        { defs[((long long)block->id << 32) | var] = value; }
+    IrValue *NewPhi(IrBlock *block, Type *type);
+    void AddOperand(IrValue *phi, IrValue *value);
+    IrValue *Merge(IrBlock *join, IrBlock *from, IrValue *value, IrValue *otherwise);
+    IrValue *TryRemoveTrivial(IrValue *phi);
+};
+
+static IrValue *Resolve(IrValue *value) {
+    IrValue *end = value;
+    while (end->replacement) end = end->replacement;
+    while (value->replacement && value->replacement != end) {
+        IrValue *next = value->replacement;
+        value->replacement = end;
+        value = next;
+    }
+    return end;
+}
+
+Lowerer::Lowerer(Program *program)
+    : decls(program->GetDecls()), ir(NULL), fn(NULL), current(NULL), nextBlock(0),
+      init(NULL), initBlock(NULL) {}
+
+IrProgram *Lowerer::Run() {
+    ir = new IrProgram;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *decl = decls->Nth(i);
+        if (VarDecl *var = dynamic_cast<VarDecl *>(decl))
+            LowerGlobal(var);
+        else if (FnDecl *function = dynamic_cast<FnDecl *>(decl))
+            LowerFunction(function);
+    }
+    if (init) {
+        fn = init;
+        current = initBlock;
+        Return(NULL);
+        Finish(init);
+        ir->functions.insert(ir->functions.begin(), init);
+    }
+    return ir;
+}
+
+// Declared before its initializer is lowered, as the checker does
+void Lowerer::LowerGlobal(VarDecl *var) {
+    ir->globals.push_back(var);
+    Symbol sym(var->GetIdentifier()->GetName(), var, E_VarDecl);
+    table.insert(sym);
+    if (!var->GetInitializer()) return;
+    if (!init) {
+        fn = init = new IrFunction(NULL, Type::voidType);
+        current = NewBlock();
+        Seal(current);
+    } else {
+        fn = init;
+        current = initBlock;
+    }
+    WriteVar(var, LowerExpr(var->GetInitializer()));
+    initBlock = current;
+    fn = NULL;
+}
+
+void Lowerer::LowerFunction(FnDecl *decl) {
+    Symbol sym(decl->GetIdentifier()->GetName(), decl, E_FunctionDecl);
+    table.insert(sym);
+    if (!decl->GetBody()) return;
+    fn = new IrFunction(decl, decl->GetType());
+    locals.clear();
+    localTypes.clear();
+    outs.clear();
+    defs.clear();
+    current = NewBlock();
+    Seal(current);
+    table.push();
+    List<VarDecl*> *formals = decl->GetFormals();
+    for (int i = 0; i < formals->NumElements(); i++) {
+        VarDecl *formal = formals->Nth(i);
+        DeclareLocal(formal);
+        if (IsOut(formal)) {
+            outs.push_back(formal);   // undefined until written
+        } else {
+            IrValue *param = new IrValue(IrParam, formal->GetType());
+            param->intValue = fn->params.size();
+            param->var = formal;
+            fn->params.push_back(param);
+            WriteVar(formal, param);
+        }
+    }
+    LowerStmt(decl->GetBody());
+    Return(NULL);
+    table.pop();
+    Finish(fn);
+    ir->functions.push_back(fn);
+    locals.clear();
+    outs.clear();
+    fn = NULL;
+}
+
+/* Drops the blocks that cannot be reached, and the phi operands that
+ * came from them, then puts in the value each removed phi stands for.
+ * Block numbers are done with by now, so a block's is -1 until it is
+ * reached, and the blocks are numbered afresh at the end.
+ */
+void Lowerer::Finish(IrFunction *function) {
+    IrBlocks &blocks = function->blocks;
+    for (int b = 0; b < blocks.size(); b++)
+        blocks[b]->id = -1;
+    vector<IrBlock *> work(1, blocks[0]);
+    blocks[0]->id = 0;
+    while (!work.empty()) {
+        Deadline::Poll();
+        IrBlock *block = work.back();
+        work.pop_back();
+        IrValue *term = block->Terminator();
+        for (int i = 0; term && i < term->targets.size(); i++) {
+            if (term->targets[i]->id == 0) continue;
+            term->targets[i]->id = 0;
+            work.push_back(term->targets[i]);
+        }
+    }
+
+    int kept = 0;
+    vector<IrValue *> pruned;
+    vector<bool> keep;
+    for (int b = 0; b < blocks.size(); b++) {
+        IrBlock *block = blocks[b];
+        if (block->id < 0) continue;
+        blocks[kept++] = block;
+        bool lost = false;
+        for (int i = 0; i < block->preds.size(); i++)
+            lost = lost || block->preds[i]->id < 0;
+        if (!lost) continue;
+        keep.clear();
+        for (int i = 0; i < block->preds.size(); i++)
+            keep.push_back(block->preds[i]->id == 0);
+        int n = 0;
+        for (int i = 0; i < block->preds.size(); i++)
+            if (keep[i]) block->preds[n++] = block->preds[i];
+        block->preds.resize(n);
+        for (int j = 0; j < block->phis.size(); j++) {
+            IrValue *phi = block->phis[j];
+            n = 0;
+            for (int i = 0; i < phi->operands.size(); i++)
+                if (keep[i]) phi->operands[n++] = phi->operands[i];
+            phi->operands.resize(n);
+            pruned.push_back(phi);
+        }
+    }
+    blocks.resize(kept);
+    for (int i = 0; i < pruned.size(); i++)
+        TryRemoveTrivial(pruned[i]);
+
+    for (int b = 0; b < blocks.size(); b++) {
+        IrBlock *block = blocks[b];
+        block->id = b;
+        int n = 0;
+        for (int j = 0; j < block->phis.size(); j++) {
+            IrValue *phi = block->phis[j];
+            if (phi->replacement) continue;
+            for (int i = 0; i < phi->operands.size(); i++)
+                phi->operands[i] = Resolve(phi->operands[i]);
+            IrValues().swap(phi->phiUsers);
+            block->phis[n++] = phi;
+        }
+        block->phis.resize(n);
+        for (int j = 0; j < block->instrs.size(); j++) {
+            IrValues &operands = block->instrs[j]->operands;
+            for (int i = 0; i < operands.size(); i++)
+                operands[i] = Resolve(operands[i]);
+        }
+    }
+}
+
+/* Each statement is lowered into the current block, and leaves current
+ * at the block that control reaches after it.
+ */
+void Lowerer::LowerStmt(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    if (Expr *expr = dynamic_cast<Expr *>(stmt)) {
+        LowerExpr(expr);
+    } else if (DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt)) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var) LowerLocal(var);
+    } else if (StmtBlock *block = dynamic_cast<StmtBlock *>(stmt)) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            LowerLocal(block->GetDecls()->Nth(i));
+        Stmt **slot;
+        for (int i = 0; (slot = block->StmtSlot(i)) != NULL; i++)
+            LowerStmt(*slot);
+    } else if (IfStmt *ifStmt = dynamic_cast<IfStmt *>(stmt)) {
+        LowerIf(ifStmt);
+    } else if (ForStmt *forStmt = dynamic_cast<ForStmt *>(stmt)) {
+        LowerFor(forStmt);
+    } else if (WhileStmt *whileStmt = dynamic_cast<WhileStmt *>(stmt)) {
+        LowerWhile(whileStmt);
+    } else if (SwitchStmt *switchStmt = dynamic_cast<SwitchStmt *>(stmt)) {
+        LowerSwitch(switchStmt);
+    } else if (SwitchLabel *label = dynamic_cast<SwitchLabel *>(stmt)) {
+        LowerStmt(*label->StmtSlot(0));   // out of place; the checker says so
+    } else if (dynamic_cast<BreakStmt *>(stmt)) {
+        if (!targets.empty()) Jump(targets.back().breakTo);
+        Unreachable();
+    } else if (dynamic_cast<ContinueStmt *>(stmt)) {
+        for (int i = targets.size() - 1; i >= 0; i--) {
+            if (targets[i].continueTo) {
+                Jump(targets[i].continueTo);
+                break;
+            }
+        }
+        Unreachable();
+    } else if (ReturnStmt *ret = dynamic_cast<ReturnStmt *>(stmt)) {
+        Expr *expr = *ret->ExprSlot(0);
+        Return(expr ? LowerExpr(expr) : NULL);
+    }
+}
+
+void Lowerer::LowerLocal(VarDecl *var) {
+    DeclareLocal(var);
+    Expr *init = var->GetInitializer();
+    WriteVar(var, init ? LowerExpr(init) : Undef(var->GetType()));
+}
+
+void Lowerer::LowerIf(IfStmt *stmt) {
+    IrValue *cond = LowerExpr(*stmt->ExprSlot(0));
+    Stmt *elseBody = *stmt->StmtSlot(1);
+    IrBlock *then = NewBlock();
+    IrBlock *other = elseBody ? NewBlock() : NULL;
+    IrBlock *join = NewBlock();
+    Branch(cond, then, other ? other : join);
+    Seal(then);
+    current = then;
+    table.push();
+    LowerStmt(*stmt->StmtSlot(0));
+    table.pop();
+    Jump(join);
+    if (other) {
+        Seal(other);
+        current = other;
+        table.push();
+        LowerStmt(elseBody);
+        table.pop();
+        Jump(join);
+    }
+    Seal(join);
+    current = join;
+}
+
+// The header is sealed only once the body has branched back to it
+void Lowerer::LowerWhile(WhileStmt *stmt) {
+    IrBlock *header = NewBlock();
+    Jump(header);
+    current = header;
+    IrValue *cond = LowerExpr(*stmt->ExprSlot(0));
+    IrBlock *body = NewBlock(), *exit = NewBlock();
+    Branch(cond, body, exit);
+    Seal(body);
+    Targets loop = { exit, header };
+    targets.push_back(loop);
+    current = body;
+    table.push();
+    LowerStmt(*stmt->StmtSlot(0));
+    table.pop();
+    Jump(header);
+    targets.pop_back();
+    Seal(header);
+    Seal(exit);
+    current = exit;
+}
+
+void Lowerer::LowerFor(ForStmt *stmt) {
+    Expr *init = *stmt->ExprSlot(0), *test = *stmt->ExprSlot(1), *step = *stmt->ExprSlot(2);
+    if (init) LowerExpr(init);
+    IrBlock *header = NewBlock();
+    Jump(header);
+    current = header;
+    IrValue *cond = test && !dynamic_cast<EmptyExpr *>(test) ? LowerExpr(test) : NULL;
+    IrBlock *body = NewBlock(), *next = NewBlock(), *exit = NewBlock();
+    if (cond)
+        Branch(cond, body, exit);
+    else
+        Jump(body);
+    Seal(body);
+    Targets loop = { exit, next };
+    targets.push_back(loop);
+    current = body;
+    table.push();
+    LowerStmt(*stmt->StmtSlot(0));
+    table.pop();
+    Jump(next);
+    targets.pop_back();
+    Seal(next);
+    current = next;
+    if (step) LowerExpr(step);
+    Jump(header);
+    Seal(header);
+    Seal(exit);
+    current = exit;
+}
+
+/* Each label gets a block, which the switch branches to and the
+ * statements before it fall through to.
+ */
+void Lowerer::LowerSwitch(SwitchStmt *stmt) {
+    IrValue *selector = LowerExpr(*stmt->ExprSlot(0));
+    vector<SwitchLabel *> labels;
+    Stmt **slot;
+    for (int i = 0; (slot = stmt->StmtSlot(i)) != NULL; i++) {
+        Stmt *item = *slot;
+        while (SwitchLabel *label = dynamic_cast<SwitchLabel *>(item)) {
+            labels.push_back(label);
+            item = *label->StmtSlot(0);
+        }
+    }
+    vector<IrBlock *> blocks;
+    IrValues cases;
+    IrBlock *def = NULL;
+    for (int i = 0; i < labels.size(); i++) {
+        blocks.push_back(NewBlock());
+        Expr *label = *labels[i]->ExprSlot(0);
+        if (label) cases.push_back(LowerExpr(label));
+        else def = blocks.back();
+    }
+    IrBlock *exit = NewBlock();
+    IrValue *sw = Emit(IrSwitch, Type::voidType);
+    sw->operands.push_back(selector);
+    for (int i = 0; i < labels.size(); i++) {
+        if (blocks[i] == def) continue;
+        sw->operands.push_back(cases[sw->operands.size() - 1]);
+        sw->targets.push_back(blocks[i]);
+    }
+    sw->targets.push_back(def ? def : exit);
+    for (int i = 0; i < sw->targets.size(); i++)
+        sw->targets[i]->preds.push_back(current);
+
+    Targets cased = { exit, NULL };
+    targets.push_back(cased);
+    table.push();
+    Unreachable();   // until the first label
+    int next = 0;
+    for (int i = 0; (slot = stmt->StmtSlot(i)) != NULL; i++) {
+        Stmt *item = *slot;
+        while (dynamic_cast<SwitchLabel *>(item)) {
+            Jump(blocks[next]);
+            Seal(blocks[next]);
+            current = blocks[next++];
+            item = *dynamic_cast<SwitchLabel *>(item)->StmtSlot(0);
+        }
+        LowerStmt(item);
+    }
+    Jump(exit);
+    table.pop();
+    targets.pop_back();
+    Seal(exit);
+    current = exit;
+}
+
+// The values of out parameters go back with the return value
+void Lowerer::Return(IrValue *value) {
+    IrValues operands;
+    bool valued = fn->returnType != Type::voidType;
+    if (valued) operands.push_back(value ? value : Undef(fn->returnType));
+    for (int i = 0; i < outs.size(); i++)
+        operands.push_back(ReadVar(outs[i]));
+    IrValue *ret = Emit(IrReturn, Type::voidType);
+    ret->intValue = valued;
+    ret->operands.swap(operands);
+    Unreachable();
+}
+
+IrValue *Lowerer::LowerExpr(Expr *expr) {
+    size_t base = frames.size();
+    Push(expr);
+    while (frames.size() > base) {
+        Deadline::Poll();
+        Step();
+    }
+    return Pop();
+}
+
+void Lowerer::Push(Expr *expr) {
+    Frame frame = { expr, 0, NULL, NULL, NULL };
+    frames.push_back(frame);
+}
+
+void Lowerer::Done(IrValue *value) {
+    frames.pop_back();
+    values.push_back(value);
+}
+
+IrValue *Lowerer::Pop() {
+    IrValue *value = values.back();
+    values.pop_back();
+    return value;
+}
+
+/* Takes the expression on top of the stack one step further: asks for
+ * an operand by pushing it, or, once the operands it needs are on the
+ * stack of values, replaces them with its own value.
+ */
+void Lowerer::Step() {
+    Expr *expr = frames.back().expr;
+    int step = frames.back().step++;
+    if (IntConstant *i = dynamic_cast<IntConstant *>(expr)) {
+        Done(Constant(Type::intType, i->GetValue(), 0));
+    } else if (FloatConstant *f = dynamic_cast<FloatConstant *>(expr)) {
+        Done(Constant(Type::floatType, 0, f->GetValue()));
+    } else if (BoolConstant *b = dynamic_cast<BoolConstant *>(expr)) {
+        Done(Constant(Type::boolType, b->GetValue(), 0));
+    } else if (VarExpr *var = dynamic_cast<VarExpr *>(expr)) {
+        Done(ReadVar(Variable(var->GetIdentifier())));
+    } else if (CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr)) {
+        StepCompound(compound, step);
+    } else if (ConditionalExpr *cond = dynamic_cast<ConditionalExpr *>(expr)) {
+        StepConditional(cond, step);
+    } else if (ArrayAccess *element = dynamic_cast<ArrayAccess *>(expr)) {
+        if (step == 0) {
+            Push(element->GetSubscript());
+            Push(element->GetBase());
+        } else {
+            IrValue *index = Pop();
+            Done(Access(Pop(), element, index));
+        }
+    } else if (FieldAccess *field = dynamic_cast<FieldAccess *>(expr)) {
+        if (!field->GetBase())
+            Done(ReadVar(Variable(field->GetField())));
+        else if (step == 0)
+            Push(field->GetBase());
+        else
+            Done(Access(Pop(), field, NULL));
+    } else if (Call *call = dynamic_cast<Call *>(expr)) {
+        StepCall(call, step);
+    } else {
+        Done(Undef(Type::voidType));   // empty
+    }
+}
+
+void Lowerer::StepCompound(CompoundExpr *expr, int step) {
+    const char *op = expr->GetOperator()->GetToken();
+    Expr *left = expr->GetLeft(), *right = expr->GetRight();
+    bool increment = strcmp(op, "++") == 0 || strcmp(op, "--") == 0;
+    if (dynamic_cast<AssignExpr *>(expr) || increment) {
+        StepUpdate(expr, step);
+    } else if (left && (strcmp(op, "&&") == 0 || strcmp(op, "||") == 0)) {
+        StepShortCircuit(expr, step);
+    } else if (step == 0) {
+        Push(right);
+        if (left) Push(left);
+    } else if (!left) {
+        IrValue *operand = Pop();
+        if (strcmp(op, "-") == 0) {
+            IrValue *neg = Emit(IrNeg, operand->type);
+            neg->operands.push_back(operand);
+            operand = neg;
+        }
+        Done(operand);
+    } else {
+        IrValue *r = Pop();
+        Done(Binary(op, Pop(), r));
+    }
+}
+
+/* Assignments, compound assignments, increments and decrements. The
+ * subscripts of the target are lowered first, then the value assigned.
+ */
+void Lowerer::StepUpdate(CompoundExpr *expr, int step) {
+    const char *op = expr->GetOperator()->GetToken();
+    bool assign = dynamic_cast<AssignExpr *>(expr) != NULL;
+    bool postfix = dynamic_cast<PostfixExpr *>(expr) != NULL;
+    Expr *target = expr->GetLeft() ? expr->GetLeft() : expr->GetRight();
+    if (step == 0) {
+        PathOf(target);
+        if (assign) Push(expr->GetRight());
+        PushSubscripts();
+        return;
+    }
+    IrValue *value = assign ? Pop() : NULL;
+    VarDecl *var = PathOf(target);
+    size_t base = values.size() - Subscripts();
+    string update;
+    if (!assign) update = string(op, 1);            // ++ adds one
+    else if (strcmp(op, "=") != 0) update = string(op, strlen(op) - 1);
+    IrValue *oldValue, *newValue;
+    Store(var, values.data() + base, update, value, &oldValue, &newValue);
+    values.resize(base);
+    Done(postfix ? oldValue : newValue);
+}
+
+// The right operand of && and || gets a block of its own
+void Lowerer::StepShortCircuit(CompoundExpr *expr, int step) {
+    if (step == 0) {
+        Push(expr->GetLeft());
+    } else if (step == 1) {
+        IrValue *left = Pop();
+        IrBlock *right = NewBlock(), *join = NewBlock();
+        Frame &frame = frames.back();
+        frame.a = current;
+        frame.b = join;
+        frame.v = left;
+        if (strcmp(expr->GetOperator()->GetToken(), "&&") == 0)
+            Branch(left, right, join);
+        else
+            Branch(left, join, right);
+        Seal(right);
+        current = right;
+        Push(expr->GetRight());
+    } else {
+        IrValue *right = Pop();
+        Frame frame = frames.back();
+        Jump(frame.b);
+        Seal(frame.b);
+        current = frame.b;
+        Done(Merge(frame.b, frame.a, frame.v, right));
+    }
+}
+
+void Lowerer::StepConditional(ConditionalExpr *expr, int step) {
+    if (step == 0) {
+        Push(expr->GetCondition());
+    } else if (step == 1) {
+        IrValue *cond = Pop();
+        IrBlock *then = NewBlock(), *other = NewBlock(), *join = NewBlock();
+        Branch(cond, then, other);
+        Seal(then);
+        Seal(other);
+        frames.back().a = other;
+        frames.back().b = join;
+        current = then;
+        Push(expr->GetTrueExpr());
+    } else if (step == 2) {
+        Frame &frame = frames.back();
+        frame.v = Pop();
+        IrBlock *thenEnd = current;
+        Jump(frame.b);
+        current = frame.a;
+        frame.a = thenEnd;
+        Push(expr->GetFalseExpr());
+    } else {
+        IrValue *otherwise = Pop();
+        Frame frame = frames.back();
+        Jump(frame.b);
+        Seal(frame.b);
+        current = frame.b;
+        Done(Merge(frame.b, frame.a, frame.v, otherwise));
+    }
+}
+
+/* The arguments for out parameters are written once the call returns;
+ * only their subscripts are lowered before it, in order with the other
+ * arguments.
+ */
+void Lowerer::StepCall(Call *call, int step) {
+    FnDecl *callee = Function(call);
+    List<Expr*> *actuals = call->GetActuals();
+    List<VarDecl*> *formals = callee ? callee->GetFormals() : NULL;
+    int n = actuals->NumElements();
+    if (step == 0) {
+        for (int i = n - 1; i >= 0; i--) {
+            if (IsOutArg(formals, i)) {
+                PathOf(actuals->Nth(i));
+                PushSubscripts();
+            } else {
+                Push(actuals->Nth(i));
+            }
+        }
+        return;
+    }
+    size_t base = values.size();
+    for (int i = 0; i < n; i++) {
+        if (!IsOutArg(formals, i)) {
+            base--;
+        } else {
+            PathOf(actuals->Nth(i));
+            base -= Subscripts();
+        }
+    }
+    Type *type = callee ? callee->GetType() : call->GetType() ? call->GetType() : Type::errorType;
+    IrValue *result = Emit(IrCall, type);
+    result->name = call->GetIdentifier()->GetName();
+    result->callee = callee;
+    size_t at = base;
+    for (int i = 0; i < n; i++) {
+        if (!IsOutArg(formals, i)) {
+            result->operands.push_back(values[at++]);
+        } else {
+            PathOf(actuals->Nth(i));
+            at += Subscripts();
+        }
+    }
+    at = base;
+    for (int i = 0; i < n; i++) {
+        if (!IsOutArg(formals, i)) {
+            at++;
+            continue;
+        }
+        VarDecl *var = PathOf(actuals->Nth(i));
+        IrValue *out = Emit(IrOutArg, formals->Nth(i)->GetType());
+        out->operands.push_back(result);
+        out->intValue = i;
+        IrValue *oldValue, *newValue;
+        Store(var, values.data() + at, "", out, &oldValue, &newValue);
+        at += Subscripts();
+    }
+    values.resize(base);
+    Done(result);
+}
+
+VarDecl *Lowerer::Variable(Identifier *id) {
+    const Symbol *sym = table.find(id->GetName());
+    return sym ? dynamic_cast<VarDecl *>(sym->decl) : NULL;
+}
+
+FnDecl *Lowerer::Function(Call *call) {
+    if (call->GetCallee()) return call->GetCallee();
+    const Symbol *sym = table.find(call->GetIdentifier()->GetName());
+    return sym ? dynamic_cast<FnDecl *>(sym->decl) : NULL;
+}
+
+/* Sets path to the accesses lvalue makes, from the variable out, and
+ * returns the variable.
+ */
+VarDecl *Lowerer::PathOf(Expr *lvalue) {
+    path.clear();
+    for (;;) {
+        ArrayAccess *element = dynamic_cast<ArrayAccess *>(lvalue);
+        FieldAccess *field = dynamic_cast<FieldAccess *>(lvalue);
+        if (element) lvalue = element->GetBase();
+        else if (field && field->GetBase()) lvalue = field->GetBase();
+        else break;
+        path.push_back(element ? (Expr *)element : field);
+    }
+    reverse(path.begin(), path.end());
+    if (VarExpr *var = dynamic_cast<VarExpr *>(lvalue))
+        return Variable(var->GetIdentifier());
+    if (FieldAccess *field = dynamic_cast<FieldAccess *>(lvalue))
+        return Variable(field->GetField());
+    return NULL;
+}
+
+int Lowerer::Subscripts() {
+    int count = 0;
+    for (int i = 0; i < path.size(); i++)
+        if (dynamic_cast<ArrayAccess *>(path[i])) count++;
+    return count;
+}
+
+// So that the first subscript along path is lowered first
+void Lowerer::PushSubscripts() {
+    for (int i = path.size() - 1; i >= 0; i--)
+        if (ArrayAccess *element = dynamic_cast<ArrayAccess *>(path[i]))
+            Push(element->GetSubscript());
+}
+
+/* Writes value to var through path, whose subscripts have been lowered
+ * to indices, after combining it with the old value by the operator
+ * update if that is not empty (a NULL value then being 1). The parts of
+ * var along path are taken out, and the changed part is put back into
+ * each in turn.
+ */
+void Lowerer::Store(VarDecl *var, IrValue **indices, const string &update, IrValue *value,
+                    IrValue **oldValue, IrValue **newValue) {
+    int n = path.size();
+    bool combine = !update.empty();
+    vector<IrValue *> index(n, NULL);
+    for (int i = 0, k = 0; i < n; i++)
+        if (dynamic_cast<ArrayAccess *>(path[i])) index[i] = indices[k++];
+    levels.clear();
+    if (n > 0 || combine) levels.push_back(ReadVar(var));
+    for (int i = 0; i < n && (i + 1 < n || combine); i++)
+        levels.push_back(Access(levels[i], path[i], index[i]));
+    if (combine) {
+        *oldValue = levels[n];
+        if (!value) value = Constant(ComponentType(levels[n]->type), 1, 1);
+        value = Binary(update, levels[n], value);
+    } else {
+        *oldValue = value;
+    }
+    *newValue = value;
+    for (int i = n - 1; i >= 0; i--)
+        value = Put(levels[i], path[i], index[i], value);
+    WriteVar(var, value);
+}
+
+IrBlock *Lowerer::NewBlock() {
+    IrBlock *block = new IrBlock(nextBlock++);
+    fn->blocks.push_back(block);
+    return block;
+}
+
+// Fills in the phis that were waiting for all the preds to be known
+void Lowerer::Seal(IrBlock *block) {
+    vector<pair<int, IrValue *> > waiting;
+    unordered_map<IrBlock *, vector<pair<int, IrValue *> > >::iterator found = incomplete.find(block);
+    if (found != incomplete.end()) {
+        waiting.swap(found->second);
+        incomplete.erase(found);
+    }
+    for (int i = 0; i < waiting.size(); i++) {
+        IrValue *phi = waiting[i].second;
+        for (int j = 0; j < block->preds.size(); j++)
+            AddOperand(phi, ReadLocal(waiting[i].first, block->preds[j]));
+        phi->complete = true;
+        TryRemoveTrivial(phi);
+    }
+    block->sealed = true;
+}
+
+// For the code after a jump: a block nothing branches to
+void Lowerer::Unreachable() {
+    current = NewBlock();
+    Seal(current);
+}
+
+IrValue *Lowerer::Emit(IrOp op, Type *type) {
+    IrValue *instr = new IrValue(op, type);
+    instr->block = current;
+    current->instrs.push_back(instr);
+    return instr;
+}
+
+IrValue *Lowerer::Constant(Type *type, int intValue, double floatValue) {
+    IrValue *value = new IrValue(IrConst, type);
+    value->intValue = intValue;
+    value->floatValue = floatValue;
+    return value;
+}
+
+IrValue *Lowerer::Undef(Type *type) {
+    return new IrValue(IrUndef, type);
+}
+
+void Lowerer::Jump(IrBlock *to) {
+    IrValue *jump = Emit(IrJump, Type::voidType);
+    jump->targets.push_back(to);
+    to->preds.push_back(current);
+}
+
+void Lowerer::Branch(IrValue *cond, IrBlock *ifTrue, IrBlock *ifFalse) {
+    IrValue *branch = Emit(IrBranch, Type::voidType);
+    branch->operands.push_back(cond);
+    branch->targets.push_back(ifTrue);
+    branch->targets.push_back(ifFalse);
+    ifTrue->preds.push_back(current);
+    ifFalse->preds.push_back(current);
+}
+
+IrValue *Lowerer::Binary(const string &op, IrValue *left, IrValue *right) {
+    static const struct { const char *token; IrOp op; } ops[] = {
+        { "+", IrAdd }, { "-", IrSub }, { "*", IrMul }, { "/", IrDiv },
+        { "<", IrLess }, { "<=", IrLessEqual }, { ">", IrGreater }, { ">=", IrGreaterEqual },
+        { "==", IrEqual }, { "!=", IrNotEqual }, { NULL, IrAdd }
+    };
+    int i = 0;
+    while (ops[i].token && op != ops[i].token) i++;
+    IrOp code = ops[i].op;
+    if (code == IrMul && !IsScalar(left->type) && !IsScalar(right->type)
+        && (left->type->IsMatrix() || right->type->IsMatrix()))
+        code = IrMatMul;
+    IrValue *instr = Emit(code, ResultType(code, left->type, right->type));
+    instr->operands.push_back(left);
+    instr->operands.push_back(right);
+    return instr;
+}
+
+// Takes the part that step (an ArrayAccess or FieldAccess) names out of
+// whole
+IrValue *Lowerer::Access(IrValue *whole, Expr *step, IrValue *index) {
+    IrValue *part;
+    if (FieldAccess *field = dynamic_cast<FieldAccess *>(step)) {
+        const char *swizzle = field->GetField()->GetName();
+        part = Emit(IrExtract, VectorOf(ComponentType(whole->type), strlen(swizzle)));
+        part->name = swizzle;
+        part->operands.push_back(whole);
+    } else {
+        part = Emit(IrIndex, ElementType(whole->type));
+        part->operands.push_back(whole);
+        part->operands.push_back(index);
+    }
+    return part;
+}
+
+// Returns whole with the part that step names replaced
+IrValue *Lowerer::Put(IrValue *whole, Expr *step, IrValue *index, IrValue *part) {
+    IrValue *changed;
+    if (FieldAccess *field = dynamic_cast<FieldAccess *>(step)) {
+        changed = Emit(IrInsert, whole->type);
+        changed->name = field->GetField()->GetName();
+        changed->operands.push_back(whole);
+    } else {
+        changed = Emit(IrSetIndex, whole->type);
+        changed->operands.push_back(whole);
+        changed->operands.push_back(index);
+    }
+    changed->operands.push_back(part);
+    return changed;
+}
+
+void Lowerer::DeclareLocal(VarDecl *var) {
+    locals[var] = localTypes.size();
+    localTypes.push_back(var->GetType());
+    Symbol sym(var->GetIdentifier()->GetName(), var, E_VarDecl);
+    table.insert(sym);
+}
+
+// Globals are in memory
+IrValue *Lowerer::ReadVar(VarDecl *var) {
+    if (var == NULL) return Undef(Type::errorType);
+    unordered_map<Decl *, int>::iterator local = locals.find(var);
+    if (local != locals.end()) return ReadLocal(local->second, current);
+    IrValue *load = Emit(IrLoad, var->GetType());
+    load->var = var;
+    return load;
+}
+
+void Lowerer::WriteVar(VarDecl *var, IrValue *value) {
+    if (var == NULL) return;
+    unordered_map<Decl *, int>::iterator local = locals.find(var);
+    if (local != locals.end()) {
+        WriteLocal(local->second, current, value);
+        return;
+    }
+    IrValue *store = Emit(IrStore, Type::voidType);
+    store->var = var;
+    store->operands.push_back(value);
+}
+
+IrValue *Lowerer::Lookup(int var, IrBlock *block) {
+    unordered_map<long long, IrValue *>::iterator def = defs.find(((long long)block->id << 32) | var);
+    return def == defs.end() ? NULL : Resolve(def->second);
+}
+
+/* Looks for the value var has at the end of block, going back through
+ * preds with an explicit stack, since a chain of blocks can be as long
+ * as the function. A block whose preds are not all known gets a phi to
+ * be filled in when they are; a join gets one before its preds are
+ * looked through, which stops the lookup going round a loop.
+ */
+IrValue *Lowerer::ReadLocal(int var, IrBlock *block) {
+    IrValue *found = Lookup(var, block);
+    if (found) return found;
+    size_t base = reads.size();
+    ReadFrame first = { block, NULL, 0 };
+    reads.push_back(first);
+    IrValue *result = NULL;    // of the frame just popped
+    while (reads.size() > base) {
+        Deadline::Poll();
+        ReadFrame &frame = reads.back();
+        IrBlock *at = frame.block;
+        if (result == NULL) {
+            result = Lookup(var, at);
+            if (!result && !at->sealed) {
+                result = NewPhi(at, localTypes[var]);
+                result->complete = false;
+                incomplete[at].push_back(make_pair(var, result));
+            } else if (!result && at->preds.empty()) {
+                result = Undef(localTypes[var]);
+            } else if (!result && at->preds.size() > 1) {
+                frame.phi = NewPhi(at, localTypes[var]);
+                frame.phi->complete = false;
+                WriteLocal(var, at, frame.phi);
+            }
+            if (result) {
+                WriteLocal(var, at, result);
+                reads.pop_back();
+            } else {
+                ReadFrame pred = { at->preds[0], NULL, 0 };
+                reads.push_back(pred);
+            }
+            continue;
+        }
+        if (frame.phi == NULL) {
+            WriteLocal(var, at, result);
+            reads.pop_back();
+            continue;
+        }
+        AddOperand(frame.phi, result);
+        if (++frame.next < at->preds.size()) {
+            ReadFrame pred = { at->preds[frame.next], NULL, 0 };
+            result = NULL;
+            reads.push_back(pred);
+            continue;
+        }
+        frame.phi->complete = true;
+        result = TryRemoveTrivial(frame.phi);
+        reads.pop_back();
+    }
+    return result;
+}
+
+IrValue *Lowerer::NewPhi(IrBlock *block, Type *type) {
+    IrValue *phi = new IrValue(IrPhi, type);
+    phi->block = block;
+    block->phis.push_back(phi);
+    return phi;
+}
+
+void Lowerer::AddOperand(IrValue *phi, IrValue *value) {
+    phi->operands.push_back(value);
+    if (value->op == IrPhi) value->phiUsers.push_back(phi);
+}
+
+// The phi at join of value, coming from the pred from, and otherwise
+IrValue *Lowerer::Merge(IrBlock *join, IrBlock *from, IrValue *value, IrValue *otherwise) {
+    IrValue *phi = NewPhi(join, value->type);
+    for (int i = 0; i < join->preds.size(); i++)
+        AddOperand(phi, join->preds[i] == from ? value : otherwise);
+    return TryRemoveTrivial(phi);
+}
+
+/* A phi whose operands are all one value, or itself, stands for that
+ * value (or for nothing, in a block that cannot be reached). Once one is
+ * found, the phis using it may have become trivial too.
+ */
+IrValue *Lowerer::TryRemoveTrivial(IrValue *phi) {
+    trivial.push_back(phi);
+    while (!trivial.empty()) {
+        IrValue *p = trivial.back();
+        trivial.pop_back();
+        if (p->replacement || !p->complete) continue;
+        IrValue *same = NULL;
+        bool isTrivial = true;
+        for (int i = 0; i < p->operands.size() && isTrivial; i++) {
+            IrValue *operand = Resolve(p->operands[i]);
+            if (operand == same || operand == p) continue;
+            if (same) isTrivial = false;
+            same = operand;
+        }
+        if (!isTrivial) continue;
+        p->replacement = same ? same : Undef(p->type);
+        for (int i = 0; i < p->phiUsers.size(); i++)
+            if (p->phiUsers[i] != p) trivial.push_back(p->phiUsers[i]);
+    }
+    return Resolve(phi);
+}
+
+IrProgram *LowerProgram(Program *program) {
+    Lowerer lowerer(program);
+    return lowerer.Run();
+}
@@ -0,0 +1,42 @@
+/* File: lower.h
+ * -------------
+ * Lowering a checked program to the SSA form of ir.h, for glc
+ * --dump-ir, which prints it after checking it with VerifyIr().
+ *
+ * Values are put into SSA form as the tree is walked, the way Braun et
+ * al. describe in "Simple and Efficient Construction of Static Single
+ * Assignment Form": each block remembers the last value it gave each
+ * variable, a use looks back through the preds for it, and a phi is
+ * placed only where the lookup reaches a join, and dropped again if all
+ * of its operands turn out to be the same value. A block whose preds
+ * may not all be known yet (a loop's header, until its body is done)
+ * gets phis that are filled in once they are. This takes time linear in
+ * the size of the function, apart from the phis that are dropped.
+ *
+ * && and || only evaluate their right operand when it matters, and ?:
+ * only the operand it picks, so each gets blocks of its own, joined by a
+ * phi. Code after a return, break or continue is lowered into a block of
+ * its own that nothing branches to, and removed at the end along with
+ * anything else that cannot be reached. The initializers of global
+ * variables make up a function of their own.
+ *
+ * Names are looked up with a symbol table of the lowering's own, scoped
+ * as the checker scopes them, so that the parts of the tree the checker
+ * leaves unresolved (such as subscripts) lower just as well. Like the
+ * checker, lowering walks expressions with an explicit stack.
+ */
+
+#ifndef _H_lower
+#define _H_lower
+
+class Program;
+class IrProgram;
+
+/* Function: LowerProgram()
+ * ------------------------
+ * Returns the functions of program, with the bodies they have, and the
+ * initializers of its globals, in SSA form.
+ */
+IrProgram *LowerProgram(Program *program);
+
+#endif
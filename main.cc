@@ -9,22 +9,245 @@
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "serve.h"
+#include "cache.h"
+#include "memo.h"
+#include "symtable.h"
+#include "arena.h"
+#include "prelude.h"
+#include "pch.h"
+#include "ast_binary.h"
+#include "ast_json.h"
+#include "passes.h"
+#include "deadline.h"
+#include "bounds.h"
+#include "options.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+
+/* Function: ReadFile()
+ * --------------------
+ * Reads the whole of the named file into contents, reporting an error
+ * and returning false if it cannot be opened.
+ */
+static bool ReadFile(const char *name, string *contents)
+{
+    ifstream file(name, ios::binary);
+    if (!file) {
+        cerr << "*** Cannot open " << name << endl;
+        return false;
+    }
+    ostringstream source;
+    source << file.rdbuf();
+    *contents = source.str();
+    return true;
+}
+
+
+/* The deadline and limits given on the command line, which each check
+ * is held to (see deadline.h and bounds.h)
+ */
+static glc_options checkOptions;
+
+static void BeginCheck()
+{
+    Deadline::Start(checkOptions.deadline_ms);
+    Bounds::Start(&checkOptions);
+}
+
+static void EndCheck()
+{
+    Deadline::Stop();
+    Bounds::Stop();
+}
+
+
+/* Function: GiveUp()
+ * -------------------
+ * Reports why a check was cut short, after dropping whatever the check
+ * was in the middle of holding back.
+ */
+static void GiveUp(const CheckAbandoned &reason)
+{
+    FunctionMemo::Abandon();
+    ReportError::Capture(NULL);
+    reason.Report();
+}
+
+
+/* Function: CheckFiles()
+ * ----------------------
+ * Batch mode: checks each input file named on the command line in turn,
+ * printing a header line before its errors, and returns the exit status.
+ * Functions shared between the files are only checked once (see memo.h).
+ * Each file is looked up in cache first if there is one, and is held to
+ * its own deadline and limits.
+ */
+static int CheckFiles(ResultCache *cache)
+{
+    int failed = 0;
+    // The JSON dump and the passes need expression types, which a memo
+    // hit leaves unset, and bodies checked in parallel cannot be recorded
+    FunctionMemo::enabled = !GetOption("dump-ast") && !PassesWanted() && Program::jobs <= 1;
+    for (int i = 0; i < NumInputFiles(); i++) {
+        const char *name = GetInputFile(i);
+        cerr << "==> " << name << " <==" << endl;
+        string source;
+        if (!ReadFile(name, &source)) {
+            failed++;
+            continue;
+        }
+
+        Arena::Mark mark = AstArena().GetMark();
+        ResetSymbolTable();
+        ReportError::ResetNumErrors();
+        BeginCheck();
+        try {
+            if (cache) {
+                cache->Check(source);
+            } else {
+                GlcParser parser;
+                parser.Feed(source.data(), source.size());
+                parser.Finish();
+            }
+        } catch (const CheckAbandoned &reason) {
+            GiveUp(reason);
+        }
+        EndCheck();
+        if (ReportError::NumErrors() > 0) failed++;
+        AstArena().Release(mark);
+    }
+    FunctionMemo::PrintStats();
+    if (cache) cache->PrintStats();
+    return (failed == 0? 0 : -1);
+}
 
 
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * The input on stdin is handed a chunk at a time to a GlcParser (see
+ * parser.h), which sets up the scanner and the parser and attempts to
+ * parse a complete program from it. Given input files instead, glc
+ * checks them all in batch mode (see CheckFiles()); with --serve it runs
+ * as a daemon, with --ast it checks a stored tree, and with --emit-pch
+ * it only writes out the prelude. The options, and what each does, are
+ * listed in one table (see options.h), which glc --help prints.
  */
 int main(int argc, char *argv[])
 {
-    ParseCommandLine(argc, argv);
-    InitScanner();
-    InitParser();
-    yyparse();
+    if (!ParseCommandLine(argc, argv, OptionsFlagged(SeparateValue), OptionsFlagged(0))) {
+        PrintUsage(stderr);
+        return 2;
+    }
+    if (GetOption("help")) {
+        PrintUsage(stdout);
+        return 0;
+    }
+    const char *dump = GetOption("dump-ast");
+    if (dump && strcmp(dump, "json") != 0) {
+        fprintf(stderr, "glc: unknown --dump-ast format '%s' (only json is supported)\n", dump);
+        return 2;
+    }
+    const char *depth = GetOption("max-depth");
+    if (depth && atoi(depth) > 0)
+        Expr::maxDepth = atoi(depth);
+    const char *jobs = GetOption("jobs");
+    if (jobs)
+        Program::jobs = *jobs ? atoi(jobs) : thread::hardware_concurrency();
+    const char *limit;
+    if ((limit = GetOption("deadline"))) checkOptions.deadline_ms = atol(limit);
+    if ((limit = GetOption("max-input-bytes"))) checkOptions.max_input_bytes = atol(limit);
+    if ((limit = GetOption("max-tokens"))) checkOptions.max_tokens = atol(limit);
+    if ((limit = GetOption("max-nodes"))) checkOptions.max_nodes = atol(limit);
+    if ((limit = GetOption("max-nesting"))) checkOptions.max_nesting = atoi(limit);
+    if ((limit = GetOption("max-scope-depth"))) checkOptions.max_scope_depth = atoi(limit);
+    if ((limit = GetOption("max-arena-bytes"))) checkOptions.max_arena_bytes = atol(limit);
+    const char *prelude = GetOption("emit-pch");
+    if (!prelude) prelude = GetOption("prelude");
+    if (prelude) {
+        string source;
+        if (!ReadFile(prelude, &source) || LoadPrelude(source.data(), source.size()) > 0)
+            return -1;
+    }
+    if (GetOption("emit-pch")) {
+        const char *output = GetOption("output");
+        if (!output) {
+            fprintf(stderr, "glc: --emit-pch needs -o <image>\n");
+            return 2;
+        }
+        return (WritePch(output)? 0 : -1);
+    }
+    const char *pch = GetOption("pch");
+    if (pch && !LoadPch(pch))
+        return -1;
+    const char *path = GetOption("serve");
+    if (path) {
+        const char *workers = GetOption("workers");
+        return Serve(path, workers ? atoi(workers) : 0, &checkOptions);
+    }
+    const char *astFile = GetOption("ast");
+    if (astFile) {
+        Program *program = LoadAst(astFile);
+        if (!program)
+            return -1;
+        if (IsDebugOn("dumpAST")) {
+            program->Print(0);
+            printf("\n");
+        }
+        BeginCheck();
+        try {
+            program->Check();
+            RunPasses(program);
+            if (GetOption("dump-ast"))
+                DumpAstJson(program);
+        } catch (const CheckAbandoned &reason) {
+            GiveUp(reason);
+        }
+        EndCheck();
+        return (ReportError::NumErrors() == 0? 0 : -1);
+    }
+    // A cache hit builds no tree, so the cache is bypassed when the tree
+    // is dumped, emitted or rewritten, and with --reachable-only, whose
+    // list a hit would not print
+    const char *cacheDir = GetOption("cache-dir");
+    ResultCache *cache = NULL;
+    if (cacheDir && !IsDebugOn("dumpAST") && !GetOption("emit-ast") && !GetOption("dump-ast")
+        && !GetOption("reachable-only") && !PassesWanted()) {
+        const char *size = GetOption("cache-size");
+        cache = new ResultCache(cacheDir, size ? atol(size) : DefaultCacheBytes);
+    }
+    if (NumInputFiles() > 0)
+        return CheckFiles(cache);
+    if (cache) {
+        ostringstream source;
+        source << cin.rdbuf();
+        BeginCheck();
+        try {
+            cache->Check(source.str());
+        } catch (const CheckAbandoned &reason) {
+            GiveUp(reason);
+        }
+        EndCheck();
+        cache->PrintStats();
+        return (ReportError::NumErrors() == 0? 0 : -1);
+    }
+    BeginCheck();
+    try {
+        GlcParser parser;
+        char chunk[65536];
+        size_t len;
+        while ((len = fread(chunk, 1, sizeof(chunk), stdin)) > 0)
+            parser.Feed(chunk, len);
+        parser.Finish();
+    } catch (const CheckAbandoned &reason) {
+        GiveUp(reason);
+    }
+    EndCheck();
     return (ReportError::NumErrors() == 0? 0 : -1);
 }
 
@@ -0,0 +1,217 @@
+/* File: memo.cc
+ * -------------
+ * Implementation of function check memoization.
+ */
+
+#include <string.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "memo.h"
+#include "parser.h"
+#include "symtable.h"
+#include "errors.h"
+#include "utility.h"
+
+using namespace std;
+
+bool FunctionMemo::enabled = false;
+
+// The memo is emptied when it grows past this many entries
+static const int MaxEntries = 1 << 16;
+
+static const uint64_t FnvOffset = 14695981039346656037ULL;
+
+// 64-bit FNV-1a
+static uint64_t Mix(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static vector<yyltype> tokenLocs;
+static vector<uint64_t> tokenHashes;
+
+/* An error raised while checking a function. Its position is kept as the
+ * offsets of the tokens it starts and ends at from the function's first
+ * token (-1 if it has none).
+ */
+struct MemoError {
+    int start, end;
+    glc_code code;
+    string message;
+};
+
+struct MemoEntry {
+    map<string, string> globals;   // name -> signature it resolved to
+    vector<MemoError> errors;
+};
+
+static map<uint64_t, vector<MemoEntry> > memo;
+static int numEntries, hits, misses, stored;
+
+// The check being recorded, if any
+static bool recording;
+static uint64_t recordKey;
+static int recordFirst, recordCount;
+static MemoEntry recordEntry;
+static vector<Diagnostic> held;
+static vector<Diagnostic> *outer;    // capture held errors are passed on to
+
+void FunctionMemo::LogToken(int kind, const YYSTYPE &value, const yyltype &loc) {
+    uint64_t hash = Mix(FnvOffset, &kind, sizeof(kind));
+    switch (kind) {
+      case T_Identifier:
+      case T_FieldSelection:
+        hash = Mix(hash, value.identifier, strlen(value.identifier));
+        break;
+      case T_IntConstant:
+        hash = Mix(hash, &value.integerConstant, sizeof(value.integerConstant));
+        break;
+      case T_FloatConstant:
+        hash = Mix(hash, &value.floatConstant, sizeof(value.floatConstant));
+        break;
+      case T_BoolConstant:
+        hash = Mix(hash, &value.boolConstant, sizeof(value.boolConstant));
+        break;
+    }
+    tokenLocs.push_back(loc);
+    tokenHashes.push_back(hash);
+}
+
+void FunctionMemo::ClearTokenLog() {
+    tokenLocs.clear();
+    tokenHashes.clear();
+}
+
+static void PrintType(ostream &out, Type *type) {
+    if (type) out << type;
+    else out << "?";
+}
+
+/* What checking a body can learn about a global name: whether it is a
+ * variable or a function, and its type or signature.
+ */
+static string Signature(const Symbol *sym) {
+    if (!sym) return "";
+    ostringstream s;
+    s << (sym->kind == E_FunctionDecl ? "function " : "variable ");
+    if (VarDecl *var = dynamic_cast<VarDecl *>(sym->decl)) {
+        PrintType(s, var->GetType());
+    } else if (FnDecl *fn = dynamic_cast<FnDecl *>(sym->decl)) {
+        PrintType(s, fn->GetType());
+        s << "(";
+        List<VarDecl*> *formals = fn->GetFormals();
+        for (int i = 0; formals && i < formals->NumElements(); i++) {
+            if (i) s << ",";
+            PrintType(s, formals->Nth(i)->GetType());
+        }
+        s << ")";
+    }
+    return s.str();
+}
+
+static bool Matches(const MemoEntry &entry) {
+    for (map<string, string>::const_iterator it = entry.globals.begin();
+         it != entry.globals.end(); ++it)
+        if (Signature(Node::symtable->find(it->first.c_str())) != it->second)
+            return false;
+    return true;
+}
+
+static void Replay(const MemoEntry &entry, int first) {
+    for (int i = 0; i < entry.errors.size(); i++) {
+        const MemoError &e = entry.errors[i];
+        Diagnostic d;
+        d.located = e.start >= 0;
+        if (d.located) {
+            d.loc = tokenLocs[first + e.start];
+            d.loc.last_line = tokenLocs[first + e.end].last_line;
+            d.loc.last_column = tokenLocs[first + e.end].last_column;
+        }
+        d.code = e.code;
+        d.message = e.message;
+        ReportError::Report(d);
+    }
+}
+
+bool FunctionMemo::Begin(FnDecl *fn) {
+    if (!enabled || recording) return false;
+    const yyltype *extent = fn->GetExtent();
+    int first, last;
+    if (!extent || !FindTokens(tokenLocs.data(), tokenLocs.size(), *extent, &first, &last))
+        return false;
+
+    uint64_t key = FnvOffset;
+    for (int i = first; i <= last; i++)
+        key = Mix(key, &tokenHashes[i], sizeof(tokenHashes[i]));
+    map<uint64_t, vector<MemoEntry> >::iterator found = memo.find(key);
+    if (found != memo.end()) {
+        for (int i = 0; i < found->second.size(); i++)
+            if (Matches(found->second[i])) {
+                Replay(found->second[i], first);
+                hits++;
+                return true;
+            }
+    }
+    misses++;
+
+    recording = true;
+    recordKey = key;
+    recordFirst = first;
+    recordCount = last - first + 1;
+    recordEntry = MemoEntry();
+    held.clear();
+    outer = ReportError::Capture(&held);
+    return false;
+}
+
+void FunctionMemo::End() {
+    if (!recording) return;
+    recording = false;
+    ReportError::Capture(outer);
+
+    bool storable = true;
+    for (int i = 0; i < held.size(); i++) {
+        const Diagnostic &d = held[i];
+        ReportError::Report(d);
+        MemoError e;
+        e.start = e.end = -1;
+        e.code = d.code;
+        e.message = d.message;
+        // A declaration conflict quotes the line of the other declaration
+        if (d.code == GLC_E_DECL_CONFLICT ||
+            (d.located && !FindTokens(&tokenLocs[recordFirst], recordCount, d.loc, &e.start, &e.end)))
+            storable = false;
+        recordEntry.errors.push_back(e);
+    }
+    if (!storable) return;
+
+    if (numEntries >= MaxEntries) {
+        memo.clear();
+        numEntries = 0;
+    }
+    memo[recordKey].push_back(recordEntry);
+    numEntries++;
+    stored++;
+}
+
+void FunctionMemo::Abandon() {
+    if (!recording) return;
+    recording = false;
+    ReportError::Capture(outer);
+}
+
+void FunctionMemo::NoteGlobal(const char *name, const Symbol *sym) {
+    if (recording && !recordEntry.globals.count(name))
+        recordEntry.globals[name] = Signature(sym);
+}
+
+void FunctionMemo::PrintStats() {
+    PrintDebug("stats", "function memo: %d hits, %d misses, %d stored",
+               hits, misses, stored);
+}
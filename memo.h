@@ -0,0 +1,60 @@
+/**
+ * File: memo.h
+ * ------------
+ * Memoization of FnDecl::Check across the programs checked by one
+ * process, for batch mode and the daemon, where the same helper
+ * functions turn up verbatim in many shaders.
+ *
+ * A function definition is keyed by a hash of its tokens (kind and
+ * value, not position). While it is checked for the first time, every
+ * name its body resolves in the global scope (or fails to resolve) is
+ * noted together with the signature it resolved to, and the errors it
+ * raises are held back. These make up a memo entry. The next time a
+ * definition with the same tokens is checked, an entry whose names all
+ * still resolve to the same signatures stands in for walking the body:
+ * its errors are reported again, positioned at the corresponding tokens
+ * of the new definition, and the body is left unchecked.
+ *
+ * Checking a body also records the types of its expressions in the
+ * nodes; on a hit those stay unset, which is fine as long as nothing
+ * looks at them after checking. Only enable memoization when that holds.
+ */
+
+#ifndef _H_memo
+#define _H_memo
+
+#include <stdint.h>
+#include "location.h"
+
+class FnDecl;
+struct Symbol;
+union YYSTYPE;
+
+class FunctionMemo {
+  public:
+    static bool enabled;
+
+    // Token log the keys are computed from. yylex() appends every token
+    // while memoization is enabled; InitScanner() clears it.
+    static void LogToken(int kind, const YYSTYPE &value, const yyltype &loc);
+    static void ClearTokenLog();
+
+    // FnDecl::Check calls Begin() once it has declared the function.
+    // Begin() returns true if the check was replayed from the memo and
+    // the rest of it should be skipped; otherwise the caller checks the
+    // function as usual and then calls End().
+    static bool Begin(FnDecl *fn);
+    static void End();
+
+    // Drops a recording interrupted by a Failure()
+    static void Abandon();
+
+    // Called by SymbolTable::find() for names found in the global scope
+    // or the prelude (sym is NULL if the name is not declared at all)
+    static void NoteGlobal(const char *name, const Symbol *sym);
+
+    // Prints hit and miss counts under the "stats" debug key
+    static void PrintStats();
+};
+
+#endif
@@ -0,0 +1,408 @@
+/* File: minify.cc
+ * ---------------
+ * Implementation of dropping and renaming declarations for --minify.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "minify.h"
+#include "glsl.h"
+#include "symtable.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "utility.h"
+#include "deadline.h"
+
+using namespace std;
+
+// The words GLSL keeps for itself, which cannot be names
+static const char *keywords[] = {
+    "attribute", "const", "uniform", "varying", "buffer", "shared", "coherent",
+    "volatile", "restrict", "readonly", "writeonly", "layout", "centroid", "flat",
+    "smooth", "noperspective", "patch", "sample", "break", "continue", "do", "for",
+    "while", "switch", "case", "default", "if", "else", "subroutine", "in", "out",
+    "inout", "float", "double", "int", "void", "bool", "true", "false", "invariant",
+    "precise", "discard", "return", "lowp", "mediump", "highp", "precision",
+    "struct", "common", "partition", "active", "asm", "class", "union", "enum",
+    "typedef", "template", "this", "resource", "goto", "inline", "noinline",
+    "public", "static", "extern", "external", "interface", "long", "short", "half",
+    "fixed", "unsigned", "superp", "input", "output", "filter", "sizeof", "cast",
+    "namespace", "using", "uint", "atomic_uint", NULL
+};
+
+// Type names are words too, though not all of them are in keywords
+static bool IsTypeName(const string &name) {
+    static const char *prefixes[] = { "vec", "ivec", "uvec", "bvec", "dvec", "mat",
+                                      "dmat", "hvec", "fvec", "sampler", "image",
+                                      "isampler", "usampler", "iimage", "uimage", NULL };
+    for (int i = 0; prefixes[i]; i++) {
+        size_t len = strlen(prefixes[i]);
+        if (name.compare(0, len, prefixes[i]) == 0 && name.size() > len
+            && isdigit((unsigned char)name[len]))
+            return true;
+    }
+    return false;
+}
+
+static bool IsReserved(const string &name) {
+    static set<string> words(keywords, keywords + sizeof(keywords) / sizeof(keywords[0]) - 1);
+    return words.count(name) || IsTypeName(name) || name.find("__") != string::npos
+           || name.compare(0, 3, "gl_") == 0;
+}
+
+// The nth of all names, shortest first: a letter, then letters, digits and '_'
+static string NthName(long n) {
+    static const char first[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    static const char rest[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    const long firsts = sizeof(first) - 1, rests = sizeof(rest) - 1;
+    long count = firsts;
+    int len = 1;
+    while (n >= count) {
+        n -= count;
+        count *= rests;
+        len++;
+    }
+    string name(len, ' ');
+    for (int i = len - 1; i > 0; i--) {
+        name[i] = rest[n % rests];
+        n /= rests;
+    }
+    name[0] = first[n];
+    return name;
+}
+
+/* Hands out the shortest names, in order, that are neither reserved nor
+ * in either of the sets it is given.
+ */
+class NameSource {
+  public:
+    NameSource(const set<string> *taken, const set<string> *alsoTaken = NULL)
+        : taken(taken), alsoTaken(alsoTaken), next(0) {}
+
+    string Next() {
+        for (;;) {
+            string name = NthName(next++);
+            if (!IsReserved(name) && !taken->count(name)
+                && !(alsoTaken && alsoTaken->count(name)))
+                return name;
+        }
+    }
+
+  private:
+    const set<string> *taken, *alsoTaken;
+    long next;
+};
+
+class Minifier {
+  public:
+    Minifier(Program *program, GlslWriter *out);
+
+    void Run();
+
+  private:
+    // A name and the declaration it refers to (a declaration's own name
+    // refers to it)
+    struct Ref {
+        Identifier *id;
+        Decl *decl;
+    };
+    // A parameter or local variable: the top-level declaration it is in,
+    // and how many others are in scope where it is declared
+    struct Local {
+        int owner;
+        int slot;
+    };
+
+    List<Decl*> *decls;
+    GlslWriter *out;
+    SymbolTable table;
+    map<Decl *, int> globals;        // top-level declarations by index
+    vector<set<int> > uses;          // the top-level declarations each refers to
+    vector<int> useCounts;           // of each top-level declaration
+    map<Decl *, Local> locals;
+    vector<Ref> refs;
+    set<string> kept;                // names nothing may be renamed to
+    int current;                     // the top-level declaration gone through
+    int live;                        // locals in scope
+    vector<int> scopes;              // live on entry to each scope
+    vector<Expr *> stack;
+
+    void WalkDecl(int index);
+    void WalkStmt(Stmt *stmt);
+    void WalkExpr(Expr *expr);
+    void DeclareLocal(VarDecl *var);
+    void Refer(Identifier *id);
+    void Push();
+    void Pop();
+
+    void Reach(vector<bool> *reached);
+    void Rename(const vector<bool> &reached);
+    void Drop(const vector<bool> &reached);
+};
+
+static bool IsInterface(VarDecl *var) {
+    TypeQualifier *typeq = var->GetTypeQualifier();
+    return typeq == TypeQualifier::inTypeQualifier || typeq == TypeQualifier::outTypeQualifier
+           || typeq == TypeQualifier::uniformTypeQualifier;
+}
+
+Minifier::Minifier(Program *program, GlslWriter *out)
+    : decls(program->GetDecls()), out(out), current(0), live(0) {
+    int n = decls->NumElements();
+    uses.resize(n);
+    useCounts.assign(n, 0);
+    for (int i = 0; i < n; i++)
+        globals[decls->Nth(i)] = i;
+}
+
+void Minifier::Run() {
+    for (int i = 0; i < decls->NumElements(); i++)
+        WalkDecl(i);
+    vector<bool> reached;
+    Reach(&reached);
+    Rename(reached);
+    Drop(reached);
+}
+
+// In source order, as the checker declares them
+void Minifier::WalkDecl(int index) {
+    current = index;
+    Decl *decl = decls->Nth(index);
+    Ref self = { decl->GetIdentifier(), decl };
+    refs.push_back(self);
+    VarDecl *var = dynamic_cast<VarDecl *>(decl);
+    FnDecl *fn = dynamic_cast<FnDecl *>(decl);
+    if (var) {
+        if (var->GetInitializer()) WalkExpr(var->GetInitializer());
+        Symbol sym(decl->GetIdentifier()->GetName(), decl, E_VarDecl);
+        table.insert(sym);
+    } else if (fn) {
+        Symbol sym(decl->GetIdentifier()->GetName(), decl, E_FunctionDecl);
+        table.insert(sym);
+        live = 0;
+        Push();
+        List<VarDecl*> *formals = fn->GetFormals();
+        for (int i = 0; i < formals->NumElements(); i++)
+            DeclareLocal(formals->Nth(i));
+        WalkStmt(fn->GetBody());
+        Pop();
+    }
+}
+
+/* The bodies of ifs and loops have scopes of their own, and so does a
+ * switch, all its cases together. A block does not: the statement it
+ * belongs to has already opened one.
+ */
+void Minifier::WalkStmt(Stmt *stmt) {
+    Deadline::Poll();
+    if (stmt == NULL) return;
+    Expr *expr = dynamic_cast<Expr *>(stmt);
+    if (expr) {
+        WalkExpr(expr);
+        return;
+    }
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) {
+        VarDecl *var = dynamic_cast<VarDecl *>(declStmt->GetDecl());
+        if (var && var->GetInitializer()) WalkExpr(var->GetInitializer());
+        if (var) DeclareLocal(var);
+        return;
+    }
+    StmtBlock *block = dynamic_cast<StmtBlock *>(stmt);
+    if (block) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            DeclareLocal(block->GetDecls()->Nth(i));
+    }
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        if (*exprSlot) WalkExpr(*exprSlot);
+    bool switches = dynamic_cast<SwitchStmt *>(stmt) != NULL;
+    bool scoped = dynamic_cast<ConditionalStmt *>(stmt) != NULL;
+    if (switches) Push();
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++) {
+        if (scoped) Push();
+        WalkStmt(*stmtSlot);
+        if (scoped) Pop();
+    }
+    if (switches) Pop();
+}
+
+void Minifier::WalkExpr(Expr *expr) {
+    stack.push_back(expr);
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *top = stack.back();
+        stack.pop_back();
+        if (VarExpr *var = dynamic_cast<VarExpr *>(top))
+            Refer(var->GetIdentifier());
+        else if (Call *call = dynamic_cast<Call *>(top))
+            Refer(call->GetIdentifier());
+        Expr **operand;
+        for (int i = 0; (operand = top->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+}
+
+void Minifier::DeclareLocal(VarDecl *var) {
+    Local local = { current, live++ };
+    locals[var] = local;
+    Ref self = { var->GetIdentifier(), var };
+    refs.push_back(self);
+    Symbol sym(var->GetIdentifier()->GetName(), var, E_VarDecl);
+    table.insert(sym);
+}
+
+// A function name refers to every function of that name
+void Minifier::Refer(Identifier *id) {
+    const Symbol *sym = table.find(id->GetName());
+    if (sym == NULL || (!locals.count(sym->decl) && !globals.count(sym->decl))) {
+        kept.insert(id->GetName());   // the prelude's, or nobody's
+        return;
+    }
+    Ref ref = { id, sym->decl };
+    refs.push_back(ref);
+    if (locals.count(sym->decl)) return;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        if (i != globals[sym->decl] && (sym->kind != E_FunctionDecl
+                || strcmp(decls->Nth(i)->GetIdentifier()->GetName(), id->GetName()) != 0
+                || !dynamic_cast<FnDecl *>(decls->Nth(i))))
+            continue;
+        uses[current].insert(i);
+        useCounts[i]++;
+    }
+}
+
+void Minifier::Push() {
+    table.push();
+    scopes.push_back(live);
+}
+
+void Minifier::Pop() {
+    table.pop();
+    live = scopes.back();
+    scopes.pop_back();
+}
+
+/* Reaches out from the entry points and the interface, keeping the
+ * names of both.
+ */
+void Minifier::Reach(vector<bool> *reached) {
+    int n = decls->NumElements();
+    reached->assign(n, false);
+    set<string> entries;
+    const char *entry = GetOption("entry");
+    string names = entry ? entry : "main";
+    for (size_t start = 0; start <= names.size(); ) {
+        size_t end = names.find(',', start);
+        if (end == string::npos) end = names.size();
+        if (end > start) entries.insert(names.substr(start, end - start));
+        start = end + 1;
+    }
+    bool hasEntry = false;
+    for (int i = 0; i < n; i++)
+        if (dynamic_cast<FnDecl *>(decls->Nth(i))
+            && entries.count(decls->Nth(i)->GetIdentifier()->GetName()))
+            hasEntry = true;
+
+    vector<int> work;
+    for (int i = 0; i < n; i++) {
+        Decl *decl = decls->Nth(i);
+        const char *name = decl->GetIdentifier()->GetName();
+        VarDecl *var = dynamic_cast<VarDecl *>(decl);
+        bool root = var ? IsInterface(var) : (!hasEntry || entries.count(name));
+        // main keeps its name even when it is not an entry point
+        if (var ? IsInterface(var) : entries.count(name) || strcmp(name, "main") == 0)
+            kept.insert(name);
+        if (root) {
+            (*reached)[i] = true;
+            work.push_back(i);
+        }
+    }
+    while (!work.empty()) {
+        int i = work.back();
+        work.pop_back();
+        for (set<int>::iterator it = uses[i].begin(); it != uses[i].end(); ++it) {
+            if ((*reached)[*it]) continue;
+            (*reached)[*it] = true;
+            work.push_back(*it);
+        }
+    }
+}
+
+static bool MoreUsed(const pair<int, int> &a, const pair<int, int> &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+void Minifier::Rename(const vector<bool> &reached) {
+    const ScopedTable *prelude = SymbolTable::getPrelude();
+    if (prelude) {
+        const SymMap &symbols = prelude->getSymbols();
+        for (SymMap::const_iterator it = symbols.begin(); it != symbols.end(); ++it)
+            kept.insert(it->first);
+    }
+
+    // Top-level names, the most used first; functions of one name share it
+    map<string, int> counts, firsts;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        string name = decls->Nth(i)->GetIdentifier()->GetName();
+        if (!reached[i] || kept.count(name)) continue;
+        if (!firsts.count(name)) firsts[name] = i;
+        counts[name] += useCounts[i];
+    }
+    vector<pair<int, int> > order;   // (uses, first index)
+    for (map<string, int>::iterator it = counts.begin(); it != counts.end(); ++it)
+        order.push_back(make_pair(it->second, firsts[it->first]));
+    sort(order.begin(), order.end(), MoreUsed);
+    map<string, string> topNames;
+    NameSource topSource(&kept);
+    for (int i = 0; i < order.size(); i++)
+        topNames[decls->Nth(order[i].second)->GetIdentifier()->GetName()] = topSource.Next();
+
+    // Locals avoid the names of the top-level declarations their owner
+    // uses, as well as those kept
+    map<int, vector<string> > localNames;
+    for (map<Decl *, Local>::iterator it = locals.begin(); it != locals.end(); ++it) {
+        vector<string> &names = localNames[it->second.owner];
+        if (it->second.slot < names.size()) continue;
+        set<string> used;
+        const set<int> &owned = uses[it->second.owner];
+        for (set<int>::const_iterator u = owned.begin(); u != owned.end(); ++u) {
+            string name = decls->Nth(*u)->GetIdentifier()->GetName();
+            used.insert(topNames.count(name) ? topNames[name] : name);
+        }
+        NameSource source(&kept, &used);
+        for (int i = 0; i < names.size(); i++) source.Next();
+        while (names.size() <= it->second.slot) names.push_back(source.Next());
+    }
+
+    for (int i = 0; i < refs.size(); i++) {
+        map<Decl *, Local>::iterator local = locals.find(refs[i].decl);
+        if (local != locals.end()) {
+            out->Rename(refs[i].id, localNames[local->second.owner][local->second.slot]);
+            continue;
+        }
+        map<string, string>::iterator top = topNames.find(refs[i].decl->GetIdentifier()->GetName());
+        if (top != topNames.end())
+            out->Rename(refs[i].id, top->second);
+    }
+}
+
+void Minifier::Drop(const vector<bool> &reached) {
+    int kept = 0;
+    for (int i = 0; i < decls->NumElements(); i++)
+        if (reached[i]) decls->NthRef(kept++) = decls->Nth(i);
+    while (decls->NumElements() > kept)
+        decls->RemoveAt(decls->NumElements() - 1);
+}
+
+void Minify(Program *program, GlslWriter *out) {
+    Minifier minifier(program, out);
+    minifier.Run();
+}
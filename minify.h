@@ -0,0 +1,39 @@
+/* File: minify.h
+ * --------------
+ * glc --emit-glsl <file> --minify: the GLSL written out as small as it
+ * can be while checking just as before, for shaders that are downloaded
+ * and compiled at run time.
+ *
+ * The writer leaves out every space and line break that does not keep
+ * two tokens apart (see GlslWriter). Before it runs, the functions and
+ * global variables that cannot be reached from the entry points (main,
+ * or those --entry=name[,name...] lists) are dropped; if the program has
+ * none of the entry points, every function is kept. Global variables
+ * with an in, out or uniform qualifier are the shader's interface and
+ * are always kept, under their own names, as are the entry points. The
+ * other functions and global variables, and all parameters and local
+ * variables, are renamed to the shortest names that nothing they would
+ * collide with uses: the most used globals get the shortest names, and
+ * locals reuse names freely, as long as they cannot hide a global their
+ * function uses or a local still in scope.
+ *
+ * To tell which declaration each name refers to, the program is gone
+ * through again with a symbol table of its own, scoped the way the
+ * checker scopes it. Names declared by the prelude are left alone, and
+ * nothing is renamed to one of them.
+ */
+
+#ifndef _H_minify
+#define _H_minify
+
+class Program;
+class GlslWriter;
+
+/* Function: Minify()
+ * ------------------
+ * Drops the unreachable declarations of program, and tells out the new
+ * name of each identifier that is renamed.
+ */
+void Minify(Program *program, GlslWriter *out);
+
+#endif
@@ -0,0 +1,114 @@
+/* File: options.cc
+ * ----------------
+ * The table of command-line options.
+ */
+
+#include <vector>
+#include "options.h"
+#include "utility.h"
+
+using namespace std;
+
+const OptionInfo glcOptions[] = {
+    // Where the input comes from and how it is checked
+    { "serve", " <socket>", SeparateValue,
+      "run as a validation daemon on socket (see serve.h)" },
+    { "workers", "=n", 0,
+      "worker processes of the daemon, one per CPU if 0" },
+    { "cache-dir", " <dir>", SeparateValue,
+      "look results up in and save them to dir (see cache.h)" },
+    { "cache-size", "=bytes", 0,
+      "most bytes the cache directory may hold" },
+    { "prelude", " <file>", SeparateValue,
+      "check file first for every shader (see prelude.h)" },
+    { "emit-pch", " <file>", SeparateValue,
+      "write prelude file to the image -o names (see pch.h)" },
+    { "pch", " <image>", SeparateValue,
+      "load a prelude written by --emit-pch" },
+    { "ast", " <file>", SeparateValue,
+      "check a tree written by --emit-ast instead of source" },
+    { "stream", "", 0,
+      "check and free each declaration as it is parsed" },
+    { "jobs", "[=n]", 0,
+      "check function bodies on n threads, one per core if no n" },
+    { "reachable-only", "", ProgramOnly,
+      "check only what the entry points reach (see callgraph.h)" },
+    { "entry", "=name[,name...]", 0,
+      "the entry points for --reachable-only, main if not given" },
+    { "max-depth", "=n", 0,
+      "report expressions nested deeper than n as errors" },
+
+    // Limits on each check
+    { "deadline", "=ms", 0,
+      "give up on a check after ms milliseconds (see deadline.h)" },
+    { "max-input-bytes", "=n", 0, "give up past n bytes of source (see bounds.h)" },
+    { "max-tokens", "=n", 0, "give up past n tokens" },
+    { "max-nodes", "=n", 0, "give up past n tree nodes" },
+    { "max-nesting", "=n", 0, "give up past n levels of open brackets" },
+    { "max-scope-depth", "=n", 0, "give up past n nested scopes" },
+    { "max-arena-bytes", "=n", 0, "give up past n bytes of tree" },
+
+    // What is written out, and the passes over the program before it is
+    // (see passes.h)
+    { "emit-ast", " <file>", SeparateValue | ProgramOnly,
+      "write the parsed tree to file (see ast_binary.h)" },
+    { "dump-ast", "=json", ProgramOnly,
+      "print the checked tree as JSON (see ast_json.h)" },
+    { "inline", "[=cost]", ProgramOnly,
+      "inline calls to small functions (see inline.h)" },
+    { "fold", "", ProgramOnly, "fold constants (see fold.h)" },
+    { "unroll", "[=n]", ProgramOnly,
+      "unroll loops that run at most n times (see unroll.h)" },
+    { "dce", "", ProgramOnly, "remove dead code (see dce.h)" },
+    { "flatten", "[=cost]", ProgramOnly,
+      "turn ifs that only store into selects (see flatten.h)" },
+    { "hoist-uniforms", " <manifest>", SeparateValue | ProgramOnly,
+      "take out what only uniforms decide (see hoist.h)" },
+    { "cse", "", ProgramOnly,
+      "compute repeated expressions once (see cse.h)" },
+    { "emit-glsl", " <file>", SeparateValue | ProgramOnly,
+      "write the program to file as GLSL, - for stdout (see glsl.h)" },
+    { "minify", "", ProgramOnly,
+      "make the GLSL as small as it can be (see minify.h)" },
+    { "dump-ir", "", ProgramOnly,
+      "print the program in SSA form (see lower.h)" },
+
+    { "help", "", 0, "print this and exit" },
+    { NULL, NULL, 0, NULL }
+};
+
+const char **OptionsFlagged(int flags) {
+    vector<const char *> *names = new vector<const char *>;
+    for (int i = 0; glcOptions[i].name; i++)
+        if ((glcOptions[i].flags & flags) == flags)
+            names->push_back(glcOptions[i].name);
+    names->push_back(NULL);
+    return names->data();
+}
+
+ProgramOptionsOff::ProgramOptionsOff() {
+    static const char **programOptions = OptionsFlagged(ProgramOnly);
+    for (int i = 0; programOptions[i]; i++) {
+        saved.push_back(GetOption(programOptions[i]));
+        SetOption(programOptions[i], NULL);
+    }
+    dumpAST = IsDebugOn("dumpAST");
+    SetDebugForKey("dumpAST", false);
+}
+
+ProgramOptionsOff::~ProgramOptionsOff() {
+    static const char **programOptions = OptionsFlagged(ProgramOnly);
+    for (int i = 0; programOptions[i]; i++)
+        SetOption(programOptions[i], saved[i]);
+    SetDebugForKey("dumpAST", dumpAST);
+}
+
+void PrintUsage(FILE *fp) {
+    fprintf(fp, "Usage: glc [--option[=value] ...] [-o file] [file ...] [-d <debug-key> ...]\n"
+                "Checks the shader on stdin, or each file named in turn.\n\n");
+    for (int i = 0; glcOptions[i].name; i++) {
+        char usage[64];
+        snprintf(usage, sizeof(usage), "--%s%s", glcOptions[i].name, glcOptions[i].value);
+        fprintf(fp, "  %-27s %s\n", usage, glcOptions[i].help);
+    }
+}
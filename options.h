@@ -0,0 +1,65 @@
+/* File: options.h
+ * ---------------
+ * The table of glc's command-line options: for each, its name, how its
+ * value is written if it takes one, whether it concerns only the
+ * program being checked, and a line saying what it does. It is the one
+ * place an option is listed. glc --help prints it, main() hands
+ * ParseCommandLine() the options whose value may be the next argument
+ * and has it refuse any option the table does not list, and the
+ * prelude and glc_check() turn off those that concern only the program
+ * while they parse (see prelude.h and glc.h). What an option does in
+ * detail is told where it is implemented, in the header its line names.
+ */
+
+#ifndef _H_options
+#define _H_options
+
+#include <stdio.h>
+#include <vector>
+
+// What an option's flags say about it
+enum {
+    SeparateValue = 1,    // its value may also be given as the next argument
+    ProgramOnly = 2       // it concerns only the program, not the prelude
+};
+
+struct OptionInfo {
+    const char *name;
+    const char *value;    // how the value is written after the name, or ""
+    int flags;
+    const char *help;
+};
+
+// The options, in the order --help lists them, ending with a NULL name
+extern const OptionInfo glcOptions[];
+
+/* Function: OptionsFlagged()
+ * --------------------------
+ * Returns the names of the options that have all of flags, in a
+ * NULL-terminated array that lasts as long as the program.
+ */
+const char **OptionsFlagged(int flags);
+
+/* Class: ProgramOptionsOff
+ * ------------------------
+ * Turns off the options that concern only the program, and the dumpAST
+ * debug key, for as long as it lives, so that what is parsed meanwhile
+ * is only checked: nothing is printed, rewritten or written out for it.
+ */
+class ProgramOptionsOff {
+  public:
+    ProgramOptionsOff();
+    ~ProgramOptionsOff();
+
+  private:
+    std::vector<const char *> saved;
+    bool dumpAST;
+};
+
+/* Function: PrintUsage()
+ * ----------------------
+ * Prints how glc is invoked and what each option does to fp.
+ */
+void PrintUsage(FILE *fp);
+
+#endif
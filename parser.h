@@ -35,4 +35,37 @@
 int yyparse();              // Defined in the generated y.tab.c file
 void InitParser();          // Defined in parser.y
 
+#include <string>
+
+struct yypstate;
+
+/* Class: GlcParser
+ * ----------------
+ * Push interface to the parser for callers that receive the source a
+ * piece at a time (editor buffers, network uploads). Feed() may be called
+ * any number of times with consecutive chunks of the input; every complete
+ * line is scanned and parsed right away. Finish() flushes the remainder
+ * and signals end of input, at which point the program is checked just as
+ * it is after yyparse(). Both return 0 once the input has been accepted,
+ * 1 or 2 if parsing was aborted, and YYPUSH_MORE while more input is
+ * expected. The generated parser keeps its state in globals, so only one
+ * GlcParser may be live at a time; it also initializes the scanner, so
+ * there is no need to call InitScanner()/InitParser() first.
+ */
+class GlcParser {
+  public:
+    GlcParser();
+    ~GlcParser();
+
+    int Feed(const char *text, size_t len);
+    int Finish();
+
+  private:
+    yypstate *state;
+    int status;
+    std::string pending;    // trailing partial line not yet scanned
+
+    void PushTokens();
+};
+
 #endif
@@ -19,11 +19,28 @@
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
+#include "ast_binary.h"
+#include "ast_json.h"
+#include "passes.h"
+#include "arena.h"
+#include "bounds.h"
 
 void yyerror(const char *msg); // standard error-handling routine
 
+static bool streaming;              // see CheckStreamed()
+static Arena::Mark bodyMark;        // where the body being parsed starts
+static vector<Diagnostic> streamErrors;
+static void CheckStreamed(Decl *decl, bool hasBody);
+static void FinishStreamed();
+
 %}
 
+/* Generate both the classic yyparse() entry point, which pulls tokens
+ * from yylex(), and a push interface (yypstate/yypush_parse) that
+ * GlcParser uses to parse input handed to it a chunk at a time.
+ */
+%define api.push-pull both
+
 /* The section before the first %% is the Definitions section of the yacc
  * input file. Here is where you declare tokens and types, add precedence
  * and associativity options, and so on.
@@ -139,11 +156,19 @@ Program   :    DeclList            {
                                        * it once you have other uses of @n*/
                                       Program *program = new Program($1);
                                       // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) {
+                                      if (streaming) {
+                                          FinishStreamed();
+                                      } else if (ReportError::NumErrors() == 0) {
                                           if ( IsDebugOn("dumpAST") ) {
                                             program->Print(0);
+                                            printf("\n");
                                           }
+                                          const char *astFile = GetOption("emit-ast");
+                                          if (astFile) WriteAst(program, astFile);
                                           program->Check();
+                                          RunPasses(program);
+                                          if (GetOption("dump-ast"))
+                                              DumpAstJson(program);
                                       }
                                     }
           ;
@@ -160,8 +185,14 @@ DeclList  :    DeclList Decl        { ($$=$1)->Append($2); }
  *       function_prototype compound_statement
  */
    
-Decl      :    Declaration                   { $$ = $1; }
-          |    FuncDecl CompoundStatement    { $1->SetFunctionBody($2); $$ = $1; }
+Decl      :    Declaration                   { $$ = $1; CheckStreamed($$, false); }
+          |    FuncDecl                      { bodyMark = AstArena().GetMark(); }
+               CompoundStatement             {
+                                               $1->SetFunctionBody($3);
+                                               $1->SetExtent(@$);
+                                               $$ = $1;
+                                               CheckStreamed($$, true);
+                                             }
           ;
 
 /* combine declaration and init_decl_list into a single rule
@@ -501,4 +532,102 @@ void InitParser()
 {
    PrintDebug("parser", "Initializing parser");
    yydebug = false;
+   // Printing or writing out the tree, finding what is reachable in it,
+   // or rewriting it, needs all of it
+   streaming = GetOption("stream") && !IsDebugOn("dumpAST")
+               && !GetOption("emit-ast") && !GetOption("dump-ast")
+               && !GetOption("reachable-only") && !PassesWanted();
+   streamErrors.clear();
+}
+
+/* Function: CheckStreamed
+ * -----------------------
+ * With --stream each top-level declaration is checked as soon as it has
+ * been parsed, instead of the whole program once parsing is done, and
+ * the body of a function definition is released from the arena once it
+ * has been checked. Only the declarations themselves stay, which is all
+ * the symbol table refers to, so memory peaks at the largest function
+ * rather than growing with the file. This relies on the scanner never
+ * allocating from the arena, so that everything past bodyMark belongs
+ * to the body.
+ *
+ * An unstreamed check never happens if the parse fails, so the errors
+ * found here are held back until it succeeds (FinishStreamed()) and
+ * dropped otherwise, and the output is the same either way.
+ */
+static void CheckStreamed(Decl *decl, bool hasBody)
+{
+   if (!streaming || ReportError::NumErrors() > 0) return;
+   vector<Diagnostic> *outer = ReportError::Capture(&streamErrors);
+   decl->Check();
+   ReportError::Capture(outer);
+   if (hasBody) {
+      static_cast<FnDecl *>(decl)->DropFunctionBody();
+      AstArena().Release(bodyMark);
+   }
+}
+
+static void FinishStreamed()
+{
+   if (ReportError::NumErrors() == 0)
+      for (int i = 0; i < streamErrors.size(); i++)
+         ReportError::Report(streamErrors[i]);
+   streamErrors.clear();
+}
+
+/* Class: GlcParser
+ * ----------------
+ * Push-style front end, see parser.h. Each Feed() hands the scanner
+ * everything up to the last complete line received so far and pushes
+ * the resulting tokens into the parser; the partial last line is held
+ * back until the rest of it arrives (no token spans a newline, and the
+ * scanner carries an open comment over in its own state).
+ */
+GlcParser::GlcParser()
+{
+   InitScanner();
+   InitParser();
+   state = yypstate_new();
+   status = state ? YYPUSH_MORE : 2;
+}
+
+GlcParser::~GlcParser()
+{
+   if (state) yypstate_delete(state);
+}
+
+int GlcParser::Feed(const char *text, size_t len)
+{
+   if (status != YYPUSH_MORE) return status;
+   Bounds::CheckBuffered(pending.size() + len);
+   pending.append(text, len);
+   size_t lineEnd = pending.rfind('\n');
+   if (lineEnd == string::npos) return status;
+   ScanChunk(pending.data(), lineEnd + 1, true);
+   pending.erase(0, lineEnd + 1);
+   PushTokens();
+   return status;
+}
+
+int GlcParser::Finish()
+{
+   if (status != YYPUSH_MORE) return status;
+   ScanChunk(pending.data(), pending.size(), false);
+   pending.clear();
+   PushTokens();
+   if (status == YYPUSH_MORE) {
+      yychar = 0; // token code 0 is end of input
+      status = yypush_parse(state);
+   }
+   return status;
+}
+
+void GlcParser::PushTokens()
+{
+   int token;
+   while (status == YYPUSH_MORE && (token = yylex()) != 0) {
+      yychar = token;
+      status = yypush_parse(state);
+   }
+   RethrowAbandoned();
 }
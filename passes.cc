@@ -0,0 +1,60 @@
+/* File: passes.cc
+ * ---------------
+ * Implementation of the passes over a checked program.
+ */
+
+#include <stdlib.h>
+#include "passes.h"
+#include "utility.h"
+#include "errors.h"
+#include "inline.h"
+#include "fold.h"
+#include "unroll.h"
+#include "dce.h"
+#include "flatten.h"
+#include "hoist.h"
+#include "cse.h"
+#include "glsl.h"
+#include "ir.h"
+#include "lower.h"
+
+bool PassesWanted() {
+    return GetOption("inline") || GetOption("fold") || GetOption("unroll")
+           || GetOption("dce") || GetOption("flatten") || GetOption("hoist-uniforms") || GetOption("cse") || GetOption("dump-ir")
+           || GetOption("emit-glsl");
+}
+
+void RunPasses(Program *program) {
+    if (ReportError::NumErrors() > 0) return;
+    const char *cost = GetOption("inline");
+    if (cost)
+        InlineCalls(program, *cost ? atoi(cost) : DefaultInlineCost);
+    if (GetOption("fold"))
+        FoldConstants(program);
+    const char *unroll = GetOption("unroll");
+    if (unroll && UnrollLoops(program, *unroll ? atoi(unroll) : DefaultUnrollTrips) > 0
+        && GetOption("fold"))
+        FoldConstants(program);     // what the copies compute from their counters
+    if (GetOption("dce"))
+        EliminateDeadCode(program);
+    const char *flatten = GetOption("flatten");
+    if (flatten)
+        FlattenBranches(program, *flatten ? atoi(flatten) : DefaultFlattenCost);
+    const char *manifest = GetOption("hoist-uniforms");
+    if (manifest)
+        HoistUniforms(program, manifest);
+    if (GetOption("cse"))
+        EliminateCommonSubexpressions(program);
+    if (GetOption("dump-ir")) {
+        IrProgram *ir = LowerProgram(program);
+        if (!VerifyIr(ir)) {
+            // What is wrong is already on stderr; an error makes glc fail
+            ReportError::Formatted(NULL, "Internal error: the IR lowered from the program"
+                                         " is malformed");
+            return;
+        }
+        DumpIr(ir, std::cout);
+    }
+    const char *glslFile = GetOption("emit-glsl");
+    if (glslFile) EmitGlsl(program, glslFile, GetOption("minify") != NULL);
+}
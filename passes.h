@@ -0,0 +1,46 @@
+/* File: passes.h
+ * --------------
+ * What glc does with a program once it has checked without errors,
+ * besides dumping it: the passes the command line asks for, which
+ * rewrite the tree in place, and then the tree written out as GLSL if
+ * --emit-glsl <file> says where (see glsl.h). With --inline[=cost] the
+ * calls to functions that cost at most cost are inlined (see inline.h),
+ * with --fold constants are folded (see fold.h), then with --unroll[=n]
+ * loops that run at most n times are unrolled (see unroll.h), and folded
+ * again if anything was, with --dce dead code is removed (see dce.h),
+ * with --flatten[=cost] ifs that only store values costing at most cost
+ * are turned into selects (see flatten.h), with --hoist-uniforms
+ * <manifest> what only uniforms and constants decide is taken out into
+ * new uniforms the engine sets (see hoist.h) and with --cse repeated
+ * expressions are computed once (see cse.h);
+ * --minify drops and renames declarations as the program is written
+ * out (see minify.h). With --dump-ir the program is lowered to SSA
+ * form, checked and printed to stdout (see lower.h); if the IR is
+ * malformed an error is reported instead, and nothing is written out.
+ *
+ * The passes need every expression's type and every variable's
+ * declaration, which a memo hit leaves unset and streaming throws away,
+ * so neither is used when a pass or --emit-glsl is asked for (see
+ * PassesWanted()).
+ */
+
+#ifndef _H_passes
+#define _H_passes
+
+class Program;
+
+/* Function: PassesWanted()
+ * ------------------------
+ * Returns whether the command line asks for any of the passes or for
+ * the GLSL output.
+ */
+bool PassesWanted();
+
+/* Function: RunPasses()
+ * ---------------------
+ * Runs the passes asked for over program, then writes it out as GLSL if
+ * asked to. Does nothing if errors have been reported.
+ */
+void RunPasses(Program *program);
+
+#endif
@@ -0,0 +1,239 @@
+/* File: pch.cc
+ * ------------
+ * Implementation of precompiled prelude images.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "pch.h"
+#include "prelude.h"
+#include "symtable.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+#include "glc.h"
+
+using namespace std;
+
+static const char PchMagic[8] = "glcpch";
+
+struct PchHeader {
+    char magic[8];
+    char version[8];
+    uint64_t fingerprint;     // of the prelude source, see prelude.h
+    uint32_t numGlobals;
+    uint32_t numFormals;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+
+/* One declaration: a global, or a formal of one of the global functions.
+ * The globals come first, then all the formals in order of the functions
+ * they belong to, then the names as NUL-terminated strings.
+ */
+struct PchDecl {
+    uint32_t name;            // offset into the names
+    int32_t kind;             // EntryKind
+    int32_t line, column, lastColumn;
+    int32_t qualifier;        // TypeQualifier::IndexOf(), -1 for none
+    int32_t type;             // Type::IndexOf(), -1 for none
+    int32_t elemCount;        // for an array of type, else -1
+    uint32_t firstFormal, numFormals;
+};
+
+static bool EncodeType(Type *type, PchDecl *record) {
+    record->type = record->elemCount = -1;
+    if (type == NULL) return true;
+    if (ArrayType *array = dynamic_cast<ArrayType *>(type)) {
+        record->elemCount = array->GetElemCount();
+        type = array->GetElemType();
+    }
+    record->type = Type::IndexOf(type);
+    return record->type >= 0;
+}
+
+static uint32_t AddName(string *names, const char *name) {
+    uint32_t offset = names->size();
+    names->append(name, strlen(name) + 1);
+    return offset;
+}
+
+static bool EncodeDecl(Decl *decl, EntryKind kind, string *names, PchDecl *record) {
+    memset(record, 0, sizeof(*record));
+    record->name = AddName(names, decl->GetIdentifier()->GetName());
+    record->kind = kind;
+    record->line = decl->GetLocation()->first_line;
+    record->column = decl->GetLocation()->first_column;
+    record->lastColumn = decl->GetLocation()->last_column;
+    if (VarDecl *var = dynamic_cast<VarDecl *>(decl)) {
+        record->qualifier = TypeQualifier::IndexOf(var->GetTypeQualifier());
+        return EncodeType(var->GetType(), record);
+    }
+    FnDecl *fn = dynamic_cast<FnDecl *>(decl);
+    record->qualifier = TypeQualifier::IndexOf(fn->GetTypeQualifier());
+    return EncodeType(fn->GetType(), record);
+}
+
+bool WritePch(const char *path) {
+    const ScopedTable *prelude = SymbolTable::getPrelude();
+    if (!prelude) {
+        fprintf(stderr, "glc: no prelude to write to %s\n", path);
+        return false;
+    }
+
+    vector<PchDecl> globals, formals;
+    string names;
+    const SymMap &symbols = prelude->getSymbols();
+    for (SymMap::const_iterator it = symbols.begin(); it != symbols.end(); ++it) {
+        PchDecl record;
+        bool ok = EncodeDecl(it->second.decl, it->second.kind, &names, &record);
+        FnDecl *fn = dynamic_cast<FnDecl *>(it->second.decl);
+        List<VarDecl*> *list = fn ? fn->GetFormals() : NULL;
+        record.firstFormal = formals.size();
+        for (int i = 0; ok && list && i < list->NumElements(); i++) {
+            PchDecl formal;
+            ok = EncodeDecl(list->Nth(i), E_VarDecl, &names, &formal);
+            formals.push_back(formal);
+        }
+        record.numFormals = formals.size() - record.firstFormal;
+        if (!ok) {
+            fprintf(stderr, "glc: cannot precompile the type of '%s'\n", it->first);
+            return false;
+        }
+        globals.push_back(record);
+    }
+
+    PchHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PchMagic, sizeof(header.magic));
+    strncpy(header.version, GLC_VERSION, sizeof(header.version));
+    header.fingerprint = PreludeFingerprint();
+    header.numGlobals = globals.size();
+    header.numFormals = formals.size();
+    header.stringsSize = names.size();
+
+    FILE *fp = fopen(path, "wb");
+    bool ok = fp && fwrite(&header, sizeof(header), 1, fp) == 1
+              && fwrite(globals.data(), sizeof(PchDecl), globals.size(), fp) == globals.size()
+              && fwrite(formals.data(), sizeof(PchDecl), formals.size(), fp) == formals.size()
+              && fwrite(names.data(), 1, names.size(), fp) == names.size();
+    if (fp && fclose(fp) != 0) ok = false;
+    if (!ok) {
+        perror("glc: cannot write precompiled prelude");
+        unlink(path);
+    }
+    return ok;
+}
+
+/* Checks everything a record refers to lies within the image, so that a
+ * damaged image is rejected rather than crashing the loader.
+ */
+static bool ValidRecord(const PchDecl &record, const PchHeader &header, const char *names) {
+    return record.name < header.stringsSize
+           && (record.kind == E_VarDecl || record.kind == E_FunctionDecl)
+           && (record.qualifier == -1 || TypeQualifier::WithIndex(record.qualifier))
+           && (record.type == -1 || Type::WithIndex(record.type))
+           && (record.type >= 0 || (record.elemCount == -1 && record.kind == E_VarDecl
+                                    && record.qualifier >= 0))
+           && record.firstFormal <= header.numFormals
+           && record.numFormals <= header.numFormals - record.firstFormal;
+}
+
+static Type *DecodeType(const PchDecl &record) {
+    if (record.type < 0) return NULL;
+    Type *type = Type::WithIndex(record.type);
+    if (record.elemCount < 0) return type;
+    yyltype loc;
+    memset(&loc, 0, sizeof(loc));
+    return new ArrayType(loc, type, record.elemCount);
+}
+
+static Identifier *DecodeName(const PchDecl &record, const char *names) {
+    yyltype loc;
+    memset(&loc, 0, sizeof(loc));
+    loc.first_line = loc.last_line = record.line;
+    loc.first_column = record.column;
+    loc.last_column = record.lastColumn;
+    return new Identifier(loc, names + record.name);
+}
+
+static VarDecl *DecodeVar(const PchDecl &record, const char *names) {
+    Identifier *id = DecodeName(record, names);
+    Type *type = DecodeType(record);
+    if (record.qualifier < 0) return new VarDecl(id, type);
+    TypeQualifier *typeq = TypeQualifier::WithIndex(record.qualifier);
+    return type ? new VarDecl(id, type, typeq) : new VarDecl(id, typeq);
+}
+
+static FnDecl *DecodeFn(const PchDecl &record, const PchDecl *formals, const char *names) {
+    List<VarDecl*> *list = new List<VarDecl*>;
+    for (uint32_t i = 0; i < record.numFormals; i++)
+        list->Append(DecodeVar(formals[record.firstFormal + i], names));
+    Identifier *id = DecodeName(record, names);
+    Type *type = DecodeType(record);
+    if (record.qualifier < 0) return new FnDecl(id, type, list);
+    return new FnDecl(id, type, TypeQualifier::WithIndex(record.qualifier), list);
+}
+
+bool LoadPch(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("glc: cannot open precompiled prelude");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void *image = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (image == MAP_FAILED) {
+        fprintf(stderr, "glc: cannot map precompiled prelude %s\n", path);
+        return false;
+    }
+
+    const PchHeader *header = (const PchHeader *)image;
+    const PchDecl *globals = (const PchDecl *)(header + 1);
+    const PchDecl *formals = globals;
+    const char *names = NULL;
+    bool ok = st.st_size >= sizeof(PchHeader)
+              && memcmp(header->magic, PchMagic, sizeof(header->magic)) == 0
+              && strncmp(header->version, GLC_VERSION, sizeof(header->version)) == 0
+              && st.st_size == sizeof(PchHeader)
+                               + ((uint64_t)header->numGlobals + header->numFormals) * sizeof(PchDecl)
+                               + header->stringsSize
+              && header->stringsSize > 0;
+    if (ok) {
+        formals = globals + header->numGlobals;
+        names = (const char *)(formals + header->numFormals);
+        ok = names[header->stringsSize - 1] == '\0';
+    }
+    for (uint32_t i = 0; ok && i < header->numGlobals + header->numFormals; i++)
+        ok = ValidRecord(globals[i], *header, names)
+             && (i < header->numGlobals || (globals[i].kind == E_VarDecl && globals[i].numFormals == 0))
+             && (globals[i].kind == E_FunctionDecl || globals[i].numFormals == 0);
+    if (!ok) {
+        fprintf(stderr, "glc: %s is not a precompiled prelude for glc %s\n", path, GLC_VERSION);
+        munmap(image, st.st_size);
+        return false;
+    }
+
+    ScopedTable *scope = new ScopedTable();
+    for (uint32_t i = 0; i < header->numGlobals; i++) {
+        Decl *decl;
+        if (globals[i].kind == E_FunctionDecl)
+            decl = DecodeFn(globals[i], formals, names);
+        else
+            decl = DecodeVar(globals[i], names);
+        Symbol sym(decl->GetIdentifier()->GetName(), decl, (EntryKind)globals[i].kind);
+        scope->insert(sym);
+    }
+    SymbolTable::installPrelude(scope);
+    SetPreludeFingerprint(header->fingerprint);
+    munmap(image, st.st_size);
+    return true;
+}
@@ -0,0 +1,43 @@
+/**
+ * File: pch.h
+ * -----------
+ * Precompiled preludes. glc --emit-pch prelude.glsl -o prelude.glcpch
+ * checks a prelude (see prelude.h) and writes its frozen global scope to
+ * an image file; glc --pch prelude.glcpch maps the image and installs
+ * the scope it describes without scanning, parsing or checking anything.
+ *
+ * The checker only ever looks at the declarations in the prelude scope,
+ * never at function bodies or initializers, so that is all an image
+ * holds: one fixed-size record per global (name, kind, position, type
+ * qualifier and type), followed by the records of the functions'
+ * formals and a table of the identifier names they refer to. Records
+ * refer to names and formals by index rather than by address, so the
+ * image can be mapped anywhere. Types are built-in types or arrays of
+ * them and are stored by their index in a fixed table. Loading rebuilds
+ * a declaration node for each record in the AST arena, below any later
+ * mark, just as a checked prelude's tree is.
+ *
+ * Images are written in the host's byte order and carry the glc version
+ * they were made by; any other version refuses to load them.
+ */
+
+#ifndef _H_pch
+#define _H_pch
+
+/* Function: WritePch()
+ * --------------------
+ * Writes the installed prelude to an image at path. Returns false, after
+ * saying why on stderr, if there is no prelude or the image cannot be
+ * written.
+ */
+bool WritePch(const char *path);
+
+/* Function: LoadPch()
+ * -------------------
+ * Installs the prelude in the image at path, replacing any current one.
+ * Returns false, after saying why on stderr, if the image cannot be read
+ * or is not one this version of glc wrote.
+ */
+bool LoadPch(const char *path);
+
+#endif
@@ -0,0 +1,62 @@
+/* File: prelude.cc
+ * ----------------
+ * Implementation of prelude loading.
+ */
+
+#include "prelude.h"
+#include "parser.h"
+#include "errors.h"
+#include "symtable.h"
+#include "memo.h"
+#include "utility.h"
+#include "options.h"
+
+static uint64_t preludeFingerprint;
+
+// 64-bit FNV-1a
+static uint64_t Hash(const char *data, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int LoadPrelude(const char *src, size_t len) {
+    // Not memoized: the prelude is only ever checked once
+    bool memoize = FunctionMemo::enabled;
+    FunctionMemo::enabled = false;
+    // The prelude is not the program, so the options that concern only
+    // the program, such as those asking for its tree to be output, are
+    // turned off while it is parsed
+    ProgramOptionsOff off;
+
+    SymbolTable::dropPrelude();
+    preludeFingerprint = 0;
+    ResetSymbolTable();
+    ReportError::ResetNumErrors();
+    {
+        GlcParser parser;
+        parser.Feed(src, len);
+        parser.Finish();
+    }
+    int errors = ReportError::NumErrors();
+    if (errors == 0) {
+        Node::symtable->freezeGlobalScope();
+        preludeFingerprint = Hash(src, len);
+    }
+
+    ResetSymbolTable();
+    ReportError::ResetNumErrors();
+    FunctionMemo::enabled = memoize;
+    return errors;
+}
+
+uint64_t PreludeFingerprint() {
+    return preludeFingerprint;
+}
+
+void SetPreludeFingerprint(uint64_t fingerprint) {
+    preludeFingerprint = fingerprint;
+}
@@ -0,0 +1,45 @@
+/**
+ * File: prelude.h
+ * ---------------
+ * Support for glc --prelude, a file of declarations (uniforms, helper
+ * functions) that many shaders start with. The prelude is parsed and
+ * checked once, and its global scope is then frozen under the symbol
+ * table of every program checked afterwards (see
+ * SymbolTable::freezeGlobalScope), so each shader pays only for its own
+ * declarations. Shaders are checked as if the prelude came first, except
+ * that positions in the prelude, such as the line a conflicting
+ * declaration quotes, are lines of the prelude file.
+ *
+ * The prelude's tree is allocated in the AST arena below any mark taken
+ * after loading it, so it stays put while programs come and go; it is
+ * never freed. Load the prelude before forking, so that the daemon's
+ * workers share its pages.
+ */
+
+#ifndef _H_prelude
+#define _H_prelude
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Function: LoadPrelude()
+ * -----------------------
+ * Checks the len bytes at src as the prelude, reporting its errors the
+ * usual way, and returns how many there were. It replaces any previous
+ * prelude, but is only installed if it has no errors; otherwise there is
+ * no prelude afterwards. Either way the symbol table and error count are
+ * reset.
+ */
+int LoadPrelude(const char *src, size_t len);
+
+/* Function: PreludeFingerprint(), SetPreludeFingerprint()
+ * --------------------------------------------------------
+ * A hash of the installed prelude's source, 0 if there is none. Results
+ * depend on the prelude, so this is part of the result cache key. A
+ * prelude loaded from a precompiled image (see pch.h) carries the
+ * fingerprint of the source it was built from.
+ */
+uint64_t PreludeFingerprint();
+void SetPreludeFingerprint(uint64_t fingerprint);
+
+#endif
@@ -0,0 +1,110 @@
+/* File: protocol.cc
+ * -----------------
+ * Framing and JSON rendering for the validation daemon.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include "protocol.h"
+
+static bool ReadFully(int fd, char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool WriteFully(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+int ConnectToDaemon(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+bool ReadFrame(int fd, string *payload) {
+    uint32_t header;
+    if (!ReadFully(fd, (char *)&header, sizeof(header))) return false;
+    uint32_t len = ntohl(header);
+    if (len > MaxFrameBytes) return false;
+    payload->resize(len);
+    return len == 0 || ReadFully(fd, &(*payload)[0], len);
+}
+
+bool WriteFrame(int fd, const string &payload) {
+    uint32_t header = htonl(payload.size());
+    // One write for small frames so they go out in a single segment
+    if (payload.size() < 4096) {
+        string frame((const char *)&header, sizeof(header));
+        frame += payload;
+        return WriteFully(fd, frame.data(), frame.size());
+    }
+    return WriteFully(fd, (const char *)&header, sizeof(header)) &&
+           WriteFully(fd, payload.data(), payload.size());
+}
+
+static void AppendJsonString(string &out, const char *s) {
+    out += '"';
+    for (; *s; s++) {
+        switch (*s) {
+          case '"': out += "\\\""; break;
+          case '\\': out += "\\\\"; break;
+          case '\n': out += "\\n"; break;
+          case '\t': out += "\\t"; break;
+          default:
+            if ((unsigned char)*s < 0x20) {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", *s);
+                out += escape;
+            } else {
+                out += *s;
+            }
+        }
+    }
+    out += '"';
+}
+
+string ResultToJson(const glc_result *result) {
+    string out;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"errors\":%d,\"diagnostics\":[", result->num_diagnostics);
+    out += buf;
+    for (int i = 0; i < result->num_diagnostics; i++) {
+        const glc_diagnostic *d = &result->diagnostics[i];
+        snprintf(buf, sizeof(buf), "%s{\"code\":%d,\"line\":%d,\"column\":%d,\"endColumn\":%d,\"message\":",
+                 i ? "," : "", d->code, d->span.first_line, d->span.first_column, d->span.last_column);
+        out += buf;
+        AppendJsonString(out, d->message);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
@@ -0,0 +1,56 @@
+/**
+ * File: protocol.h
+ * ----------------
+ * Wire format spoken over the socket of glc --serve (see serve.h).
+ *
+ * Every message in either direction is a frame: a 4-byte length in
+ * network byte order followed by that many bytes of payload. A client
+ * sends the shader source as the payload of a request frame and gets
+ * back one response frame holding a JSON object:
+ *
+ *   {"errors":1,"diagnostics":[{"code":10,"line":4,"column":9,
+ *     "endColumn":11,"message":"No declaration found for variable 'x'"}]}
+ *
+ * line, column and endColumn are 0 for errors without a position; the
+ * codes are the glc_code values of glc.h. Any number of requests may be
+ * sent over one connection, each answered in turn.
+ */
+
+#ifndef _H_protocol
+#define _H_protocol
+
+#include <string>
+#include "glc.h"
+
+using namespace std;
+
+// Frames larger than this are refused rather than buffered
+#define MaxFrameBytes (64 << 20)
+
+/* Function: ConnectToDaemon()
+ * ---------------------------
+ * Connects to the daemon listening on the socket at path. Returns the
+ * connected descriptor, or -1 with errno set.
+ */
+int ConnectToDaemon(const char *path);
+
+/* Function: ReadFrame()
+ * ---------------------
+ * Reads one frame from fd into payload. Returns false at end of input,
+ * on a read error, or if the frame is larger than MaxFrameBytes.
+ */
+bool ReadFrame(int fd, string *payload);
+
+/* Function: WriteFrame()
+ * ----------------------
+ * Writes payload to fd as one frame. Returns false on a write error.
+ */
+bool WriteFrame(int fd, const string &payload);
+
+/* Function: ResultToJson()
+ * ------------------------
+ * Renders the diagnostics of a glc_check() call as a response payload.
+ */
+string ResultToJson(const glc_result *result);
+
+#endif
@@ -0,0 +1,29 @@
+// Written out with --emit-ast to ast_emit.ast, which ast_load.glsl
+// checks again with --ast
+uniform mat4 transform;
+uniform float weights[3];
+in vec4 position;
+out vec4 color;
+
+float weigh(float x, int i) {
+    if (x > 0.5 && i < 3)
+        return x * weights[i];
+    return -x;
+}
+
+void main() {
+    vec4 p = position;
+    int i;
+    for (i = 0; i < 3; i++) {
+        p.x = weigh(p.x, i) + 1.5;
+        if (p.y > 0.0) break;
+    }
+    switch (i) {
+    case 1:
+        p.z = 2.0;
+        break;
+    default:
+        p.w = p.x > 0.0 ? 1.0 : 0.0;
+    }
+    color = p;
+}
@@ -0,0 +1,2 @@
+// Not read: glc --ast checks the tree ast_emit.glsl wrote to
+// ast_emit.ast instead, and writes it out as ast_emit.glsl does
@@ -0,0 +1,13 @@
+// The entry for this shader is in cache_hit/, so its errors are
+// replayed from it rather than found by checking it again
+uniform float scale;
+out vec4 color;
+
+float brighten(float x) {
+    return x * scale + offset;
+}
+
+void main() {
+    color.x = brighten(color.y);
+    color.w = true;
+}
@@ -0,0 +1,17 @@
+uniform vec3 light;
+
+float shade(vec3 n, float k) {
+	float d;
+	d = n.x * light.x + n.y * light.y + n.z * light.z;
+	if (d < 0.0) {
+		d = 0.0;
+	}
+	return d * k;
+}
+
+void main() {
+	vec3 n;
+	float c;
+	n = light;
+	c = shade(n, 0.5);
+}
@@ -0,0 +1,30 @@
+uniform vec3 n;
+uniform float k;
+float total;
+
+float bump() {
+	total = total + 1.0;
+	return total;
+}
+
+float shade(float a, float b) {
+	float x;
+	float y;
+	float z;
+	x = a * b + k;
+	y = (b * a + k) * 2.0;
+	z = n.x * k + n.y * k;
+	y = y + n.x * k;
+	a = a + 1.0;
+	x = x + a * b;
+	z = z + bump() * bump();
+	if (x > 0.0 && a * b > 1.0) {
+		z = z + a * b;
+	}
+	return x + y + z;
+}
+
+void main() {
+	float w;
+	w = shade(1.0, 2.0);
+}
@@ -0,0 +1,41 @@
+uniform float gain;
+out vec4 color;
+float total;
+
+void count() {
+	total = total + 1.0;
+}
+
+float bump() {
+	total = total + 2.0;
+	return total;
+}
+
+float pick(float x) {
+	float unused;
+	float y;
+	float z = x * 3.0;
+	unused = x + 1.0;
+	y = x * 2.0;
+	y = x * gain;
+	if (false) {
+		y = 0.0;
+	}
+	while (false) {
+		count();
+	}
+	if (x > 1.0) {
+		z = 4.0;
+	}
+	return y;
+	y = 5.0;
+}
+
+void main() {
+	float a;
+	float b;
+	a = pick(gain);
+	b = bump();
+	count();
+	color.x = a;
+}
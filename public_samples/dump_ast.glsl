@@ -0,0 +1,13 @@
+uniform float scale;
+out vec4 color;
+
+float brighten(float x) {
+    return x * scale + 0.5;
+}
+
+void main() {
+    int i;
+    for (i = 0; i < 2; i++)
+        color.x = brighten(color.x);
+    color.y = i > 1 ? -1.0 : 1.0;
+}
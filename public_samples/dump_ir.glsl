@@ -0,0 +1,19 @@
+uniform float limit;
+
+float grow(float x) {
+	float y;
+	int i;
+	y = x;
+	for (i = 0; i < 4; i++) {
+		if (y > limit) {
+			break;
+		}
+		y = y * 2.0;
+	}
+	return y;
+}
+
+void main() {
+	float z;
+	z = grow(1.5);
+}
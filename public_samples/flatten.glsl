@@ -0,0 +1,37 @@
+uniform float threshold;
+uniform float values[2];
+in vec4 level;
+out vec4 color;
+
+float bump() {
+    return threshold + 1.0;
+}
+
+void main() {
+    float a = level.x;
+    float b = level.y;
+    vec4 c = level;
+    if (a > threshold)
+        b = 1.0;
+    else
+        b = 2.0;
+    if (a > b) {
+        c.x = a;
+        c.y += b;
+    }
+    if (b < 0.0)
+        a = 0.0;
+    else {
+        if (a > 1.0)
+            a = 1.0;
+    }
+    // Left alone: a call, a subscript, and a branch that costs too much
+    if (a > 0.5)
+        b = bump();
+    if (b > 0.5)
+        a = values[1];
+    if (a < b)
+        c = c * c * c * c * c * c * c * c * c * c * c * c * c * c * c * c;
+    c.z = a + b;
+    color = c;
+}
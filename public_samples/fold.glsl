@@ -0,0 +1,23 @@
+const float scale = 2.0 * 4.0;
+const int count = 3 + 4 * 2;
+uniform float gain;
+
+float shade(float x, int n) {
+	float y;
+	int k;
+	y = x * 1.0 + 0.0;
+	y = -(-y) / 4.0;
+	y = y * scale;
+	k = n + count * 2 - 0;
+	k = k + 7 / 0;
+	bool b = 1 < 2 && true;
+	if (b) {
+		y = y + (1.0 + 2.0) * gain;
+	}
+	return y / gain;
+}
+
+void main() {
+	float z;
+	z = shade(0.5, 7 / 2);
+}
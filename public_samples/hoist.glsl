@@ -0,0 +1,22 @@
+uniform mat4 projection;
+uniform mat4 view;
+uniform float gamma;
+uniform float time;
+uniform float offset;
+const float scale = 2.0;
+in float level;
+out float color;
+float hoisted0;
+
+float curve(float x) {
+    return x * (1.0 / gamma);
+}
+
+void main() {
+    mat4 m = projection * view;
+    mat4 n = projection * view;
+    float t = time * scale + level;
+    float u = time + curve(offset);
+    float v = offset + level;
+    color = curve(t) + u + v + m[0].x + n[1].y;
+}
@@ -0,0 +1,49 @@
+uniform float scale;
+in float level;
+out float color;
+float total;
+
+float twice(float x) {
+    return x * 2.0;
+}
+
+float clampUp(float x) {
+    if (x < 0.0)
+        return 0.0;
+    return x;
+}
+
+float early(float x) {
+    if (x > 1.0) {
+        return 1.0;
+        x = 0.0;
+    }
+    return x;
+}
+
+float countdown(float x) {
+    if (x > 0.0)
+        return countdown(x - 1.0);
+    return x;
+}
+
+float bump() {
+    total = total + 1.0;
+    return total;
+}
+
+float scaled(float x) {
+    return x * scale;
+}
+
+void main() {
+    float a = twice(level);
+    float b = clampUp(a);
+    float c = early(b);
+    float d = countdown(c);
+    float e = bump() + bump();
+    float scale = 3.0;
+    float f = scaled(e);
+    bool g = a > 0.0 && twice(b) > 1.0;
+    color = a + b + c + d + e + f + scale;
+}
@@ -0,0 +1,28 @@
+// With --jobs=2 the function bodies are checked on two threads; the
+// errors still come out in source order
+uniform float scale;
+out vec4 color;
+
+float a(float x) {
+    return x * scale + missingA;
+}
+
+float b(float x) {
+    int i = x;
+    return x;
+}
+
+float c(float x) {
+    if (x) return 1.0;
+    return 0.0;
+}
+
+float d(float x) {
+    return a(x) + b(x) + c(x);
+}
+
+void main() {
+    color.x = d(color.y);
+    color.y = e(color.x);
+    color.z = a(1.0, 2.0);
+}
@@ -0,0 +1,22 @@
+uniform float a;
+out vec4 b;
+float unused;
+float counter;
+
+float never(float x) {
+	return x;
+}
+
+float helper(float value, float weight) {
+	float result;
+	result = value * weight + a + counter;
+	return result;
+}
+
+void main() {
+	float first;
+	float second;
+	first = helper(1.0, 2.5);
+	second = first * counter;
+	counter = second + b.x;
+}
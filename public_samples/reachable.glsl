@@ -0,0 +1,35 @@
+// Only what vertex() and fragment() reach is checked: broken(), unused()
+// and main() are skipped, and listed so that they can be stripped
+uniform float scale;
+out vec4 color;
+
+float helper(float x) {
+    return x * scale;
+}
+
+float bias = helper(1.0);
+
+float shade(float x) {
+    return helper(x) + bias + missing;
+}
+
+float unused(float x) {
+    return x;
+}
+
+float broken(float x) {
+    bool b = x;
+    return shade(x) * undefinedToo;
+}
+
+void vertex() {
+    color.x = shade(color.y);
+}
+
+void fragment() {
+    color.y = helper(color.x);
+}
+
+void main() {
+    color.z = broken(color.w);
+}
@@ -0,0 +1,21 @@
+// With --stream each declaration is checked as soon as it is parsed;
+// the errors come out as a check of the whole program prints them
+uniform float scale;
+out vec4 color;
+
+float first(float x) {
+    return x * scale + missing;
+}
+
+float total;
+
+float second(float x) {
+    bool b = x;
+    return x + total;
+}
+
+void main() {
+    color.x = first(color.y);
+    color.y = second(color.x, 1.0);
+    color.z = third(color.x);
+}
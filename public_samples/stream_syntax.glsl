@@ -0,0 +1,10 @@
+// The semantic error in first() is held back with --stream and then
+// dropped, as the parse fails and an unstreamed check would not run
+float first(float x) {
+    return x + missing;
+}
+
+void main() {
+    float y = first(1.0)
+    y = y * 2.0;
+}
@@ -0,0 +1,25 @@
+const int count = 3;
+uniform float weights[4];
+in float level;
+out float color;
+
+void main() {
+    int i;
+    float sum = 0.0;
+    for (i = 0; i < count; i++) {
+        float w = weights[i];
+        sum = sum + w * level;
+    }
+    for (i = 6; i >= 0; i -= 3)
+        sum = sum + weights[1];
+    // Never ends: the step is zero
+    for (i = 0; i < 4; i += 0)
+        sum = sum * 0.5;
+    // Would run past the largest int
+    for (i = 2147483640; i > 0; i++)
+        sum = sum * 0.5;
+    // Runs more often than --unroll allows
+    for (i = 0; i < 100; i++)
+        sum = sum + level;
+    color = sum;
+}
@@ -0,0 +1,115 @@
+/* File: rewriter.cc
+ * -----------------
+ * Implementation of the walk that rewriting passes share.
+ */
+
+#include "rewriter.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+
+using namespace std;
+
+void Rewriter::Rewrite(Program *program) {
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++)
+        RewriteDecl(decls->Nth(i));
+}
+
+void Rewriter::RewriteDecl(Decl *decl) {
+    VarDecl *var = dynamic_cast<VarDecl *>(decl);
+    if (var && var->GetInitializer()) {
+        Expr *init = var->GetInitializer();
+        RewriteExpr(&init);
+        var->SetInitializer(init);
+    }
+    FnDecl *fn = dynamic_cast<FnDecl *>(decl);
+    if (fn && fn->HasBody()) {
+        Stmt *body = fn->GetBody();
+        RewriteStmt(&body);
+        if (body != fn->GetBody()) fn->SetFunctionBody(body);
+    }
+}
+
+void Rewriter::RewriteStmt(Stmt **slot) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL) return;
+    Expr *expr = dynamic_cast<Expr *>(stmt);
+    if (expr) {
+        RewriteExpr(&expr);
+        *slot = expr;
+        return;
+    }
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    if (declStmt) RewriteDecl(declStmt->GetDecl());
+    StmtBlock *block = dynamic_cast<StmtBlock *>(stmt);
+    if (block) {
+        for (int i = 0; i < block->GetDecls()->NumElements(); i++)
+            RewriteDecl(block->GetDecls()->Nth(i));
+    }
+    Expr **exprSlot;
+    for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+        if (*exprSlot) RewriteExpr(exprSlot);
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        RewriteStmt(stmtSlot);
+}
+
+/* The frames of this walk go on top of those of any walk whose
+ * LeaveExpr() started it, and are gone when it returns.
+ */
+void Rewriter::RewriteExpr(Expr **slot) {
+    size_t base = frames.size();
+    Frame root = { slot, 0 };
+    frames.push_back(root);
+    while (frames.size() > base) {
+        Deadline::Poll();
+        Frame &top = frames.back();
+        Expr *expr = *top.slot;
+        Expr **operand = expr->ExprSlot(top.next++);
+        if (operand) {
+            Frame next = { operand, 0 };
+            if (*operand) frames.push_back(next);
+            continue;
+        }
+        Expr **done = top.slot;
+        frames.pop_back();
+        Expr *result = LeaveExpr(expr);
+        if (result != expr) {
+            result->SetParent(expr->GetParent());
+            *done = result;
+        }
+    }
+}
+
+void WriteFinder::Written(Expr *target) {
+    for (;;) {
+        ArrayAccess *element = dynamic_cast<ArrayAccess *>(target);
+        FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+        if (element) target = element->GetBase();
+        else if (field && field->GetBase()) target = field->GetBase();
+        else break;
+    }
+    VarExpr *var = dynamic_cast<VarExpr *>(target);
+    if (var && var->GetDecl()) written.insert(var->GetDecl());
+}
+
+Expr *WriteFinder::LeaveExpr(Expr *expr) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+    Call *call = dynamic_cast<Call *>(expr);
+    if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr)) {
+        Written(compound->GetLeft());
+    } else if (compound && !compound->GetLeft()
+               && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--"))) {
+        Written(compound->GetRight());
+    } else if (call && call->GetCallee()) {
+        List<VarDecl*> *formals = call->GetCallee()->GetFormals();
+        for (int i = 0; i < formals->NumElements(); i++)
+            if (formals->Nth(i)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                Written(call->GetActuals()->Nth(i));
+    }
+    return expr;
+}
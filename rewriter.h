@@ -0,0 +1,69 @@
+/* File: rewriter.h
+ * ----------------
+ * The base of the passes that rewrite a checked program in place, such
+ * as constant folding (see fold.h). A Rewriter goes through the program
+ * in source order, and a pass overrides the hooks for the nodes it is
+ * interested in.
+ *
+ * Statements are reached through Stmt::StmtSlot() and expressions
+ * through Stmt::ExprSlot(), and every expression is offered to
+ * LeaveExpr() after its operands, which may already have been replaced.
+ * Whatever LeaveExpr() returns takes the expression's place in the
+ * tree. Statements nest no deeper than the checker lets them, so they
+ * are gone through by recursion; expressions are gone through with an
+ * explicit stack, like the checker does, and with the deadline polled
+ * at every node.
+ */
+
+#ifndef _H_rewriter
+#define _H_rewriter
+
+#include <set>
+#include <vector>
+
+class Node;
+class Program;
+class Decl;
+class Stmt;
+class Expr;
+class VarDecl;
+
+class Rewriter {
+  public:
+    virtual ~Rewriter() {}
+
+    void Rewrite(Program *program);
+
+  protected:
+    // The expression to put in the place of expr, once its operands are
+    // done; expr itself to leave it be
+    virtual Expr *LeaveExpr(Expr *expr) { return expr; }
+
+    void RewriteDecl(Decl *decl);
+    void RewriteStmt(Stmt **slot);
+    void RewriteExpr(Expr **slot);
+
+  private:
+    struct Frame {
+        Expr **slot;
+        int next;       // the operand to go into next
+    };
+    std::vector<Frame> frames;
+};
+
+/* Finds the variables the program writes to: the targets of
+ * assignments, increments and decrements (a[i] and v.x being writes to
+ * a and v), and the arguments passed for out parameters.
+ */
+class WriteFinder : public Rewriter {
+  public:
+    std::set<VarDecl *> written;
+
+  protected:
+    Expr *LeaveExpr(Expr *expr);
+
+  private:
+    void Written(Expr *target);
+};
+
+#endif
@@ -13,5 +13,27 @@ fi
 
 for file in $LIST; do
         echo $file
-	./glc < $file 
+	./glc `cat ${file%.glsl}.args 2>/dev/null` < $file
 done
+
+# Smoke test of the daemon, and through it of glc_check() (see serve.h)
+if [ "$#" = "0" ] && [ -x glc-client ]; then
+	SOCKET=/tmp/glc-runall.$$
+	./glc --serve $SOCKET --workers=1 &
+	DAEMON=$!
+	for i in 1 2 3 4 5 6 7 8 9 10; do
+		[ -S $SOCKET ] && break
+		sleep 1
+	done
+	echo "daemon: a valid shader"
+	echo 'void main() { float x = 1.0; }' | ./glc-client $SOCKET
+	echo "exit $?"
+	echo "daemon: a shader with an error"
+	echo 'void main() { float x = y; }' | ./glc-client $SOCKET
+	echo "exit $?"
+	kill $DAEMON
+	wait $DAEMON
+	echo "daemon: refuses --fold"
+	./glc --serve $SOCKET --fold
+	echo "exit $?"
+fi
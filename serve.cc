@@ -0,0 +1,150 @@
+/* File: serve.cc
+ * --------------
+ * Implementation of the prefork validation daemon.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <vector>
+#include "serve.h"
+#include "protocol.h"
+#include "glc.h"
+#include "memo.h"
+#include "options.h"
+#include "utility.h"
+
+static volatile sig_atomic_t stopping = 0;
+static glc_options requestOptions;
+
+static void Stop(int) {
+    stopping = 1;
+}
+
+/* Checks a typical small shader so the code, the static types and the
+ * first arena chunk are all paged in before the workers are forked and
+ * share them.
+ */
+static void WarmUp() {
+    static const char shader[] =
+        "uniform vec4 color;\n"
+        "float scale(float x) {\n"
+        "    return x * 2.0;\n"
+        "}\n"
+        "void main() {\n"
+        "    vec4 c = color;\n"
+        "    float s = scale(c.x);\n"
+        "    if (s > 1.0) {\n"
+        "        c.y = s;\n"
+        "    }\n"
+        "}\n";
+    glc_result result;
+    glc_check(shader, sizeof(shader) - 1, NULL, &result);
+    glc_result_free(&result);
+}
+
+static void ServeConnection(int conn) {
+    string request;
+    while (ReadFrame(conn, &request)) {
+        glc_result result;
+        glc_check(request.data(), request.size(), &requestOptions, &result);
+        bool sent = WriteFrame(conn, ResultToJson(&result));
+        glc_result_free(&result);
+        if (!sent) break;
+    }
+}
+
+static void Work(int listener) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    for (;;) {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("glc: accept");
+            _exit(1);
+        }
+        ServeConnection(conn);
+        close(conn);
+    }
+}
+
+static pid_t Spawn(int listener) {
+    pid_t pid = fork();
+    if (pid == 0) Work(listener);
+    if (pid < 0) perror("glc: fork");
+    return pid;
+}
+
+int Serve(const char *path, int workers, const glc_options *options) {
+    // Requests are only checked: nothing is dumped, rewritten or written
+    // out, and a memo hit would leave the types the passes need unset
+    const char **programOnly = OptionsFlagged(ProgramOnly);
+    for (int i = 0; programOnly[i]; i++)
+        if (GetOption(programOnly[i])) {
+            fprintf(stderr, "glc: --%s cannot be used with --serve\n", programOnly[i]);
+            return 2;
+        }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "glc: socket path too long: %s\n", path);
+        return 2;
+    }
+    strcpy(addr.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        perror("glc: cannot listen on socket");
+        return 2;
+    }
+
+    // Without SA_RESTART so that wait() below returns when asked to stop
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);   // a client hanging up is not fatal
+
+    FunctionMemo::enabled = true;
+    WarmUp();
+    requestOptions = *options;
+
+    if (workers <= 0) workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0) workers = 1;
+    vector<pid_t> pool;
+    for (int i = 0; i < workers; i++)
+        pool.push_back(Spawn(listener));
+
+    while (!stopping) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < pool.size(); i++)
+            if (pool[i] == pid && !stopping) {
+                fprintf(stderr, "glc: worker %d died, restarting\n", (int)pid);
+                pool[i] = Spawn(listener);
+            }
+    }
+
+    for (int i = 0; i < pool.size(); i++)
+        if (pool[i] > 0) kill(pool[i], SIGTERM);
+    while (wait(NULL) > 0 || errno == EINTR)
+        ;
+    close(listener);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,40 @@
+/**
+ * File: serve.h
+ * -------------
+ * The validation daemon behind glc --serve. It keeps compiler processes
+ * warm so that checking a shader costs only the check itself, not
+ * process startup, static initialization and first-touch page faults.
+ *
+ * The checker keeps its state in globals, so requests cannot share a
+ * process concurrently. Instead the daemon binds the socket, warms up by
+ * checking a small shader once, and then forks a pool of workers that
+ * all accept on the same socket; each worker is one checker context and
+ * serves one connection at a time. Every request goes through
+ * glc_check(), which hands back the AST arena when it is done, so a
+ * worker's memory stays flat however many shaders it sees. Each worker
+ * also memoizes the functions it has checked (see memo.h). A worker
+ * that dies is replaced, taking down only the request it was serving,
+ * and one that takes too long over a request, or reaches one of the
+ * daemon's limits, gives up on it with a diagnostic saying so.
+ *
+ * See protocol.h for what goes over the socket.
+ */
+
+#ifndef _H_serve
+#define _H_serve
+
+#include "glc.h"
+
+/* Function: Serve()
+ * -----------------
+ * Listens on the Unix domain socket at path (replacing any stale one)
+ * with the given number of worker processes, or one per CPU if workers
+ * is 0. Each request is checked with the given options, for its deadline
+ * and limits. Returns an exit status once the daemon is stopped by SIGINT
+ * or SIGTERM, or if the socket could not be set up. Options that concern
+ * only the program, such as the passes and what is written out (see
+ * options.h), are refused.
+ */
+int Serve(const char *path, int workers, const glc_options *options);
+
+#endif
@@ -47,6 +47,21 @@ then
         cp parser.y $pid/
         cp symtable.cc $pid/
         cp symtable.h $pid/
+        cp glc.h $pid/
+        cp glc.cc $pid/
+        cp arena.h arena.cc $pid/
+        cp serve.h serve.cc $pid/
+        cp protocol.h protocol.cc $pid/
+        cp glc_client.cc glc_loadtest.cc $pid/
+        cp cache.h cache.cc $pid/
+        cp memo.h memo.cc $pid/
+        cp prelude.h prelude.cc $pid/
+        cp pch.h pch.cc $pid/
+        cp callgraph.h callgraph.cc $pid/
+        cp rewriter.h rewriter.cc copy.h copy.cc inline.h inline.cc fold.h fold.cc unroll.h unroll.cc dce.h dce.cc flatten.h flatten.cc hoist.h hoist.cc cse.h cse.cc glsl.h glsl.cc minify.h minify.cc ir.h ir.cc lower.h lower.cc passes.h passes.cc $pid/
+        cp options.h options.cc $pid/
+        cp deadline.h deadline.cc $pid/
+        cp bounds.h bounds.cc $pid/
 
 	zip -r $pid.zip $pid/*
 else 
@@ -1,23 +1,41 @@
 
 #include "symtable.h"
 #include "ast_type.h"
+#include "ast_decl.h"
+#include "memo.h"
+#include "bounds.h"
 
-int SymbolTable::loopNum = 0;
-int SymbolTable::switchNum = 0;
-bool SymbolTable::needReturn = false;
-bool SymbolTable::hasReturn = false;
-Type * SymbolTable::needReturnType = NULL;
+const ScopedTable * SymbolTable::prelude = NULL;
 
-SymbolTable::SymbolTable(){
+void ResetSymbolTable(){
+    delete Node::symtable;
+    Node::symtable = new SymbolTable();
+}
+
+SymbolTable::SymbolTable() : globals(NULL), visibleTo(NULL), loopNum(0), switchNum(0),
+                             needReturn(false), hasReturn(false), needReturnType(NULL){
+    SymbolTable::push();
+}
+
+SymbolTable::SymbolTable(const ScopedTable *g) : globals(g), visibleTo(NULL), loopNum(0),
+                             switchNum(0), needReturn(false), hasReturn(false),
+                             needReturnType(NULL){
     SymbolTable::push();
 }
 
+SymbolTable::~SymbolTable(){
+    while (!SymbolTable::tables.empty())
+        SymbolTable::pop();
+}
+
 //push in a new scope
 void SymbolTable::push(){
+    Bounds::CheckScopes(tables.size() + 1);
     SymbolTable::tables.push_back(new ScopedTable());
 }
 
 void SymbolTable::pop(){
+    delete SymbolTable::tables.back();
     SymbolTable::tables.pop_back();
 }
 
@@ -32,33 +50,65 @@ void SymbolTable::remove(Symbol &sym){
         SymbolTable::tables.back()->remove(sym);
 }
 
-Symbol* SymbolTable::find(const char *name){
-    Symbol *res_sym;
+const Symbol* SymbolTable::find(const char *name){
+    const Symbol *res_sym;
     for (std::vector<ScopedTable*>::reverse_iterator it = SymbolTable::tables.rbegin();
         it != SymbolTable::tables.rend(); ++it){
         res_sym = (*it)->find(name);
-        if (res_sym != NULL) return res_sym;
+        if (res_sym != NULL){
+            if (it + 1 == SymbolTable::tables.rend())
+                FunctionMemo::NoteGlobal(name, res_sym);
+            return res_sym;
+        }
     }
-    return NULL;
+    if (SymbolTable::globals){
+        res_sym = SymbolTable::globals->findDeclaredBefore(name, SymbolTable::visibleTo);
+        if (res_sym != NULL)
+            return res_sym;
+    }
+    res_sym = SymbolTable::prelude ? SymbolTable::prelude->find(name) : NULL;
+    FunctionMemo::NoteGlobal(name, res_sym);
+    return res_sym;
 }
 
-Symbol* SymbolTable::findInCurrScope(const char *name){
+const Symbol* SymbolTable::findInCurrScope(const char *name){
     if (!SymbolTable::tables.empty()){
-        return SymbolTable::tables.back()->find(name);
+        const Symbol *res_sym = SymbolTable::tables.back()->find(name);
+        if (res_sym == NULL && SymbolTable::tables.size() == 1 && SymbolTable::prelude)
+            res_sym = SymbolTable::prelude->find(name);
+        return res_sym;
     }
     return NULL;
 }
 
+void SymbolTable::freezeGlobalScope(){
+    if (SymbolTable::tables.empty()) return;
+    installPrelude(SymbolTable::tables.front());
+    SymbolTable::tables.front() = new ScopedTable();
+}
+
+void SymbolTable::dropPrelude(){
+    installPrelude(NULL);
+}
+
+void SymbolTable::installPrelude(const ScopedTable *scope){
+    delete SymbolTable::prelude;
+    SymbolTable::prelude = scope;
+}
+
 
 
 
 ScopedTable::ScopedTable(){}
 
+ScopedTable::~ScopedTable(){}
+
 void ScopedTable::insert(Symbol &sym){
     std::pair<SymbolIterator,bool> p;
 
     p = ScopedTable::symbols.insert(SymMap::value_type(sym.name, sym));
     if (p.second == false){
+        ScopedTable::replaced.push_back(p.first->second);
         p.first->second = sym;
     }
 }
@@ -67,15 +117,34 @@ void ScopedTable::remove(Symbol &sym){
     ScopedTable::symbols.erase(sym.name);
 }
 
-Symbol* ScopedTable::find(const char *name){
+const Symbol* ScopedTable::find(const char *name) const{
     //std::map<char *,Symbol,lessStr>::iterator it;
-    SymbolIterator it;
+    SymMap::const_iterator it;
     it = ScopedTable::symbols.find(name);
     if (it != ScopedTable::symbols.end())
         return &(it->second);
     return NULL;
 }
 
+static bool DeclaredBefore(const Symbol *sym, const yyltype *pos){
+    const yyltype *loc = sym->decl->GetLocation();
+    return loc->first_line < pos->first_line ||
+           (loc->first_line == pos->first_line && loc->first_column <= pos->first_column);
+}
+
+const Symbol* ScopedTable::findDeclaredBefore(const char *name, const yyltype *pos) const{
+    const Symbol *res_sym = ScopedTable::find(name);
+    if (res_sym == NULL || DeclaredBefore(res_sym, pos))
+        return res_sym;
+    // Declared again since; the earlier declarations are in order
+    for (int i = ScopedTable::replaced.size() - 1; i >= 0; i--){
+        const Symbol *old = &ScopedTable::replaced[i];
+        if (strcmp(old->name, name) == 0 && DeclaredBefore(old, pos))
+            return old;
+    }
+    return NULL;
+}
+
 
 
 
@@ -7,7 +7,14 @@
  *  uses the standard C++ map.
  *
  *  Symbol table is implemented as a vector, where each vector entry holds
- *  a pointer to the scoped table.
+ *  a pointer to the scoped table. Below the vector there may be a frozen
+ *  prelude scope shared by all symbol tables (see prelude.h).
+ *
+ *  Each thread checks with its own symbol table (Node::symtable is per
+ *  thread). To check function bodies in parallel, the global scope is
+ *  built first and then shared read-only by the tables of the threads
+ *  checking the bodies, each body seeing only what was declared before
+ *  it (see Program::Check()).
  */
 
 #ifndef _H_symtable
@@ -19,6 +26,7 @@
 #include <string.h>
 #include "errors.h"
 #include "ast_type.h"
+#include "location.h"
 
 using namespace std;
 
@@ -55,6 +63,7 @@ typedef map<const char *, Symbol, lessStr> SymMap;
 class ScopedTable {
   //map<const char *, Symbol, lessStr> symbols;
   SymMap symbols;
+  vector<Symbol> replaced;   // by a later declaration of the same name
 
   public:
     ScopedTable();
@@ -62,31 +71,62 @@ class ScopedTable {
 
     void insert(Symbol &sym);
     void remove(Symbol &sym);
-    Symbol *find(const char *name);
+    const Symbol *find(const char *name) const;
+    // Finds the last declaration of name that comes before pos in the
+    // source, or is at pos
+    const Symbol *findDeclaredBefore(const char *name, const yyltype *pos) const;
+    const SymMap &getSymbols() const { return symbols; }
 };
 
 class SymbolTable {
   std::vector<ScopedTable *> tables;
+  static const ScopedTable *prelude;
+  const ScopedTable *globals;     // shared global scope, if any
+  const yyltype *visibleTo;
 
   public:
     SymbolTable();
+    // A table whose lookups that reach the bottom go on to globals, which
+    // is never written to, and see only the names declared at or before
+    // the position given to setVisibleTo()
+    SymbolTable(const ScopedTable *globals);
     ~SymbolTable();
 
+    void setVisibleTo(const yyltype *pos) { visibleTo = pos; }
+    const ScopedTable *getGlobalScope() const { return tables.front(); }
+
     void push();
     void pop();
 
     void insert(Symbol &sym);
     void remove(Symbol &sym);
-    Symbol *find(const char *name);
-    Symbol *findInCurrScope(const char *name);
-
-    static int loopNum;
-    static int switchNum;
-    static bool needReturn;
-    static bool hasReturn;
-    static Type * needReturnType;
+    const Symbol *find(const char *name);
+    const Symbol *findInCurrScope(const char *name);
+
+    // Takes the global scope checked so far as the prelude, a read-only
+    // layer under the global scope of every table created afterwards, and
+    // leaves this table with an empty global scope. Lookups that reach the
+    // bottom fall through to the prelude, and declaring one of its names
+    // again at global scope is a conflict. Nothing ever writes to it, so
+    // any number of threads may look names up in it at once.
+    void freezeGlobalScope();
+    static void dropPrelude();
+    static const ScopedTable *getPrelude() { return prelude; }
+    // Replaces the prelude with scope, which the table takes over
+    static void installPrelude(const ScopedTable *scope);
+
+    // State of the function body being checked
+    int loopNum;
+    int switchNum;
+    bool needReturn;
+    bool hasReturn;
+    Type * needReturnType;
 };
 
+// Replaces Node::symtable with an empty table, so that another program
+// can be checked in the same process.
+void ResetSymbolTable();
+
 class MyStack {
     vector<Stmt *> stmtStack;
 
@@ -14,6 +14,10 @@
 # will need to do your own testing.  Be sure to look over these tests
 # carefully and to think over what cases are covered and, more importantly,
 # what cases are not.
+#
+# A test that needs command-line options has them in a file of the same
+# name ending in .args, for example --fold --emit-glsl - to check what
+# the folded program looks like.
 
 import os
 from subprocess import *
@@ -26,8 +30,12 @@ for _, _, files in os.walk(TEST_DIRECTORY):
       continue
     refName = os.path.join(TEST_DIRECTORY, '%s.out' % file.split('.')[0])
     testName = os.path.join(TEST_DIRECTORY, file)
+    argsName = os.path.join(TEST_DIRECTORY, '%s.args' % file.split('.')[0])
+    args = ''
+    if os.path.exists(argsName):
+      args = ' '.join(open(argsName).read().split()) + ' '
 
-    result = Popen('./glc < ' + testName, shell = True, stderr = STDOUT, stdout = PIPE)
+    result = Popen('./glc ' + args + '< ' + testName, shell = True, stderr = STDOUT, stdout = PIPE)
     result = Popen('diff -w - ' + refName, shell = True, stdin = result.stdout, stdout = PIPE)
     print 'Executing test "%s"' % testName
     print ''.join(result.stdout.readlines())
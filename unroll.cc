@@ -0,0 +1,277 @@
+/* File: unroll.cc
+ * ---------------
+ * Implementation of loop unrolling.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "unroll.h"
+#include "copy.h"
+#include "ast_stmt.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_type.h"
+#include "deadline.h"
+#include "utility.h"
+
+using namespace std;
+
+// Whether expr is the variable var, or an unresolved name of it
+static bool Is(Expr *expr, VarDecl *var) {
+    VarExpr *use = dynamic_cast<VarExpr *>(expr);
+    if (!use) return false;
+    if (use->GetDecl()) return use->GetDecl() == var;
+    return strcmp(use->GetIdentifier()->GetName(), var->GetIdentifier()->GetName()) == 0;
+}
+
+// The value of an int constant, or of a const variable initialized with one
+static bool Constant(Expr *expr, long long *value) {
+    if (VarExpr *use = dynamic_cast<VarExpr *>(expr)) {
+        VarDecl *var = use->GetDecl();
+        if (!var || var->GetTypeQualifier() != TypeQualifier::constTypeQualifier
+            || var->GetType() != Type::intType)
+            return false;
+        expr = var->GetInitializer();
+    }
+    IntConstant *constant = dynamic_cast<IntConstant *>(expr);
+    if (constant) *value = constant->GetValue();
+    return constant != NULL;
+}
+
+// What the step adds to var, 0 if it is not a step of var by a constant
+static long long Step(Expr *step, VarDecl *var) {
+    CompoundExpr *compound = dynamic_cast<CompoundExpr *>(step);
+    if (!compound) return 0;
+    Operator *op = compound->GetOperator();
+    if (op->IsOp("++") || op->IsOp("--")) {
+        Expr *target = compound->GetLeft() ? compound->GetLeft() : compound->GetRight();
+        return !Is(target, var) ? 0 : op->IsOp("++") ? 1 : -1;
+    }
+    if (!dynamic_cast<AssignExpr *>(step) || !Is(compound->GetLeft(), var)) return 0;
+    long long by;
+    if (op->IsOp("+=") || op->IsOp("-=")) {
+        if (!Constant(compound->GetRight(), &by)) return 0;
+        return op->IsOp("+=") ? by : -by;
+    }
+    ArithmeticExpr *sum = dynamic_cast<ArithmeticExpr *>(compound->GetRight());
+    if (!op->IsOp("=") || !sum || !sum->GetLeft()) return 0;
+    bool plus = sum->GetOperator()->IsOp("+");
+    if (!plus && !sum->GetOperator()->IsOp("-")) return 0;
+    if (Is(sum->GetLeft(), var) && Constant(sum->GetRight(), &by))
+        return plus ? by : -by;
+    if (plus && Is(sum->GetRight(), var) && Constant(sum->GetLeft(), &by))
+        return by;
+    return 0;
+}
+
+/* Whether a statement of the body of a loop over var leaves var and the
+ * loop alone, rather than storing to var, passing it as an out argument
+ * or breaking or continuing the loop. The statement is inside as many
+ * loops and switches of the body as loops and switches say, and a
+ * break or continue inside one of those is its own.
+ */
+static bool LeavesAlone(Stmt *stmt, VarDecl *var, int loops, int switches) {
+    Deadline::Poll();
+    if (stmt == NULL) return true;
+    if (dynamic_cast<BreakStmt *>(stmt)) return loops + switches > 0;
+    if (dynamic_cast<ContinueStmt *>(stmt)) return loops > 0;
+    vector<Expr *> stack;
+    DeclStmt *declStmt = dynamic_cast<DeclStmt *>(stmt);
+    VarDecl *local = declStmt ? dynamic_cast<VarDecl *>(declStmt->GetDecl()) : NULL;
+    if (dynamic_cast<Expr *>(stmt)) {
+        stack.push_back(dynamic_cast<Expr *>(stmt));
+    } else if (local && local->GetInitializer()) {
+        stack.push_back(local->GetInitializer());
+    } else {
+        Expr **exprSlot;
+        for (int i = 0; (exprSlot = stmt->ExprSlot(i)) != NULL; i++)
+            if (*exprSlot) stack.push_back(*exprSlot);
+    }
+    while (!stack.empty()) {
+        Deadline::Poll();
+        Expr *expr = stack.back();
+        stack.pop_back();
+        vector<Expr *> targets;
+        CompoundExpr *compound = dynamic_cast<CompoundExpr *>(expr);
+        Call *call = dynamic_cast<Call *>(expr);
+        if (dynamic_cast<AssignExpr *>(expr) || dynamic_cast<PostfixExpr *>(expr)) {
+            targets.push_back(compound->GetLeft());
+        } else if (compound && !compound->GetLeft()
+                   && (compound->GetOperator()->IsOp("++") || compound->GetOperator()->IsOp("--"))) {
+            targets.push_back(compound->GetRight());
+        } else if (call && call->GetCallee()) {
+            List<VarDecl*> *formals = call->GetCallee()->GetFormals();
+            for (int i = 0; i < formals->NumElements(); i++)
+                if (formals->Nth(i)->GetTypeQualifier() == TypeQualifier::outTypeQualifier)
+                    targets.push_back(call->GetActuals()->Nth(i));
+        }
+        for (size_t i = 0; i < targets.size(); i++) {
+            Expr *target = targets[i];
+            for (;;) {
+                ArrayAccess *element = dynamic_cast<ArrayAccess *>(target);
+                FieldAccess *field = dynamic_cast<FieldAccess *>(target);
+                if (element) target = element->GetBase();
+                else if (field && field->GetBase()) target = field->GetBase();
+                else break;
+            }
+            if (Is(target, var)) return false;
+        }
+        Expr **operand;
+        for (int i = 0; (operand = expr->ExprSlot(i)) != NULL; i++)
+            if (*operand) stack.push_back(*operand);
+    }
+    if (dynamic_cast<LoopStmt *>(stmt)) loops++;
+    if (dynamic_cast<SwitchStmt *>(stmt)) switches++;
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        if (!LeavesAlone(*stmtSlot, var, loops, switches)) return false;
+    return true;
+}
+
+bool CountTrips(ForStmt *loop, TripCount *count) {
+    AssignExpr *init = dynamic_cast<AssignExpr *>(*loop->ExprSlot(0));
+    Expr *test = *loop->ExprSlot(1), *step = *loop->ExprSlot(2);
+    VarExpr *use = init ? dynamic_cast<VarExpr *>(init->GetLeft()) : NULL;
+    VarDecl *var = use ? use->GetDecl() : NULL;
+    long long start, end;
+    if (!var || !init->GetOperator()->IsOp("=") || var->GetType() != Type::intType
+        || dynamic_cast<Program *>(var->GetParent()) || !Constant(init->GetRight(), &start))
+        return false;
+
+    // The test, turned round if need be to have i on its left
+    CompoundExpr *compare = dynamic_cast<CompoundExpr *>(test);
+    if (!compare || !compare->GetLeft() || dynamic_cast<AssignExpr *>(test)) return false;
+    string op = compare->GetOperator()->GetToken();
+    if (Is(compare->GetRight(), var) && Constant(compare->GetLeft(), &end)) {
+        if (op[0] == '<') op[0] = '>';
+        else if (op[0] == '>') op[0] = '<';
+    } else if (!Is(compare->GetLeft(), var) || !Constant(compare->GetRight(), &end)) {
+        return false;
+    }
+    long long by = step ? Step(step, var) : 0;
+    if (by == 0) return false;
+
+    long long trips;
+    if (op == "<=" || op == ">=") end += op == "<=" ? 1 : -1;
+    if (op == "<" || op == "<=") {
+        if (start >= end) trips = 0;
+        else if (by < 0) return false;
+        else trips = (end - start + by - 1) / by;
+    } else if (op == ">" || op == ">=") {
+        if (start <= end) trips = 0;
+        else if (by > 0) return false;
+        else trips = (start - end - by - 1) / -by;
+    } else if (op == "!=") {
+        if ((end - start) % by != 0 || (end - start) / by < 0) return false;
+        trips = (end - start) / by;
+    } else {
+        return false;
+    }
+    long long last = start + trips * by;
+    if (trips > INT_MAX || last < INT_MIN || last > INT_MAX) return false;
+    if (!LeavesAlone(loop->StmtSlot(0) ? *loop->StmtSlot(0) : NULL, var, 0, 0)) return false;
+    count->var = var;
+    count->start = start;
+    count->step = by;
+    count->trips = trips;
+    return true;
+}
+
+/* Goes through the functions' statements innermost first, replacing
+ * the counted loops that run few enough times.
+ */
+class LoopUnroller : public TreeCopier {
+  public:
+    LoopUnroller(Program *program, int most)
+        : counted(0), unrolled(0), copies(0), program(program), most(most) {}
+
+    void Run();
+
+    int counted, unrolled, copies;
+
+  protected:
+    string NameFor(VarDecl *var);
+
+  private:
+    Program *program;
+    int most;
+    set<string> names;
+    map<string, int> suffixes;                  // the last one given each name
+
+    void Walk(Stmt **slot);
+    Stmt *Unroll(ForStmt *loop, const TripCount &count);
+};
+
+void LoopUnroller::Run() {
+    DeclaredNames(program, &names);
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (!fn || !fn->HasBody()) continue;
+        Stmt *body = fn->GetBody();
+        Walk(&body);
+    }
+}
+
+void LoopUnroller::Walk(Stmt **slot) {
+    Deadline::Poll();
+    Stmt *stmt = *slot;
+    if (stmt == NULL || dynamic_cast<Expr *>(stmt)) return;
+    Stmt **stmtSlot;
+    for (int i = 0; (stmtSlot = stmt->StmtSlot(i)) != NULL; i++)
+        Walk(stmtSlot);
+    ForStmt *loop = dynamic_cast<ForStmt *>(stmt);
+    TripCount count;
+    if (!loop || !CountTrips(loop, &count)) return;
+    counted++;
+    if (count.trips > most) return;
+    Stmt *block = Unroll(loop, count);
+    block->SetParent(stmt->GetParent());
+    *slot = block;
+    unrolled++;
+    copies += count.trips;
+}
+
+Stmt *LoopUnroller::Unroll(ForStmt *loop, const TripCount &count) {
+    yyltype loc = *count.var->GetIdentifier()->GetLocation();
+    List<Stmt*> *stmts = new List<Stmt*>;
+    long long value = count.start;
+    for (int i = 0; i < count.trips; i++, value += count.step) {
+        Expr *constant = new IntConstant(loc, value);
+        constant->Check();
+        Clear();
+        Substitute(count.var, constant);
+        stmts->Append(CopyStmt(*loop->StmtSlot(0)));
+    }
+    Clear();
+    Expr *last = new IntConstant(loc, value);
+    last->Check();
+    Expr *assign = new AssignExpr(new VarExpr(loc, count.var), new Operator(loc, "="), last);
+    assign->SetType(count.var->GetType());
+    stmts->Append(assign);
+    return new StmtBlock(new List<VarDecl*>, stmts);
+}
+
+string LoopUnroller::NameFor(VarDecl *var) {
+    const char *base = var->GetIdentifier()->GetName();
+    int &suffix = suffixes[base];
+    char name[64];
+    do {
+        snprintf(name, sizeof(name), "%s_%d", base, ++suffix);
+    } while (names.count(name));
+    names.insert(name);
+    return name;
+}
+
+int UnrollLoops(Program *program, int most) {
+    LoopUnroller unroller(program, most);
+    unroller.Run();
+    PrintDebug("stats", "unroll: unrolled %d of %d counted loops into %d copies of their bodies",
+               unroller.unrolled, unroller.counted, unroller.copies);
+    return unroller.unrolled;
+}
@@ -0,0 +1,64 @@
+/* File: unroll.h
+ * --------------
+ * Loop unrolling, for glc --unroll[=n]: finds the for loops of a
+ * program that checked without errors that run a number of times known
+ * before they start, and writes those that run at most n times
+ * (default DefaultUnrollTrips) as that many copies of their body, before
+ * the program is written out (see glsl.h).
+ *
+ * A loop is counted if it has the shape
+ *
+ *   for (i = start; i < end; i++) body
+ *
+ * where i is an int variable local to the function, start and end are
+ * int constants (literals or const variables initialized with them; run
+ * --fold first to find more), the test is any of <, <=, >, >= and !=
+ * with i on either side, and the step is one of i++, ++i, i--, --i,
+ * i += c, i -= c, i = i + c and i = i - c for a constant c other than
+ * zero. The body must not store to i, pass it as an out argument, or
+ * break or continue the loop itself. The number of times such a loop
+ * runs is worked out from start, end and the step; a loop that would
+ * run forever, or past the range of an int, is not counted.
+ *
+ * A counted loop is replaced by a block holding a copy of its body for
+ * each time round, with the value i has that time in place of i (see
+ * copy.h), followed by an assignment of the value i is left with. The
+ * variables the body declares are declared afresh in each copy under
+ * names of their own, so that the copies can share the block. Loops
+ * inside others are unrolled first. Once done, the pass says how many
+ * loops it counted and unrolled under the "stats" debug key.
+ */
+
+#ifndef _H_unroll
+#define _H_unroll
+
+class Program;
+class ForStmt;
+class VarDecl;
+
+// Loops that run at most this many times are unrolled by --unroll
+#define DefaultUnrollTrips 8
+
+/* The induction variable of a counted loop, the value it starts with
+ * and what each step adds to it, and how many times the loop runs.
+ */
+struct TripCount {
+    VarDecl *var;
+    int start, step, trips;
+};
+
+/* Function: CountTrips()
+ * ----------------------
+ * Works out how many times loop runs into count. Returns false if it is
+ * not a counted loop.
+ */
+bool CountTrips(ForStmt *loop, TripCount *count);
+
+/* Function: UnrollLoops()
+ * -----------------------
+ * Unrolls in place the counted loops of program that run at most most
+ * times. Returns how many it unrolled.
+ */
+int UnrollLoops(Program *program, int most);
+
+#endif
@@ -11,6 +11,9 @@
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> optionKeys, optionValues;
+static vector<const char*> inputFiles;
+static FailureHandler failureHandler;
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...) {
@@ -18,13 +21,19 @@ void Failure(const char *format, ...) {
   char errbuf[BufferSize];
   
   va_start(args, format);
-  vsprintf(errbuf, format, args);
+  vsnprintf(errbuf, BufferSize, format, args);
   va_end(args);
+  if (failureHandler)
+    failureHandler(errbuf);
   fflush(stdout);
   fprintf(stderr,"\n*** Failure: %s\n\n", errbuf);
   abort();
 }
 
+void SetFailureHandler(FailureHandler handler) {
+  failureHandler = handler;
+}
+
 int IndexOf(const char *key) {
   for (unsigned int i = 0; i < debugKeys.size(); i++)
     if (!strcmp(debugKeys[i], key)) 
@@ -58,19 +67,82 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
-void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
+int OptionIndexOf(const char *key) {
+  for (unsigned int i = 0; i < optionKeys.size(); i++)
+    if (!strcmp(optionKeys[i], key))
+      return i;
+
+  return -1;
+}
+
+const char *GetOption(const char *key) {
+  int k = OptionIndexOf(key);
+  return k == -1 ? NULL : optionValues[k];
+}
+
+void SetOption(const char *key, const char *value) {
+  int k = OptionIndexOf(key);
+  if (k != -1) {
+    optionKeys.erase(optionKeys.begin() + k);
+    optionValues.erase(optionValues.begin() + k);
+  }
+  if (value) {
+    optionKeys.push_back(key);
+    optionValues.push_back(value);
+  }
+}
+
+static bool Listed(const char *name, const char *names[]) {
+  for (int i = 0; names && names[i]; i++)
+    if (strcmp(name, names[i]) == 0) return true;
+  return false;
+}
+
+bool ParseCommandLine(int argc, char *argv[], const char *valued[], const char *known[]) {
+  int first = 1;
+  for (; first < argc; first++) {
+    if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+      SetOption("output", argv[++first]);
+      continue;
+    }
+    if (strncmp(argv[first], "--", 2) != 0)
+      break;
+    char *name = argv[first] + 2;
+    char *equals = strchr(name, '=');
+    if (equals) *equals = '\0'; // split name=value in place
+    if (known && !Listed(name, known)) {
+      fprintf(stderr, "glc: unknown option --%s\n", name);
+      return false;
+    }
+    if (!equals && Listed(name, valued) && first + 1 < argc)
+      SetOption(name, argv[++first]);
+    else
+      SetOption(name, equals ? equals + 1 : "");
+  }
+  for (; first < argc && argv[first][0] != '-'; first++)
+    inputFiles.push_back(argv[first]);
+
+  if (first == argc)
+    return true;
   
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
+  if (strcmp(argv[first], "-d") != 0) { // next arg is not -d
     printf("Incorrect Use:   ");
     for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
     printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
+    printf("Correct Usage:   [--option[=value] ...] [-o file] [file ...] -d <debug-key-1> <debug-key-2> ... \n");
     exit(2);
   }
 
-  for (int i = 2; i < argc; i++)
+  for (int i = first + 1; i < argc; i++)
     SetDebugForKey(argv[i], true);
+  return true;
 }
 
+
+int NumInputFiles() {
+  return inputFiles.size();
+}
+
+const char *GetInputFile(int n) {
+  return inputFiles[n];
+}
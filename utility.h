@@ -23,6 +23,19 @@
 
 void Failure(const char *format, ...);
 
+/**
+ * Function: SetFailureHandler()
+ * Usage: SetFailureHandler(ThrowFailure);
+ * ---------------------------------------
+ * Installs a function that Failure() (and so Assert()) hands the
+ * formatted message to instead of printing it and aborting. The handler
+ * must not return; the library uses one that throws so that a failure
+ * unwinds back to glc_check(). Pass NULL to restore the default.
+ */
+
+typedef void (*FailureHandler)(const char *message);
+void SetFailureHandler(FailureHandler handler);
+
 /**
  * Macro: Assert()
  * Usage: Assert(num > 0);
@@ -73,14 +86,52 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: GetOption()
+ * Usage: const char *dir = GetOption("cache-dir");
+ * -----------------------------------------------
+ * Returns the value given for the named option on the command line
+ * ("" if it was given without =value), or NULL if it was not given.
+ */
+
+const char *GetOption(const char *key);
+
+/**
+ * Function: SetOption()
+ * Usage: SetOption("emit-ast", NULL);
+ * ----------------------------------
+ * Sets an option as if it had been given on the command line. Passing
+ * a NULL value clears it.
+ */
+
+void SetOption(const char *key, const char *value);
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the options and debugging flags from the command line.  Leading
+ * arguments of the form --name or --name=value set options, see
+ * GetOption. The options named in the NULL-terminated array valued
+ * always take a value, which may also be given as the next argument
+ * (--name value), and -o file sets the option "output". If known is
+ * given, an option not named in it is reported on stderr and false
+ * returned. Arguments after the options that do not start with - name
+ * input files, see GetInputFile. Verifies that the next argument, if
+ * any, is -d, and then interpret all the arguments that follow as being
+ * flags to turn on.
+ */
+
+bool ParseCommandLine(int argc, char *argv[], const char *valued[] = NULL,
+                      const char *known[] = NULL);
+
+/**
+ * Function: NumInputFiles(), GetInputFile()
+ * Usage: for (int i = 0; i < NumInputFiles(); i++) Check(GetInputFile(i));
+ * ------------------------------------------------------------------------
+ * The input files named on the command line, in order.
  */
 
-void ParseCommandLine(int argc, char *argv[]);
+int NumInputFiles();
+const char *GetInputFile(int n);
      
 #endif